@@ -0,0 +1,158 @@
+/****************************************************************************
+ * BufferLevel.cpp                                                          *
+ ****************************************************************************
+ * Copyright (C) 2026                                                       *
+ *                                                                          *
+ * Created on: Oct 19, 2026                                                 *
+ * Authors: agent <agent@local>                                             *
+ *                                                                          *
+ * This program is free software: you can redistribute it and/or modify     *
+ * it under the terms of the GNU General Public License as published by     *
+ * the Free Software Foundation, either version 3 of the License, or        *
+ * (at your option) any later version.                                      *
+ *                                                                          *
+ * This program is distributed in the hope that it will be useful,          *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ * GNU General Public License for more details.                             *
+ *                                                                          *
+ * You should have received a copy of the GNU General Public License        *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.     *
+ ****************************************************************************/
+
+#include "BufferLevel.h"
+#include "DebugAdapter.h"
+
+namespace dashp2p {
+
+bool BufferLevel::ifValid = false;
+ContentIdSegment BufferLevel::firstSeg(-1, -1, -1, -1);
+int64_t BufferLevel::firstByte = 0;
+ContentIdSegment BufferLevel::lastSeg(-1, -1, -1, -1);
+int64_t BufferLevel::lastByte = 0;
+int64_t BufferLevel::midBytes = 0;
+int64_t BufferLevel::midUsec = 0;
+std::deque<int64_t> BufferLevel::midSegUsec;
+pair<int64_t, int64_t> BufferLevel::level(0, 0);
+vector<BufferLevel::Callback> BufferLevel::callbacks;
+
+void BufferLevel::reset()
+{
+    ifValid = false;
+    level = pair<int64_t, int64_t>(0, 0);
+}
+
+void BufferLevel::cleanup()
+{
+    reset();
+    callbacks.clear();
+}
+
+pair<int64_t, int64_t> BufferLevel::update(const Contour& contour, const StreamPosition& nextPos)
+{
+    const pair<int64_t, int64_t> oldLevel = level;
+
+    if(!nextPos.valid()) {
+        reset();
+    } else {
+        if(!ifValid || !matches(contour, firstSeg) || !matches(contour, lastSeg) || !consume(contour, nextPos)) {
+            DBGMSG("Rebuilding buffer level at %s.", nextPos.toString().c_str());
+            rebuild(nextPos);
+        }
+        extend(contour);
+        level = compute();
+    }
+
+    if(level != oldLevel) {
+        for(unsigned i = 0; i < callbacks.size(); ++i)
+            callbacks[i](level.first, level.second);
+    }
+
+    return level;
+}
+
+bool BufferLevel::matches(const Contour& contour, const ContentIdSegment& segId)
+{
+    return contour.contains(segId);
+}
+
+void BufferLevel::rebuild(const StreamPosition& nextPos)
+{
+    firstSeg = nextPos.segId;
+    firstByte = nextPos.byte;
+    lastSeg = nextPos.segId;
+    lastByte = nextPos.byte;
+    midBytes = 0;
+    midUsec = 0;
+    midSegUsec.clear();
+    ifValid = true;
+}
+
+bool BufferLevel::consume(const Contour& contour, const StreamPosition& nextPos)
+{
+    while(firstSeg != nextPos.segId) {
+        if(firstSeg == lastSeg || !contour.hasNext(firstSeg))
+            return false;
+        firstSeg = contour.getNext(firstSeg);
+        firstByte = 0;
+        if(firstSeg != lastSeg) {
+            const DashSegment& seg = SegmentStorage::get(firstSeg);
+            midBytes -= seg.getTotalSize();
+            midUsec -= midSegUsec.front();
+            midSegUsec.pop_front();
+        }
+    }
+    if(nextPos.byte < firstByte || (firstSeg == lastSeg && nextPos.byte > lastByte))
+        return false;
+    firstByte = nextPos.byte;
+    return true;
+}
+
+void BufferLevel::extend(const Contour& contour)
+{
+    for(;;)
+    {
+        /* Crossing a segment boundary requires the next segment to be in the contour, which might happen only later. */
+        if(lastByte > 0 && lastByte == SegmentStorage::getTotalSize(lastSeg)) {
+            if(!contour.hasNext(lastSeg))
+                break;
+            if(lastSeg != firstSeg) {
+                const DashSegment& seg = SegmentStorage::get(lastSeg);
+                const int64_t usec = seg.getMediaTime(seg.getTotalSize());
+                midBytes += seg.getTotalSize();
+                midUsec += usec;
+                midSegUsec.push_back(usec);
+            }
+            lastSeg = contour.getNext(lastSeg);
+            lastByte = 0;
+            continue;
+        }
+        if(!SegmentStorage::dataAvailable(StreamPosition(lastSeg, lastByte)))
+            break;
+        lastByte += SegmentStorage::get(lastSeg).getContigInterval(lastByte).second;
+    }
+}
+
+pair<int64_t, int64_t> BufferLevel::compute()
+{
+    /* By media time, as in SegmentStorage::getContigInterval(). */
+    if(firstSeg == lastSeg) {
+        if(lastByte == firstByte)
+            return pair<int64_t, int64_t>(0, 0);
+        const DashSegment& seg = SegmentStorage::get(firstSeg);
+        const int64_t bytes = lastByte - firstByte;
+        return pair<int64_t, int64_t>(seg.getMediaTime(firstByte, bytes), bytes);
+    }
+
+    const DashSegment& segFirst = SegmentStorage::get(firstSeg);
+    const int64_t bytesFirst = segFirst.getTotalSize() - firstByte;
+    pair<int64_t, int64_t> ret(segFirst.getMediaTime(firstByte, bytesFirst) + midUsec, bytesFirst + midBytes);
+    if(lastByte > 0) {
+        const DashSegment& segLast = SegmentStorage::get(lastSeg);
+        ret.first += segLast.getMediaTime(lastByte);
+        ret.second += lastByte;
+    }
+    return ret;
+}
+
+} /* namespace dashp2p */
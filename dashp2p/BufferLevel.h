@@ -0,0 +1,88 @@
+/****************************************************************************
+ * BufferLevel.h                                                            *
+ ****************************************************************************
+ * Copyright (C) 2026                                                       *
+ *                                                                          *
+ * Created on: Oct 19, 2026                                                 *
+ * Authors: agent <agent@local>                                             *
+ *                                                                          *
+ * This program is free software: you can redistribute it and/or modify     *
+ * it under the terms of the GNU General Public License as published by     *
+ * the Free Software Foundation, either version 3 of the License, or        *
+ * (at your option) any later version.                                      *
+ *                                                                          *
+ * This program is distributed in the hope that it will be useful,          *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ * GNU General Public License for more details.                             *
+ *                                                                          *
+ * You should have received a copy of the GNU General Public License        *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.     *
+ ****************************************************************************/
+
+#ifndef BUFFERLEVEL_H_
+#define BUFFERLEVEL_H_
+
+#include "Contour.h"
+#include "SegmentStorage.h"
+#include <deque>
+#include <utility>
+#include <vector>
+using std::pair;
+using std::vector;
+
+namespace dashp2p {
+
+/**
+ * Incrementally maintained amount of contiguous data (usec, bytes) ahead of the playback position.
+ *
+ * The tracker remembers the next byte to be played and the first byte following it that is not yet available, together with
+ * the totals of the complete segments in between. update() only moves these two positions forward, so its cost is proportional
+ * to the data that arrived or was played since the last call, and get() is O(1). The result equals
+ * SegmentStorage::getContigInterval(nextPos, contour), except that the media time of a complete segment in between is the one
+ * it had when the tracker reached its end (it may become exact only later, see FragmentParser). If the contour changed under
+ * the tracker (e.g., the last segment was replaced by another representation) or playback jumped, the state is rebuilt from
+ * the playback position.
+ *
+ * Subscribers are notified on every change of the buffer level. All methods must be called with Control's mutex locked.
+ */
+class BufferLevel
+{
+public:
+    typedef void (*Callback)(int64_t usec, int64_t bytes);
+
+public:
+    static void reset();
+    /* Resets and drops all subscribers. */
+    static void cleanup();
+    /* Synchronizes with the playback position nextPos and with newly arrived data. Returns the buffer level (usec, bytes). */
+    static pair<int64_t, int64_t> update(const Contour& contour, const StreamPosition& nextPos);
+    /* Buffer level (usec, bytes) as of the last update(). */
+    static pair<int64_t, int64_t> get() {return level;}
+    static void subscribe(Callback cb) {callbacks.push_back(cb);}
+
+private:
+    BufferLevel(){}
+    virtual ~BufferLevel(){}
+    static bool matches(const Contour& contour, const ContentIdSegment& segId);
+    static void rebuild(const StreamPosition& nextPos);
+    /* Returns false if nextPos is not between the current playback position and the end of available data. */
+    static bool consume(const Contour& contour, const StreamPosition& nextPos);
+    static void extend(const Contour& contour);
+    static pair<int64_t, int64_t> compute();
+
+private:
+    static bool ifValid;
+    static ContentIdSegment firstSeg;   // segment of the next byte to be played
+    static int64_t firstByte;
+    static ContentIdSegment lastSeg;    // segment of the first byte not available
+    static int64_t lastByte;
+    static int64_t midBytes;            // complete segments strictly between firstSeg and lastSeg
+    static int64_t midUsec;
+    static std::deque<int64_t> midSegUsec; // media time of each of them, as added to midUsec
+    static pair<int64_t, int64_t> level;
+    static vector<Callback> callbacks;
+};
+
+} /* namespace dashp2p */
+#endif /* BUFFERLEVEL_H_ */
@@ -47,23 +47,15 @@ string ContentIdSegment::toString() const
 bool ContentIdSegment::operator==(const ContentId& other) const
 {
     if(other.getType() == ContentType_Segment)
-        return operator==(dynamic_cast<const ContentIdSegment&>(other));
+        return operator==(static_cast<const ContentIdSegment&>(other));
     else
         return false;
 }
 
-bool ContentIdSegment::operator==(const ContentIdSegment& other) const
-{
-    return (   _periodIndex == other._periodIndex
-            && _adaptationSetIndex == other._adaptationSetIndex
-            && _bitRate == other._bitRate
-            && _segmentIndex == other._segmentIndex);
-}
-
 bool ContentIdSegment::operator<(const ContentId& other) const
 {
     if(other.getType() == ContentType_Segment)
-        return operator<(dynamic_cast<const ContentIdSegment&>(other));
+        return operator<(static_cast<const ContentIdSegment&>(other));
     else
         return ContentType_Segment < other.getType();
 }
@@ -25,6 +25,8 @@
 
 #include "DebugAdapter.h"
 //#include "PeerId.h"
+#include <cstdint>
+#include <functional>
 #include <string>
 #include <sstream>
 using std::ostringstream;
@@ -88,11 +90,15 @@ public:
 	bool valid() const {return (_periodIndex >= 0 && _adaptationSetIndex >= 0 && _bitRate >= 0 && _segmentIndex >= 0);}
 
 	virtual bool operator==(const ContentId& other) const;
-	virtual bool operator==(const ContentIdSegment& other) const;
 	virtual bool operator!=(const ContentId& other) const {return ! operator==(other);}
-	virtual bool operator!=(const ContentIdSegment& other) const {return ! operator==(other);}
 	virtual bool operator<(const ContentId& contentId) const;
-	virtual bool operator<(const ContentIdSegment& other) const;
+	/* Non-virtual overloads, used when both sides are known to be segments. */
+	bool operator==(const ContentIdSegment& other) const {
+	    return (_segmentIndex == other._segmentIndex && _bitRate == other._bitRate
+	            && _adaptationSetIndex == other._adaptationSetIndex && _periodIndex == other._periodIndex);
+	}
+	bool operator!=(const ContentIdSegment& other) const {return ! operator==(other);}
+	bool operator<(const ContentIdSegment& other) const;
 
 private:
 	int _periodIndex;
@@ -101,6 +107,36 @@ private:
 	int _segmentIndex;
 };
 
+/* Compact value-type key of a segment: period (8 bits), adaptation set (8 bits), representation (16 bits) and segment (32 bits)
+ * indices packed into 64 bits. Representation indices are assigned by whoever owns the key space (see SegmentStorage). */
+class SegmentKey
+{
+public:
+	SegmentKey(): key(~(uint64_t)0) {}
+	SegmentKey(int periodIndex, int adaptationSetIndex, int representationIndex, int segmentIndex):
+	    key(((uint64_t)(uint8_t)periodIndex << 56) | ((uint64_t)(uint8_t)adaptationSetIndex << 48)
+	            | ((uint64_t)(uint16_t)representationIndex << 32) | (uint32_t)segmentIndex)
+	{
+	    dp2p_assert(periodIndex >= 0 && periodIndex < 256 && adaptationSetIndex >= 0 && adaptationSetIndex < 256
+	            && representationIndex >= 0 && representationIndex < 65536 && segmentIndex >= 0);
+	}
+	int periodIndex() const {return key >> 56;}
+	int adaptationSetIndex() const {return (key >> 48) & 0xff;}
+	int representationIndex() const {return (key >> 32) & 0xffff;}
+	int segmentIndex() const {return key & 0xffffffff;}
+	bool valid() const {return key != ~(uint64_t)0;}
+	uint64_t get() const {return key;}
+	bool operator==(const SegmentKey& other) const {return key == other.key;}
+	bool operator!=(const SegmentKey& other) const {return key != other.key;}
+	bool operator<(const SegmentKey& other) const {return key < other.key;}
+private:
+	uint64_t key;
+};
+
+struct SegmentKeyHash {
+	size_t operator()(const SegmentKey& k) const {return std::hash<uint64_t>()(k.get());}
+};
+
 #if 0
 class ContentIdGeneric: public ContentId
 {
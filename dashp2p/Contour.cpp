@@ -23,85 +23,183 @@
 #include "Contour.h"
 #include "DebugAdapter.h"
 #include <assert.h>
+#include <algorithm>
 
 #ifdef DBGMSG
 # undef DBGMSG
 # define DBGMSG(...)
 #endif
 
-using std::pair;
-
 namespace dashp2p {
 
+void Contour::clear()
+{
+    initBitRate = -1;
+    first = -1;
+    periodIndex = -1;
+    adaptationSetIndex = -1;
+    c = std::make_shared<ContourVector>();
+    companionAdaptationSetIndex = -1;
+    companionFirst = -1;
+    cc.reset();
+    following.reset();
+}
+
 ContentIdSegment Contour::getStart() const
 {
-    dp2p_assert(!c.empty());
-    ContourMap::const_iterator it = c.begin();
-    dp2p_assert(c.count(it->first) == 1);
-    ContentIdSegment segId(0, 0, it->second, it->first);
-    return segId;
+    dp2p_assert(!empty());
+    return (initBitRate != -1) ? get(0) : get(first);
 }
 
-bool Contour::hasNext(const ContentIdSegment& segId) const
+bool Contour::contains(int segmentIndex) const
+{
+    if(segmentIndex == 0)
+        return initBitRate != -1;
+    return !c->empty() && segmentIndex >= first && segmentIndex < first + (int)c->size();
+}
+
+bool Contour::contains(const ContentIdSegment& segId) const
 {
-    /* Find given segment in the map */
-    pair<ContourMap::const_iterator, ContourMap::const_iterator> range = c.equal_range(segId.segmentIndex());
-    dp2p_assert(range.first != c.end() && distance(range.first, range.second) == 1);
+    if(segId.periodIndex() != periodIndex)
+        return following && following->contains(segId);
+    if(segId.adaptationSetIndex() == adaptationSetIndex)
+        return contains(segId.segmentIndex()) && get(segId.segmentIndex()).bitRate() == segId.bitRate();
+    if(!isCompanion(segId))
+        return false;
+    const int j = segId.segmentIndex() - companionFirst;
+    return j >= 0 && j < (int)cc->bitRates.size() && cc->bitRates[j] == segId.bitRate();
+}
 
-    return (range.second != c.end());
+ContentIdSegment Contour::get(int segmentIndex) const
+{
+    dp2p_assert_v(contains(segmentIndex), "Segment %d not in the contour: %s. Probably a bug.", segmentIndex, toString().c_str());
+    const int bitRate = (segmentIndex == 0) ? initBitRate : (*c)[segmentIndex - first];
+    return ContentIdSegment(periodIndex, adaptationSetIndex, bitRate, segmentIndex);
+}
+
+bool Contour::hasNext(const ContentIdSegment& segId) const
+{
+    return getNext(segId).valid();
 }
 
 ContentIdSegment Contour::getNext(const ContentIdSegment& segId) const
 {
-    DBGMSG("Asking for next segment to (%d, %d).", segId.repId(), segId.segNr());
+    DBGMSG("Asking for next segment to (%d, %d).", segId.bitRate(), segId.segmentIndex());
 
-    /* Find given segment in the map */
-    pair<ContourMap::const_iterator, ContourMap::const_iterator> range = c.equal_range(segId.segmentIndex());
-    if(range.first == c.end()) {
-        DBGMSG("Not found. Probably a bug.");
-        dp2p_assert(0);
-    } else if(distance(range.first, range.second) != 1) {
-        DBGMSG("More than one element for given segment Nr. Bug?");
-        dp2p_assert(0);
+    if(following && segId.periodIndex() != periodIndex)
+        return following->getNext(segId);
+
+    /* The last segment of a period is followed by the initialization segment of the next one. If given segment is the last one, return an invalid SegId */
+    const ContentIdSegment ret = next(segId);
+    if(!ret.valid() && following)
+        return following->getStart();
+    return ret;
+}
+
+void Contour::setNext(const ContentIdSegment& nextSeg)
+{
+    /* The next period, or one that already follows. */
+    if(following || (!empty() && nextSeg.periodIndex() != periodIndex)) {
+        if(following) {
+            detachFollowing();
+        } else {
+            dp2p_assert_v(nextSeg.periodIndex() == periodIndex + 1 && nextSeg.segmentIndex() <= 1 && !c->empty(),
+                    "Contour ends in period %d with: %s, trying to continue with %s. Probably a bug.", periodIndex, toString().c_str(), nextSeg.toString().c_str());
+            following = std::make_shared<Contour>();
+        }
+        following->setNext(nextSeg);
+        return;
     }
-    //dp2p_assert(range.first != c.end() && range.second != c.end() && distance(range.first, range.second) == 1);
 
-    /* If given segment is the last one, return an invalid SegId */
-    if(range.second == c.end()) {
-        return ContentIdSegment(-1, -1, -1, -1);
+    if(empty()) {
+        periodIndex = nextSeg.periodIndex();
+        adaptationSetIndex = nextSeg.adaptationSetIndex();
+    } else {
+        dp2p_assert_v(nextSeg.periodIndex() == periodIndex && nextSeg.adaptationSetIndex() == adaptationSetIndex,
+                "Contour is for (period %d, adaptation set %d), trying to add a segment of (period %d, adaptation set %d). Probably a bug.",
+                periodIndex, adaptationSetIndex, nextSeg.periodIndex(), nextSeg.adaptationSetIndex());
     }
 
-    const ContentIdSegment segNext(0, 0, range.second->second, range.second->first);
-    dp2p_assert(segNext.segmentIndex() == segId.segmentIndex() + 1 || segId.segmentIndex() == 0);
+    if(nextSeg.segmentIndex() == 0) {
+        if(!empty()) {
+            ERRMSG("Trying to set next segment to (RepId: %d, SegNr: %d) but this SegNr is already in the Contour.", nextSeg.bitRate(), nextSeg.segmentIndex());
+            ERRMSG("Contour: %s.", toString().c_str());
+        }
+        dp2p_assert(empty());
+        initBitRate = nextSeg.bitRate();
+        return;
+    }
 
-    DBGMSG("Found segment (%d, %d).", segNext.repId(), segNext.segNr());
+    detach();
+    if(c->empty()) {
+        first = nextSeg.segmentIndex();
+    } else {
+        const int lastSegNr = first + c->size() - 1;
+        dp2p_assert_v(nextSeg.segmentIndex() == lastSegNr + 1, "Last segment in the contour: %d, trying to add as next: %d. Probably a bug.", lastSegNr, nextSeg.segmentIndex());
+    }
+    c->push_back(nextSeg.bitRate());
 
-    range = c.equal_range(segNext.segmentIndex());
-    if(range.first == c.end() || distance(range.first, range.second) != 1) {
-        DBGMSG("Asked for next segment in the contour for (RepId: %d, SegNr: %d). Map contains (RepId: %d, SegNr: %d). Probably a bug.",
-                segId.bitRate(), segId.segmentIndex(), segNext.bitRate(), segNext.segmentIndex());
-        dp2p_assert(0);
+    /* Nothing attached to it yet. */
+    if(cc) {
+        detachCompanion();
+        cc->end.push_back(cc->end.empty() ? 0 : cc->end.back());
     }
-    return segNext;
 }
 
-void Contour::setNext(const ContentIdSegment& nextSeg)
+void Contour::setNextCompanion(const ContentIdSegment& nextSeg)
 {
-    pair<ContourMap::const_iterator, ContourMap::const_iterator> rangeNext = c.equal_range(nextSeg.segmentIndex());
-    if(rangeNext.first != c.end()) {
-        ERRMSG("Trying to set next segment to (RepId: %d, SegNr: %d) but this SegNr is already in the Contour.", nextSeg.bitRate(), nextSeg.segmentIndex());
-        ERRMSG("Contour: %s.", toString().c_str());
+    if(following) {
+        detachFollowing();
+        following->setNextCompanion(nextSeg);
+        return;
     }
-    dp2p_assert(rangeNext.second == c.end());
 
-    if(!c.empty()) {
-        ContourMap::const_iterator it = c.end();
-        --it;
-        const int lastSegNr = it->first;
-        dp2p_assert_v(lastSegNr == 0 || nextSeg.segmentIndex() == lastSegNr + 1, "Last segment in the contour: %d, trying to add as next: %d. Probably a bug.", lastSegNr, nextSeg.segmentIndex());
+    dp2p_assert_v(!c->empty() && nextSeg.periodIndex() == periodIndex && nextSeg.adaptationSetIndex() != adaptationSetIndex && nextSeg.segmentIndex() > 0,
+            "Cannot attach %s to the contour: %s. Probably a bug.", nextSeg.toString().c_str(), toString().c_str());
+
+    if(!cc) {
+        companionAdaptationSetIndex = nextSeg.adaptationSetIndex();
+        companionFirst = nextSeg.segmentIndex();
+        cc = std::make_shared<Companion>();
+        cc->end.assign(c->size(), 0);
+    } else {
+        dp2p_assert_v(nextSeg.adaptationSetIndex() == companionAdaptationSetIndex && nextSeg.segmentIndex() == getLastCompanion() + 1,
+                "Last companion segment in the contour: %d, trying to add as next: %s. Probably a bug.", getLastCompanion(), nextSeg.toString().c_str());
+        detachCompanion();
     }
+    cc->bitRates.push_back(nextSeg.bitRate());
+    ++cc->end.back();
+}
 
-    c.insert(pair<int,int>(nextSeg.segmentIndex(), nextSeg.bitRate()));
+int Contour::getMainIndex(const ContentIdSegment& segId) const
+{
+    if(following && segId.periodIndex() != periodIndex)
+        return following->getMainIndex(segId);
+    if(!isCompanion(segId))
+        return segId.segmentIndex();
+    dp2p_assert(contains(segId));
+    /* First media segment whose attached companion segments end after segId. */
+    const int j = segId.segmentIndex() - companionFirst;
+    return first + (std::upper_bound(cc->end.begin(), cc->end.end(), j) - cc->end.begin());
+}
+
+void Contour::replaceLast(const ContentIdSegment& seg)
+{
+    dp2p_assert(!empty());
+    if(following) {
+        detachFollowing();
+        following->replaceLast(seg);
+        return;
+    }
+    if(c->empty()) {
+        dp2p_assert_v(seg.segmentIndex() == 0, "Last segment in the contour: 0, trying to replace it by: %d. Probably a bug.", seg.segmentIndex());
+        initBitRate = seg.bitRate();
+        return;
+    }
+    const int lastSegNr = first + c->size() - 1;
+    dp2p_assert_v(lastSegNr == seg.segmentIndex(), "Last segment in the contour: %d, trying to replace it by: %d. Probably a bug.", lastSegNr, seg.segmentIndex());
+    detach();
+    c->back() = seg.bitRate();
 }
 
 string Contour::toString() const
@@ -109,11 +207,81 @@ string Contour::toString() const
     string ret;
     ret.reserve(1024);
     char tmp[1024];
-    for(ContourMap::const_iterator it = c.begin(); it != c.end(); ++it) {
-        sprintf(tmp, "(%d,%d)", it->first, it->second);
+    if(initBitRate != -1) {
+        sprintf(tmp, "(%d,%d)", 0, initBitRate);
         ret.append(tmp);
     }
+    for(unsigned i = 0; i < c->size(); ++i) {
+        sprintf(tmp, "(%d,%d)", first + (int)i, (*c)[i]);
+        ret.append(tmp);
+        for(int j = cc ? companionFrom(i) : 0; cc && j < cc->end[i]; ++j) {
+            sprintf(tmp, "+(%d,%d)", companionFirst + j, cc->bitRates[j]);
+            ret.append(tmp);
+        }
+    }
+    if(following) {
+        sprintf(tmp, " period %d: ", following->periodIndex);
+        ret.append(tmp);
+        ret.append(following->toString());
+    }
     return ret;
 }
 
+const Contour* Contour::getPeriod(int periodIndex) const
+{
+    if(empty())
+        return nullptr;
+    if(periodIndex == this->periodIndex)
+        return this;
+    return following ? following->getPeriod(periodIndex) : nullptr;
+}
+
+/*
+ * Private methods
+ */
+void Contour::detach()
+{
+    if(c.use_count() != 1)
+        c = std::make_shared<ContourVector>(*c);
+}
+
+void Contour::detachCompanion()
+{
+    if(cc.use_count() != 1)
+        cc = std::make_shared<Companion>(*cc);
+}
+
+void Contour::detachFollowing()
+{
+    if(following.use_count() != 1)
+        following = std::make_shared<Contour>(*following);
+}
+
+ContentIdSegment Contour::next(const ContentIdSegment& segId) const
+{
+    dp2p_assert_v(cc ? contains(segId) : contains(segId.segmentIndex()), "%s not in the contour: %s. Probably a bug.", segId.toString().c_str(), toString().c_str());
+
+    /* Initialization segment: the first media segment. */
+    if(segId.segmentIndex() == 0)
+        return c->empty() ? ContentIdSegment(-1, -1, -1, -1) : get(first);
+    if(!cc)
+        return (segId.segmentIndex() + 1 < first + (int)c->size()) ? get(segId.segmentIndex() + 1) : ContentIdSegment(-1, -1, -1, -1);
+
+    /* Attached companion segments first, then the next media segment. */
+    int i = 0;
+    int j = 0;
+    if(isCompanion(segId)) {
+        i = getMainIndex(segId) - first;
+        j = segId.segmentIndex() - companionFirst + 1;
+    } else {
+        i = segId.segmentIndex() - first;
+        j = companionFrom(i);
+    }
+    if(j < cc->end[i])
+        return ContentIdSegment(periodIndex, companionAdaptationSetIndex, cc->bitRates[j], companionFirst + j);
+    if(i + 1 < (int)c->size())
+        return get(first + i + 1);
+    return ContentIdSegment(-1, -1, -1, -1);
+}
+
 }
@@ -25,35 +25,94 @@
 
 //#include "Dashp2pTypes.h"
 #include "ContentId.h"
-#include <list>
-#include <map>
-using std::list;
-using std::multimap;
+#include <memory>
+#include <vector>
+using std::vector;
 
 namespace dashp2p {
 
+/* Sequence of segments to be played out: optionally the initialization segment (index 0) followed by consecutive media segments
+ * of one period and adaptation set, each with its chosen bit-rate. Look-ups by segment index are O(1). Copies share the underlying
+ * vector until one of them is modified (copy-on-write), so taking a snapshot is cheap.
+ *
+ * Optionally, a companion track (separate audio) of another adaptation set of the same period: its consecutive media segments
+ * are attached to media segments of the main track and played right after the one they are attached to. Segment indexes
+ * (contains(int), get(int), getStartSegment(), ...) always refer to the main track.
+ *
+ * Playback may continue in the following periods. Each of them has a contour of its own, starting with its initialization
+ * segment (left out if it is identical to the one of the previous period) and chained behind the previous one. Look-ups by segment (contains(const ContentIdSegment&), getNext(), ...) cover
+ * the whole chain, those by segment index only the first period (see getPeriod()). Segments are appended to the last period. */
 class Contour
 {
 /* Public methods */
 public:
-    Contour(): c() {}
+    Contour(): initBitRate(-1), first(-1), periodIndex(-1), adaptationSetIndex(-1), c(std::make_shared<ContourVector>()),
+               companionAdaptationSetIndex(-1), companionFirst(-1), cc(), following() {}
     virtual ~Contour() {}
-    bool empty() const {return c.empty();}
-    int size() const {return c.size();}
-    void clear() {c.clear();}
+    bool empty() const {return initBitRate == -1 && c->empty();}
+    int size() const {return (initBitRate != -1 ? 1 : 0) + c->size() + (following ? following->size() : 0);}
+    void clear();
     ContentIdSegment getStart() const;
+    /* If the segment with the given index is in the contour. */
+    bool contains(int segmentIndex) const;
+    /* If segId, of either track, is in the contour. */
+    bool contains(const ContentIdSegment& segId) const;
+    /* The segment with the given index. Must be contained. */
+    ContentIdSegment get(int segmentIndex) const;
     bool hasNext(const ContentIdSegment& segId) const;
     ContentIdSegment getNext(const ContentIdSegment& segId) const;
+    /* Appends nextSeg to the last period. The initialization segment of the next period, or its first media segment, starts that one. */
     void setNext(const ContentIdSegment& nextSeg);
+    /* Replaces the last segment by another representation of the same segment. */
+    void replaceLast(const ContentIdSegment& seg);
     string toString() const;
+    /* The part of the contour in the given period, NULL if none. */
+    const Contour* getPeriod(int periodIndex) const;
+
+    /* Appends a media segment to the companion track, attached to the last media segment of the main track. */
+    void setNextCompanion(const ContentIdSegment& nextSeg);
+    /* If the last period has companion segments. */
+    bool hasCompanion() const {return following ? following->hasCompanion() : (cc && !cc->bitRates.empty());}
+    /* If segId belongs to the companion track of its period (also if it is not in the contour). */
+    bool isCompanion(const ContentIdSegment& segId) const {
+        return (following && segId.periodIndex() != periodIndex) ? following->isCompanion(segId) : (cc && segId.adaptationSetIndex() == companionAdaptationSetIndex);
+    }
+    /* Index of the last media segment of the companion track in the last period. -1 if none. */
+    int getLastCompanion() const {return following ? following->getLastCompanion() : (hasCompanion() ? companionFirst + (int)cc->bitRates.size() - 1 : -1);}
+    /* Index of the main track's segment with which segId (contained) is played. */
+    int getMainIndex(const ContentIdSegment& segId) const;
 
 /* Private types */
 private:
-    typedef multimap<int, int> ContourMap;
+    typedef vector<int> ContourVector;
+    class Companion {
+    public:
+        ContourVector bitRates;    // bitRates[j] is the bit-rate of companion media segment companionFirst + j
+        ContourVector end;         // end[i]: companion segments [end[i - 1], end[i]) (relative to companionFirst) follow media segment first + i
+    };
+
+/* Private methods */
+private:
+    /* Must be called before modifying c (cc, respectively). */
+    void detach();
+    void detachCompanion();
+    void detachFollowing();
+    /* Next segment after segId (contained) in its period, an invalid one if it is the last one. */
+    ContentIdSegment next(const ContentIdSegment& segId) const;
+    /* Companion segments following media segment first + i: [from, to) relative to companionFirst. */
+    int companionFrom(int i) const {return (i == 0) ? 0 : cc->end[i - 1];}
 
 /* Private members */
 private:
-    ContourMap c;
+    int initBitRate;        // bit-rate of the initialization segment, -1 if not in the contour
+    int first;              // index of the first media segment, -1 if none
+    int periodIndex;
+    int adaptationSetIndex;
+    std::shared_ptr<ContourVector> c; // c->at(i) is the bit-rate of media segment first + i
+    int companionAdaptationSetIndex;
+    int companionFirst;     // index of the first companion media segment, -1 if none
+    std::shared_ptr<Companion> cc; // null if there is no companion track
+    std::shared_ptr<Contour> following; // contour of the next period, null if playback does not get there (yet)
 };
 
 }
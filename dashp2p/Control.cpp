@@ -23,6 +23,7 @@
 //#include "Dashp2pTypes.h"
 #include "Utilities.h"
 #include "Control.h"
+#include "BufferLevel.h"
 #include "HttpRequestManager.h"
 #include "TcpConnectionManager.h"
 #include "HttpClientManager.h"
@@ -77,6 +78,13 @@ StreamPosition Control::curPos = StreamPosition();
 CondVar Control::playbackPausedCondvar;
 //Contour Control::contour;
 
+/* Seek related stuff */
+int64_t Control::streamPos = 0;
+map<int64_t, ContentIdSegment> Control::streamSegments;
+int Control::seeksPending = 0;
+StreamPosition Control::restartPos = StreamPosition();
+int64_t Control::seekTime = -1;
+
 /* MPD related stuff. */
 dashp2p::URL Control::splittedMpdUrl;
 //MpdWrapper* Control::mpdWrapper = NULL;
@@ -145,9 +153,18 @@ void Control::init(
 
     /* Playback related stuff */
     Control::curPos = StreamPosition(); /* last byte given to VLC */
+    BufferLevel::reset();
+    BufferLevel::subscribe(displayBufferLevelOverlay);
     ThreadAdapter::condVarInit(&playbackPausedCondvar);
     //Control::contour = Contour();
 
+    /* Seek related stuff */
+    Control::streamPos = 0;
+    Control::streamSegments.clear();
+    Control::seeksPending = 0;
+    Control::restartPos = StreamPosition();
+    Control::seekTime = -1;
+
     /* MPD related stuff. */
     if(mpdUrl.compare("dummy.mpd") == 0)
         Control::splittedMpdUrl = dashp2p::URL();
@@ -267,9 +284,14 @@ void Control::cleanUp()
 
     /* Playback related stuff */
     Control::curPos = StreamPosition();
+    BufferLevel::cleanup();
     ThreadAdapter::condVarDestroy(&Control::playbackPausedCondvar);
     //Control::contour.clear();
 
+    /* Seek related stuff */
+    Control::streamSegments.clear();
+    Control::restartPos = StreamPosition();
+
     /* MPD related stuff. */
     Control::splittedMpdUrl = dashp2p::URL();
     //delete Control::mpdWrapper; Control::mpdWrapper = NULL;
@@ -340,10 +362,16 @@ void* Control::controlThreadMain(void* /*params*/)
     while(state == ControlState_Playing /*|| state == ControlState_Paused*/)
     {
         /* If no actions and no events available -> wait */
+    	/* ... but not beyond the control logic's timer. */
+    	const int64_t toTimer = max<int64_t>(0, min<int64_t>(1000000, controlLogic->getTimer() - Utilities::getTime()));
     	struct timeval selectTimeout;
-    	selectTimeout.tv_sec = 1;
+    	selectTimeout.tv_sec = toTimer / 1000000;
+    	selectTimeout.tv_usec = toTimer % 1000000;
     	/*pair<bool,bool> retSelect =*/ Control::waitSelect(selectTimeout);
 
+    	/* Release HTTP clients that were retired by the control logic. Not under mutex since their threads might be waiting for it. */
+    	HttpClientManager::reap();
+
         /* If there are events, process ONE event. */
         ThreadAdapter::mutexLock(&eventsMutex);
         DBGMSG("Control's main loop: %d events.", events.size());
@@ -357,7 +385,10 @@ void* Control::controlThreadMain(void* /*params*/)
 
         	ThreadAdapter::mutexLock(&mutex);
         	DBGMSG("Processing event: %s.", event->toString().c_str());
+        	const bool isSeek = (event->getType() == Event_Seek);
         	list<ControlLogicAction*> newActions = controlLogic->processEvent(event);
+        	if(isSeek && --seeksPending == 0 && !controlLogic->getContour().empty() && SegmentStorage::dataAvailable(getNextPosition()))
+        		ThreadAdapter::condVarSignal(&playbackPausedCondvar);
         	ThreadAdapter::mutexUnlock(&mutex);
 
         	const int numNewActions = newActions.size();
@@ -376,6 +407,24 @@ void* Control::controlThreadMain(void* /*params*/)
         	ThreadAdapter::mutexUnlock(&eventsMutex);
         }
 
+        /* If the control logic's timer expired, let it run. */
+        if(controlLogic->getTimer() <= Utilities::getTime())
+        {
+        	ThreadAdapter::mutexLock(&mutex);
+        	DBGMSG("Processing event: Timer.");
+        	list<ControlLogicAction*> newActions = controlLogic->processEvent(new ControlLogicEventTimer(BufferLevel::get()));
+        	ThreadAdapter::mutexUnlock(&mutex);
+
+        	const int numNewActions = newActions.size();
+
+        	ThreadAdapter::mutexLock(&actionsMutex);
+        	actions.splice(actions.end(), newActions);
+        	uint64_t buf = numNewActions;
+        	dp2p_assert(8 == write(fdActions, &buf, 8));
+        	DBGMSG("Received %d new actions. Now in total: %d pending actions.", numNewActions, actions.size());
+        	ThreadAdapter::mutexUnlock(&actionsMutex);
+        }
+
         /* If there are actions, process ALL actions. */
         ThreadAdapter::mutexLock(&actionsMutex);
         DBGMSG("Control's main loop: %d actions.", actions.size());
@@ -566,6 +615,15 @@ void Control::displayThroughputOverlay(int /* segNr */, int64_t /* usec */, doub
     //}
 }
 
+void Control::displayBufferLevelOverlay(int64_t usec, int64_t /*bytes*/)
+{
+    if(dashp2p::Utilities::getTime() / 1000000 > lastReportedBufferLevelTime || usec / 1000000 > lastReportedBufferLevel / 1000000) {
+        OverlayAdapter::print(2, "%5s: % 8.0f sec", "Buf", usec / 1e6);
+        lastReportedBufferLevelTime = dashp2p::Utilities::getTime() / 1000000;
+        lastReportedBufferLevel = usec;
+    }
+}
+
 pair<bool,bool> Control::waitSelect(struct timeval selectTimeout)
 {
 	fd_set fdSetRead;
@@ -631,9 +689,12 @@ void Control::httpDataReceived(HttpEventDataReceived& e)
 void Control::httpDataReceived_Mpd(HttpEventDataReceived& e)
 {
 	ThreadAdapter::mutexLock(&eventsMutex);
-	dp2p_assert(HttpRequestManager::getHttpMethod(e.reqId) == HttpMethod_GET && state == ControlState_Playing && HttpRequestManager::getContentLength(e.reqId) > 0);
+	/* Progress of the download (see DashHttp::processNewData()), the length of a chunked MPD is not known before the end. */
+	dp2p_assert(HttpRequestManager::getHttpMethod(e.reqId) == HttpMethod_GET && state == ControlState_Playing
+			&& (!HttpRequestManager::isCompleted(e.reqId) || HttpRequestManager::getContentLength(e.reqId) > 0
+			    || HttpRequestManager::getHdr(e.reqId).statusCode == HTTP_STATUS_CODE_NOT_MODIFIED));
 	DBGMSG("Got (piece of) the MPD, ContentId: %s.", HttpRequestManager::getContentId(e.reqId).toString().c_str());
-	events.push_back(new ControlLogicEventDataReceived(e.tcpConnectionId, e.reqId, e.byteFrom, e.byteTo, pair<int64_t, int64_t>(0,0)));
+	events.push_back(new ControlLogicEventDataReceived(e.tcpConnectionId, e.reqId, e.byteFrom, e.byteTo, e.timestamp, pair<int64_t, int64_t>(0,0)));
 	uint64_t buf = 1;
 	dp2p_assert(8 == write(fdEvents, &buf, 8));
 	DBGMSG("Added new ControlLogicEventDataReceived to the event list.");
@@ -683,7 +744,9 @@ void Control::httpDataReceived_Segment(HttpEventDataReceived& e)
 	default: dp2p_assert(0); break;
 	}
 
-	const ContentIdSegment& segId = dynamic_cast<const ContentIdSegment&>(HttpRequestManager::getContentId(e.reqId));
+	const ContentId& contentId = HttpRequestManager::getContentId(e.reqId);
+	dp2p_assert(contentId.getType() == ContentType_Segment);
+	const ContentIdSegment& segId = static_cast<const ContentIdSegment&>(contentId);
 
 	/* Debug output and sanity checks */
 	switch(HttpRequestManager::getHttpMethod(e.reqId)) {
@@ -714,7 +777,9 @@ void Control::httpDataReceived_Segment(HttpEventDataReceived& e)
 	ThreadAdapter::mutexLock(&mutex);
 	DBGMSG("Locked mutex.");
 
-	dp2p_assert(segId.segmentIndex() <= controlLogic->getStopSegment() && HttpRequestManager::getContentLength(e.reqId) > 0);
+	/* Number of segments might not be known before the first initialization segment (with the segment index) is completed. */
+	dp2p_assert((segId.segmentIndex() == 0 || controlLogic->isAudio(segId) || segId.segmentIndex() <= controlLogic->getStopSegment(segId.periodIndex()))
+	        && (HttpRequestManager::getContentLength(e.reqId) > 0 || HttpRequestManager::getHdr(e.reqId).chunked));
 
 	/* If it is first data of the segment, initialize the corresponding Segment object */
 #if 0
@@ -753,13 +818,14 @@ void Control::httpDataReceived_Segment(HttpEventDataReceived& e)
 	}
 #endif
 
-	DBGMSG("Calculating contig interval.");
-	const pair<int64_t, int64_t> availableContigInterval =
-	        SegmentStorage::getContigInterval(getNextPosition(), controlLogic->getContour());
+	/* While a seek is pending, the position is not known. Data received meanwhile belong to cancelled requests. */
+	const pair<int64_t, int64_t> availableContigInterval = (seeksPending > 0) ? pair<int64_t, int64_t>(0, 0)
+	        : BufferLevel::update(controlLogic->getContour(), getNextPosition());
 
 	DBGMSG("Have %" PRId64 " bytes (%" PRId64 " us) of contiguous data in the storage.", availableContigInterval.second, availableContigInterval.first);
 
 	// TODO: underrun handling!
+	/* With progress events, this happens as soon as the first bytes of the next segment are in the storage, not only when it is complete. */
 	if(state == ControlState_Playing && availableContigInterval.second > 0)
 		resumePlayback();
 
@@ -770,23 +836,11 @@ void Control::httpDataReceived_Segment(HttpEventDataReceived& e)
 	//    fprintf(fileSecDownloaded, "% 17.6f % 17.6f\n", dashp2p::Utilities::now(), usecDownloaded / 1e6);
 	//}
 
-	/* overlay output */
-	if(dashp2p::Utilities::getTime() / 1000000 > lastReportedBufferLevelTime || availableContigInterval.first / 1000000 > lastReportedBufferLevel / 1000000) {
-//#ifdef __ANDROID__
-//	    if(!withHandover)
-//	        DisplayHandover::displayOverlay(2, "%5s: % 8.0f sec", "Buf", availableContigInterval.first / 1e6);
-//#else
-	    OverlayAdapter::print(2, "%5s: % 8.0f sec", "Buf", availableContigInterval.first / 1e6);
-//#endif
-	    lastReportedBufferLevelTime = dashp2p::Utilities::getTime() / 1000000;
-	    lastReportedBufferLevel = availableContigInterval.first;
-	}
-
 	//dp2p_assert(state != ControlState_Paused);
 	ThreadAdapter::mutexUnlock(&mutex);
 
 	ThreadAdapter::mutexLock(&eventsMutex);
-	events.push_back(new ControlLogicEventDataReceived(e.tcpConnectionId, e.reqId, e.byteFrom, e.byteTo, availableContigInterval));
+	events.push_back(new ControlLogicEventDataReceived(e.tcpConnectionId, e.reqId, e.byteFrom, e.byteTo, e.timestamp, availableContigInterval));
 	uint64_t buf = 1;
 	dp2p_assert(8 == write(fdEvents, &buf, 8));
 	DBGMSG("Added new ControlLogicEventDataReceived to the event list.");
@@ -841,7 +895,7 @@ void Control::httpDisconnect(const HttpEventDisconnect& e)
 	ThreadAdapter::mutexUnlock(&eventsMutex);
 }
 
-int Control::vlcCb(char** buffer, int* bufferSize, int* bytesReturned, int64_t* usecReturned)
+int Control::vlcCb(char** buffer, int* bufferSize, int* bytesReturned, int64_t* usecReturned, DataBuffer** dataBuffer)
 {
     /* If terminating or stopTime passed, signal EOF */
     // TODO: set b_eof of access_t when EOF reached!
@@ -885,9 +939,12 @@ int Control::vlcCb(char** buffer, int* bufferSize, int* bytesReturned, int64_t*
     //else if(state != ControlState_Paused && absNow >= startTime - startTimeTolerance)
     {
         //startTimeCrossed = true;
-        if(controlLogic->getContour().empty() || !SegmentStorage::dataAvailable(getNextPosition())) {
+        if(seeksPending > 0 || controlLogic->getContour().empty() || !SegmentStorage::dataAvailable(getNextPosition())) {
         	int64_t waitingTime = -1;
-            if(controlLogic->getContour().empty()) {
+            if(seeksPending > 0) {
+            	waitingTime = 10000;
+                DBGMSG("Seek pending. Will wait %gs until %11.4f.", waitingTime / 1e6, (absNow + waitingTime - Utilities::getReferenceTime()) / 1e6);
+            } else if(controlLogic->getContour().empty()) {
             	waitingTime = 1000000;
                 DBGMSG("We passed startTime but contour is empty. Will wait %gs until %11.4f.", waitingTime / 1e6, (absNow + waitingTime - Utilities::getReferenceTime()) / 1e6);
             } else {
@@ -906,7 +963,7 @@ int Control::vlcCb(char** buffer, int* bufferSize, int* bytesReturned, int64_t*
                 DBGMSG("Back from waiting. Everything is terminating. Will return.");
                 ThreadAdapter::mutexUnlock(&mutex);
                 return 0;
-            } else if(!controlLogic->getContour().empty() && SegmentStorage::dataAvailable(getNextPosition())) { // data available, go on
+            } else if(seeksPending == 0 && !controlLogic->getContour().empty() && SegmentStorage::dataAvailable(getNextPosition())) { // data available, go on
                 DBGMSG("Back from waiting. Data is available.");
             } else { // still no data available, return
                 DBGMSG("Back from waiting. Still no data available. Will return.");
@@ -938,7 +995,7 @@ int Control::vlcCb(char** buffer, int* bufferSize, int* bytesReturned, int64_t*
         }
     }*/
 
-    const pair<int64_t, int64_t> contigIntervalPre = SegmentStorage::getContigInterval(getNextPosition(), controlLogic->getContour());
+    const pair<int64_t, int64_t> contigIntervalPre = BufferLevel::update(controlLogic->getContour(), getNextPosition());
     DBGMSG("We passed startTime and %" PRId64 " bytes (%" PRId64 " us) are available starting from (RepId: %d, SegNr: %d, offset: %" PRId64 ").",
             contigIntervalPre.second, contigIntervalPre.first, curPos.segId.bitRate(), curPos.segId.segmentIndex(), curPos.byte);
 
@@ -962,10 +1019,21 @@ int Control::vlcCb(char** buffer, int* bufferSize, int* bytesReturned, int64_t*
     }
 #endif
 
-    const StreamPosition lastPos = SegmentStorage::getData(getNextPosition(), controlLogic->getContour(), buffer, bufferSize, bytesReturned, usecReturned);
+    const StreamPosition nextPos = getNextPosition();
+    const StreamPosition lastPos = dataBuffer
+            ? SegmentStorage::getDataRef(nextPos, bufferSize[0], dataBuffer, (const char**)buffer, bytesReturned, usecReturned)
+            : SegmentStorage::getData(nextPos, controlLogic->getContour(), buffer, bufferSize, bytesReturned, usecReturned);
     curPos = lastPos;
+    if(bytesReturned[0] > 0) {
+        restartPos = StreamPosition();
+        recordStreamSegments(nextPos, lastPos, bytesReturned[0]);
+        if(seekTime != -1) {
+            Statistics::recordSeek(dashp2p::Utilities::getTime() - seekTime);
+            seekTime = -1;
+        }
+    }
 
-    const pair<int64_t, int64_t> contigIntervalPost = SegmentStorage::getContigInterval(getNextPosition(), controlLogic->getContour());
+    const pair<int64_t, int64_t> contigIntervalPost = BufferLevel::update(controlLogic->getContour(), getNextPosition());
 
 #if 0
     /* Signal if beta is below Bdelay. */
@@ -1016,16 +1084,6 @@ int Control::vlcCb(char** buffer, int* bufferSize, int* bytesReturned, int64_t*
     }
 #endif
 //#endif
-    if(dashp2p::Utilities::getTime() / 1000000 > lastReportedBufferLevelTime || contigIntervalPost.first / 1000000 > lastReportedBufferLevel / 1000000) {
-//#ifdef __ANDROID__
-//        if(!withHandover)
-//            DisplayHandover::displayOverlay(2, "%5s: % 8.0f sec", "Buf", contigIntervalPost.first / 1e6);
-//#else
-        OverlayAdapter::print(2, "%5s: % 8.0f sec", "Buf", contigIntervalPost.first / 1e6);
-//#endif
-        lastReportedBufferLevelTime = dashp2p::Utilities::getTime() / 1000000;
-        lastReportedBufferLevel = contigIntervalPost.first;
-    }
 
     /* Unlock the mutex for storage access. */
     //vlc_mutex_unlock(&storageMutex);
@@ -1043,19 +1101,35 @@ int Control::vlcCb(char** buffer, int* bufferSize, int* bytesReturned, int64_t*
 
 int64_t Control::getPosition()
 {
-	const int64_t segmentSize = SegmentStorage::getTotalSize(curPos.segId);
-	return MpdWrapper::getPosition(curPos.segId, curPos.byte, segmentSize);
+	/* Start of the segment from the MPD, position within the segment from its samples (muxed audio has no duration of its own). */
+	const DashSegment& seg = SegmentStorage::get(curPos.segId);
+	if(seg.duration == 0)
+	    return MpdWrapper::getPosition(curPos.segId, curPos.byte, seg.getTotalSize());
+	return MpdWrapper::getPosition(curPos.segId, 0, seg.getTotalSize()) + seg.getMediaTime(curPos.byte);
 }
 
 std::vector<int64_t> Control::getSwitchingPoints(int _num)
 {
-    if(!curPos.valid() || curPos.segId.segmentIndex() == controlLogic->getStopSegment())
+    if(!curPos.valid())
         return std::vector<int64_t>();
 
-    int num = std::min<int>(_num, controlLogic->getStopSegment() - curPos.segId.segmentIndex());
+    /* Within the separate audio, switching points are those of the video segment it is played with. */
+    const Contour& contour = controlLogic->getContour();
+    const ContentIdSegment curSegId = (contour.isCompanion(curPos.segId) && contour.contains(curPos.segId))
+            ? contour.get(contour.getMainIndex(curPos.segId)) : curPos.segId;
+    const int stopSegment = controlLogic->getStopSegment(curSegId.periodIndex());
+    if(contour.isCompanion(curSegId) || curSegId.segmentIndex() == stopSegment)
+        return std::vector<int64_t>();
+
+    /* Within the period. */
+    const Contour* period = contour.getPeriod(curSegId.periodIndex());
+    int num = std::min<int>(_num, stopSegment - curSegId.segmentIndex());
     std::vector<int64_t> retVal(num);
     for(unsigned i = 0; i < retVal.size(); ++i) {
-    	const ContentIdSegment nextSegId(curPos.segId.periodIndex(), curPos.segId.adaptationSetIndex(), curPos.segId.bitRate(), curPos.segId.segmentIndex() + i);
+    	const int segmentIndex = curSegId.segmentIndex() + i;
+    	/* Segments not yet scheduled are assumed to keep the current bit-rate. */
+    	const ContentIdSegment nextSegId = (period && period->contains(segmentIndex)) ? period->get(segmentIndex)
+    	        : ContentIdSegment(curSegId.periodIndex(), curSegId.adaptationSetIndex(), curSegId.bitRate(), segmentIndex);
     	retVal.at(i) = MpdWrapper::getEndTime(nextSegId);
     }
     return retVal;
@@ -1191,6 +1265,12 @@ bool Control::processActionOpenTcpConnection(const ControlLogicActionOpenTcpConn
 
 bool Control::processActionStartDownload(const ControlLogicActionStartDownload& a)
 {
+    /* The control logic might have retired the connection (e.g., peer fallback) while the action was queued. */
+    if(!HttpClientManager::exists(a.tcpConnectionId)) {
+        DBGMSG("HTTP client for TCP connection %d was retired. Dropping action.", a.tcpConnectionId.numeric());
+        return true;
+    }
+
     DashHttp& http = HttpClientManager::get(a.tcpConnectionId);
 	//dp2p_assert(httpMap.find(a.tcpConnectionId) != httpMap.end());
 
@@ -1203,16 +1283,23 @@ bool Control::processActionStartDownload(const ControlLogicActionStartDownload&
 	list<const ContentId*>::const_iterator it = a.contentIds.begin();
 	list<dashp2p::URL>::const_iterator jt = a.urls.begin();
 	list<HttpMethod>::const_iterator kt = a.httpMethods.begin();
+	list<pair<int64_t, int64_t> >::const_iterator lt = a.byteRanges.begin();
 	while(it != a.contentIds.end())
 	{
 		dp2p_assert(jt != a.urls.end());
 
-		const int reqId = HttpRequestManager::newHttpRequest(a.tcpConnectionId, (*it)->copy(), /*jt->hostName,*/ jt->withoutHostname, true, *kt);
+		const pair<int64_t, int64_t> byteRange = (lt != a.byteRanges.end()) ? *lt++ : pair<int64_t, int64_t>(-1, -1);
+		const int reqId = HttpRequestManager::newHttpRequest(a.tcpConnectionId, (*it)->copy(), /*jt->hostName,*/ jt->withoutHostname, true, *kt, byteRange);
 		//dp2p_assert(requestMap.insert(pair<ReqId, pair<ContentIdSegment, HttpMethod> >(req->reqId, pair<ContentIdSegment, HttpMethod>(*it, HttpMethod_HEAD))).second == true);
 		reqs.push_back(reqId);
 
-		if((*it)->getType() == ContentType_Mpd)
-			Statistics::recordScalarD64("startDownloadMPD", dashp2p::Utilities::getTime());
+		if((*it)->getType() == ContentType_Mpd) {
+			/* Running from a snapshot or refreshing a live MPD: only fetch the MPD if it changed. */
+			if(!MpdWrapper::hasMpd() || !MpdWrapper::isLive())
+				Statistics::recordScalarD64("startDownloadMPD", dashp2p::Utilities::getTime());
+			if(MpdWrapper::hasMpd())
+				HttpRequestManager::setValidators(reqId, MpdWrapper::getEtag(), MpdWrapper::getLastModified());
+		}
 
 		DBGMSG("Starting request nr. %d: %s over interface %s.\n", reqId, (*it)->toString().c_str(),
 				tc.getIfString().c_str());
@@ -1280,7 +1367,9 @@ StreamPosition Control::getNextPosition()
 {
     //DBGMSG("Enter. We are at position: (%d, %d, %" PRId64 ").", curPos.segId.repId(), curPos.segId.segNr(), curPos.byte);
 
-    if(!curPos.valid()) {
+    if(!curPos.valid() && restartPos.valid()) {
+        return restartPos;
+    } else if(!curPos.valid()) {
         dp2p_assert(!controlLogic->getContour().empty());
         ContentIdSegment startSegId = controlLogic->getContour().getStart();
         dp2p_assert(startSegId.segmentIndex() == 0 || startSegId.segmentIndex() == controlLogic->getStartSegment()); // we might start directly with the start segment after a pausing
@@ -1297,14 +1386,134 @@ StreamPosition Control::getNextPosition()
     return StreamPosition(controlLogic->getContour().getNext(curPos.segId), 0);
 }
 
+void Control::recordStreamSegments(const StreamPosition& from, const StreamPosition& to, int numBytes)
+{
+    int64_t offset = streamPos - from.byte;
+    ContentIdSegment segId = from.segId;
+    streamSegments.erase(offset);
+    streamSegments.insert(pair<int64_t, ContentIdSegment>(offset, segId));
+    while(segId != to.segId) {
+        offset += SegmentStorage::getTotalSize(segId);
+        segId = controlLogic->getContour().getNext(segId);
+        streamSegments.erase(offset);
+        streamSegments.insert(pair<int64_t, ContentIdSegment>(offset, segId));
+    }
+    streamPos += numBytes;
+}
+
+ContentIdSegment Control::getReferenceSegment(int periodIndex)
+{
+    const int adaptationSetIndex = ControlLogic::getVideoAdaptationSet(periodIndex);
+    const int bitRate = MpdWrapper::getBitrate(RepresentationId(AdaptationSetId(periodIndex, adaptationSetIndex), 0));
+    return ContentIdSegment(periodIndex, adaptationSetIndex, bitRate, 1);
+}
+
+bool Control::seek(int64_t pos)
+{
+    ThreadAdapter::mutexLock(&mutex);
+
+    if(state != ControlState_Playing) {
+        DBGMSG("Not playing. Cannot seek to %" PRId64 ".", pos);
+        ThreadAdapter::mutexUnlock(&mutex);
+        return false;
+    }
+
+    /* Segment given to VLC at pos, if any. */
+    map<int64_t, ContentIdSegment>::const_iterator it = streamSegments.upper_bound(pos);
+    bool known = false;
+    if(it != streamSegments.begin()) {
+        --it;
+        known = (pos - it->first < SegmentStorage::getTotalSize(it->second));
+    }
+
+    const Contour& contour = controlLogic->getContour();
+    int64_t segmentStart = pos;
+    if(known && seeksPending == 0 && contour.contains(it->second))
+    {
+        /* Still in the contour, so the data are in the storage. Just continue from there. */
+        DBGMSG("Seek to %" PRId64 ": byte %" PRId64 " of %s, in the contour.", pos, pos - it->first, it->second.toString().c_str());
+        segmentStart = it->first;
+        restartPos = StreamPosition(it->second, pos - it->first);
+    }
+    else
+    {
+        if(!controlLogic->canSeek() || (known && it->second.segmentIndex() == 0)) {
+            DBGMSG("Cannot seek to %" PRId64 " now.", pos);
+            ThreadAdapter::mutexUnlock(&mutex);
+            return false;
+        }
+
+        /* The control logic restarts the downloads. In the middle of a segment, it has to use the same representation. */
+        int periodIndex = -1;
+        int segmentIndex = -1;
+        int bitRate = -1;
+        if(known && contour.isCompanion(it->second)) {
+            /* Separate audio: restart with the video segment it belongs to. */
+            segmentStart = it->first;
+            periodIndex = it->second.periodIndex();
+            segmentIndex = MpdWrapper::findSegment(getReferenceSegment(periodIndex), MpdWrapper::getStartTime(it->second));
+            restartPos = StreamPosition();
+        } else if(known) {
+            segmentStart = it->first;
+            periodIndex = it->second.periodIndex();
+            segmentIndex = it->second.segmentIndex();
+            if(pos > segmentStart) {
+                bitRate = it->second.bitRate();
+                restartPos = StreamPosition(it->second, pos - segmentStart);
+            } else {
+                restartPos = StreamPosition();
+            }
+        } else {
+            /* Beyond what VLC got: extrapolated at the last bit-rate, possibly into a later period. Times relative to the start of the presentation. */
+            const ContentIdSegment segId = streamSegments.empty() ? contour.getStart() : streamSegments.rbegin()->second;
+            const int64_t offset = streamSegments.empty() ? 0 : streamSegments.rbegin()->first + SegmentStorage::getTotalSize(segId);
+            const int64_t time = std::max<int64_t>(0, MpdWrapper::getPeriodStart(segId.periodIndex())) + ((segId.segmentIndex() == 0) ? 0 : MpdWrapper::getEndTime(segId))
+                    + 8000000 * std::max<int64_t>(0, pos - offset) / segId.bitRate();
+            periodIndex = MpdWrapper::findPeriod(time);
+            segmentIndex = MpdWrapper::findSegment(getReferenceSegment(periodIndex), time - std::max<int64_t>(0, MpdWrapper::getPeriodStart(periodIndex)));
+            restartPos = StreamPosition();
+        }
+        DBGMSG("Seek to %" PRId64 ": period %d, segment %d, byte %" PRId64 ".", pos, periodIndex, segmentIndex, pos - segmentStart);
+
+        /* The decoder needs the initialization segment of the period if it was last given segments of another one. */
+        const bool initSegment = !streamSegments.empty() && streamSegments.rbegin()->second.periodIndex() != periodIndex;
+
+        ++seeksPending;
+        ThreadAdapter::mutexLock(&eventsMutex);
+        events.push_back(new ControlLogicEventSeek(periodIndex, segmentIndex, bitRate, initSegment));
+        uint64_t buf = 1;
+        dp2p_assert(8 == write(fdEvents, &buf, 8));
+        ThreadAdapter::mutexUnlock(&eventsMutex);
+    }
+
+    /* What VLC gets from now on replaces what it got after segmentStart. */
+    streamSegments.erase(streamSegments.lower_bound(segmentStart), streamSegments.end());
+    streamPos = pos;
+    curPos = StreamPosition();
+    seekTime = dashp2p::Utilities::getTime();
+    BufferLevel::reset();
+
+    ThreadAdapter::mutexUnlock(&mutex);
+    return true;
+}
+
 bool Control::eof()
 {
 	if(!MpdWrapper::hasMpd()) {
 		return false;
 	} else if(forcedEof) {
 		return true;
-	} else if(controlLogic->getStopSegment() > 0 && curPos.segId.segmentIndex() == controlLogic->getStopSegment()
+	} else if(!MpdWrapper::isLive() && curPos.segId.periodIndex() != MpdWrapper::getNumPeriods() - 1) {
+		/* Only the last period ends the stream. */
+		return false;
+	} else if(!MpdWrapper::isLive() && controlLogic->getStopSegment(curPos.segId.periodIndex()) > 0 && curPos.segId.segmentIndex() == controlLogic->getStopSegment(curPos.segId.periodIndex())
+	        && curPos.byte == SegmentStorage::getTotalSize(curPos.segId) - 1
+	        && !controlLogic->getContour().hasCompanion()) {
+		return true;
+	} else if(!MpdWrapper::isLive() && controlLogic->getContour().hasCompanion() && controlLogic->getContour().contains(curPos.segId)
+	        && controlLogic->getContour().getMainIndex(curPos.segId) == controlLogic->getStopSegment(curPos.segId.periodIndex()) && !controlLogic->getContour().hasNext(curPos.segId)
 	        && curPos.byte == SegmentStorage::getTotalSize(curPos.segId) - 1) {
+		/* With separate audio, the stream ends with the last audio segment after the stop segment. */
 		return true;
 	}
 	return false;
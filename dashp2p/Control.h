@@ -77,9 +77,19 @@ public:
      * @param bufferSize Size of the allocated memory.
      * @param bytesReturned Number of bytes actually returned.
      * @param secReturned Approximate number of seconds returned.
+     * @param dataBuffer If given, nothing is copied: buffer is set to point into the returned dataBuffer, which the caller must unref().
+     *                   At most bufferSize bytes (if > 0) from the current segment are returned.
      * @return 0 if EOF, otherwise 1.
      */
-    static int vlcCb(char** buffer, int* bufferSize, int* bytesReturned, int64_t* usecReturned);
+    static int vlcCb(char** buffer, int* bufferSize, int* bytesReturned, int64_t* usecReturned, DataBuffer** dataBuffer = NULL);
+
+    /**
+     * Interface to the DASH-P2P plugin file. Continues the stream given to VLC at byte offset pos.
+     * Within data already given to VLC, the position is exact. Beyond, it is extrapolated at the bit-rate of the last segment given to VLC
+     * and playback continues with the segment containing the resulting time.
+     * @return False if seeking is not possible (yet).
+     */
+    static bool seek(int64_t pos);
 
     /* Stream related stuff */
     static dashp2p::URL& getMpdUrl() {return splittedMpdUrl;}
@@ -93,6 +103,8 @@ public:
 
     /* Overlay related stuff */
     static void displayThroughputOverlay(int segNr, int64_t usec, double thrpt);
+    /* Subscribed to BufferLevel. */
+    static void displayBufferLevelOverlay(int64_t usec, int64_t bytes);
 
     //static void toFile (ContentIdSegment segId, string& fileName){SegmentStorage::toFile(segId,fileName);};
 
@@ -120,6 +132,12 @@ protected:
 
     static StreamPosition getNextPosition();
 
+    /* Records which segments were given to VLC at which offset. */
+    static void recordStreamSegments(const StreamPosition& from, const StreamPosition& to, int numBytes);
+
+    /* A segment of the video played in the given period, to find segments by time. */
+    static ContentIdSegment getReferenceSegment(int periodIndex);
+
     static bool eof();
 
     //static void closeConnection(const TcpConnectionId& tcpConnectionId);
@@ -153,6 +171,18 @@ protected:
     static StreamPosition curPos;
     static CondVar playbackPausedCondvar;
 
+    /* Seek related stuff */
+    // offset in the stream given to VLC of the next byte
+    static int64_t streamPos;
+    // stream offset of the first byte of each segment given to VLC
+    static map<int64_t, ContentIdSegment> streamSegments;
+    // seeks not yet processed by the control logic; no data are given to VLC meanwhile
+    static int seeksPending;
+    // if valid, playback continues here after a seek, otherwise at the beginning of the contour
+    static StreamPosition restartPos;
+    // time of the last seek, -1 once data were given to VLC after it
+    static int64_t seekTime;
+
     /* MPD related stuff. */
     static dashp2p::URL splittedMpdUrl;
     //static MpdWrapper* mpdWrapper;
@@ -26,20 +26,34 @@
 #include "ControlLogicAction.h"
 #include "HttpRequestManager.h"
 #include "SegmentStorage.h"
+#include "TrackMuxer.h"
 #include "Statistics.h"
 
+#include <algorithm>
 #include <cassert>
+#include <limits>
 
 namespace dashp2p {
 
+bool ControlLogic::fastStart = false;
+int64_t ControlLogic::liveDelay = -1;
+bool ControlLogic::lowLatency = false;
+bool ControlLogic::separateAudio = true;
+
 ControlLogic::ControlLogic(int width, int height)
   : state(NO_MPD),
     mutex(),
     width(width),
     height(height),
+    periodIndex(0),
+    adaptationSetIndex(0),
+    audioAdaptationSetIndex(-1),
     bitRates(),
+    audioBitRates(),
     ifData(),
     contour(),
+    startSegment(1),
+    timer(std::numeric_limits<int64_t>::max()),
     //mpdWrapper(nullptr),
     //mpdDataField(nullptr),
     pendingActions()
@@ -126,6 +140,19 @@ list<ControlLogicAction*> ControlLogic::processEvent(ControlLogicEvent* e)
     	break;
     }
 
+    case Event_Seek: {
+    	dp2p_assert(state == HAVE_MPD);
+    	const ControlLogicEventSeek& event = dynamic_cast<const ControlLogicEventSeek&>(*e);
+    	actions = processEventSeek(event);
+    	break;
+    }
+
+    case Event_Timer: {
+    	const ControlLogicEventTimer& event = dynamic_cast<const ControlLogicEventTimer&>(*e);
+    	actions = processEventTimer(event);
+    	break;
+    }
+
     default:
         THROW_RUNTIME("Got unexpected event: %s.", e->toString().c_str());
     }
@@ -194,13 +221,17 @@ int ControlLogic::getStartSegment() const
 
 	//int ret = 1 + startPosition / mpdWrapper->getNominalSegmentDuration(periodIndex, adaptationSetIndex, representationIndex);
 	//dp2p_assert(ret > 0 && ret < mpdWrapper->getNumSegments(periodIndex, adaptationSetIndex, representationIndex));
-	return 1;
+	return startSegment;
 }
 
 int ControlLogic::getStopSegment() const
 {
-	const int periodIndex = 0;
-	const int adaptationSetIndex = 0;
+	return getStopSegment(periodIndex);
+}
+
+int ControlLogic::getStopSegment(int periodIndex) const
+{
+	const int adaptationSetIndex = getVideoAdaptationSet(periodIndex);
 	const int representationIndex = 0;
 
 	int ret;
@@ -212,14 +243,39 @@ int ControlLogic::getStopSegment() const
 	return ret;
 }
 
+int ControlLogic::getVideoAdaptationSet(int periodIndex)
+{
+	const int ret = MpdWrapper::findAdaptationSet(periodIndex, "video");
+	return (ret != -1) ? ret : 0;
+}
+
+int ControlLogic::findSeparateAudio(int periodIndex)
+{
+	return (MpdWrapper::findAdaptationSet(periodIndex, "video") != -1) ? MpdWrapper::findAdaptationSet(periodIndex, "audio") : -1;
+}
+
+bool ControlLogic::isAudio(const ContentIdSegment& segId) const
+{
+	return TrackMuxer::enabled() && TrackMuxer::isAudio(segId);
+}
+
+int ControlLogic::getClosestBitRate(int bitRate) const
+{
+	int ret = bitRates.at(0);
+	for(unsigned i = 1; i < bitRates.size() && bitRates.at(i) <= bitRate; ++i)
+		ret = bitRates.at(i);
+	return ret;
+}
+
 list<ControlLogicAction*> ControlLogic::processEventDataReceived(ControlLogicEventDataReceived& e)
 {
 	switch(HttpRequestManager::getContentType(e.reqId))
 	{
 
 	case ContentType_Mpd:
-		dp2p_assert(state == NO_MPD);
-		dp2p_assert(contour.empty());
+		/* We may have started before the MPD is complete, from a snapshot, or the MPD is refreshed (live). */
+		dp2p_assert(state == NO_MPD || MpdWrapper::parsing() || MpdWrapper::fromSnapshot() || MpdWrapper::isLive());
+		dp2p_assert(state == HAVE_MPD || contour.empty());
 		return processEventDataReceivedMpd(e);
 
 	/*case ContentType_MpdPeer:
@@ -310,6 +366,57 @@ bool ControlLogic::ackActionRequestCompleted (const ContentId& contentId)
 	return ret;
 }
 
+int ControlLogic::ackActionsSegmentDownloads()
+{
+	int actionCount = 0;
+	for(ActionList::iterator it = pendingActions.begin(); it != pendingActions.end(); )
+	{
+		if((*it)->getType() == Action_StartDownload) {
+			ControlLogicActionStartDownload* a = dynamic_cast<ControlLogicActionStartDownload*>(*it);
+			if(!a->contentIds.empty() && a->contentIds.front()->getType() == ContentType_Segment && a->httpMethods.front() == HttpMethod_GET) {
+				delete a;
+				it = pendingActions.erase(it);
+				++actionCount;
+				continue;
+			}
+		}
+		++it;
+	}
+	DBGMSG("Removed %d actions from pending actions list. Pending: %d.", actionCount, pendingActions.size());
+	return actionCount;
+}
+
+bool ControlLogic::isRequested(const ContentId& contentId) const
+{
+	for(ActionList::const_iterator it = pendingActions.begin(); it != pendingActions.end(); ++it)
+	{
+		if((*it)->getType() != Action_StartDownload)
+			continue;
+		const ControlLogicActionStartDownload* a = dynamic_cast<const ControlLogicActionStartDownload*>(*it);
+		for(list<const ContentId*>::const_iterator jt = a->contentIds.begin(); jt != a->contentIds.end(); ++jt)
+			if(**jt == contentId)
+				return true;
+	}
+	return false;
+}
+
+bool ControlLogic::canSeek() const
+{
+	if(state != HAVE_MPD || contour.empty())
+		return false;
+
+	for(ActionList::const_iterator it = pendingActions.begin(); it != pendingActions.end(); ++it)
+	{
+		if((*it)->getType() != Action_StartDownload)
+			continue;
+		const ControlLogicActionStartDownload* a = dynamic_cast<const ControlLogicActionStartDownload*>(*it);
+		for(list<const ContentId*>::const_iterator jt = a->contentIds.begin(); jt != a->contentIds.end(); ++jt)
+			if((*jt)->getType() == ContentType_Segment && static_cast<const ContentIdSegment*>(*jt)->segmentIndex() == 0)
+				return false;
+	}
+	return true;
+}
+
 /*bool ControlLogic::ackActionDisconnect (const TcpConnectionId& tcpConnectionId)
 {
 	int ret = 0;
@@ -337,16 +444,13 @@ bool ControlLogic::ackActionRequestCompleted (const ContentId& contentId)
 
 unsigned ControlLogic::getIndex(int bitrate)
 {
-    for(unsigned i = 0; i < bitRates.size(); ++i) {
-        if(bitRates.at(i) == bitrate) {
-            return i;
-        }
-    }
-    dp2p_assert(false);
-    return 0;
+    /* bitRates is sorted (see MpdWrapper::getBitrates()). */
+    const vector<int>::const_iterator it = std::lower_bound(bitRates.begin(), bitRates.end(), bitrate);
+    dp2p_assert(it != bitRates.end() && *it == bitrate);
+    return it - bitRates.begin();
 }
 
-void ControlLogic::processEventDataReceivedMpd_Completed(const ContentIdMpd& contentIdMpd)
+bool ControlLogic::processEventDataReceivedMpd_Parse(const ContentIdMpd& contentIdMpd)
 {
 	//dp2p_assert(mpdDataField->full());
 
@@ -359,29 +463,69 @@ void ControlLogic::processEventDataReceivedMpd_Completed(const ContentIdMpd& con
 #endif
 
 	/* Logging. */
-	Statistics::recordScalarD64("completedDownloadMPD", dashp2p::Utilities::getTime());
+	if(SegmentStorage::get(contentIdMpd).completed())
+		Statistics::recordStartupEvent("completedDownloadMPD", dashp2p::Utilities::getTime());
 
-	/* Parse MPD */
+	/* Parse MPD, as far as received */
 	//MpdWrapper::init(mpdDataField->getCopy((char*)malloc(mpdDataField->getReservedSize() * sizeof(char)), mpdDataField->getReservedSize()), mpdDataField->getReservedSize()); // we reserve this memory with malloc since it will be freed by the VLC XML plugin which uses free()
-	MpdWrapper::init(contentIdMpd);
+	const bool hadMpd = MpdWrapper::hasMpd();
+	MpdWrapper::parse(contentIdMpd);
 	//delete mpdDataField;
 	//mpdDataField = nullptr;
 
 	/* Logging. */
-	DBGMSG("Parsed MPD file.");
-	Statistics::recordScalarD64("parsedMPD", dashp2p::Utilities::getTime());
-	Statistics::recordScalarDouble("videoDuration", MpdWrapper::getVideoDuration() / 1e6);
+	if(!MpdWrapper::parsing()) {
+		DBGMSG("Parsed MPD file.");
+		Statistics::recordStartupEvent("parsedMPD", dashp2p::Utilities::getTime());
+	}
+
+	if(hadMpd || !MpdWrapper::hasMpd())
+		return false;
+
+	if(MpdWrapper::parsing())
+		INFOMSG("MPD file partially downloaded and parsed. Enough to start.");
+	else
+		INFOMSG("MPD file downloaded and parsed.");
+	processMpdAvailable();
+
+	return true;
+}
+
+void ControlLogic::processMpdAvailable()
+{
+	Statistics::recordStartupEvent("startableMPD", dashp2p::Utilities::getTime());
+	if(MpdWrapper::getVideoDuration() >= 0)
+		Statistics::recordScalarDouble("videoDuration", MpdWrapper::getVideoDuration() / 1e6);
 
 	/* Give MPD to the Statistics module */
 	//Statistics::setMpdWrapper(mpdWrapper);
 
-	INFOMSG("MPD file downloaded and parsed.");
 	state = HAVE_MPD;
 
-	/* Show the list of available spatial resolutions. */
-	const int periodIndex = 0;
-	const int adaptationSetIndex = 0;
+	/* Start with the first period. Live: with the last one that started, as far behind the live edge as configured, as suggested by the MPD
+	 * or by three segments (none in low-latency mode, where the live edge is the segment being produced). */
 	const int representationIndex = 0;
+	const int64_t now = dashp2p::Utilities::getAbsTime();
+	int64_t delay = 0;
+	periodIndex = 0;
+	if(MpdWrapper::isLive())
+	{
+		const int64_t nominalDuration = MpdWrapper::getNominalSegmentDuration(0, getVideoAdaptationSet(0), representationIndex);
+		delay = (liveDelay >= 0) ? liveDelay
+				: (MpdWrapper::getSuggestedPresentationDelay() >= 0) ? MpdWrapper::getSuggestedPresentationDelay() : lowLatency ? 0 : 3 * nominalDuration;
+		for(int p = MpdWrapper::getNumPeriods() - 1; p > 0; --p) {
+			const int bitRate = MpdWrapper::getBitrate(RepresentationId(AdaptationSetId(p, getVideoAdaptationSet(p)), representationIndex));
+			if(MpdWrapper::getAvailabilityTime(ContentIdSegment(p, getVideoAdaptationSet(p), bitRate, 1), lowLatency) <= now - delay) {
+				periodIndex = p;
+				break;
+			}
+		}
+	}
+	adaptationSetIndex = getVideoAdaptationSet(periodIndex);
+	if(MpdWrapper::getNumPeriods() > 1)
+		INFOMSG("%d periods. Starting with period %d.", MpdWrapper::getNumPeriods(), periodIndex);
+
+	/* Show the list of available spatial resolutions. */
 	std::string resolutions = MpdWrapper::printSpatialResolutions(periodIndex, adaptationSetIndex);
 	INFOMSG("Available spatial resolutions:\n%s.", resolutions.c_str());
 	INFOMSG("Segment duration: %.3f.", MpdWrapper::getNominalSegmentDuration(periodIndex, adaptationSetIndex, representationIndex) / 1e6);
@@ -418,6 +562,18 @@ void ControlLogic::processEventDataReceivedMpd_Completed(const ContentIdMpd& con
 		abort();
 	}
 
+	setPeriod(periodIndex);
+
+	if(MpdWrapper::isLive())
+	{
+		const int bitRate = MpdWrapper::getBitrate(RepresentationId(AdaptationSetId(periodIndex, adaptationSetIndex), representationIndex));
+		const ContentIdSegment segId(periodIndex, adaptationSetIndex, bitRate, 1);
+		this->startSegment = MpdWrapper::getLiveEdgeSegment(segId, now - delay, lowLatency);
+		INFOMSG("Live stream%s. Live edge: segment %d. Starting %.3f sec behind it, with segment %d.", lowLatency ? " (low latency)" : "",
+				MpdWrapper::getLiveEdgeSegment(segId, now, lowLatency), delay / 1e6, this->startSegment);
+		Statistics::recordScalarDouble("liveDelay", delay / 1e6);
+	}
+
 	/* Sanity checks and debug output */
 	int startSegment = getStartSegment();
 	int stopSegment = getStopSegment();
@@ -425,26 +581,66 @@ void ControlLogic::processEventDataReceivedMpd_Completed(const ContentIdMpd& con
 	DBGMSG("Setting startSegment: %d, stopSegment: %d.", startSegment, stopSegment);
 }
 
+void ControlLogic::setPeriod(int periodIndex)
+{
+	this->periodIndex = periodIndex;
+	adaptationSetIndex = getVideoAdaptationSet(periodIndex);
+
+	/* The audio, if it is separate. */
+	const int separateAudioIndex = findSeparateAudio(periodIndex);
+	audioAdaptationSetIndex = -1;
+	audioBitRates.clear();
+	if(separateAudioIndex != -1 && !separateAudio) {
+		INFOMSG("Ignoring the separate audio (period %d, adaptation set %d).", periodIndex, separateAudioIndex);
+	} else if(separateAudioIndex != -1) {
+		const vector<int> audio = MpdWrapper::getBitrates(periodIndex, separateAudioIndex, 0, 0);
+		const ContentIdSegment videoInit(periodIndex, adaptationSetIndex, MpdWrapper::getBitrates(periodIndex, adaptationSetIndex, 0, 0).at(0), 0);
+		const ContentIdSegment audioInit(periodIndex, separateAudioIndex, audio.at(0), 0);
+		if(MpdWrapper::usesSegmentIndex(videoInit) || MpdWrapper::usesSegmentIndex(audioInit)) {
+			WARNMSG("Separate audio (period %d, adaptation set %d) in single-file representations is not supported. Playing without audio.", periodIndex, separateAudioIndex);
+		} else {
+			audioAdaptationSetIndex = separateAudioIndex;
+			audioBitRates = audio;
+			TrackMuxer::init(periodIndex, adaptationSetIndex, audioAdaptationSetIndex);
+		}
+	}
+
+	/* The spatial resolution selected at the start might not be offered in later periods. */
+	bitRates = MpdWrapper::getBitrates(periodIndex, adaptationSetIndex, width, height);
+	if(bitRates.empty()) {
+		WARNMSG("Period %d does not offer %d x %d. Using all of its representations.", periodIndex, width, height);
+		bitRates = MpdWrapper::getBitrates(periodIndex, adaptationSetIndex, 0, 0);
+	}
+	DBGMSG("Period %d: adaptation set %d, %d representations, audio adaptation set %d.", periodIndex, adaptationSetIndex, (int)bitRates.size(), audioAdaptationSetIndex);
+}
+
 ControlLogicAction* ControlLogic::createActionDownloadSegments(list<const ContentId*> segIds, const TcpConnectionId& tcpConnectionId, HttpMethod httpMethod) const
 {
 	list<dashp2p::URL> urls;
 	list<HttpMethod> httpMethods;
+	list<pair<int64_t, int64_t> > byteRanges;
+	string url;
 	for(list<const ContentId*>::iterator it = segIds.begin(); it != segIds.end(); ++it)
 	{
 	    const ContentIdSegment& segId = *dynamic_cast<const ContentIdSegment*>(*it);
 
 		//DBGMSG("%s", (*it)->toString().c_str());
-		urls.push_back(dashp2p::Utilities::splitURL(MpdWrapper::getSegmentURL(segId)));
+		MpdWrapper::getSegmentURL(segId, url);
+		urls.push_back(dashp2p::Utilities::splitURL(url));
 		httpMethods.push_back(httpMethod);
+		byteRanges.push_back((httpMethod == HttpMethod_GET) ? MpdWrapper::getSegmentRange(segId) : pair<int64_t, int64_t>(-1, -1));
 
+		/* Separate audio does not count for the buffer level (see BufferLevel), the video it is played with does. The size of
+		 * the video initialization segment changes when the audio track is added to it. */
 		if(!SegmentStorage::initialized(segId)) {
 		    DBGMSG("Segment not yet available in the storage. Initializing.");
-		    SegmentStorage::initSegment(segId, -1, MpdWrapper::getSegmentDuration(segId));
+		    const bool isJoint = TrackMuxer::enabled() && TrackMuxer::isJointInit(segId);
+		    SegmentStorage::initSegment(segId, isJoint ? -1 : MpdWrapper::getSegmentSize(segId), isAudio(segId) ? 0 : MpdWrapper::getSegmentDuration(segId));
 		} else {
 		    DBGMSG("Segment aleady registered in the storage module.");
 		}
 	}
-	return new ControlLogicActionStartDownload(tcpConnectionId, segIds, urls, httpMethods);
+	return new ControlLogicActionStartDownload(tcpConnectionId, segIds, urls, httpMethods, byteRanges);
 }
 
 }
@@ -59,13 +59,40 @@ public:
     //virtual list<ControlLogicAction*> actionRejected(ControlLogicAction* a);
 
     virtual int getStartSegment() const;
+    /* Last segment of the period being downloaded, respectively, of the given period. */
     virtual int getStopSegment() const;
+    int getStopSegment(int periodIndex) const;
+    /* Period being downloaded. Playback may still be in the previous one. */
+    int getPeriod() const {return periodIndex;}
+    /* Adaptation set played in the given period: the video, if the MPD tells, otherwise the first one. */
+    static int getVideoAdaptationSet(int periodIndex);
+    /* Adaptation set of the audio of the given period if it is separate from the video, -1 if none. Without media types, there is none. */
+    static int findSeparateAudio(int periodIndex);
+    /* If segId is of the separate audio (see TrackMuxer). Its segment numbers are not those of the video. */
+    bool isAudio(const ContentIdSegment& segId) const;
+
+    /* If a seek can be processed now: the MPD is known and no initialization segment is being downloaded. */
+    virtual bool canSeek() const;
 
     //virtual const MpdWrapper* getMpdWrapper() const {return mpdWrapper;}
     virtual const Contour& getContour() const {return contour;}
 
     //virtual void setStartPosition(int64_t startPosition) {this->startPosition = startPosition;}
 
+    /* Fast start: open a second connection while the MPD is downloaded and fetch the initialization
+     * and the start segment in parallel instead of pipelined. */
+    static void setFastStart(bool fastStart) {ControlLogic::fastStart = fastStart;}
+    /* Live: distance [us] from the live edge at which playback starts. -1: as suggested by the MPD. */
+    static void setLiveDelay(int64_t liveDelay) {ControlLogic::liveDelay = liveDelay;}
+    /* Live: request segments as soon as the server starts delivering them (SegmentTemplate@availabilityTimeOffset, chunked transfer),
+     * not only once they are complete. */
+    static void setLowLatency(bool lowLatency) {ControlLogic::lowLatency = lowLatency;}
+    /* If the audio is in an adaptation set of its own, download it along with the video and mux it into the stream (see TrackMuxer). */
+    static void setSeparateAudio(bool separateAudio) {ControlLogic::separateAudio = separateAudio;}
+
+    /* Time [us, see Utilities::getTime()] at which the control logic wants to get a ControlLogicEventTimer. INT64_MAX if none. */
+    virtual int64_t getTimer() const {return timer;}
+
 /* Protected methods */
 protected:
 
@@ -80,9 +107,15 @@ protected:
     //virtual list<ControlLogicAction*> processEventPause               (const ControlLogicEventPause& e)          = 0;
     //virtual list<ControlLogicAction*> processEventResumePlayback      (const ControlLogicEventResumePlayback& e) = 0;
     virtual list<ControlLogicAction*> processEventStartPlayback       (const ControlLogicEventStartPlayback& e)  = 0;
+    virtual list<ControlLogicAction*> processEventSeek                (const ControlLogicEventSeek& e)           = 0;
+    virtual list<ControlLogicAction*> processEventTimer               (const ControlLogicEventTimer& e)          = 0;
 
     //virtual bool ackActionConnected        (const ConnectionId& connId);
     virtual bool ackActionRequestCompleted (const ContentId& contentId);
+    /* Forgets all pending segment downloads (GET), e.g., when they were cancelled. Returns the number of removed actions. */
+    virtual int ackActionsSegmentDownloads();
+    /* If a download of contentId is pending. */
+    bool isRequested(const ContentId& contentId) const;
     //virtual bool ackActionDisconnect       (const TcpConnectionId& tcpConnectionId);
 
     //virtual list<ControlLogicAction*> actionRejectedStartDownload(ControlLogicActionStartDownload* a) = 0;
@@ -90,7 +123,14 @@ protected:
     virtual IfData getInitialIf() const {return ifData.at(0);}
 
     virtual unsigned getIndex(int bitrate);
-    virtual void processEventDataReceivedMpd_Completed(const ContentIdMpd& contentIdMpd);
+    /* Parses the MPD data received so far. Returns true (once) when enough is known to start. Then, state is HAVE_MPD. */
+    virtual bool processEventDataReceivedMpd_Parse(const ContentIdMpd& contentIdMpd);
+    /* Once the MPD can be used, parsed or from the MpdCache: selects the start period and the spatial resolution. Then, state is HAVE_MPD. */
+    virtual void processMpdAvailable();
+    /* Continues downloading with the given period: selects its adaptation sets and representations. */
+    virtual void setPeriod(int periodIndex);
+    /* Highest bit-rate of the period not above bitRate. The lowest one if there is none. */
+    int getClosestBitRate(int bitRate) const;
     virtual ControlLogicAction* createActionDownloadSegments(list<const ContentId*> segIds, const TcpConnectionId& tcpConnectionId, HttpMethod httpMethod) const;
 
 /* Protected types */
@@ -106,17 +146,36 @@ protected:
     int width;
     int height;
 
-    /* Stores the vector of available representations. Assumes it to be sorted in ascending order. */
+    /* Period being downloaded, its adaptation set played (see getVideoAdaptationSet()) and the one of the separate audio, -1 if none.
+     * Set by setPeriod(). */
+    int periodIndex;
+    int adaptationSetIndex;
+    int audioAdaptationSetIndex;
+
+    /* Stores the vector of available representations of the period. Assumes it to be sorted in ascending order. */
     vector<int> bitRates;
+    /* Same for the separate audio. */
+    vector<int> audioBitRates;
 
     std::vector<IfData> ifData;
 
     Contour contour;
 
+    /* First segment to play, changed by seeking. */
+    int startSegment;
+
+    /* See getTimer(). */
+    int64_t timer;
+
     //MpdWrapper* mpdWrapper;
     //DataField* mpdDataField;
 
     ActionList pendingActions;
+
+    static bool fastStart;
+    static int64_t liveDelay;
+    static bool lowLatency;
+    static bool separateAudio;
 };
 
 }
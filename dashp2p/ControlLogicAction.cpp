@@ -32,7 +32,7 @@ ControlLogicAction* ControlLogicActionStartDownload::copy() const
 	for(list<const ContentId*>::const_iterator it = contentIds.begin(); it != contentIds.end(); ++it) {
 		contentIds_copy.push_back((*it)->copy());
 	}
-	return new ControlLogicActionStartDownload(tcpConnectionId, contentIds_copy, urls, httpMethods);
+	return new ControlLogicActionStartDownload(tcpConnectionId, contentIds_copy, urls, httpMethods, byteRanges);
 }
 
 string ControlLogicActionStartDownload::toString() const
@@ -89,8 +89,9 @@ public:
 class ControlLogicActionStartDownload: public ControlLogicAction
 {
 public:
-    ControlLogicActionStartDownload(const TcpConnectionId& tcpConnectionId, list<const ContentId*> contentIds, list<dashp2p::URL> urls, list<HttpMethod> httpMethods)
-      : ControlLogicAction(), tcpConnectionId(tcpConnectionId), contentIds(contentIds), urls(urls), httpMethods(httpMethods) {}
+    ControlLogicActionStartDownload(const TcpConnectionId& tcpConnectionId, list<const ContentId*> contentIds, list<dashp2p::URL> urls, list<HttpMethod> httpMethods,
+            list<pair<int64_t, int64_t> > byteRanges = list<pair<int64_t, int64_t> >())
+      : ControlLogicAction(), tcpConnectionId(tcpConnectionId), contentIds(contentIds), urls(urls), httpMethods(httpMethods), byteRanges(byteRanges) {}
     virtual ~ControlLogicActionStartDownload() {while(!contentIds.empty()){delete contentIds.front(); contentIds.pop_front();}}
     virtual ControlLogicAction* copy() const;
     virtual ControlLogicActionType getType() const {return Action_StartDownload;}
@@ -101,6 +102,7 @@ public:
     list<const ContentId*> contentIds;
     list<dashp2p::URL> urls;
     list<HttpMethod> httpMethods;
+    list<pair<int64_t, int64_t> > byteRanges; // empty if all requests are for whole files
 };
 
 }
@@ -48,6 +48,8 @@ public:
     	//case Event_Pause:          return "Pause";
     	//case Event_ResumePlayback: return "ResumePlayback";
     	case Event_StartPlayback:  return "StartPlayback";
+    	case Event_Seek:           return "Seek";
+    	case Event_Timer:          return "Timer";
     	default: ERRMSG("Unknown ControlLogicEvent type."); throw std::runtime_error("Unknown event type.");
     	}
     	return "";
@@ -94,13 +96,14 @@ public:
 class ControlLogicEventDataReceived: public ControlLogicEvent
 {
 public:
-    ControlLogicEventDataReceived(const TcpConnectionId& tcpConnectionId, int reqId, int64_t byteFrom, int64_t byteTo,
+    ControlLogicEventDataReceived(const TcpConnectionId& tcpConnectionId, int reqId, int64_t byteFrom, int64_t byteTo, int64_t timestamp,
             pair<int64_t, int64_t> availableContigInterval)
       : ControlLogicEvent(),
         tcpConnectionId(tcpConnectionId),
         reqId(reqId),
         byteFrom(byteFrom),
         byteTo(byteTo),
+        timestamp(timestamp),
         availableContigInterval(availableContigInterval)
     {}
     virtual ~ControlLogicEventDataReceived() {}
@@ -111,6 +114,7 @@ public:
     int reqId;
     const int64_t byteFrom;
     const int64_t byteTo;
+    const int64_t timestamp; // [us] time when byteTo was received
     const pair<int64_t, int64_t> availableContigInterval;
     //const bool socketDisconnected;
 };
@@ -163,6 +167,38 @@ public:
     const dashp2p::URL mpdUrl;
 };
 
+
+class ControlLogicEventSeek: public ControlLogicEvent
+{
+public:
+    ControlLogicEventSeek(int periodIndex, int segmentIndex, int bitRate, bool initSegment)
+      : ControlLogicEvent(), periodIndex(periodIndex), segmentIndex(segmentIndex), bitRate(bitRate), initSegment(initSegment) {}
+    virtual ~ControlLogicEventSeek(){}
+    virtual ControlLogicEventType getType() const {return Event_Seek;}
+
+public:
+    /* Playback continues with this segment of this period. */
+    const int periodIndex;
+    const int segmentIndex;
+    /* If not -1, the segment must be taken from this representation (playback continues in the middle of it). */
+    const int bitRate;
+    /* If the decoder needs the initialization segment of the period first: it was last given segments of another one. */
+    const bool initSegment;
+};
+
+
+/* The time requested by the control logic (see ControlLogic::getTimer()) has come. */
+class ControlLogicEventTimer: public ControlLogicEvent
+{
+public:
+    ControlLogicEventTimer(pair<int64_t, int64_t> availableContigInterval): ControlLogicEvent(), availableContigInterval(availableContigInterval) {}
+    virtual ~ControlLogicEventTimer(){}
+    virtual ControlLogicEventType getType() const {return Event_Timer;}
+
+public:
+    pair<int64_t, int64_t> availableContigInterval;
+};
+
 }
 
 #endif /* CONTROLLOGICEVENT_H_ */
@@ -49,6 +49,10 @@
 #include "HttpRequestManager.h"
 #include "TcpConnectionManager.h"
 #include "SourceManager.h"
+#include "PeerManager.h"
+#include "MpdCache.h"
+#include "BufferLevel.h"
+#include "ThroughputHistory.h"
 
 #include <cstdio>
 #include <cassert>
@@ -64,6 +68,10 @@ using std::numeric_limits;
 
 namespace dashp2p {
 
+/* Upon a seek, segment requests already sent are left to drain from the connection if that takes at most this long [us].
+ * Otherwise, the connection is replaced by a new one. */
+static const int64_t seekMaxDrainTime = 200000;
+
 ControlLogicST::ControlLogicST(int width, int height, const std::string& config)
   : ControlLogic(width, height),
     Bmin(0),
@@ -75,17 +83,39 @@ ControlLogicST::ControlLogicST(int width, int height, const std::string& config)
     alfa4(0),
     alfa5(0),
     Delta_t(0),
+    fetchHeads(0),
+    pacingFactor(0),
     betaTimeSeries(nullptr),
     initialIncrease(true),
     initialIncreaseTerminationTime(0),
     Bdelay(numeric_limits<int64_t>::max()),
     delayedRequests(),
+    pacingRate(0),
+    collapseReqId(-1),
+    firstReqIdAfterSeek(0),
     tcpConnectionId(),
-    mpdUrl()
+    mpdUrl(),
+    peerConnectionId(),
+    peerSegId(-1, -1, -1, -1),
+    peerDeadline(0),
+    startupConnectionId(),
+    mpdConnectionId(),
+    nextMpdRefresh(numeric_limits<int64_t>::max()),
+    mpdRefreshPending(false),
+    delayedUntil(0),
+    waitingForMpd(false),
+    lastSegment(-1, -1, -1, -1),
+    audioBitRate(0),
+    completedRequests(1),
+    periodStartTime(0),
+    startBitRate(0),
+    historyOrigin(),
+    historyIfName()
 {
 
     double _delta_t = 0;
-    if(10 != sscanf(config.c_str(), "%lf:%lf:%lf:%lf:%lf:%lf:%lf:%lf:%lf:%d", &Bmin, &Blow, &Bhigh, &alfa1, &alfa2, &alfa3, &alfa4, &alfa5, &_delta_t, &fetchHeads)) {
+    const int numParsed = sscanf(config.c_str(), "%lf:%lf:%lf:%lf:%lf:%lf:%lf:%lf:%lf:%d:%lf", &Bmin, &Blow, &Bhigh, &alfa1, &alfa2, &alfa3, &alfa4, &alfa5, &_delta_t, &fetchHeads, &pacingFactor);
+    if(numParsed != 10 && numParsed != 11) {
         ERRMSG("ControlLogicST module could not parse the configuration string \"%s\".", config.c_str());
         dp2p_assert(0);
     }
@@ -103,10 +133,19 @@ ControlLogicST::ControlLogicST(int width, int height, const std::string& config)
     Statistics::recordScalarDouble("alfa5", alfa5);
     Statistics::recordScalarD64("Delta_t", Delta_t);
     Statistics::recordScalarDouble("fetchHeads", fetchHeads);
+    Statistics::recordScalarDouble("pacingFactor", pacingFactor);
 }
 
 ControlLogicST::~ControlLogicST()
 {
+    /* Leave the throughput of this session to the next ones on the same path. */
+    if(!historyOrigin.empty() && ThroughputHistory::enabled()) {
+        vector<double> throughput;
+        vector<double> rtt;
+        Statistics::getPathSamples(tcpConnectionId, throughput, rtt);
+        ThroughputHistory::record(historyOrigin, historyIfName, throughput, rtt);
+    }
+
     delete betaTimeSeries;
     while(!delayedRequests.empty()) {
         delete delayedRequests.front();
@@ -138,19 +177,97 @@ list<ControlLogicAction*> ControlLogicST::processEventDataPlayed(const ControlLo
 	/* Calculate if beta_min is increasing. */
 	betaTimeSeries->pushBack(dashp2p::Utilities::getTime(), e.availableContigInterval.first);
 
-	if(!delayedRequests.empty() && e.availableContigInterval.first <= Bdelay)
-	{
-	    INFOMSGWT("beta <= Bdelay (%.3g <= %.3g). Release %d delayed request(s).",
-	            e.availableContigInterval.first / 1e6, Bdelay / 1e6, delayedRequests.size());
-		dp2p_assert(delayedRequests.size() == 1);
-		actions.push_back(createActionDownloadSegments(delayedRequests, tcpConnectionId, HttpMethod_GET));
-		delayedRequests.clear();
-		Bdelay = numeric_limits<int64_t>::max();
-	}
+	/* A peer that did not deliver in time loses the segment to the origin server. */
+	if(peerConnectionId.numeric() != -1 && dashp2p::Utilities::getTime() >= peerDeadline)
+		actions.push_back(fallBackToOrigin("deadline missed"));
+
+	/* Buffer dropped to the level at which the paced download would have started anyway: full speed. */
+	if(pacingRate > 0 && e.availableContigInterval.first <= Bdelay)
+		setPacingRate(0);
+
+	actions.splice(actions.end(), releaseDelayedRequest(e.availableContigInterval.first));
+
+	return actions;
+}
+
+list<ControlLogicAction*> ControlLogicST::processEventTimer(const ControlLogicEventTimer& e)
+{
+	DBGMSG("Event: %s.", e.toString().c_str());
+
+	list<ControlLogicAction*> actions;
+
+	/* Live: time to refresh the MPD. */
+	if(!mpdRefreshPending && dashp2p::Utilities::getTime() >= nextMpdRefresh)
+		actions.push_back(createActionRefreshMpd());
+
+	/* Live: the delayed segment became available. */
+	actions.splice(actions.end(), releaseDelayedRequest(e.availableContigInterval.first));
+
+	updateTimer();
+
+	return actions;
+}
+
+list<ControlLogicAction*> ControlLogicST::releaseDelayedRequest(int64_t beta)
+{
+	list<ControlLogicAction*> actions;
+	if(delayedRequests.empty() || beta > Bdelay || dashp2p::Utilities::getTime() < delayedUntil)
+		return actions;
 
+	INFOMSGWT("beta <= Bdelay (%.3g <= %.3g). Release %d delayed request(s).", beta / 1e6, Bdelay / 1e6, delayedRequests.size());
+	dp2p_assert(delayedRequests.size() == 1);
+	const ContentIdSegment* segNext = dynamic_cast<const ContentIdSegment*>(delayedRequests.front());
+	actions = requestSegment(segNext, beta);
+	delayedRequests.clear();
+	Bdelay = numeric_limits<int64_t>::max();
+	delayedUntil = 0;
+	updateTimer();
 	return actions;
 }
 
+void ControlLogicST::updateTimer()
+{
+	timer = mpdRefreshPending ? numeric_limits<int64_t>::max() : nextMpdRefresh;
+	if(!delayedRequests.empty() && delayedUntil > dashp2p::Utilities::getTime())
+		timer = std::min<int64_t>(timer, delayedUntil);
+}
+
+void ControlLogicST::scheduleMpdRefresh()
+{
+	const int64_t minimumUpdatePeriod = MpdWrapper::getMinimumUpdatePeriod();
+	if(!MpdWrapper::isLive() || minimumUpdatePeriod < 0) {
+		nextMpdRefresh = numeric_limits<int64_t>::max();
+	} else {
+		/* A minimum update period of 0 means the MPD may change at any time. Not more often than once per segment, though. */
+		nextMpdRefresh = dashp2p::Utilities::getTime()
+				+ ((minimumUpdatePeriod > 0) ? minimumUpdatePeriod : MpdWrapper::getNominalSegmentDuration(periodIndex, adaptationSetIndex, 0));
+	}
+	updateTimer();
+}
+
+ControlLogicAction* ControlLogicST::createActionRefreshMpd()
+{
+	/* A connection of its own, so that the refresh neither waits behind segment downloads nor distorts their throughput. */
+	if(mpdConnectionId.numeric() != -1 && TcpConnectionManager::get(mpdConnectionId).keepAliveMaxRemaining == 0) {
+		HttpClientManager::retire(mpdConnectionId);
+		mpdConnectionId = TcpConnectionId();
+	}
+	if(mpdConnectionId.numeric() == -1) {
+		mpdConnectionId = TcpConnectionManager::create(TcpConnectionManager::get(tcpConnectionId).srcId);
+		HttpClientManager::create(mpdConnectionId, Control::httpCb);
+	}
+
+	/* Downloaded anew into the storage. Sent with the validators of the last version. */
+	SegmentStorage::get(ContentIdMpd()).clear();
+	mpdRefreshPending = true;
+	DBGMSG("Refreshing the MPD over TCP connection %d.", mpdConnectionId.numeric());
+
+	list<const ContentId*> contentIds(1, new ContentIdMpd);
+	list<dashp2p::URL> urls(1, mpdUrl);
+	list<HttpMethod> httpMethods(1, HttpMethod_GET);
+	return new ControlLogicActionStartDownload(mpdConnectionId, contentIds, urls, httpMethods);
+}
+
 //TODO: handle e.socketDisconnected
 list<ControlLogicAction*> ControlLogicST::processEventDataReceivedMpd(ControlLogicEventDataReceived& e)
 {
@@ -158,6 +275,17 @@ list<ControlLogicAction*> ControlLogicST::processEventDataReceivedMpd(ControlLog
 
 	list<ControlLogicAction*> actions;
 
+	/* Live: refresh of the MPD. */
+	if(e.tcpConnectionId == mpdConnectionId)
+		return processEventDataReceivedMpdRefresh(e);
+
+	/* Revalidation of the snapshot we started from. Nothing changed. */
+	if(HttpRequestManager::getHdr(e.reqId).statusCode == HTTP_STATUS_CODE_NOT_MODIFIED) {
+		INFOMSG("MPD not modified since the snapshot was taken.");
+		ackActionRequestCompleted(HttpRequestManager::getContentId(e.reqId));
+		return actions;
+	}
+
 	/*if(mpdDataField == nullptr) {
 		dp2p_assert(e.byteFrom == 0);
 		mpdDataField = new DataField(HttpRequestManager::getContentLength(e.reqId));
@@ -168,43 +296,102 @@ list<ControlLogicAction*> ControlLogicST::processEventDataReceivedMpd(ControlLog
 
 	//mpdDataField->setData(e.byteFrom, e.byteTo, HttpRequestManager::getPldBytes(e.reqId) + e.byteFrom, false);
 
+	/* The MPD is parsed as it arrives. We start as soon as enough of it is known. */
 	//if(mpdDataField->full()) {
+	Statistics::recordStartupEvent("connectedMpdHost", TcpConnectionManager::get(tcpConnectionId).connectedTimestamp);
+	Statistics::recordStartupEvent("firstByteMPD", HttpRequestManager::getTsFirstByte(e.reqId));
+	const ContentIdMpd& contentIdMpd = dynamic_cast<const ContentIdMpd&>(HttpRequestManager::getContentId(e.reqId));
+	const bool start = processEventDataReceivedMpd_Parse(contentIdMpd);
 	if(HttpRequestManager::isCompleted(e.reqId)) {
-		processEventDataReceivedMpd_Completed(dynamic_cast<const ContentIdMpd&>(HttpRequestManager::getContentId(e.reqId)));
-		ackActionRequestCompleted(HttpRequestManager::getContentId(e.reqId));
+		if(MpdCache::enabled()) {
+			if(MpdWrapper::fromSnapshot())
+				INFOMSG("MPD changed since the snapshot was taken. Storing the new one for the next start.");
+			const HttpHdr& hdr = HttpRequestManager::getHdr(e.reqId);
+			MpdWrapper::storeSnapshot(contentIdMpd, mpdUrl.whole, hdr.etag, hdr.lastModified);
+		}
+		ackActionRequestCompleted(contentIdMpd);
 		Statistics::recordRequestStatistics(tcpConnectionId, e.reqId);
+		if(!MpdWrapper::fromSnapshot()) {
+			const HttpHdr& hdr = HttpRequestManager::getHdr(e.reqId);
+			MpdWrapper::setValidators(hdr.etag, hdr.lastModified);
+		}
+		scheduleMpdRefresh();
+	}
+	if(!start)
+		return actions;
+
+	return createStartActions();
+}
+
+list<ControlLogicAction*> ControlLogicST::processEventDataReceivedMpdRefresh(ControlLogicEventDataReceived& e)
+{
+	list<ControlLogicAction*> actions;
+
+	const HttpHdr& hdr = HttpRequestManager::getHdr(e.reqId);
+	if(hdr.statusCode == HTTP_STATUS_CODE_NOT_MODIFIED) {
+		DBGMSG("MPD not modified.");
+		Statistics::recordMpdRefresh(false, 0, 0, 0);
+	} else if(HttpRequestManager::isCompleted(e.reqId)) {
+		const int newSegments = MpdWrapper::refresh(dynamic_cast<const ContentIdMpd&>(HttpRequestManager::getContentId(e.reqId)));
+		if(newSegments >= 0) {
+			MpdWrapper::setValidators(hdr.etag, hdr.lastModified);
+			INFOMSG("MPD refreshed. %d new segments.", newSegments);
+		} else {
+			/* Keep the old validators, so that the next refresh gets the MPD again and not 304. */
+			WARNMSG("MPD refresh failed. Retrying with the next one.");
+		}
 	} else {
+		DBGMSG("MPD refresh not complete yet. No action required.");
 		return actions;
 	}
 
-	const int periodIndex = 0;
-	const int adaptationSetIndex = 0;
+	ackActionRequestCompleted(HttpRequestManager::getContentId(e.reqId));
+	Statistics::recordRequestStatistics(mpdConnectionId, e.reqId);
+	mpdRefreshPending = false;
+	scheduleMpdRefresh();
 
-	bitRates = MpdWrapper::getBitrates(periodIndex, adaptationSetIndex, width, height);
-	const int startSegment = getStartSegment();
-	const int stopSegment = getStopSegment();
+	/* Continue after the last segment of the old MPD, if it is not the last one anymore. */
+	if(waitingForMpd && lastSegment.segmentIndex() < getStopSegment()) {
+		waitingForMpd = false;
+		actions = selectNextSegment(lastSegment, BufferLevel::get().first, tcpConnectionId);
+	}
 
-	const unsigned lowestBitrate = bitRates.at(0);
+	return actions;
+}
 
-	/* Fetch HEADs of the segments to get segment sizes. */
-	if(fetchHeads)
+list<ControlLogicAction*> ControlLogicST::createStartActions()
+{
+	list<ControlLogicAction*> actions;
+
+	const unsigned lowestBitrate = bitRates.at(0);
+	selectAudioBitRate();
+	startBitRate = selectStartBitRate();
+
+	/* Single-file representations: the initialization segments are fetched together with the segment index,
+	 * which gives sizes and durations of all segments, so no HEADs are needed. Only the one of the start representation
+	 * comes first; the start segment is requested once its index is parsed, the other representations after it
+	 * (see processEventInitSegmentWithIndex()). With fast start, both go over the start-up connection. */
+	if(MpdWrapper::usesSegmentIndex(ContentIdSegment(periodIndex, adaptationSetIndex, lowestBitrate, 0)))
 	{
-		// TODO: this is an extension to the original ST algo
-		list<const ContentId*> segIdsHeads;
-		for(unsigned i = 0; i < bitRates.size(); ++i) {
-			const int bitRate = bitRates.at(i);
-			segIdsHeads.push_back(new ContentIdSegment(periodIndex, adaptationSetIndex, bitRate, 0));
-			for(int segNr = startSegment; segNr <= stopSegment ; ++segNr) {
-				segIdsHeads.push_back(new ContentIdSegment(periodIndex, adaptationSetIndex, bitRate, segNr));
-			}
-		}
-		actions.push_back(this->createActionDownloadSegments(segIdsHeads, tcpConnectionId, HttpMethod_HEAD));
+		const ContentIdSegment* init = new ContentIdSegment(periodIndex, adaptationSetIndex, startBitRate, 0);
+		contour.setNext(*init);
+		const TcpConnectionId& connId = (startupConnectionId.numeric() != -1) ? startupConnectionId : tcpConnectionId;
+		actions.push_back(this->createActionDownloadSegments(list<const ContentId*>(1, init), connId, HttpMethod_GET));
+		return actions;
 	}
 
-	/* Download the initiallization and the first segment at lowest quality, pipelined */
+	const int startSegment = getStartSegment();
+	const int stopSegment = getStopSegment();
+
+	/* Fetch HEADs of the segments to get segment sizes. Not for live streams, which have no end yet. */
+	const bool fetchHeads = this->fetchHeads && !MpdWrapper::isLive();
+	if(fetchHeads && startupConnectionId.numeric() == -1)
+		actions.push_back(createActionDownloadHeads(startSegment, stopSegment));
+
+	/* Download the initiallization and the first segment, pipelined */
 	list<const ContentId*> segIds;
 	segIds.push_back(new ContentIdSegment(periodIndex, adaptationSetIndex, lowestBitrate, 0));
-	segIds.push_back(new ContentIdSegment(periodIndex, adaptationSetIndex, lowestBitrate, startSegment));
+	segIds.push_back(new ContentIdSegment(periodIndex, adaptationSetIndex, startBitRate, startSegment));
 
 	for(list<const ContentId*>::const_iterator it = segIds.begin(); it != segIds.end(); ++it)
 	{
@@ -215,11 +402,97 @@ list<ControlLogicAction*> ControlLogicST::processEventDataReceivedMpd(ControlLog
 		contour.setNext(dynamic_cast<const ContentIdSegment&>(**it));
 	}
 
+	/* Separate audio: its initialization segment (not in the contour, it is joined into the video one) and the segments played with
+	 * the start segment, between the two. */
+	if(audioAdaptationSetIndex != -1) {
+		list<const ContentId*> audioIds = attachAudio(dynamic_cast<const ContentIdSegment&>(*segIds.back()));
+		audioIds.push_front(new ContentIdSegment(periodIndex, audioAdaptationSetIndex, audioBitRate, 0));
+		segIds.splice(--segIds.end(), audioIds);
+	}
+
+	/* Fast start: in parallel, the start segment over the (already connected) start-up connection.
+	 * The HEADs then queue behind the initialization segment instead of in front of it. */
+	if(startupConnectionId.numeric() != -1) {
+		actions.push_back(this->createActionDownloadSegments(list<const ContentId*>(1, segIds.back()), startupConnectionId, HttpMethod_GET));
+		segIds.pop_back();
+		actions.push_back(this->createActionDownloadSegments(segIds, tcpConnectionId, HttpMethod_GET));
+		if(fetchHeads)
+			actions.push_back(createActionDownloadHeads(startSegment, stopSegment));
+		prefetchInitSegments(actions);
+		return actions;
+	}
+
 	actions.push_back(this->createActionDownloadSegments(segIds, tcpConnectionId, HttpMethod_GET));
+	prefetchInitSegments(actions);
 
 	return actions;
 }
 
+unsigned ControlLogicST::selectStartBitRate()
+{
+	if(!ThroughputHistory::enabled())
+		return bitRates.at(0);
+
+	const TcpConnection& tc = TcpConnectionManager::get(tcpConnectionId);
+	const SourceData& sd = SourceManager::get(tc.srcId);
+	historyOrigin = sd.hostName + ":" + std::to_string(sd.port);
+	historyIfName = tc.ifData.name;
+
+	ThroughputHistory::Estimate estimate;
+	if(!ThroughputHistory::lookup(historyOrigin, historyIfName, estimate)) {
+		INFOMSG("No throughput history of %s. Starting at the lowest bit-rate.", historyOrigin.c_str());
+		return bitRates.at(0);
+	}
+	Statistics::recordScalarDouble("historyThroughputLow", estimate.throughputLow);
+	Statistics::recordScalarDouble("historyThroughputMedian", estimate.throughputMedian);
+	Statistics::recordScalarDouble("historyRttHigh", estimate.rttHigh / 1e6);
+
+	/* An RTT far above what the path used to have, measured while the MPD was downloaded (not known when starting from a snapshot):
+	 * it is not the path we know. */
+	const unsigned rtt = tc.rtt();
+	if(estimate.rttHigh > 0 && rtt > 2 * estimate.rttHigh) {
+		INFOMSG("RTT to %s is %.3f s, the history has at most %.3f s. Starting at the lowest bit-rate.", historyOrigin.c_str(), rtt / 1e6, estimate.rttHigh / 1e6);
+		return bitRates.at(0);
+	}
+
+	/* The representation the initial increase would switch to with an empty buffer at the low quantile of the throughput in the history.
+	 * The increase continues from there. */
+	unsigned i = 0;
+	while(i + 1 < bitRates.size() && bitRates.at(i + 1) + audioBitRate <= alfa2 * estimate.throughputLow)
+		++i;
+	INFOMSG("Throughput history of %s: %.3f Mbit/s (20 %% quantile), %.3f Mbit/s (median), %.1f sessions. Starting at %.3f Mbit/s.",
+			historyOrigin.c_str(), estimate.throughputLow / 1e6, estimate.throughputMedian / 1e6, estimate.weight, bitRates.at(i) / 1e6);
+	Statistics::recordScalarU64("startBitRate", bitRates.at(i));
+	return bitRates.at(i);
+}
+
+void ControlLogicST::prefetchInitSegments(list<ControlLogicAction*>& actions)
+{
+	/* Live: later periods appear with refreshes of the MPD, their initialization segments might not be available yet. */
+	if(MpdWrapper::isLive())
+		return;
+
+	list<const ContentId*> segIds;
+	for(int p = periodIndex + 1; p < MpdWrapper::getNumPeriods(); ++p)
+	{
+		/* The one setPeriod() will start the period with. The audio is joined into it (see TrackMuxer) only once the period is entered. */
+		const int videoIndex = getVideoAdaptationSet(p);
+		if(separateAudio && findSeparateAudio(p) != -1)
+			continue;
+		vector<int> rates = MpdWrapper::getBitrates(p, videoIndex, width, height);
+		if(rates.empty())
+			rates = MpdWrapper::getBitrates(p, videoIndex, 0, 0);
+		const ContentIdSegment init(p, videoIndex, rates.at(0), 0);
+		if(!MpdWrapper::usesSegmentIndex(init) && !SegmentStorage::initialized(init))
+			segIds.push_back(init.copy());
+	}
+	if(segIds.empty())
+		return;
+
+	DBGMSG("Prefetching the initialization segments of %d following periods.", (int)segIds.size());
+	actions.push_back(createActionDownloadSegments(segIds, tcpConnectionId, HttpMethod_GET));
+}
+
 list<ControlLogicAction*> ControlLogicST::processEventDataReceivedSegment(ControlLogicEventDataReceived& e)
 {
 	DBGMSG("Event: %s.", e.toString().c_str());
@@ -229,9 +502,37 @@ list<ControlLogicAction*> ControlLogicST::processEventDataReceivedSegment(Contro
 
 	const ContentIdSegment& segId = dynamic_cast<const ContentIdSegment&>(HttpRequestManager::getContentId(e.reqId));
 
+	/* Late events from a peer or start-up connection we already gave up on. */
+	if(e.tcpConnectionId != tcpConnectionId && e.tcpConnectionId != peerConnectionId && e.tcpConnectionId != startupConnectionId) {
+		DBGMSG("Event from retired TCP connection %d. Ignoring.", e.tcpConnectionId.numeric());
+		return actions;
+	}
+
+	/* Requests cancelled by a seek just drain from the connection. */
+	if(e.reqId < firstReqIdAfterSeek) {
+		DBGMSG("Event for request %d, cancelled by a seek. Ignoring.", e.reqId);
+		return actions;
+	}
+
+	/* Separate audio is requested along with the video. The video segments drive the adaptation. */
+	if(isAudio(segId)) {
+		if(e.byteTo == HttpRequestManager::getContentLength(e.reqId) - 1) {
+			DBGMSG("Audio segment completed.");
+			dp2p_assert(ackActionRequestCompleted(segId));
+			Statistics::recordRequestStatistics(e.tcpConnectionId, e.reqId);
+		}
+		return actions;
+	}
+
 	/* We do not start a new download if (i) the last one is not finished yet, or (ii) we have already downloading the stop segment,
 	 * or (iii) we downloaded the initial segment (since we have aready requested initial segment and start segment pipelined) */
 	if(e.byteTo != HttpRequestManager::getContentLength(e.reqId) - 1) {
+		/* A chunked segment arrives at the pace it is produced and its size is not known: no collapse detection. */
+		double rho = 0;
+		int64_t remainingTime = 0;
+		if(segId.periodIndex() == periodIndex && segId.segmentIndex() > getStartSegment() && !HttpRequestManager::getHdr(e.reqId).chunked && e.tcpConnectionId == tcpConnectionId && e.reqId != collapseReqId
+				&& checkThroughputCollapse(e, rho, remainingTime))
+			return abandonSegment(e, segId, rho, remainingTime);
 		DBGMSG("Segment not ready yet. No action required.");
 		return actions;
 	}
@@ -241,31 +542,85 @@ list<ControlLogicAction*> ControlLogicST::processEventDataReceivedSegment(Contro
 	dp2p_assert(ackActionRequestCompleted(HttpRequestManager::getContentId(e.reqId)));
 	dp2p_assert(delayedRequests.empty());
 
+	/* A peer connection is used for one segment only. */
+	const bool fromPeer = (e.tcpConnectionId == peerConnectionId);
+	if(fromPeer) {
+		HttpClientManager::retire(peerConnectionId);
+		peerConnectionId = TcpConnectionId();
+	}
+	Statistics::recordSegmentSource(fromPeer, HttpRequestManager::getContentLength(e.reqId));
+	PeerManager::announce(segId);
+
+	/* The start-up connection is done once the start segment is in. */
+	if(segId.segmentIndex() == 0) {
+		Statistics::recordStartupEvent("completedInitSegment", dashp2p::Utilities::getTime());
+	} else if(segId.segmentIndex() == getStartSegment()) {
+		Statistics::recordStartupEvent("completedStartSegment", dashp2p::Utilities::getTime());
+		if(e.tcpConnectionId == startupConnectionId) {
+			HttpClientManager::retire(startupConnectionId);
+			startupConnectionId = TcpConnectionId();
+		}
+	}
+
 	/* Give the HttpRequest object to the Statistics module. It will delete it later. */
-	Statistics::recordRequestStatistics(tcpConnectionId, e.reqId);
+	Statistics::recordRequestStatistics(e.tcpConnectionId, e.reqId);
 
 	betaTimeSeries->pushBack(dashp2p::Utilities::getTime(), e.availableContigInterval.first);
 
-	if (segId.segmentIndex() == getStopSegment()) {
-		DBGMSG("Stop segment. No action required.");
-		return actions;
+	if (segId.segmentIndex() == 0 && MpdWrapper::usesSegmentIndex(segId)) {
+		return processEventInitSegmentWithIndex(segId);
 	} else if (segId.segmentIndex() == 0) {
 		DBGMSG("Init segment. No action required.");
 		return actions;
 	}
 
+	++completedRequests;
+
+	/* First segment of a period entered at its end of the previous one. */
+	if(periodStartTime != 0 && segId.periodIndex() == periodIndex) {
+		Statistics::recordPeriodStart(periodIndex, dashp2p::Utilities::getTime() - periodStartTime, e.availableContigInterval.first);
+		periodStartTime = 0;
+	}
+
+	const bool lastPeriod = (segId.periodIndex() + 1 >= MpdWrapper::getNumPeriods());
+	if (segId.segmentIndex() == getStopSegment(segId.periodIndex()) && !lastPeriod) {
+		const Contour* next = contour.getPeriod(segId.periodIndex() + 1);
+		if(next && next->contains(1)) {
+			DBGMSG("End of period %d. The first segment of period %d is requested already.", segId.periodIndex(), segId.periodIndex() + 1);
+			return actions;
+		}
+		DBGMSG("End of period %d. Continuing with period %d.", segId.periodIndex(), periodIndex);
+	} else if (segId.segmentIndex() == getStopSegment(segId.periodIndex()) && MpdWrapper::isLive()) {
+		DBGMSG("Last segment in the MPD. Continuing after the next MPD refresh.");
+		waitingForMpd = true;
+		lastSegment = segId;
+		return actions;
+	} else if (segId.segmentIndex() == getStopSegment(segId.periodIndex())) {
+		DBGMSG("Stop segment. No action required.");
+		return actions;
+	}
+
+	return selectNextSegment(segId, e.availableContigInterval.first, e.tcpConnectionId);
+}
+
+list<ControlLogicAction*> ControlLogicST::selectNextSegment(const ContentIdSegment& _segId, int64_t beta, const TcpConnectionId& connId)
+{
+	list<ControlLogicAction*> actions;
+
+	/* The last segment of the previous period: continue as if it was the initialization segment of this one, at the closest bit-rate. */
+	const ContentIdSegment segId = (_segId.periodIndex() == periodIndex) ? _segId
+			: ContentIdSegment(periodIndex, adaptationSetIndex, getClosestBitRate(_segId.bitRate()), 0);
+
 	/* select bit-rate */
 	const bool ifBetaMinIncreasing = betaTimeSeries->minIncreasing();
-	const int64_t beta = e.availableContigInterval.first;
-	// TODO: in the next two lines we need to use the proper connection ID!
-	const double rho = Statistics::getThroughput(tcpConnectionId, std::min<int64_t>(Delta_t, dashp2p::Utilities::getTime()));
-	const double rhoLast = Statistics::getThroughputLastRequest(tcpConnectionId);
-	const unsigned completedRequests = (segId.segmentIndex() == 0) ? 1 : segId.segmentIndex() - getStartSegment() + 2;
+	const double rho = Statistics::getThroughput(connId, std::min<int64_t>(Delta_t, dashp2p::Utilities::getTime()));
+	const double rhoLast = Statistics::getThroughputLastRequest(connId);
+	/* The separate audio takes its share of the throughput. */
 	Decision adaptationDecision = selectRepresentation(
 			ifBetaMinIncreasing,
 			beta / 1e6,
-			rho,
-			rhoLast,
+			std::max<double>(0, rho - audioBitRate),
+			std::max<double>(0, rhoLast - audioBitRate),
 			completedRequests,
 			segId);
 	//std::pair<Representation, double> repAndDelay = AdaptationST::selectRepresentationAlwaysLowest();
@@ -273,10 +628,8 @@ list<ControlLogicAction*> ControlLogicST::processEventDataReceivedSegment(Contro
 
 	Bdelay = adaptationDecision.Bdelay;
 	dp2p_assert(Bdelay > 0);
-	const int r_new = adaptationDecision.bitRate;
+	const int r_new = getIndexedBitRate(adaptationDecision.bitRate);
 
-	const int periodIndex = 0;
-	const int adaptationSetIndex = 0;
 	const ContentIdSegment* segNext = new ContentIdSegment(periodIndex, adaptationSetIndex, r_new, segId.segmentIndex() + 1);
 	DBGMSG("Will download segment Nr. %d (last one will be %d, segment 0 is initial segment.)", segNext->segmentIndex(), getStopSegment());
 
@@ -300,7 +653,7 @@ list<ControlLogicAction*> ControlLogicST::processEventDataReceivedSegment(Contro
 	    const list<int> unfinishedRequests = HttpClientManager::get(tcpConnectionId).clearUnfinishedRequests();
 	    assert(unfinishedRequests.empty());
 	    /* get source ID of the closed TCP connection */
-	    const SourceId srcId = TcpConnectionManager::get(e.tcpConnectionId).srcId;
+	    const SourceId srcId = TcpConnectionManager::get(tcpConnectionId).srcId;
 
 	    /* destroy HTTP client and disconnect TCP connection */
 	    HttpClientManager::destroy(tcpConnectionId);
@@ -311,11 +664,31 @@ list<ControlLogicAction*> ControlLogicST::processEventDataReceivedSegment(Contro
 	    HttpClientManager::create(tcpConnectionId, Control::httpCb);
 	}
 
-	/* Either request the next segment immediately or save it in delayedRequests */
-	if(e.availableContigInterval.first <= Bdelay) {
-		list<const ContentId*> contentIds;
-		contentIds.push_back(segNext);
-		actions.push_back(this->createActionDownloadSegments(contentIds, tcpConnectionId, HttpMethod_GET));
+	/* Live: a segment that is not yet available waits in delayedRequests until it is (in low-latency mode, until the server starts delivering it). */
+	const int64_t availableIn = MpdWrapper::getAvailabilityTime(*segNext, lowLatency) - dashp2p::Utilities::getAbsTime();
+	if(availableIn > 0) {
+		DBGMSG("Segment %d available in %.3f sec.", segNext->segmentIndex(), availableIn / 1e6);
+		delayedRequests.push_back(segNext);
+		delayedUntil = dashp2p::Utilities::getTime() + availableIn;
+		updateTimer();
+		return actions;
+	}
+
+	/* Either request the next segment immediately (at full speed or paced) or save it in delayedRequests.
+	 * Pacing replaces the on/off pattern by a continuous download at whatever buffer level above Bdelay: the segment arrives
+	 * at the rate that brings the buffer back to Bdelay by the time it is complete (it drains by beta - Bdelay more than the
+	 * segment adds), times pacingFactor as a margin. */
+	if(beta <= Bdelay || pacingFactor > 0) {
+		if(beta <= Bdelay) {
+			setPacingRate(0);
+		} else {
+			const int64_t segNextDuration = MpdWrapper::getSegmentDuration(*segNext);
+			const int64_t segNextSize = MpdWrapper::getSegmentSize(*segNext);
+			const double bitRate = (segNextSize > 0 && segNextDuration > 0) ? (8e6 * segNextSize / segNextDuration) : segNext->bitRate();
+			const double stretch = (segNextDuration > 0) ? (double)segNextDuration / (segNextDuration + beta - Bdelay) : 1;
+			setPacingRate(std::max<int64_t>(1, (int64_t)(pacingFactor * (bitRate + audioBitRate) * stretch)));
+		}
+		actions = requestSegment(segNext, beta);
 	} else {
 		delayedRequests.push_back(segNext);
 	}
@@ -323,6 +696,96 @@ list<ControlLogicAction*> ControlLogicST::processEventDataReceivedSegment(Contro
 	return actions;
 }
 
+list<ControlLogicAction*> ControlLogicST::requestSegment(const ContentIdSegment* segNext, int64_t beta)
+{
+	list<ControlLogicAction*> actions;
+
+	const int bitRate = segNext->bitRate();
+	const bool periodEnd = (segNext->segmentIndex() == getStopSegment(segNext->periodIndex()) && segNext->periodIndex() + 1 < MpdWrapper::getNumPeriods());
+
+	ControlLogicAction* a = createActionDownloadAudio(*segNext);
+	if(a)
+		actions.push_back(a);
+	if(periodEnd)
+		actions.splice(actions.end(), enterPeriod(segNext->periodIndex() + 1));
+	actions.push_back(createActionDownloadNextSegment(segNext, beta));
+	if(periodEnd) {
+		a = createActionPrefetchSegment(bitRate);
+		if(a)
+			actions.push_back(a);
+	}
+
+	return actions;
+}
+
+list<ControlLogicAction*> ControlLogicST::enterPeriod(int periodIndex)
+{
+	list<ControlLogicAction*> actions;
+
+	INFOMSG("Requesting the last segment of period %d. Continuing with period %d.", periodIndex - 1, periodIndex);
+	const ContentIdSegment previousInit(this->periodIndex, adaptationSetIndex, bitRates.at(0), 0);
+	setPeriod(periodIndex);
+	selectAudioBitRate();
+	periodStartTime = dashp2p::Utilities::getTime();
+
+	/* The initialization segment goes into the contour, the decoder needs it if the period's is different. Known to be the same, if it
+	 * was prefetched (see prefetchInitSegments()) and is identical to the one of the previous period, which the decoder has already.
+	 * Single-file representations: those of all representations, which carry the segment indexes. Separate audio: its one, which is
+	 * joined into the video one. */
+	const ContentIdSegment videoInit(periodIndex, adaptationSetIndex, bitRates.at(0), 0);
+	list<const ContentId*> segIds;
+	if(MpdWrapper::usesSegmentIndex(videoInit)) {
+		contour.setNext(videoInit);
+		for(unsigned i = 0; i < bitRates.size(); ++i)
+			segIds.push_back(new ContentIdSegment(periodIndex, adaptationSetIndex, bitRates.at(i), 0));
+	} else {
+		if(SegmentStorage::sameContent(videoInit, previousInit))
+			INFOMSG("Period %d has the initialization segment of period %d. Not giving it to the decoder again.", periodIndex, previousInit.periodIndex());
+		else
+			contour.setNext(videoInit);
+		if(!SegmentStorage::initialized(videoInit) || (!SegmentStorage::get(videoInit).completed() && !isRequested(videoInit)))
+			segIds.push_back(videoInit.copy());
+		if(audioAdaptationSetIndex != -1)
+			segIds.push_back(new ContentIdSegment(periodIndex, audioAdaptationSetIndex, audioBitRate, 0));
+	}
+	if(!segIds.empty())
+		actions.push_back(createActionDownloadSegments(segIds, tcpConnectionId, HttpMethod_GET));
+
+	if(fetchHeads && !MpdWrapper::isLive())
+		actions.push_back(createActionDownloadHeads(1, getStopSegment()));
+
+	return actions;
+}
+
+ControlLogicAction* ControlLogicST::createActionPrefetchSegment(int bitRate)
+{
+	/* Single-file representations: not before the segment index arrived, then processEventInitSegmentWithIndex() requests it.
+	 * Live: not before it is available, then it is selected once the last segment of the previous period is completed. */
+	const ContentIdSegment* segFirst = new ContentIdSegment(periodIndex, adaptationSetIndex, getClosestBitRate(bitRate), 1);
+	if((MpdWrapper::usesSegmentIndex(*segFirst) && !MpdWrapper::hasSegmentIndex(*segFirst))
+			|| MpdWrapper::getAvailabilityTime(*segFirst, lowLatency) > dashp2p::Utilities::getAbsTime()) {
+		delete segFirst;
+		return nullptr;
+	}
+
+	DBGMSG("Prefetching the first segment of period %d at %.3f Mbit/s.", periodIndex, segFirst->bitRate() / 1e6);
+	contour.setNext(*segFirst);
+	list<const ContentId*> segIds = attachAudio(*segFirst);
+	segIds.push_back(segFirst);
+	return createActionDownloadSegments(segIds, tcpConnectionId, HttpMethod_GET);
+}
+
+void ControlLogicST::selectAudioBitRate()
+{
+	audioBitRate = 0;
+	if(audioAdaptationSetIndex == -1)
+		return;
+	audioBitRate = audioBitRates.at(0);
+	for(unsigned i = 1; i < audioBitRates.size() && audioBitRates.at(i) <= bitRates.at(0); ++i)
+		audioBitRate = audioBitRates.at(i);
+	INFOMSG("Separate audio at %.3f kbit/s.", audioBitRate / 1e3);
+}
+
 // TODO: make sure unfinished downloads are removed from the list of pending actions in ControlLogic
 list<ControlLogicAction*> ControlLogicST::processEventDisconnect(const ControlLogicEventDisconnect& e)
 {
@@ -330,12 +793,38 @@ list<ControlLogicAction*> ControlLogicST::processEventDisconnect(const ControlLo
 
 	list<ControlLogicAction*> actions;
 
-	if(e.tcpConnectionId < tcpConnectionId) {
-	    DBGMSG("We have already re-connected.");
+	if(e.tcpConnectionId == peerConnectionId) {
+	    actions.push_back(fallBackToOrigin("peer disconnected"));
+	    return actions;
+	}
+
+	/* A new connection for the next refresh. A refresh in progress is lost, try again right away. */
+	if(e.tcpConnectionId == mpdConnectionId) {
+	    DBGMSG("MPD connection %d disconnected.", mpdConnectionId.numeric());
+	    HttpClientManager::retire(mpdConnectionId);
+	    mpdConnectionId = TcpConnectionId();
+	    if(mpdRefreshPending) {
+	        ackActionRequestCompleted(ContentIdMpd());
+	        mpdRefreshPending = false;
+	        nextMpdRefresh = dashp2p::Utilities::getTime();
+	        updateTimer();
+	    }
+	    return actions;
+	}
+
+	/* Not worth re-establishing the start-up connection. Continue over the main one. */
+	if(e.tcpConnectionId == startupConnectionId) {
+	    WARNMSG("Start-up connection %d disconnected. Moving its requests to TCP connection %d.", startupConnectionId.numeric(), tcpConnectionId.numeric());
+	    const list<const ContentId*> contentIds = retireStartupConnection();
+	    if(!contentIds.empty())
+	        actions.push_back(createActionDownloadSegments(contentIds, tcpConnectionId, HttpMethod_GET));
 	    return actions;
 	}
 
-	dp2p_assert_v(e.tcpConnectionId == tcpConnectionId, "e.tcpConnectionId: %d, tcpConnectionId: %d", e.tcpConnectionId, tcpConnectionId);
+	if(e.tcpConnectionId != tcpConnectionId) {
+	    DBGMSG("We have already re-connected or retired the connection.");
+	    return actions;
+	}
 
 	/* get content IDs of unfinished requests */
 	const list<int> unfinishedRequests = HttpClientManager::get(tcpConnectionId).clearUnfinishedRequests();
@@ -369,6 +858,467 @@ list<ControlLogicAction*> ControlLogicST::processEventDisconnect(const ControlLo
 	return actions;
 }
 
+ControlLogicAction* ControlLogicST::createActionDownloadNextSegment(const ContentIdSegment* segId, int64_t beta)
+{
+	list<const ContentId*> contentIds(1, segId);
+
+	/* Only ask a peer if there would still be time to get the segment from the origin server. */
+	if(PeerManager::enabled() && peerConnectionId.numeric() == -1 && beta > PeerManager::getDeadlineMargin())
+	{
+		const SourceId peerSrcId = PeerManager::findPeer(*segId);
+		if(peerSrcId.numeric() != -1)
+		{
+			const SourceData& sd = SourceManager::get(peerSrcId);
+			peerConnectionId = TcpConnectionManager::create(peerSrcId, sd.port, IfData(), 0, 1000000);
+			HttpClientManager::create(peerConnectionId, Control::httpCb);
+			peerSegId = *segId;
+			peerDeadline = dashp2p::Utilities::getTime() + beta - PeerManager::getDeadlineMargin();
+
+			if(!SegmentStorage::initialized(*segId)) {
+			    DBGMSG("Segment not yet available in the storage. Initializing.");
+			    SegmentStorage::initSegment(*segId, MpdWrapper::getSegmentSize(*segId), MpdWrapper::getSegmentDuration(*segId));
+			}
+
+			char tmp[1024];
+			sprintf(tmp, "http://%s:%d/%s", sd.hostName.c_str(), sd.port, PeerManager::getPath(*segId).c_str());
+			list<dashp2p::URL> urls(1, dashp2p::Utilities::splitURL(tmp));
+			list<HttpMethod> httpMethods(1, HttpMethod_GET);
+			INFOMSG("Requesting %s from peer %s:%d. Deadline in %.3f sec.", segId->toString().c_str(), sd.hostName.c_str(), sd.port,
+			        (peerDeadline - dashp2p::Utilities::getTime()) / 1e6);
+			return new ControlLogicActionStartDownload(peerConnectionId, contentIds, urls, httpMethods);
+		}
+	}
+
+	return createActionDownloadSegments(contentIds, tcpConnectionId, HttpMethod_GET);
+}
+
+list<const ContentId*> ControlLogicST::attachAudio(const ContentIdSegment& videoSeg)
+{
+	list<const ContentId*> segIds;
+	if(audioAdaptationSetIndex == -1)
+		return segIds;
+
+	/* Continue after the last attached one. The first one is the one playing at the start of the first video segment. */
+	const ContentIdSegment audioRep(videoSeg.periodIndex(), audioAdaptationSetIndex, audioBitRate, 0);
+	const int numSegments = MpdWrapper::getNumSegments(MpdWrapper::getRepresentationIdByBitrate(AdaptationSetId(videoSeg.periodIndex(), audioAdaptationSetIndex), audioBitRate));
+	int segNr = contour.hasCompanion() ? contour.getLastCompanion() + 1 : MpdWrapper::findSegment(audioRep, MpdWrapper::getStartTime(videoSeg));
+
+	/* Up to the end of the video segment. With the stop segment (unless live, where more may come), all remaining ones. */
+	const bool all = (videoSeg.segmentIndex() == getStopSegment(videoSeg.periodIndex()) && !MpdWrapper::isLive());
+	const int64_t end = MpdWrapper::getStartTime(videoSeg) + MpdWrapper::getSegmentDuration(videoSeg);
+	for( ; segNr > 0 && segNr < numSegments; ++segNr)
+	{
+		const ContentIdSegment segId(videoSeg.periodIndex(), audioAdaptationSetIndex, audioBitRate, segNr);
+		if(!all && MpdWrapper::getStartTime(segId) >= end)
+			break;
+		if(MpdWrapper::getAvailabilityTime(segId, lowLatency) > dashp2p::Utilities::getAbsTime()) {
+			DBGMSG("Audio segment %d not available yet. Attaching it to a later video segment.", segNr);
+			break;
+		}
+		contour.setNextCompanion(segId);
+		if(!SegmentStorage::initialized(segId) || !SegmentStorage::get(segId).completed())
+			segIds.push_back(segId.copy());
+	}
+
+	return segIds;
+}
+
+ControlLogicAction* ControlLogicST::createActionDownloadAudio(const ContentIdSegment& videoSeg)
+{
+	const list<const ContentId*> segIds = attachAudio(videoSeg);
+	if(segIds.empty())
+		return nullptr;
+	return createActionDownloadSegments(segIds, tcpConnectionId, HttpMethod_GET);
+}
+
+ControlLogicAction* ControlLogicST::createActionDownloadHeads(int startSegment, int stopSegment) const
+{
+	// TODO: this is an extension to the original ST algo
+	list<const ContentId*> segIdsHeads;
+	for(unsigned i = 0; i < bitRates.size(); ++i) {
+		const int bitRate = bitRates.at(i);
+		segIdsHeads.push_back(new ContentIdSegment(periodIndex, adaptationSetIndex, bitRate, 0));
+		for(int segNr = startSegment; segNr <= stopSegment ; ++segNr) {
+			segIdsHeads.push_back(new ContentIdSegment(periodIndex, adaptationSetIndex, bitRate, segNr));
+		}
+	}
+	return this->createActionDownloadSegments(segIdsHeads, tcpConnectionId, HttpMethod_HEAD);
+}
+
+list<ControlLogicAction*> ControlLogicST::processEventInitSegmentWithIndex(const ContentIdSegment& segId)
+{
+	list<ControlLogicAction*> actions;
+
+	if(MpdWrapper::hasSegmentIndex(segId)) {
+		DBGMSG("Segment index of %s already known. No action required.", segId.toString().c_str());
+		return actions;
+	}
+
+	int64_t size = 0;
+	char* p = SegmentStorage::getCopy(segId, &size);
+	dp2p_assert(p);
+	const bool ifIndex = MpdWrapper::setSegmentIndex(segId, p, size);
+	delete [] p;
+	if(!ifIndex)
+		THROW_RUNTIME("No segment index found in %s.", segId.toString().c_str());
+
+	/* Make segment sizes available to the statistics module, as HEAD requests would. */
+	const int stopSegment = getStopSegment(segId.periodIndex());
+	for(int segNr = 1; segNr <= stopSegment; ++segNr) {
+		const ContentIdSegment s(segId.periodIndex(), segId.adaptationSetIndex(), segId.bitRate(), segNr);
+		Statistics::recordSegmentSize(s, MpdWrapper::getSegmentSize(s));
+	}
+	DBGMSG("Parsed segment index of %s: %d segments.", segId.toString().c_str(), stopSegment);
+
+	/* Start with the start representation as soon as its index is known (with fast start, over the start-up connection, which is idle now).
+	 * Same in a later period with the lowest one, unless its first segment was requested already (see createActionPrefetchSegment()). */
+	const Contour* period = contour.getPeriod(segId.periodIndex());
+	const unsigned r = (period == &contour) ? startBitRate : bitRates.at(0);
+	if(segId.periodIndex() == periodIndex && period && period->size() == 1 && segId.bitRate() == (int)r) {
+		const int segNr = (period == &contour) ? getStartSegment() : 1;
+		const ContentIdSegment* segStart = new ContentIdSegment(segId.periodIndex(), segId.adaptationSetIndex(), segId.bitRate(), segNr);
+		contour.setNext(*segStart);
+		const TcpConnectionId& connId = (startupConnectionId.numeric() != -1) ? startupConnectionId : tcpConnectionId;
+		actions.push_back(createActionDownloadSegments(list<const ContentId*>(1, segStart), connId, HttpMethod_GET));
+
+		/* Now the indexes of the other representations, which adaptation needs from the next segment on (see getIndexedBitRate()),
+		 * and the initialization segments of the following periods. */
+		if(period == &contour) {
+			requestSegmentIndexes(actions);
+			prefetchInitSegments(actions);
+		}
+	}
+
+	return actions;
+}
+
+void ControlLogicST::requestSegmentIndexes(list<ControlLogicAction*>& actions)
+{
+	list<const ContentId*> segIdsInit;
+	for(unsigned i = 0; i < bitRates.size(); ++i) {
+		const ContentIdSegment init(periodIndex, adaptationSetIndex, bitRates.at(i), 0);
+		if(MpdWrapper::usesSegmentIndex(init) && !MpdWrapper::hasSegmentIndex(init) && !isRequested(init))
+			segIdsInit.push_back(init.copy());
+	}
+	if(!segIdsInit.empty())
+		actions.push_back(createActionDownloadSegments(segIdsInit, tcpConnectionId, HttpMethod_GET));
+}
+
+int ControlLogicST::getIndexedBitRate(int bitRate) const
+{
+	int ret = -1;
+	for(unsigned i = 0; i < bitRates.size(); ++i) {
+		const ContentIdSegment init(periodIndex, adaptationSetIndex, bitRates.at(i), 0);
+		if(MpdWrapper::usesSegmentIndex(init) && !MpdWrapper::hasSegmentIndex(init))
+			continue;
+		if(bitRates.at(i) <= bitRate || ret == -1)
+			ret = bitRates.at(i);
+	}
+	dp2p_assert(ret != -1);
+	return ret;
+}
+
+bool ControlLogicST::checkThroughputCollapse(const ControlLogicEventDataReceived& e, double& rho, int64_t& remainingTime)
+{
+	/* Too early to tell. */
+	const int64_t elapsed = e.timestamp - HttpRequestManager::getTsFirstByte(e.reqId);
+	if(elapsed < 500000)
+		return false;
+
+	rho = 8e6 * (e.byteTo + 1) / elapsed; // [bit/s]
+	const int64_t remainingBytes = HttpRequestManager::getContentLength(e.reqId) - e.byteTo - 1;
+	remainingTime = (int64_t)(8e6 * remainingBytes / rho); // [us]
+	if(remainingTime <= e.availableContigInterval.first)
+		return false;
+
+	collapseReqId = e.reqId;
+	WARNMSG("Throughput dropped to %.3f Mbit/s while downloading %s. Completion expected in %.3f sec, buffer: %.3f sec.",
+			rho / 1e6, HttpRequestManager::getContentId(e.reqId).toString().c_str(), remainingTime / 1e6, e.availableContigInterval.first / 1e6);
+	Statistics::recordThroughputCollapse();
+	return true;
+}
+
+list<ControlLogicAction*> ControlLogicST::abandonSegment(const ControlLogicEventDataReceived& e, const ContentIdSegment& segId, double rho, int64_t remainingTime)
+{
+	list<ControlLogicAction*> actions;
+
+	/* Cancelling means closing the connection, so nothing else may be pending on it. */
+	if(HttpClientManager::get(tcpConnectionId).hasRequests() != 1) {
+		DBGMSG("Other requests pending on TCP connection %d. Not abandoning.", tcpConnectionId.numeric());
+		return actions;
+	}
+
+	/* Playback must not have reached the segment yet. beta0 is the buffer level without the received part of the segment. */
+	const int64_t contentLength = HttpRequestManager::getContentLength(e.reqId);
+	const int64_t segDuration = MpdWrapper::getSegmentDuration(segId);
+	const int64_t beta0 = e.availableContigInterval.first - segDuration * (e.byteTo + 1) / contentLength;
+	if(beta0 <= 0) {
+		DBGMSG("Already playing %s. Not abandoning.", segId.toString().c_str());
+		return actions;
+	}
+
+	/* Highest lower bit-rate whose segment is expected to arrive before the buffer runs empty. Otherwise, the lowest one, if it arrives earlier
+	 * than the rest of the current one. */
+	int r_new = -1;
+	int64_t tNew = 0;
+	for(int i = (int)bitRates.size() - 1; i >= 0; --i)
+	{
+		if(bitRates.at(i) >= segId.bitRate() || getIndexedBitRate(bitRates.at(i)) != bitRates.at(i))
+			continue;
+		const ContentIdSegment s(segId.periodIndex(), segId.adaptationSetIndex(), bitRates.at(i), segId.segmentIndex());
+		const int64_t size = (MpdWrapper::getSegmentSize(s) > 0) ? MpdWrapper::getSegmentSize(s) : (int64_t)bitRates.at(i) * segDuration / 8000000;
+		tNew = (int64_t)(8e6 * size / rho);
+		if(tNew < beta0 || (i == 0 && tNew < remainingTime)) {
+			r_new = bitRates.at(i);
+			break;
+		}
+	}
+	if(r_new == -1) {
+		DBGMSG("Switching down would not help. Not abandoning %s.", segId.toString().c_str());
+		return actions;
+	}
+
+	WARNMSG("Abandoning %s after %" PRId64 " of %" PRId64 " bytes. Re-requesting at %.3f Mbit/s (expected to take %.3f sec).",
+			segId.toString().c_str(), e.byteTo + 1, contentLength, r_new / 1e6, tNew / 1e6);
+	Statistics::recordAbandonment(e.byteTo + 1, remainingTime - e.availableContigInterval.first);
+
+	const ContentIdSegment* segNew = new ContentIdSegment(segId.periodIndex(), segId.adaptationSetIndex(), r_new, segId.segmentIndex());
+
+	/* Drop the request together with its TCP connection and open a new one to the same server. Late events from the old one are ignored. */
+	dp2p_assert(ackActionRequestCompleted(segId));
+	const SourceId srcId = TcpConnectionManager::get(tcpConnectionId).srcId;
+	HttpClientManager::retire(tcpConnectionId);
+	tcpConnectionId = TcpConnectionManager::create(srcId);
+	HttpClientManager::create(tcpConnectionId, Control::httpCb);
+	pacingRate = 0;
+
+	contour.replaceLast(*segNew);
+	actions.push_back(createActionDownloadSegments(list<const ContentId*>(1, segNew), tcpConnectionId, HttpMethod_GET));
+
+	return actions;
+}
+
+void ControlLogicST::setPacingRate(int64_t rate)
+{
+	if(rate != pacingRate)
+		DBGMSG("Pacing rate: %.3f Mbit/s.", rate / 1e6);
+	pacingRate = rate;
+	/* Always apply, tcpConnectionId might have been re-created. */
+	HttpClientManager::get(tcpConnectionId).setPacingRate(rate);
+}
+
+ControlLogicAction* ControlLogicST::fallBackToOrigin(const char* reason)
+{
+	dp2p_assert(peerConnectionId.numeric() != -1);
+
+	WARNMSG("Peer download of %s failed (%s). Falling back to the origin server.", peerSegId.toString().c_str(), reason);
+
+	const SourceId peerSrcId = TcpConnectionManager::get(peerConnectionId).srcId;
+	HttpClientManager::retire(peerConnectionId);
+	peerConnectionId = TcpConnectionId();
+	PeerManager::markFailed(peerSrcId);
+	Statistics::recordPeerFallback();
+
+	ackActionRequestCompleted(peerSegId);
+	list<const ContentId*> contentIds(1, peerSegId.copy());
+	return createActionDownloadSegments(contentIds, tcpConnectionId, HttpMethod_GET);
+}
+
+list<const ContentId*> ControlLogicST::retireStartupConnection()
+{
+	dp2p_assert(startupConnectionId.numeric() != -1);
+
+	const list<int> unfinishedRequests = HttpClientManager::get(startupConnectionId).clearUnfinishedRequests();
+	list<const ContentId*> contentIds;
+	for(list<int>::const_iterator it = unfinishedRequests.begin(); it != unfinishedRequests.end(); ++it) {
+		ackActionRequestCompleted(HttpRequestManager::getContentId(*it));
+		contentIds.push_back(HttpRequestManager::getContentId(*it).copy());
+	}
+
+	HttpClientManager::destroy(startupConnectionId);
+	TcpConnectionManager::disconnect(startupConnectionId);
+	startupConnectionId = TcpConnectionId();
+
+	return contentIds;
+}
+
+list<ControlLogicAction*> ControlLogicST::processEventSeek(const ControlLogicEventSeek& e)
+{
+	DBGMSG("Event: %s. Period: %d, segment: %d, bit-rate: %d.", e.toString().c_str(), e.periodIndex, e.segmentIndex, e.bitRate);
+
+	list<ControlLogicAction*> actions;
+
+	dp2p_assert(0 <= e.periodIndex && e.periodIndex < MpdWrapper::getNumPeriods());
+	const int stopSegment = getStopSegment(e.periodIndex);
+	dp2p_assert_v(1 <= e.segmentIndex && e.segmentIndex <= stopSegment, "segment: %d, stop segment: %d", e.segmentIndex, stopSegment);
+
+	/* Restart the adaptation as after start-up. */
+	while(!delayedRequests.empty()) {
+		delete delayedRequests.front();
+		delayedRequests.pop_front();
+	}
+	Bdelay = numeric_limits<int64_t>::max();
+	delayedUntil = 0;
+	waitingForMpd = false;
+	updateTimer();
+	collapseReqId = -1;
+	initialIncrease = true;
+	initialIncreaseTerminationTime = 0;
+	completedRequests = 1;
+	periodStartTime = 0;
+	delete betaTimeSeries;
+	betaTimeSeries = new TimeSeries<int64_t>(1000000, false, true);
+
+	/* Give up the peer download, if any. It is not the peer's fault. */
+	if(peerConnectionId.numeric() != -1) {
+		HttpClientManager::retire(peerConnectionId);
+		peerConnectionId = TcpConnectionId();
+	}
+
+	/* Same for the start-up connection. */
+	if(startupConnectionId.numeric() != -1) {
+		HttpClientManager::retire(startupConnectionId);
+		startupConnectionId = TcpConnectionId();
+	}
+
+	/* Cancel the downloads from the origin server. Keep the connection if the requests already sent drain quickly enough,
+	 * otherwise replace it (as when abandoning a segment). */
+	const int64_t outstanding = getOutstandingBytes();
+	const double rho = Statistics::getThroughput(tcpConnectionId, std::min<int64_t>(Delta_t, dashp2p::Utilities::getTime()));
+	const bool reconnect = (outstanding > 0 && (rho <= 0 || 8e6 * outstanding / rho > seekMaxDrainTime));
+	ackActionsSegmentDownloads();
+	if(reconnect) {
+		DBGMSG("%" PRId64 " bytes outstanding at %.3f Mbit/s. Replacing TCP connection %d.", outstanding, rho / 1e6, tcpConnectionId.numeric());
+		const SourceId srcId = TcpConnectionManager::get(tcpConnectionId).srcId;
+		HttpClientManager::retire(tcpConnectionId);
+		tcpConnectionId = TcpConnectionManager::create(srcId);
+		HttpClientManager::create(tcpConnectionId, Control::httpCb);
+		pacingRate = 0;
+	} else {
+		DBGMSG("%" PRId64 " bytes outstanding at %.3f Mbit/s. Draining TCP connection %d.", outstanding, rho / 1e6, tcpConnectionId.numeric());
+		HttpClientManager::get(tcpConnectionId).cancelRequests();
+		setPacingRate(0);
+	}
+	firstReqIdAfterSeek = HttpRequestManager::getNextReqId();
+
+	/* New contour, without the initialization segment if the decoder already has it (see ControlLogicEventSeek). Segments already stored are
+	 * played from the storage. */
+	if(e.periodIndex != periodIndex) {
+		setPeriod(e.periodIndex);
+		selectAudioBitRate();
+	}
+	startBitRate = bitRates.at(0);
+	contour.clear();
+	startSegment = e.segmentIndex;
+	list<const ContentId*> audioIds; // separate audio of the stored segments, as far as not stored
+	if(e.initSegment) {
+		const ContentIdSegment videoInit(periodIndex, adaptationSetIndex, bitRates.at(0), 0);
+		contour.setNext(videoInit);
+		/* Single-file representations of a period not played yet: the segment index of the lowest one first, then the segment and the other
+		 * indexes (see processEventInitSegmentWithIndex()). */
+		if(MpdWrapper::usesSegmentIndex(videoInit) && !MpdWrapper::hasSegmentIndex(videoInit)) {
+			Statistics::recordSeekRestart(reconnect, 0);
+			INFOMSG("Seek to segment %d of period %d. Getting the segment index first.", e.segmentIndex, periodIndex);
+			actions.push_back(createActionDownloadSegments(list<const ContentId*>(1, videoInit.copy()), tcpConnectionId, HttpMethod_GET));
+			return actions;
+		}
+		if(!SegmentStorage::initialized(videoInit) || !SegmentStorage::get(videoInit).completed()) {
+			audioIds.push_back(videoInit.copy());
+			if(audioAdaptationSetIndex != -1)
+				audioIds.push_back(new ContentIdSegment(periodIndex, audioAdaptationSetIndex, audioBitRate, 0));
+		}
+	}
+	int segNr = e.segmentIndex;
+	for( ; segNr <= stopSegment; ++segNr) {
+		const int r = getStoredBitRate(segNr, (segNr == e.segmentIndex) ? e.bitRate : -1);
+		if(r == -1)
+			break;
+		const ContentIdSegment segId(periodIndex, adaptationSetIndex, r, segNr);
+		contour.setNext(segId);
+		audioIds.splice(audioIds.end(), attachAudio(segId));
+	}
+	Statistics::recordSeekRestart(reconnect, segNr - e.segmentIndex);
+	INFOMSG("Seek to segment %d of period %d. %d segments stored. %s.", e.segmentIndex, periodIndex, segNr - e.segmentIndex, reconnect ? "Reconnected" : "Kept the connection");
+
+	const bool lastPeriod = (periodIndex + 1 >= MpdWrapper::getNumPeriods());
+	if(segNr > stopSegment && lastPeriod) {
+		DBGMSG("Stored up to the stop segment. No action required.");
+		if(!audioIds.empty())
+			actions.push_back(createActionDownloadSegments(audioIds, tcpConnectionId, HttpMethod_GET));
+		return actions;
+	} else if(segNr > stopSegment) {
+		DBGMSG("Stored up to the end of the period. Continuing with the next one.");
+		if(!audioIds.empty())
+			actions.push_back(createActionDownloadSegments(audioIds, tcpConnectionId, HttpMethod_GET));
+		const int r = contour.get(stopSegment).bitRate();
+		actions.splice(actions.end(), enterPeriod(periodIndex + 1));
+		ControlLogicAction* a = createActionPrefetchSegment(r);
+		if(a)
+			actions.push_back(a);
+		return actions;
+	}
+
+	/* Continue downloading at the lowest bit-rate (with a known segment index), unless the position is in the middle of a given representation. */
+	const int r = (segNr == e.segmentIndex && e.bitRate != -1) ? e.bitRate : getIndexedBitRate(bitRates.at(0));
+	const ContentIdSegment* segNext = new ContentIdSegment(periodIndex, adaptationSetIndex, r, segNr);
+	contour.setNext(*segNext);
+	audioIds.splice(audioIds.end(), attachAudio(*segNext));
+	audioIds.push_back(segNext);
+
+	/* The last segment of the period: as in requestSegment(). */
+	const bool periodEnd = (segNr == stopSegment && !lastPeriod);
+	if(periodEnd)
+		actions.splice(actions.end(), enterPeriod(periodIndex + 1));
+	actions.push_back(createActionDownloadSegments(audioIds, tcpConnectionId, HttpMethod_GET));
+	if(periodEnd) {
+		ControlLogicAction* a = createActionPrefetchSegment(r);
+		if(a)
+			actions.push_back(a);
+	} else {
+		/* Single-file representations: indexes that were cancelled before they arrived. */
+		requestSegmentIndexes(actions);
+	}
+
+	return actions;
+}
+
+int64_t ControlLogicST::getOutstandingBytes() const
+{
+	int64_t ret = 0;
+	for(ActionList::const_iterator it = pendingActions.begin(); it != pendingActions.end(); ++it)
+	{
+		if((*it)->getType() != Action_StartDownload)
+			continue;
+		const ControlLogicActionStartDownload* a = dynamic_cast<const ControlLogicActionStartDownload*>(*it);
+		if(a->tcpConnectionId != tcpConnectionId)
+			continue;
+		list<HttpMethod>::const_iterator kt = a->httpMethods.begin();
+		for(list<const ContentId*>::const_iterator jt = a->contentIds.begin(); jt != a->contentIds.end(); ++jt, ++kt)
+		{
+			if(*kt != HttpMethod_GET || (*jt)->getType() != ContentType_Segment)
+				continue;
+			const ContentIdSegment& segId = static_cast<const ContentIdSegment&>(**jt);
+			const int64_t size = (MpdWrapper::getSegmentSize(segId) > 0) ? MpdWrapper::getSegmentSize(segId)
+					: (int64_t)segId.bitRate() * MpdWrapper::getSegmentDuration(segId) / 8000000;
+			const int64_t received = SegmentStorage::initialized(segId) ? SegmentStorage::get(segId).getContigBytes() : 0;
+			ret += std::max<int64_t>(0, size - received);
+		}
+	}
+	return ret;
+}
+
+int ControlLogicST::getStoredBitRate(int segmentIndex, int bitRate) const
+{
+	for(int i = (int)bitRates.size() - 1; i >= 0; --i)
+	{
+		if(bitRate != -1 && bitRates.at(i) != bitRate)
+			continue;
+		const ContentIdSegment segId(periodIndex, adaptationSetIndex, bitRates.at(i), segmentIndex);
+		if(SegmentStorage::initialized(segId) && SegmentStorage::get(segId).completed())
+			return bitRates.at(i);
+	}
+	return -1;
+}
 
 #if 0
 list<ControlLogicAction*> ControlLogicST::processEventPause(const ControlLogicEventPause& e)
@@ -434,9 +1384,16 @@ list<ControlLogicAction*> ControlLogicST::processEventStartPlayback(const Contro
 
 	/* Create a new TCP connection */
 	const int srcId = SourceManager::add(mpdUrl.hostName);
+	Statistics::recordStartupEvent("resolvedMpdHost", dashp2p::Utilities::getTime());
 	tcpConnectionId = TcpConnectionManager::create(srcId);
 	HttpClientManager::create(tcpConnectionId, Control::httpCb);
 
+	/* Fast start: connect the start-up connection while the MPD is being downloaded. */
+	if(fastStart) {
+	    startupConnectionId = TcpConnectionManager::create(srcId);
+	    HttpClientManager::create(startupConnectionId, Control::httpCb);
+	}
+
 	//actions.push_back(new ControlLogicActionOpenTcpConnection(connId));
 
 	if(!SegmentStorage::initialized(ContentIdMpd())) {
@@ -446,6 +1403,13 @@ list<ControlLogicAction*> ControlLogicST::processEventStartPlayback(const Contro
 	    DBGMSG("Segment aleady registered in the storage module.");
 	}
 
+	/* Restart with a snapshot of the MPD: start right away. The MPD is still requested, conditionally, to revalidate the snapshot. */
+	if(MpdWrapper::loadSnapshot(mpdUrl.whole)) {
+		INFOMSG("Using the snapshot of the MPD from the cache.");
+		processMpdAvailable();
+		actions = createStartActions();
+	}
+
 	/* Start MPD download */
 	list<const ContentId*> contentIds(1, new ContentIdMpd);
 	list<dashp2p::URL> urls(1, mpdUrl);
@@ -107,13 +107,101 @@ private:
     //virtual list<ControlLogicAction*> processEventPause               (const ControlLogicEventPause& e);
     //virtual list<ControlLogicAction*> processEventResumePlayback      (const ControlLogicEventResumePlayback& e);
     virtual list<ControlLogicAction*> processEventStartPlayback       (const ControlLogicEventStartPlayback& e);
+    virtual list<ControlLogicAction*> processEventSeek                (const ControlLogicEventSeek& e);
+    virtual list<ControlLogicAction*> processEventTimer               (const ControlLogicEventTimer& e);
+
+    /* Live: response to a refresh of the MPD. */
+    list<ControlLogicAction*> processEventDataReceivedMpdRefresh(ControlLogicEventDataReceived& e);
 
     //virtual list<ControlLogicAction*> actionRejectedStartDownload(ControlLogicActionStartDownload* a);
 
+    /* Downloads of the initialization and the start segment (or of the segment indexes), once the MPD is available. */
+    list<ControlLogicAction*> createStartActions();
+    /* Appends the download of the initialization segments of the following periods, in one pipelined request, so that they are there
+     * when the period changes (see enterPeriod()). Not those muxed with separate audio or carrying a segment index. */
+    void prefetchInitSegments(list<ControlLogicAction*>& actions);
+    /* Single-file representations: requests the initialization segments (with the segment indexes) of the current period not known
+     * and not requested yet. */
+    void requestSegmentIndexes(list<ControlLogicAction*>& actions);
+    /* Single-file representations: the highest bit-rate not above bitRate whose segment index is known, the lowest known one if none.
+     * Other representations: bitRate. */
+    int getIndexedBitRate(int bitRate) const;
+
     /* Selects the representation for the next segment and the buffer level when the download should be started (Inf, if immediately). */
     Decision selectRepresentation(bool ifBetaMinIncreasing, double beta,
     		double rho, double rhoLast, unsigned completedRequests, const ContentIdSegment& lastSegment);
 
+    /* Selects the bit-rate of the segment following segId, and requests it now, paced, or later (see delayedRequests).
+     * beta is the buffer level [us], connId the connection whose throughput counts. */
+    list<ControlLogicAction*> selectNextSegment(const ContentIdSegment& segId, int64_t beta, const TcpConnectionId& connId);
+
+    /* Requests the delayed segment if the buffer level beta [us] dropped to Bdelay and the segment is available. Nothing otherwise. */
+    list<ControlLogicAction*> releaseDelayedRequest(int64_t beta);
+
+    /* Requests segNext, which it takes over, with its separate audio. With the last segment of a period that is not the last one,
+     * also the initialization segments of the next period (ahead, so that the segment indexes are known in time) and its first segment
+     * (behind), so that the pipeline does not run empty at the period boundary. */
+    list<ControlLogicAction*> requestSegment(const ContentIdSegment* segNext, int64_t beta);
+
+    /* Continues downloading with the given period. Returns the downloads of its initialization segments (and the HEADs). */
+    list<ControlLogicAction*> enterPeriod(int periodIndex);
+
+    /* Requests the first segment of the period entered last, at the bit-rate closest to bitRate, if it can be requested now. nullptr otherwise. */
+    ControlLogicAction* createActionPrefetchSegment(int bitRate);
+
+    /* Separate audio: the highest bit-rate not above the lowest video bit-rate, so that it never dominates the throughput. */
+    void selectAudioBitRate();
+
+    /* Bit-rate of the start segment: from the throughput history of the path (see ThroughputHistory), the lowest one if there is none. */
+    unsigned selectStartBitRate();
+
+    /* Live: the next refresh of the MPD, according to its minimum update period. */
+    void scheduleMpdRefresh();
+    ControlLogicAction* createActionRefreshMpd();
+
+    /* Sets the timer to the next refresh of the MPD or to the time the delayed segment becomes available. */
+    void updateTimer();
+
+    /* Requests the next segment from a peer if one has it and there is enough time, otherwise from the origin server.
+     * Takes over segId. */
+    ControlLogicAction* createActionDownloadNextSegment(const ContentIdSegment* segId, int64_t beta);
+
+    /* Separate audio: appends to the contour the audio segments played with videoSeg, the last video segment in it, as far as they
+     * are available. Returns those not in the storage yet. */
+    list<const ContentId*> attachAudio(const ContentIdSegment& videoSeg);
+    /* Requests the audio segments attached by attachAudio(). nullptr if there are none. */
+    ControlLogicAction* createActionDownloadAudio(const ContentIdSegment& videoSeg);
+
+    /* HEADs of the initialization segments and of segments startSegment..stopSegment, for all representations. */
+    ControlLogicAction* createActionDownloadHeads(int startSegment, int stopSegment) const;
+
+    /* Parses the segment index carried by a completely downloaded initialization segment. */
+    list<ControlLogicAction*> processEventInitSegmentWithIndex(const ContentIdSegment& segId);
+
+    /* Checks a progress event of the current segment download for a throughput collapse, i.e.,
+     * if at the throughput achieved so far, the segment would not complete before the buffer runs empty.
+     * If so, returns true, the throughput so far [bit/s] and the expected remaining download time [us]. */
+    bool checkThroughputCollapse(const ControlLogicEventDataReceived& e, double& rho, int64_t& remainingTime);
+
+    /* Cancels the download of segId and requests the same segment at a lower bit-rate, if that helps. */
+    list<ControlLogicAction*> abandonSegment(const ControlLogicEventDataReceived& e, const ContentIdSegment& segId, double rho, int64_t remainingTime);
+
+    /* Sets the receive pacing rate of tcpConnectionId [bit/s]. 0 disables pacing. */
+    void setPacingRate(int64_t rate);
+
+    /* Gives up on the pending peer download and requests the segment from the origin server. Bytes the peer already
+     * delivered are kept, the re-fetch only fills in the rest (see DataField::setData()). */
+    ControlLogicAction* fallBackToOrigin(const char* reason);
+
+    /* Upper bound on the payload [byte] still to be received for the pending segment downloads on tcpConnectionId. */
+    int64_t getOutstandingBytes() const;
+
+    /* Closes the start-up connection. Returns the content IDs of its unfinished requests. */
+    list<const ContentId*> retireStartupConnection();
+
+    /* Highest bit-rate at which the segment is completely in the storage (only bitRate is checked if not -1). -1 if none. */
+    int getStoredBitRate(int segmentIndex, int bitRate) const;
+
 /* Private fields */
 private:
     /* Parameters */
@@ -127,6 +215,9 @@ private:
     double alfa5;
     int64_t Delta_t;
     int fetchHeads;
+    /* Optional. If > 0, downloads that would be delayed are instead paced, at pacingFactor times the rate that brings the buffer
+     * back to Bdelay when the segment is complete. */
+    double pacingFactor;
 
     TimeSeries<int64_t>* betaTimeSeries;
 
@@ -139,8 +230,54 @@ private:
     int64_t Bdelay;
     list<const ContentId*> delayedRequests;
 
+    /* Current receive pacing rate [bit/s] of tcpConnectionId, 0 if not pacing. */
+    int64_t pacingRate;
+
+    /* Request for which a throughput collapse was already detected. */
+    int collapseReqId;
+
+    /* Segment requests with smaller identifiers were cancelled by a seek. */
+    int firstReqIdAfterSeek;
+
     TcpConnectionId tcpConnectionId;
     dashp2p::URL mpdUrl;
+
+    /* Pending peer download, if any: connection, segment and the time [us] by which it must be completed. */
+    TcpConnectionId peerConnectionId;
+    ContentIdSegment peerSegId;
+    int64_t peerDeadline;
+
+    /* Fast start: second connection to the origin server, used for the start segment only. */
+    TcpConnectionId startupConnectionId;
+
+    /* Live: connection to the origin server for refreshing the MPD, time [us] of the next refresh (INT64_MAX if none),
+     * and if one is in progress. */
+    TcpConnectionId mpdConnectionId;
+    int64_t nextMpdRefresh;
+    bool mpdRefreshPending;
+
+    /* Live: the delayed request is not released before this time [us], at which the segment becomes available. */
+    int64_t delayedUntil;
+
+    /* Live: lastSegment was the last one in the MPD. The next one is selected once a refresh adds segments. */
+    bool waitingForMpd;
+    ContentIdSegment lastSegment;
+
+    /* Separate audio: the representation, which does not change within a period (the joint initialization segment describes one), 0 if none. */
+    int audioBitRate;
+
+    /* Video media segments completed since the start or the last seek, plus one for the initialization segment. */
+    unsigned completedRequests;
+
+    /* Time [us] at which the initialization segment of the period being downloaded was requested. 0 once its first segment is completed. */
+    int64_t periodStartTime;
+
+    /* Bit-rate of the start segment (see selectStartBitRate()). */
+    unsigned startBitRate;
+
+    /* Origin server ("host:port") and interface of the session, for ThroughputHistory. Empty if it is not used. */
+    string historyOrigin;
+    string historyIfName;
 };
 
 }
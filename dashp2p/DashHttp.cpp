@@ -50,15 +50,23 @@
 
 namespace dashp2p {
 
+int64_t DashHttp::progressEventInterval = 0;
+
 DashHttp::DashHttp(const TcpConnectionId& tcpConnectionId, HttpCb cb)
   : tcpConnectionId(tcpConnectionId),
     state(DashHttpState_Undefined),
     ifTerminating(false),
+    threadTerminated(false),
     fdWakeUpSelect(-1),
     reqQueue(),
     newReqs(),
     newReqsMutex(),
     fdNewReqs(-1),
+    cancelRequested(false),
+    pacingRate(0),
+    pacingNextRead(0),
+    lastProgressReqId(-1),
+    lastProgressTime(0),
     mainThread(),
     cb(cb)
 {
@@ -86,7 +94,7 @@ DashHttp::~DashHttp()
 {
     DBGMSG("Terminating DashHttp.");
 
-    {
+    if(!ifTerminating) {
         ifTerminating = true;
         uint64_t dummy = 1;
         dp2p_assert(sizeof(dummy) == ::write(fdWakeUpSelect, &dummy, sizeof(dummy)));
@@ -97,6 +105,13 @@ DashHttp::~DashHttp()
 
     DBGMSG("Thread terminated.");
 
+    /* A stopped client drops whatever it did not finish. */
+    if(state == DashHttpState_NotAcceptingRequests) {
+        const list<int> dropped = clearUnfinishedRequests();
+        if(!dropped.empty())
+            DBGMSG("Dropping %d unfinished requests.", dropped.size());
+    }
+
     //dp2p_assert_v(state == DashHttpState_NotAcceptingRequests, "state: %d", state);
 
     /* Request queue and related. */
@@ -154,19 +169,33 @@ void DashHttp::threadMain()
 
     while(!ifTerminating)
     {
+    	/* When pacing, do not look at the socket before the next read is due. */
+    	ThreadAdapter::mutexLock(&newReqsMutex);
+    	const int64_t rate = pacingRate;
+    	ThreadAdapter::mutexUnlock(&newReqsMutex);
+    	const int64_t now = Utilities::getAbsTime();
+    	const bool readAllowed = (rate == 0 || now >= pacingNextRead);
+
     	/* wait for events */
-    	const int64_t to = calculateWaitingTimeout();
-    	const InternalEvent ev = waitForEvents(to);
+    	const int64_t to = readAllowed ? calculateWaitingTimeout() : min<int64_t>(calculateWaitingTimeout(), pacingNextRead - now);
+    	const InternalEvent ev = waitForEvents(to, readAllowed);
 
         if(ifTerminating) {
         	//reportDisconnect();
         	break;
         }
 
+        if(ev.wakeUp)
+        	dropCancelledRequests();
+
         /* process events */
         if(ev.socketEvent) {
         	TcpConnectionManager::logTCPState(tcpConnectionId, "before recv");
-        	const int bytesReceived = TcpConnectionManager::get(tcpConnectionId).read();
+        	/* When pacing, read 10 ms worth of data at a time and schedule the next read accordingly. */
+        	const int maxBytes = (rate == 0) ? 0 : (int)max<int64_t>(1460, rate / 8 / 100);
+        	const int bytesReceived = TcpConnectionManager::get(tcpConnectionId).read(maxBytes);
+        	if(rate > 0 && bytesReceived > 0)
+        		pacingNextRead = max<int64_t>(pacingNextRead, now) + (8000000LL * bytesReceived) / rate;
         	TcpConnectionManager::logTCPState(tcpConnectionId, "after recv");
         	//const bool socketDisconnected = TcpConnectionManager::get(tcpConnectionId).state() != TCP_ESTABLISHED;
 
@@ -285,10 +314,83 @@ list<int> DashHttp::clearUnfinishedRequests()
     return ret;
 }
 
+void DashHttp::cancelRequests()
+{
+    ThreadAdapter::mutexLock(&newReqsMutex);
+
+    /* New requests were not handed over to the main thread yet, drop them right here. */
+    if(!newReqs.empty()) {
+        uint64_t numNewReqs = 0;
+        dp2p_assert(sizeof(numNewReqs) == ::read(fdNewReqs, &numNewReqs, sizeof(numNewReqs)));
+        dp2p_assert(numNewReqs == newReqs.size());
+        for(list<int>::iterator it = newReqs.begin(); it != newReqs.end(); ) {
+            if(HttpRequestManager::getHttpMethod(*it) == HttpMethod_GET)
+                it = newReqs.erase(it);
+            else
+                ++it;
+        }
+        if(!newReqs.empty()) {
+            numNewReqs = newReqs.size();
+            dp2p_assert(sizeof(numNewReqs) == ::write(fdNewReqs, &numNewReqs, sizeof(numNewReqs)));
+        }
+    }
+
+    cancelRequested = true;
+    ThreadAdapter::mutexUnlock(&newReqsMutex);
+
+    /* The request queue belongs to the main thread. */
+    uint64_t dummy = 1;
+    dp2p_assert(sizeof(dummy) == ::write(fdWakeUpSelect, &dummy, sizeof(dummy)));
+}
+
+void DashHttp::dropCancelledRequests()
+{
+    uint64_t dummy = 0;
+    dp2p_assert(sizeof(dummy) == ::read(fdWakeUpSelect, &dummy, sizeof(dummy)));
+
+    ThreadAdapter::mutexLock(&newReqsMutex);
+    if(cancelRequested) {
+        int numDropped = 0;
+        for(list<int>::iterator it = reqQueue.begin(); it != reqQueue.end(); ) {
+            if(!HttpRequestManager::isSent(*it) && HttpRequestManager::getHttpMethod(*it) == HttpMethod_GET) {
+                it = reqQueue.erase(it);
+                ++numDropped;
+            } else {
+                ++it;
+            }
+        }
+        cancelRequested = false;
+        DBGMSG("Dropped %d cancelled requests. Queue state: %s.", numDropped, reqQueue2String().c_str());
+    }
+    ThreadAdapter::mutexUnlock(&newReqsMutex);
+}
+
+void DashHttp::stop()
+{
+    ThreadAdapter::mutexLock(&newReqsMutex);
+    state = DashHttpState_NotAcceptingRequests;
+    ThreadAdapter::mutexUnlock(&newReqsMutex);
+
+    if(!ifTerminating) {
+        ifTerminating = true;
+        uint64_t dummy = 1;
+        dp2p_assert(sizeof(dummy) == ::write(fdWakeUpSelect, &dummy, sizeof(dummy)));
+    }
+}
+
+void DashHttp::setPacingRate(int64_t pacingRate)
+{
+	dp2p_assert(pacingRate >= 0);
+	ThreadAdapter::mutexLock(&newReqsMutex);
+	this->pacingRate = pacingRate;
+	ThreadAdapter::mutexUnlock(&newReqsMutex);
+}
+
 void* DashHttp::startThread(void* params)
 {
     DashHttp* dashHttp = (DashHttp*)params;
     dashHttp->threadMain();
+    dashHttp->threadTerminated = true;
     return NULL;
 }
 
@@ -328,14 +430,16 @@ int64_t DashHttp::calculateWaitingTimeout()
 #endif
 }
 
-DashHttp::InternalEvent DashHttp::waitForEvents(const int64_t& to)
+DashHttp::InternalEvent DashHttp::waitForEvents(const int64_t& to, bool watchSocket)
 {
 	fd_set fdSetRead;
 	FD_ZERO(&fdSetRead);
 	int nfds = 0;
 
-	FD_SET(TcpConnectionManager::get(tcpConnectionId).fdSocket, &fdSetRead);
-	nfds = max<int>(nfds, TcpConnectionManager::get(tcpConnectionId).fdSocket);
+	if(watchSocket) {
+		FD_SET(TcpConnectionManager::get(tcpConnectionId).fdSocket, &fdSetRead);
+		nfds = max<int>(nfds, TcpConnectionManager::get(tcpConnectionId).fdSocket);
+	}
 
 	FD_SET(fdNewReqs, &fdSetRead);
 	nfds = max<int>(nfds, fdNewReqs);
@@ -358,8 +462,9 @@ DashHttp::InternalEvent DashHttp::waitForEvents(const int64_t& to)
 	}
 
 	InternalEvent ev;
-	ev.socketEvent = FD_ISSET(TcpConnectionManager::get(tcpConnectionId).fdSocket, &fdSetRead);
+	ev.socketEvent = watchSocket && FD_ISSET(TcpConnectionManager::get(tcpConnectionId).fdSocket, &fdSetRead);
 	ev.newRequests = FD_ISSET(fdNewReqs, &fdSetRead);
+	ev.wakeUp = FD_ISSET(fdWakeUpSelect, &fdSetRead);
 	return ev;
 }
 
@@ -627,6 +732,8 @@ void DashHttp::processNewData()
 
             switch(hdr.statusCode) {
         	case HTTP_STATUS_CODE_OK:
+        	case HTTP_STATUS_CODE_PARTIAL_CONTENT:
+        	case HTTP_STATUS_CODE_NOT_MODIFIED:
         	{
         	    /* If this was the first header from this server, initialize server info */
         	    if(!tc.aHdrReceived)
@@ -723,11 +830,22 @@ void DashHttp::processNewData()
         /* Notify Control if request completed */
         if(HttpRequestManager::isCompleted(reqId)) {
             HttpEventDataReceived* eventDataReceived = new HttpEventDataReceived(tcpConnectionId, reqId, 0,
-                    HttpRequestManager::getPldBytesReceived(reqId) - 1);
+                    HttpRequestManager::getPldBytesReceived(reqId) - 1, tc.recvTimestamp);
             DBGMSG("Before cb().");
             cb(eventDataReceived);
             DBGMSG("cb() returned.");
         }
+        /* Otherwise, report the progress of segment and MPD downloads: immediately for the first data, then rate-limited.
+         * The MPD is parsed as it arrives (see MpdWrapper::parse()). */
+        else if(progressEventInterval > 0 && HttpRequestManager::isHdrCompleted(reqId) && HttpRequestManager::getPldBytesReceived(reqId) > 0
+                && (HttpRequestManager::getContentType(reqId) == ContentType_Segment || HttpRequestManager::getContentType(reqId) == ContentType_Mpd)
+                && HttpRequestManager::getHttpMethod(reqId) == HttpMethod_GET
+                && (reqId != lastProgressReqId || tc.recvTimestamp - lastProgressTime >= progressEventInterval))
+        {
+            lastProgressReqId = reqId;
+            lastProgressTime = tc.recvTimestamp;
+            cb(new HttpEventDataReceived(tcpConnectionId, reqId, 0, HttpRequestManager::getPldBytesReceived(reqId) - 1, tc.recvTimestamp));
+        }
 
     }
     tc.recvBufContent = 0;
@@ -850,6 +968,20 @@ void DashHttp::sendHttpRequest(const list<int>& reqsToSend)
         reqBuf.append(methodString); reqBuf.append(" /"); reqBuf.append(HttpRequestManager::getFileName(reqId)); reqBuf.append(" HTTP/1.1\r\n");
         reqBuf.append("User-Agent: CUSTOM\r\n");
         reqBuf.append("Host: "); reqBuf.append(sd.hostName); reqBuf.append("\r\n");
+        const pair<int64_t, int64_t>& byteRange = HttpRequestManager::getByteRange(reqId);
+        if(byteRange.first >= 0) {
+            char tmp[128];
+            sprintf(tmp, "Range: bytes=%" PRId64 "-%" PRId64 "\r\n", byteRange.first, byteRange.second);
+            reqBuf.append(tmp);
+        }
+        const string& ifNoneMatch = HttpRequestManager::getIfNoneMatch(reqId);
+        if(!ifNoneMatch.empty()) {
+            reqBuf.append("If-None-Match: "); reqBuf.append(ifNoneMatch); reqBuf.append("\r\n");
+        }
+        const string& ifModifiedSince = HttpRequestManager::getIfModifiedSince(reqId);
+        if(!ifModifiedSince.empty()) {
+            reqBuf.append("If-Modified-Since: "); reqBuf.append(ifModifiedSince); reqBuf.append("\r\n");
+        }
         reqBuf.append("Connection: Keep-Alive\r\n");
         reqBuf.append("\r\n");
     }
@@ -933,6 +1065,26 @@ int DashHttp::parseData(const char* p, int size, int reqId, int64_t recvTimestam
 	else
 		dp2p_assert(HttpRequestManager::isHdrCompleted(reqId));
 
+	/* Chunked payload: the chunks are stored as they arrive, the size is known after the last one. */
+	if(HttpRequestManager::getHdr(reqId).chunked)
+	{
+		HttpChunkDecoder& decoder = HttpRequestManager::getChunkDecoder(reqId);
+		while(bytesParsed < size && !decoder.done())
+		{
+			const bool inChunk = decoder.inChunk();
+			const char* pld = NULL;
+			int pldSize = 0;
+			bytesParsed += decoder.decode(p + bytesParsed, size - bytesParsed, &pld, &pldSize);
+			if(pldSize > 0)
+				HttpRequestManager::appendPldBytes(reqId, pld, pldSize, recvTimestamp, inChunk);
+		}
+		if(decoder.done()) {
+			HttpRequestManager::completeChunked(reqId, recvTimestamp);
+			DBGMSG("Received the last chunk of request %u: %" PRId64 " bytes in total.", reqId, HttpRequestManager::getPldBytesReceived(reqId));
+		}
+		return bytesParsed;
+	}
+
 	const int64_t contentLength = HttpRequestManager::getContentLength(reqId);
 	const int64_t pldBytesReceived = HttpRequestManager::getPldBytesReceived(reqId);
 
@@ -960,7 +1112,16 @@ void DashHttp::parseHeader(int reqId) const
 	const HttpHdr& hdr = HttpRequestManager::parseHeader(reqId);
 
 	switch(hdr.statusCode) {
-	case HTTP_STATUS_CODE_OK: break;
+	case HTTP_STATUS_CODE_OK:
+		dp2p_assert_v(HttpRequestManager::getByteRange(reqId).first < 0, "Server ignored the Range header for %s/%s.", sd.hostName.c_str(), HttpRequestManager::getFileName(reqId).c_str());
+		break;
+	case HTTP_STATUS_CODE_PARTIAL_CONTENT:
+		dp2p_assert_v(HttpRequestManager::getByteRange(reqId).first >= 0, "Got 206 for %s without asking for a range.", HttpRequestManager::getFileName(reqId).c_str());
+		break;
+	case HTTP_STATUS_CODE_NOT_MODIFIED:
+		dp2p_assert_v(!HttpRequestManager::getIfNoneMatch(reqId).empty() || !HttpRequestManager::getIfModifiedSince(reqId).empty(),
+				"Got 304 for %s without a conditional request.", HttpRequestManager::getFileName(reqId).c_str());
+		break;
 	//case HTTP_STATUS_CODE_FOUND: break;
 	default:
 		ERRMSG("HTTP returned status code %" PRIu32 " for %s/%s.", hdr.statusCode, sd.hostName.c_str(), HttpRequestManager::getFileName(reqId).c_str());
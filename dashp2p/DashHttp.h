@@ -33,6 +33,7 @@
 #include "TcpConnectionManager.h"
 
 #include <semaphore.h>
+#include <atomic>
 #include <string>
 #include <list>
 #include <vector>
@@ -55,6 +56,7 @@ private:
 	struct InternalEvent {
 		bool socketEvent = false;
 		bool newRequests = false;
+		bool wakeUp = false;
 	};
 
 /* Public methods. */
@@ -78,6 +80,26 @@ public:
 
     list<int> clearUnfinishedRequests();
 
+    /** Drops all GET requests that were not sent yet, keeping the connection. Requests already sent are received as usual,
+     *  it is up to the caller to ignore them. HEAD requests are kept. Does not block, the main thread drops its queued requests asynchronously. */
+    void cancelRequests();
+
+    /** Stops accepting requests and asks the main thread to terminate. Does not block.
+     *  Unfinished requests of a stopped client are dropped in the destructor. */
+    void stop();
+
+    /** Minimum time [us] between two progress events for the same segment or MPD request. 0 disables progress events,
+     *  in which case an event is only issued when a request is completed. */
+    static void setProgressEventInterval(int64_t interval) {progressEventInterval = interval;}
+
+    /** True once the main thread has returned, i.e., deleting the object will not block. */
+    bool terminated() const {return threadTerminated;}
+
+    /** Limits the rate [bit/s] at which data are read from the socket. 0 means no limit.
+     *  Once the socket receive buffer is full, TCP flow control slows down the sender to the same rate,
+     *  and receive buffer auto-tuning keeps the buffer small since the application reads slowly. */
+    void setPacingRate(int64_t pacingRate);
+
     //string getIfName() const {return ifData.name;}
     //string getIfAddr() const {return ifData.printAddress();}
     //string getIfString() const {return ifData.toString();}
@@ -89,7 +111,9 @@ protected:
     void threadMain();
     static void* startThread(void* params);
     int64_t calculateWaitingTimeout();
-    InternalEvent waitForEvents(const int64_t& to);
+    InternalEvent waitForEvents(const int64_t& to, bool watchSocket);
+    /* Called upon a wake up signal. Drops queued requests if cancelRequests() was called. */
+    void dropCancelledRequests();
     //int checkIfSocketHasData();
     //bool checkIfHaveNewRequests();
 
@@ -140,8 +164,9 @@ public:
 private:
     enum DashHttpState {DashHttpState_Undefined = 0, DashHttpState_Constructed = 1, DashHttpState_NotAcceptingRequests = 2} state;
 
-    /* Termination flag */
-    bool ifTerminating;
+    /* Termination flags. Set and read by different threads. */
+    std::atomic<bool> ifTerminating;
+    std::atomic<bool> threadTerminated;
     int fdWakeUpSelect;
 
     /* Request queue, mutex and semaphore for the request queue. */
@@ -149,6 +174,17 @@ private:
     list<int> newReqs;
     Mutex newReqsMutex;
     int fdNewReqs;
+    /* Set by cancelRequests(), protected by newReqsMutex. */
+    bool cancelRequested;
+
+    /* Receive pacing. pacingRate is protected by newReqsMutex, pacingNextRead is used by the main thread only. */
+    int64_t pacingRate;
+    int64_t pacingNextRead;
+
+    /* Progress events. */
+    static int64_t progressEventInterval;
+    int lastProgressReqId;
+    int64_t lastProgressTime;
 
     /* Main thread. */
     Thread mainThread;
@@ -33,28 +33,32 @@ DashObject::DashObject(const ContentId& contentId, int64_t numBytes)
     dataField(nullptr)
 {
     if(numBytes > 0)
-        dataField = new DataField(numBytes);
+        dataField.store(new DataField(numBytes));
 }
 
 DashObject::~DashObject()
 {
     delete &contentId;
-    delete dataField;
+    delete dataField.load();
 }
 
 void DashObject::setSize(int64_t s)
 {
-    if(dataField == nullptr)
-        dataField = new DataField(s);
-    else
-        dp2p_assert(dataField->getReservedSize() == s);
+    DataField* expected = field();
+    if(expected == nullptr) {
+        DataField* f = (s >= 0) ? new DataField(s) : new DataField(getSizeEstimate(), true);
+        if(dataField.compare_exchange_strong(expected, f, std::memory_order_acq_rel))
+            return;
+        delete f;
+    }
+    dp2p_assert(s < 0 || expected->isOpen() || expected->getReservedSize() == s);
 }
 
 void DashObject::setData(int64_t byteFrom, int64_t byteTo, const char* srcBuffer, bool overwrite)
 {
     DBGMSG("Adding data to %s at [%" PRId64 ", %" PRId64 "] with%s overwriting.",
             contentId.toString().c_str(), byteFrom, byteTo, overwrite?" potential":"out");
-    dataField->setData(byteFrom, byteTo, srcBuffer, overwrite);
+    field()->setData(byteFrom, byteTo, srcBuffer, overwrite);
     //DBGMSG("Done.");
 }
 
@@ -63,25 +67,33 @@ int64_t DashObject::getData(int64_t offset, char* buffer, int bufferSize)
     //const int64_t numCopiedBytes = dataField->getData(offset, buffer, bufferSize);
     //const int64_t numCopiedUsecs = (numCopiedBytes * duration) / getTotalSize();
     //return pair<int64_t, int64_t>(numCopiedUsecs, numCopiedBytes);
-    return dataField->getData(offset, buffer, bufferSize);
+    return field()->getData(offset, buffer, bufferSize);
 }
 
 int64_t DashObject::getTotalSize() const
 {
-    return dataField->getReservedSize();
+    return field()->getReservedSize();
 }
 
 void DashObject::toFile(string& fileName)
 {
-	dataField->toFile(fileName);
+	field()->toFile(fileName);
 }
 
 pair<int64_t, int64_t> DashSegment::getContigInterval(int64_t offset)
 {
     pair<int64_t, int64_t> ret;
-    ret.second = dataField->getContigInterval(offset);
-    ret.first = (ret.second * duration) / getTotalSize();
+    ret.second = field()->getContigInterval(offset);
+    ret.first = getMediaTime(offset, ret.second);
     return ret;
 }
 
+int64_t DashSegment::getMediaTime(int64_t numBytes) const
+{
+    if(duration == 0)
+        return 0;
+    const int64_t usec = parser.getMediaTime(numBytes);
+    return (usec >= 0) ? usec : numBytes * duration / getTotalSize();
+}
+
 }
@@ -25,7 +25,10 @@
 
 #include "ContentId.h"
 #include "DataField.h"
+#include "FragmentParser.h"
 #include "Utilities.h"
+#include <algorithm>
+#include <atomic>
 #include <string>
 using std::string;
 using std::pair;
@@ -38,18 +41,30 @@ class DashObject
 public:
     DashObject(const ContentId& contentId, int64_t numBytes = -1);
     virtual ~DashObject();
+    /* A negative size means that it is not known yet (chunked transfer): the data field is open until setFinalSize(). */
     void setSize(int64_t s);
+    void setFinalSize(int64_t s) {field()->close(s);}
+    /* Drops the data, so that the object can be downloaded again (a refreshed MPD). Nobody may be reading or writing it. */
+    void clear() {delete dataField.exchange(nullptr, std::memory_order_acq_rel);}
     void setData(int64_t byteFrom, int64_t byteTo, const char* srcBuffer, bool overwrite);
     int64_t getData(int64_t offset, char* buffer, int bufferSize);
+    DataBuffer* getDataRef(int64_t offset, int64_t maxBytes, const char** data, int64_t* numBytes) {return field()->getDataRef(offset, maxBytes, data, numBytes);}
     int64_t getTotalSize() const;
-    bool completed() const {return dataField && dataField->full();}
-    bool hasData(int64_t byteNr) {return dataField && dataField->isOccupied(byteNr);}
-    string printDownloadedData(int64_t offset) {return dataField->printDownloadedData(offset);}
+    bool completed() const {DataField* f = field(); return f && f->full();}
+    /* Number of bytes available contiguously from the beginning. */
+    int64_t getContigBytes() const {DataField* f = field(); return f ? f->getWatermark() : 0;}
+    bool hasData(int64_t byteNr) {DataField* f = field(); return f && f->isOccupied(byteNr);}
+    char* getCopy() {return field()->getCopy();}
+    string printDownloadedData(int64_t offset) {return field()->printDownloadedData(offset);}
     void toFile(string& fileName);
 public:
     const ContentId& contentId;
 protected:
-    DataField* dataField;
+    /* Initial capacity [byte] of the data field if the size is not known. */
+    virtual int64_t getSizeEstimate() const {return 64 * 1024;}
+    DataField* field() const {return dataField.load(std::memory_order_acquire);}
+    /* Created lazily by setSize() while readers may already be polling hasData(). */
+    std::atomic<DataField*> dataField;
 };
 
 /* Type for storing information about a segment. */
@@ -58,13 +73,29 @@ class DashSegment: public DashObject
 /* Public methods */
 public:
     DashSegment(const ContentIdSegment& segId, int64_t numBytes, int64_t duration):
-        DashObject(segId, numBytes), segId(dynamic_cast<const ContentIdSegment&>(contentId)), duration(duration) {}
+        DashObject(segId, numBytes), segId(static_cast<const ContentIdSegment&>(contentId)), duration(duration), original(nullptr) {}
     virtual ~DashSegment(){}
     //int64_t getTotalDuration() const {return duration;}
     pair<int64_t, int64_t> getContigInterval(int64_t offset);
+    /* Continues parsing the data that arrived (see FragmentParser), tracks NULL if not known yet. Segments without a duration
+     * (initialization, muxed audio) are not parsed. */
+    void parse(const TrackInfoMap* tracks) {DataField* f = field(); if(duration > 0 && f) parser.process(*f, tracks);}
+    /* Media time [us] decodable from the first numBytes bytes. Estimated linearly if the segment is not fragmented MP4. */
+    int64_t getMediaTime(int64_t numBytes) const;
+    /* Media time [us] of the numBytes bytes at offset. */
+    int64_t getMediaTime(int64_t offset, int64_t numBytes) const {return std::max<int64_t>(0, getMediaTime(offset + numBytes) - getMediaTime(offset));}
+    /* Initialization segment: the first complete one in the storage with the same bytes, this one if there is none. NULL while not complete. */
+    const DashSegment* getOriginal() const {return original.load(std::memory_order_acquire);}
+    void setOriginal(const DashSegment* seg) {original.store(seg, std::memory_order_release);}
+protected:
+    /* Nominal size plus a margin for the variation of the bit-rate. */
+    virtual int64_t getSizeEstimate() const {return segId.bitRate() * duration / 8000000 * 3 / 2 + 4096;}
 public:
     const ContentIdSegment& segId;
     const int64_t duration;
+private:
+    FragmentParser parser;
+    std::atomic<const DashSegment*> original;
 };
 
 }
@@ -27,25 +27,61 @@
 #include <cassert>
 #include <cstdio>
 #include <cstring>
-#include <list>
-using std::list;
 using std::pair;
 
 namespace dashp2p {
 
-DataField::DataField(int64_t numBytes)
+DataBuffer::DataBuffer(int64_t numBytes)
   : p(new char[numBytes]),
+    refCount(1)
+{
+    ThreadAdapter::mutexInit(&mutex);
+    dp2p_assert(p);
+}
+
+DataBuffer::~DataBuffer()
+{
+    delete [] p;
+    ThreadAdapter::mutexDestroy(&mutex);
+}
+
+void DataBuffer::ref()
+{
+    ThreadAdapter::mutexLock(&mutex);
+    dp2p_assert(refCount > 0);
+    ++refCount;
+    ThreadAdapter::mutexUnlock(&mutex);
+}
+
+void DataBuffer::unref()
+{
+    ThreadAdapter::mutexLock(&mutex);
+    dp2p_assert(refCount > 0);
+    const int remaining = --refCount;
+    ThreadAdapter::mutexUnlock(&mutex);
+    if(remaining == 0)
+        delete this;
+}
+
+DataField::DataField(int64_t numBytes, bool open)
+  : buf(new DataBuffer(numBytes)),
     reservedSize(numBytes),
+    open(open),
     occupiedSize(0),
-    dataMap()
+    watermark(0),
+    dataMap(),
+    retired()
 {
     ThreadAdapter::mutexInit(&mutex);
-    dp2p_assert(p);
+    dp2p_assert(numBytes >= 0);
 }
 
 DataField::~DataField()
 {
-    delete [] p;
+    /* Data handed out by getDataRef() might still be in use. */
+    buf.load()->unref();
+    for(size_t i = 0; i < retired.size(); ++i)
+        retired[i]->unref();
     //int64_t reservedSize;
     //int64_t occupiedSize;
     //map<int64_t, int64_t> dataMap;
@@ -54,8 +90,11 @@ DataField::~DataField()
 
 bool DataField::isOccupied(int64_t byteNr)
 {
+    if(byteNr < getWatermark())
+        return true;
+
     ThreadAdapter::mutexLock(&mutex);
-    dp2p_assert(p && reservedSize && 0 <= byteNr && byteNr < reservedSize);
+    dp2p_assert(0 <= byteNr && (byteNr < reservedSize.load(std::memory_order_relaxed) || isOpen()));
     for(map<int64_t, int64_t>::const_iterator it = dataMap.begin(); it != dataMap.end(); ++it)
     {
         const int64_t _from = it->first;
@@ -75,69 +114,64 @@ bool DataField::isOccupied(int64_t byteNr)
 void DataField::setData(int64_t byteFrom, int64_t byteTo, const char* srcBuffer, bool overwrite)
 {
     ThreadAdapter::mutexLock(&mutex);
-    dp2p_assert(p && byteFrom <= byteTo && byteTo < reservedSize && srcBuffer);
+    dp2p_assert(byteFrom <= byteTo && srcBuffer);
+    if(isOpen() && byteTo + 1 >= reservedSize.load(std::memory_order_relaxed))
+        grow(byteTo + 2);
+    dp2p_assert(byteTo < reservedSize.load(std::memory_order_relaxed));
+
+    char* const p = buf.load(std::memory_order_relaxed)->p;
 
-    /* Copy the data */
-    memcpy(p + byteFrom, srcBuffer, byteTo - byteFrom + 1);
+    /* Start at the entry overlapping or adjoining byteFrom, if any. */
+    DataMap::iterator it = dataMap.upper_bound(byteFrom);
+    if(it != dataMap.begin()) {
+        DataMap::iterator prev = it;
+        --prev;
+        if(prev->second + 1 >= byteFrom)
+            it = prev;
+    }
 
-    /* Find overlapping entries */
-    list<pair<int64_t, int64_t> > overlappingEntries;
-    for(map<int64_t, int64_t>::iterator it = dataMap.begin(); it != dataMap.end(); ++it)
+    /* Copy only into the gaps between the data we already have and merge the entries we touch. Bytes once written are
+     * never written again, so readers below the watermark (or in any other held range) never see them change. */
+    int64_t leftBoundaryMerged = byteFrom;
+    int64_t rightBoundaryMerged = byteTo;
+    int64_t pos = byteFrom;
+    while(it != dataMap.end() && it->first <= byteTo + 1)
     {
         const int64_t from = it->first;
         const int64_t to = it->second;
-        if((byteFrom <= from && from <= byteTo) || (byteFrom <= to && to <= byteTo) || (from < byteFrom && byteTo < to)) {
-            overlappingEntries.push_back(*it);
-        }
+        dp2p_assert(overwrite || to < byteFrom || byteTo < from);
+        if(pos < from)
+            memcpy(p + pos, srcBuffer + (pos - byteFrom), std::min(from - 1, byteTo) - pos + 1);
+        pos = std::max(pos, to + 1);
+        leftBoundaryMerged = std::min(leftBoundaryMerged, from);
+        rightBoundaryMerged = std::max(rightBoundaryMerged, to);
+        occupiedSize -= to - from + 1;
+        dataMap.erase(it++);
     }
-    dp2p_assert(overlappingEntries.empty() || overwrite);
+    if(pos <= byteTo)
+        memcpy(p + pos, srcBuffer + (pos - byteFrom), byteTo - pos + 1);
 
-    /* Erase overlapping entries and adapt the occupied size */
-    for(list<pair<int64_t, int64_t> >::iterator it = overlappingEntries.begin(); it != overlappingEntries.end(); ++it) {
-        dp2p_assert(1 == dataMap.erase(it->first));
-        occupiedSize -= it->second - it->first + 1;
-    }
-
-    /* Calculate the boundaries of the new data region */
-    int64_t leftBoundaryMerged = overlappingEntries.empty() ? byteFrom : std::min(byteFrom, overlappingEntries.front().first);
-    int64_t rightBoundaryMerged =  overlappingEntries.empty() ? byteTo : std::max(byteTo, overlappingEntries.back().first);
-
-    /* Adapt the occupied size */
+    /* Create an entry in the data map and adapt the occupied size */
+    dp2p_assert(dataMap.insert(pair<int64_t, int64_t>(leftBoundaryMerged, rightBoundaryMerged)).second);
     occupiedSize += rightBoundaryMerged - leftBoundaryMerged + 1;
 
-    if(!dataMap.empty())
-    {
-        /* Find the left neighbor and merge if possible */
-        DataMap::iterator neighborRight = dataMap.lower_bound(leftBoundaryMerged);
-        if(neighborRight != dataMap.end()) {
-            dp2p_assert(neighborRight->first > rightBoundaryMerged);
-            if(neighborRight->first == rightBoundaryMerged + 1) {
-                rightBoundaryMerged = neighborRight->second;
-            }
-        }
-        if(neighborRight != dataMap.begin()) {
-            --neighborRight;
-            DataMap::iterator neighborLeft = neighborRight;
-            ++neighborRight;
-            dp2p_assert(neighborLeft->second < leftBoundaryMerged);
-            if(neighborLeft->second == leftBoundaryMerged - 1) {
-                leftBoundaryMerged = neighborLeft->first;
-                dataMap.erase(neighborLeft);
-            }
-        }
-        if(neighborRight != dataMap.end() && neighborRight->second == rightBoundaryMerged) {
-            dataMap.erase(neighborRight);
-        }
-    }
-
-    /* Create an entry in the data map */
-    dp2p_assert(dataMap.insert(pair<int64_t, int64_t>(leftBoundaryMerged, rightBoundaryMerged)).second);
+    /* Publish the contiguous prefix. */
+    if(dataMap.begin()->first == 0 && dataMap.begin()->second + 1 > watermark.load(std::memory_order_relaxed))
+        watermark.store(dataMap.begin()->second + 1, std::memory_order_release);
 
     ThreadAdapter::mutexUnlock(&mutex);
 }
 
 int64_t DataField::getData(int64_t offset, char* buffer, int bufferSize)
 {
+    /* Fast path: published data */
+    const int64_t w = getWatermark();
+    if(offset < w) {
+        const int64_t numCopiedBytes = std::min<int64_t>(w - offset, bufferSize);
+        memcpy(buffer, buf.load(std::memory_order_acquire)->p + offset, numCopiedBytes);
+        return numCopiedBytes;
+    }
+
     ThreadAdapter::mutexLock(&mutex);
     DataMap::const_iterator it = dataMap.begin();
     for( ; it != dataMap.end(); ++it)
@@ -149,16 +183,45 @@ int64_t DataField::getData(int64_t offset, char* buffer, int bufferSize)
 
     const int64_t numCopiedBytes = std::min<int64_t>(it->second - offset + 1, bufferSize);
 
-    memcpy(buffer, p + offset, numCopiedBytes);
+    memcpy(buffer, buf.load(std::memory_order_relaxed)->p + offset, numCopiedBytes);
 
     ThreadAdapter::mutexUnlock(&mutex);
     return numCopiedBytes;
 }
 
+DataBuffer* DataField::getDataRef(int64_t offset, int64_t maxBytes, const char** data, int64_t* numBytes)
+{
+    /* Fast path: published data */
+    const int64_t w = getWatermark();
+    if(offset < w) {
+        numBytes[0] = (maxBytes > 0) ? std::min<int64_t>(w - offset, maxBytes) : (w - offset);
+        DataBuffer* const b = buf.load(std::memory_order_acquire);
+        data[0] = b->p + offset;
+        b->ref();
+        return b;
+    }
+
+    ThreadAdapter::mutexLock(&mutex);
+    DataMap::const_iterator it = dataMap.begin();
+    for( ; it != dataMap.end(); ++it)
+    {
+        if(it->first <= offset && offset <= it->second)
+            break;
+    }
+    dp2p_assert(it != dataMap.end());
+
+    numBytes[0] = (maxBytes > 0) ? std::min<int64_t>(it->second - offset + 1, maxBytes) : (it->second - offset + 1);
+    DataBuffer* const b = buf.load(std::memory_order_relaxed);
+    data[0] = b->p + offset;
+    b->ref();
+
+    ThreadAdapter::mutexUnlock(&mutex);
+    return b;
+}
+
 bool DataField::full() const
 {
-    dp2p_assert(reservedSize > 0);
-    return (occupiedSize == reservedSize);
+    return (!isOpen() && getWatermark() == getReservedSize());
 }
 
 char* DataField::getCopy(char* pCopy, int64_t size)
@@ -166,18 +229,23 @@ char* DataField::getCopy(char* pCopy, int64_t size)
     ThreadAdapter::mutexLock(&mutex);
     dp2p_assert(full());
     if(size > 0) {
-    	dp2p_assert(size == reservedSize);
+    	dp2p_assert(size == getReservedSize());
     } else {
-    	pCopy = new char[reservedSize];
+    	pCopy = new char[getReservedSize()];
     }
     dp2p_assert(pCopy);
-    memcpy(pCopy, p, reservedSize);
+    memcpy(pCopy, buf.load(std::memory_order_relaxed)->p, getReservedSize());
     ThreadAdapter::mutexUnlock(&mutex);
     return pCopy;
 }
 
 int64_t DataField::getContigInterval(int64_t offset)
 {
+    /* Fast path: the published prefix ends exactly at the watermark. */
+    const int64_t w = getWatermark();
+    if(offset < w)
+        return w - offset;
+
     ThreadAdapter::mutexLock(&mutex);
     DataMap::const_iterator it = dataMap.begin();
     for( ; it != dataMap.end(); ++it)
@@ -186,9 +254,10 @@ int64_t DataField::getContigInterval(int64_t offset)
             break;
     }
     dp2p_assert(it != dataMap.end());
+    const int64_t contigInterval = it->second - offset + 1;
 
     ThreadAdapter::mutexUnlock(&mutex);
-    return it->second - offset + 1;
+    return contigInterval;
 }
 
 string DataField::printDownloadedData(int64_t offset)
@@ -213,19 +282,44 @@ string DataField::printDownloadedData(int64_t offset)
 void DataField::toFile(string& fileName)
 {
     ThreadAdapter::mutexLock(&mutex);
-	DBGMSG("occupied : %lld reserved : %lld",occupiedSize, reservedSize);
+	DBGMSG("occupied : %" PRId64 " reserved : %" PRId64, occupiedSize.load(std::memory_order_relaxed), getReservedSize());
 	assert(full());
 	FILE* f = fopen(fileName.c_str(),"w");
 	assert(f);
-	assert(occupiedSize == (int64_t)fwrite(p, 1, occupiedSize, f));
+	assert(occupiedSize == (int64_t)fwrite(buf.load(std::memory_order_relaxed)->p, 1, occupiedSize.load(std::memory_order_relaxed), f));
 	assert(0 == fclose(f));
 	ThreadAdapter::mutexUnlock(&mutex);
 }
 
 
+void DataField::close(int64_t numBytes)
+{
+    ThreadAdapter::mutexLock(&mutex);
+    dp2p_assert_v(isOpen() && numBytes > 0 && numBytes == getWatermark() && numBytes == occupiedSize,
+            "size: %" PRId64 ", watermark: %" PRId64 ", occupied: %" PRId64, numBytes, getWatermark(), occupiedSize.load(std::memory_order_relaxed));
+    reservedSize.store(numBytes, std::memory_order_release);
+    open.store(false, std::memory_order_release);
+    ThreadAdapter::mutexUnlock(&mutex);
+}
+
+
 /*
  * Private methods
  */
+
+/* Must be called with the mutex locked. Readers still holding the old buffer find the published data there. */
+void DataField::grow(int64_t numBytes)
+{
+    const int64_t newSize = std::max<int64_t>(numBytes, 2 * reservedSize.load(std::memory_order_relaxed));
+    DataBuffer* const oldBuf = buf.load(std::memory_order_relaxed);
+    DataBuffer* const newBuf = new DataBuffer(newSize);
+    if(!dataMap.empty())
+        memcpy(newBuf->p, oldBuf->p, dataMap.rbegin()->second + 1);
+    retired.push_back(oldBuf);
+    buf.store(newBuf, std::memory_order_release);
+    reservedSize.store(newSize, std::memory_order_release);
+    DBGMSG("Grew an open data field to %" PRId64 " bytes.", newSize);
+}
 #if 0
 void DataField::reserve(int64_t numBytes)
 {
@@ -25,25 +25,59 @@
 
 #include "ThreadAdapter.h"
 
+#include <atomic>
 #include <cstdint>
 #include <map>
 #include <string>
+#include <vector>
 using std::map;
 using std::string;
 
 namespace dashp2p {
 
+/* Memory of a DataField. Reference counted, so that it can be handed out without copying (see DataField::getDataRef())
+ * and outlive the DataField. */
+class DataBuffer
+{
+public:
+    DataBuffer(int64_t numBytes);
+    void ref();
+    void unref(); // deletes the object when the last reference is gone
+public:
+    char* const p;
+private:
+    virtual ~DataBuffer();
+    int refCount;
+    Mutex mutex;
+};
+
+/* Data below the watermark (the contiguous prefix [0, watermark - 1]) are published by setData() with release semantics
+ * and never change afterwards. Readers access them without taking the mutex.
+ *
+ * An open field does not know its size yet (chunked transfer). numBytes is only the initial capacity: setData() grows the
+ * buffer as needed and close() fixes the size. Replaced buffers are kept until the field is deleted, since readers might still
+ * be using them. While open, the capacity stays above the watermark, so the field never looks complete before close(). */
 class DataField
 {
 /* Public methods */
 public:
-    DataField(int64_t numBytes);
+    DataField(int64_t numBytes, bool open = false);
     virtual ~DataField();
-    int64_t getReservedSize() const {return reservedSize;}
-    int64_t getOccupiedSize() const {return occupiedSize;}
+    /* The size, or the current capacity if the field is open. */
+    int64_t getReservedSize() const {return reservedSize.load(std::memory_order_acquire);}
+    bool isOpen() const {return open.load(std::memory_order_acquire);}
+    /* Fixes the size of an open field. All data must be there. */
+    void close(int64_t numBytes);
+    int64_t getOccupiedSize() const {return occupiedSize.load(std::memory_order_acquire);}
+    int64_t getWatermark() const {return watermark.load(std::memory_order_acquire);}
     bool isOccupied(int64_t byteNr);
+    /* Stores [byteFrom, byteTo]. Without overwrite, the range must not overlap data already there. With overwrite, only
+     * the missing bytes are copied: data once stored is never written again, in particular not below the watermark. */
     void setData(int64_t byteFrom, int64_t byteTo, const char* srcBuffer, bool overwrite);
     int64_t getData(int64_t offset, char* buffer, int bufferSize);
+    /* Zero-copy variant of getData(). Sets *data to the contiguous data at offset and *numBytes to their number (at most maxBytes, if maxBytes > 0).
+     * Returns the buffer holding the data with a reference taken. The caller must unref() it when done. */
+    DataBuffer* getDataRef(int64_t offset, int64_t maxBytes, const char** data, int64_t* numBytes);
     bool full() const;
     char* getCopy(char* pCopy = NULL, int64_t size = 0);
     int64_t getContigInterval(int64_t offset);
@@ -53,6 +87,8 @@ public:
 /* Private methods */
 private:
     //void reserve(int64_t numBytes);
+    /* Replaces the buffer of an open field by one of at least numBytes. */
+    void grow(int64_t numBytes);
     //void mergeMap();
 
 /* Private types */
@@ -62,10 +98,15 @@ private:
 
 /* Private members */
 private:
-    char* p;
-    int64_t reservedSize;
-    int64_t occupiedSize;
+    std::atomic<DataBuffer*> buf;
+    std::atomic<int64_t> reservedSize;
+    std::atomic<bool> open;
+    /* Written with the mutex held, atomic for getOccupiedSize(). */
+    std::atomic<int64_t> occupiedSize;
+    std::atomic<int64_t> watermark;
     DataMap dataMap;
+    /* Buffers replaced while the field was open. */
+    std::vector<DataBuffer*> retired;
     Mutex mutex;
 };
 
@@ -0,0 +1,333 @@
+/****************************************************************************
+ * FragmentParser.cpp                                                       *
+ ****************************************************************************
+ * Copyright (C) 2026                                                       *
+ *                                                                          *
+ * Created on: Oct 19, 2026                                                 *
+ * Authors: agent <agent@local>                                             *
+ *                                                                          *
+ * This program is free software: you can redistribute it and/or modify     *
+ * it under the terms of the GNU General Public License as published by     *
+ * the Free Software Foundation, either version 3 of the License, or        *
+ * (at your option) any later version.                                      *
+ *                                                                          *
+ * This program is distributed in the hope that it will be useful,          *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ * GNU General Public License for more details.                             *
+ *                                                                          *
+ * You should have received a copy of the GNU General Public License        *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.     *
+ ****************************************************************************/
+
+#include "FragmentParser.h"
+#include "DebugAdapter.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace dashp2p {
+
+namespace {
+
+/* Largest movie fragment that is read. Anything bigger is not a fragment of a DASH segment. */
+const int64_t MAX_MOOF_SIZE = 16 * 1024 * 1024;
+
+uint32_t fourcc(const char* t)
+{
+    return ((uint32_t)(unsigned char)t[0] << 24) | ((uint32_t)(unsigned char)t[1] << 16) | ((uint32_t)(unsigned char)t[2] << 8) | (unsigned char)t[3];
+}
+
+uint32_t get32(const char* p)
+{
+    const unsigned char* q = (const unsigned char*)p;
+    return ((uint32_t)q[0] << 24) | ((uint32_t)q[1] << 16) | ((uint32_t)q[2] << 8) | q[3];
+}
+
+uint64_t get64(const char* p)
+{
+    return ((uint64_t)get32(p) << 32) | get32(p + 4);
+}
+
+/* Box starting at at, within [at, end) of p. Sets its size and header length. False if damaged. */
+bool readBox(const char* p, int64_t at, int64_t end, uint32_t& type, int64_t& size, int64_t& hdr)
+{
+    if(at + 8 > end)
+        return false;
+    type = get32(p + at + 4);
+    size = get32(p + at);
+    hdr = 8;
+    if(size == 1) {
+        if(at + 16 > end)
+            return false;
+        size = get64(p + at + 8);
+        hdr = 16;
+    } else if(size == 0) {
+        size = end - at;
+    }
+    return size >= hdr && at + size <= end;
+}
+
+/* Offset of the first box of the given type in [from, end) of p, -1 if none. Sets its size and header length. */
+int64_t findBox(const char* p, int64_t from, int64_t end, const char* type, int64_t& size, int64_t& hdr)
+{
+    uint32_t t = 0;
+    for(int64_t at = from; readBox(p, at, end, t, size, hdr); at += size)
+        if(t == fourcc(type))
+            return at;
+    return -1;
+}
+
+/* Boxes expected at the top level of a media segment. Anything else means that it is not fragmented MP4. */
+bool isTopLevel(uint32_t type)
+{
+    static const char* const types[] = {"styp", "sidx", "ssix", "prft", "emsg", "moof", "mdat", "free", "skip", "uuid"};
+    for(unsigned i = 0; i < sizeof(types) / sizeof(types[0]); ++i)
+        if(type == fourcc(types[i]))
+            return true;
+    return false;
+}
+
+}
+
+bool FragmentParser::parseInit(const char* p, int64_t size, TrackInfoMap& tracks)
+{
+    tracks.clear();
+
+    int64_t moovSize = 0, moovHdr = 0;
+    const int64_t moov = findBox(p, 0, size, "moov", moovSize, moovHdr);
+    if(moov < 0)
+        return false;
+    const int64_t moovEnd = moov + moovSize;
+
+    /* Timescales */
+    uint32_t type = 0;
+    int64_t boxSize = 0, hdr = 0;
+    for(int64_t at = moov + moovHdr; readBox(p, at, moovEnd, type, boxSize, hdr); at += boxSize)
+    {
+        if(type != fourcc("trak"))
+            continue;
+        int64_t tkhdSize = 0, tkhdHdr = 0, mdiaSize = 0, mdiaHdr = 0, mdhdSize = 0, mdhdHdr = 0;
+        const int64_t tkhd = findBox(p, at + hdr, at + boxSize, "tkhd", tkhdSize, tkhdHdr);
+        const int64_t mdia = findBox(p, at + hdr, at + boxSize, "mdia", mdiaSize, mdiaHdr);
+        const int64_t mdhd = (mdia < 0) ? -1 : findBox(p, mdia + mdiaHdr, mdia + mdiaSize, "mdhd", mdhdSize, mdhdHdr);
+        if(tkhd < 0 || mdhd < 0)
+            return false;
+        /* Both: version and flags, creation and modification time (32 or 64 bit), then the value. */
+        const int64_t trackIdAt = tkhd + tkhdHdr + 4 + ((p[tkhd + tkhdHdr] == 1) ? 16 : 8);
+        const int64_t timescaleAt = mdhd + mdhdHdr + 4 + ((p[mdhd + mdhdHdr] == 1) ? 16 : 8);
+        if(trackIdAt + 4 > tkhd + tkhdSize || timescaleAt + 4 > mdhd + mdhdSize)
+            return false;
+        tracks[get32(p + trackIdAt)].timescale = get32(p + timescaleAt);
+    }
+
+    /* Defaults of the track fragments */
+    int64_t mvexSize = 0, mvexHdr = 0;
+    const int64_t mvex = findBox(p, moov + moovHdr, moovEnd, "mvex", mvexSize, mvexHdr);
+    if(mvex < 0)
+        return false;
+    for(int64_t at = mvex + mvexHdr; readBox(p, at, mvex + mvexSize, type, boxSize, hdr); at += boxSize)
+    {
+        /* version and flags, track_ID, default_sample_description_index, default_sample_duration, default_sample_size, default_sample_flags */
+        if(type != fourcc("trex") || hdr + 24 > boxSize)
+            continue;
+        TrackInfoMap::iterator it = tracks.find(get32(p + at + hdr + 4));
+        if(it == tracks.end())
+            continue;
+        it->second.defaultSampleDuration = get32(p + at + hdr + 12);
+        it->second.defaultSampleSize = get32(p + at + hdr + 16);
+    }
+
+    return !tracks.empty();
+}
+
+void FragmentParser::process(DataField& field, const TrackInfoMap* tracks)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    if(failed || pos < 0)
+        return;
+    if(tracks)
+        tracksKnown = true;
+
+    const int64_t watermark = field.getWatermark();
+    while(pos + 8 <= watermark)
+    {
+        char hdr[16];
+        const int64_t hdrBytes = field.getData(pos, hdr, std::min<int64_t>(sizeof(hdr), watermark - pos));
+        const uint32_t type = get32(hdr + 4);
+        int64_t size = get32(hdr);
+        int64_t hdrLen = 8;
+        if(size == 1) {
+            if(hdrBytes < 16)
+                break;
+            size = get64(hdr + 8);
+            hdrLen = 16;
+        } else if(size == 0) {
+            /* The last box extends to the end of the segment. Nothing comes after it. */
+            pos = -1;
+            return;
+        }
+        if(!isTopLevel(type) || size < hdrLen || (type == fourcc("moof") && size > MAX_MOOF_SIZE)) {
+            DBGMSG("No fragmented MP4 at offset %" PRId64 ". Estimating media time linearly.", pos);
+            failed = true;
+            return;
+        }
+
+        if(type == fourcc("moof")) {
+            if(pos + size > watermark || !tracks)
+                break;
+            vector<char> moof(size);
+            for(int64_t copied = 0; copied < size; )
+                copied += field.getData(pos + copied, &moof[copied], size - copied);
+            if(!parseMoof(&moof[0], size, pos, *tracks)) {
+                DBGMSG("Movie fragment at offset %" PRId64 " not understood. Estimating media time linearly.", pos);
+                failed = true;
+                return;
+            }
+        }
+
+        pos += size;
+    }
+}
+
+int64_t FragmentParser::getMediaTime(int64_t numBytes) const
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    if(failed || !tracksKnown)
+        return -1;
+
+    /* Last sample ending within the first numBytes bytes. */
+    vector<pair<int64_t, int64_t> >::const_iterator it = std::upper_bound(checkpoints.begin(), checkpoints.end(),
+            pair<int64_t, int64_t>(numBytes, std::numeric_limits<int64_t>::max()));
+    if(it == checkpoints.begin())
+        return 0;
+    --it;
+    return it->second * 1000000 / timescale;
+}
+
+bool FragmentParser::parseMoof(const char* p, int64_t size, int64_t moofStart, const TrackInfoMap& tracks)
+{
+    uint32_t type = 0;
+    int64_t moofSize = 0, moofHdr = 0;
+    if(!readBox(p, 0, size, type, moofSize, moofHdr))
+        return false;
+
+    int64_t trafSize = 0, trafHdr = 0;
+    for(int64_t traf = moofHdr; readBox(p, traf, size, type, trafSize, trafHdr); traf += trafSize)
+    {
+        if(type != fourcc("traf"))
+            continue;
+        const int64_t trafEnd = traf + trafSize;
+
+        /* Track fragment header: version and flags, track_ID, then the optional fields given by the flags. */
+        int64_t tfhdSize = 0, tfhdHdr = 0;
+        const int64_t tfhd = findBox(p, traf + trafHdr, trafEnd, "tfhd", tfhdSize, tfhdHdr);
+        if(tfhd < 0 || tfhdHdr + 8 > tfhdSize)
+            return false;
+        const uint32_t tfhdFlags = get32(p + tfhd + tfhdHdr) & 0xffffff;
+        const uint32_t id = get32(p + tfhd + tfhdHdr + 4);
+        if(trackId == 0) {
+            TrackInfoMap::const_iterator it = tracks.find(id);
+            if(it == tracks.end() || it->second.timescale == 0)
+                return false;
+            trackId = id;
+            timescale = it->second.timescale;
+        }
+        if(id != trackId)
+            continue;
+        const TrackInfo& track = tracks.find(trackId)->second;
+
+        int64_t baseDataOffset = moofStart;
+        uint32_t defaultDuration = track.defaultSampleDuration;
+        uint32_t defaultSize = track.defaultSampleSize;
+        int64_t at = tfhd + tfhdHdr + 8;
+        const int64_t tfhdEnd = tfhd + tfhdSize;
+        if(tfhdFlags & 0x1) {
+            if(at + 8 > tfhdEnd)
+                return false;
+            baseDataOffset = get64(p + at);
+            at += 8;
+        }
+        if(tfhdFlags & 0x2)
+            at += 4;
+        if(tfhdFlags & 0x8) {
+            if(at + 4 > tfhdEnd)
+                return false;
+            defaultDuration = get32(p + at);
+            at += 4;
+        }
+        if(tfhdFlags & 0x10) {
+            if(at + 4 > tfhdEnd)
+                return false;
+            defaultSize = get32(p + at);
+        }
+
+        /* Decode time of the first sample of the fragment. Without tfdt, the fragment follows the previous one. */
+        int64_t ticks = endTicks;
+        int64_t tfdtSize = 0, tfdtHdr = 0;
+        const int64_t tfdt = findBox(p, traf + trafHdr, trafEnd, "tfdt", tfdtSize, tfdtHdr);
+        if(tfdt >= 0) {
+            const bool v1 = (p[tfdt + tfdtHdr] == 1);
+            if(tfdtHdr + (v1 ? 12 : 8) > tfdtSize)
+                return false;
+            const int64_t decodeTime = v1 ? (int64_t)get64(p + tfdt + tfdtHdr + 4) : get32(p + tfdt + tfdtHdr + 4);
+            if(startTime < 0)
+                startTime = decodeTime;
+            ticks = std::max(endTicks, decodeTime - startTime);
+        } else if(startTime < 0) {
+            startTime = 0;
+        }
+
+        /* Track runs: version and flags, sample_count, the optional data_offset and first_sample_flags, then the samples. */
+        int64_t dataOffset = baseDataOffset;
+        int64_t trunSize = 0, trunHdr = 0;
+        for(int64_t trun = traf + trafHdr; readBox(p, trun, trafEnd, type, trunSize, trunHdr); trun += trunSize)
+        {
+            if(type != fourcc("trun"))
+                continue;
+            const int64_t trunEnd = trun + trunSize;
+            if(trunHdr + 8 > trunSize)
+                return false;
+            const uint32_t trunFlags = get32(p + trun + trunHdr) & 0xffffff;
+            const uint32_t sampleCount = get32(p + trun + trunHdr + 4);
+            at = trun + trunHdr + 8;
+            if(trunFlags & 0x1) {
+                if(at + 4 > trunEnd)
+                    return false;
+                dataOffset = baseDataOffset + (int32_t)get32(p + at);
+                at += 4;
+            }
+            if(trunFlags & 0x4)
+                at += 4;
+            if((!(trunFlags & 0x100) && defaultDuration == 0) || (!(trunFlags & 0x200) && defaultSize == 0))
+                return false;
+            const int64_t entrySize = 4 * (!!(trunFlags & 0x100) + !!(trunFlags & 0x200) + !!(trunFlags & 0x400) + !!(trunFlags & 0x800));
+            if(at + sampleCount * entrySize > trunEnd)
+                return false;
+            for(uint32_t i = 0; i < sampleCount; ++i, at += entrySize)
+            {
+                int64_t field = at;
+                uint32_t duration = defaultDuration;
+                uint32_t sampleSize = defaultSize;
+                if(trunFlags & 0x100) {
+                    duration = get32(p + field);
+                    field += 4;
+                }
+                if(trunFlags & 0x200)
+                    sampleSize = get32(p + field);
+                dataOffset += sampleSize;
+                ticks += duration;
+                if(!checkpoints.empty() && dataOffset < checkpoints.back().first)
+                    return false;
+                checkpoints.push_back(pair<int64_t, int64_t>(dataOffset, ticks));
+            }
+        }
+        endTicks = ticks;
+    }
+
+    return trackId != 0;
+}
+
+} /* namespace dashp2p */
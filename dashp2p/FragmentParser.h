@@ -0,0 +1,100 @@
+/****************************************************************************
+ * FragmentParser.h                                                         *
+ ****************************************************************************
+ * Copyright (C) 2026                                                       *
+ *                                                                          *
+ * Created on: Oct 19, 2026                                                 *
+ * Authors: agent <agent@local>                                             *
+ *                                                                          *
+ * This program is free software: you can redistribute it and/or modify     *
+ * it under the terms of the GNU General Public License as published by     *
+ * the Free Software Foundation, either version 3 of the License, or        *
+ * (at your option) any later version.                                      *
+ *                                                                          *
+ * This program is distributed in the hope that it will be useful,          *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ * GNU General Public License for more details.                             *
+ *                                                                          *
+ * You should have received a copy of the GNU General Public License        *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.     *
+ ****************************************************************************/
+
+#ifndef FRAGMENTPARSER_H_
+#define FRAGMENTPARSER_H_
+
+#include "DataField.h"
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <utility>
+#include <vector>
+using std::pair;
+using std::vector;
+
+namespace dashp2p {
+
+/* Values of a track in the initialization segment that its track fragments refer to. */
+class TrackInfo
+{
+public:
+    TrackInfo(): timescale(0), defaultSampleDuration(0), defaultSampleSize(0) {}
+    uint32_t timescale;             // of the media (mdhd)
+    uint32_t defaultSampleDuration; // from trex, 0 if none
+    uint32_t defaultSampleSize;
+};
+
+/* By track_ID. */
+typedef std::map<uint32_t, TrackInfo> TrackInfoMap;
+
+/**
+ * Media time contained in the beginning of a fragmented MP4 segment, which arrives in arbitrary pieces.
+ *
+ * Each time more data are available contiguously from the beginning, process() continues parsing at the box it stopped at:
+ * movie fragments (moof) are read as soon as they are complete, media data and other boxes are skipped. The sample tables
+ * (trun) give the byte range and the duration of every sample, so the media time decodable from the first n bytes is
+ * known exactly, instead of being estimated linearly from the size and the nominal duration of the segment.
+ *
+ * A segment may arrive before the initialization segment of its adaptation set is complete. Then, parsing stops at the first
+ * movie fragment and continues once the tracks are known.
+ *
+ * process() is called by the writer of the data (and once by whoever reads the tracks), getMediaTime() by any thread.
+ */
+class FragmentParser
+{
+public:
+    FragmentParser(): pos(0), failed(false), tracksKnown(false), trackId(0), timescale(0), startTime(-1), endTicks(0) {}
+
+    /* Reads the tracks of an initialization segment of size bytes. Returns false if it is not fragmented MP4 as expected. */
+    static bool parseInit(const char* p, int64_t size, TrackInfoMap& tracks);
+
+    /**
+     * Continues parsing the data available contiguously in field. tracks are those of the initialization segment, NULL while
+     * they are not known. Parsing stops for good if the data are not fragmented MP4 as expected.
+     */
+    void process(DataField& field, const TrackInfoMap* tracks);
+
+    /* Media time [us] of the samples lying completely within the first numBytes bytes. -1 if not known (parsing failed, or the
+     * tracks are not known yet). */
+    int64_t getMediaTime(int64_t numBytes) const;
+
+private:
+    /* Called with the lock held. Reads the movie fragment p[0, size), which is at offset moofStart of the segment. */
+    bool parseMoof(const char* p, int64_t size, int64_t moofStart, const TrackInfoMap& tracks);
+
+private:
+    mutable std::mutex _mutex;
+    int64_t pos;        // offset of the next box, -1 if the last box extends to the end of the segment
+    bool failed;
+    bool tracksKnown;   // if process() was given the tracks. Before, movie fragments are not parsed.
+    uint32_t trackId;   // of the first track fragment, 0 while none is parsed. Other tracks are ignored.
+    uint32_t timescale;
+    int64_t startTime;  // decode time [ticks] of the first sample (tfdt), -1 while not known
+    int64_t endTicks;   // decode time [ticks] at the end of the last sample, relative to startTime
+    /* <offset of the end of a sample, decode time [ticks] at the end of the sample, relative to startTime>, in the order of the offsets */
+    vector<pair<int64_t, int64_t> > checkpoints;
+};
+
+} /* namespace dashp2p */
+#endif /* FRAGMENTPARSER_H_ */
@@ -13,12 +13,14 @@ namespace dashp2p {
 
 // static variables in HttpClientManager
 HttpClientManager::HttpVec HttpClientManager::httpVec(1024, nullptr);
+list<DashHttp*> HttpClientManager::retired;
 
 void HttpClientManager::cleanup()
 {
     for(std::size_t i = 0; i < httpVec.size(); ++i)
         delete httpVec.at(i);
     httpVec.clear();
+    reap(true);
 }
 
 void HttpClientManager::create(const TcpConnectionId& id, const HttpCb& cb)
@@ -37,4 +39,28 @@ void HttpClientManager::destroy(const TcpConnectionId& tcpConnectionId)
     httpVec.at(tcpConnectionId.numeric()) = nullptr;
 }
 
+void HttpClientManager::retire(const TcpConnectionId& tcpConnectionId)
+{
+    DashHttp* http = httpVec.at(tcpConnectionId.numeric());
+    dp2p_assert(http);
+    http->stop();
+    httpVec.at(tcpConnectionId.numeric()) = nullptr;
+    retired.push_back(http);
+}
+
+void HttpClientManager::reap(bool wait)
+{
+    for(list<DashHttp*>::iterator it = retired.begin(); it != retired.end(); ) {
+        DashHttp* http = *it;
+        if(!wait && !http->terminated()) {
+            ++it;
+            continue;
+        }
+        it = retired.erase(it);
+        const TcpConnectionId tcpConnectionId = http->tcpConnectionId;
+        delete http;
+        TcpConnectionManager::disconnect(tcpConnectionId);
+    }
+}
+
 } /* namespace dashp2p */
@@ -27,7 +27,9 @@
 #include "TcpConnectionManager.h"
 
 #include <vector>
+#include <list>
 using std::vector;
+using std::list;
 
 namespace dashp2p {
 
@@ -56,6 +58,12 @@ public: // public methods
     static void create(const TcpConnectionId& tcpConnectionId, const HttpCb& cb);
     static void destroy(const TcpConnectionId& tcpConnectionId);
     static DashHttp& get(const TcpConnectionId& tcpConnectionId) {return *httpVec.at(tcpConnectionId.numeric());}
+    /* Stops the client without waiting for its thread. The client and its TCP connection are released in reap(). */
+    static void retire(const TcpConnectionId& tcpConnectionId);
+    /* Deletes retired clients whose threads have returned (all of them if wait is set) and disconnects their TCP connections.
+     * Must not be called while holding Control::mutex. */
+    static void reap(bool wait = false);
+    static bool exists(const TcpConnectionId& tcpConnectionId) {return httpVec.at(tcpConnectionId.numeric()) != nullptr;}
 
 private: // private methods
     HttpClientManager(){}
@@ -66,6 +74,7 @@ private: // private types
 
 private: // private fields
     static HttpVec httpVec;
+    static list<DashHttp*> retired;
 };
 
 } /* namespace dashp2p */
@@ -27,8 +27,12 @@
 #include <cassert>
 //#include <cinttypes>
 #include <cstdio>
+#include <cctype>
 #include <cstring>
+#include <cstdlib>
+#include <algorithm>
 #include <stdexcept>
+#include <strings.h>
 
 namespace dashp2p {
 
@@ -37,7 +41,7 @@ vector<vector<HttpRequestManager::HttpRequest*>* > HttpRequestManager::reqs;
 Mutex HttpRequestManager::mutex;
 
 int HttpRequestManager::newHttpRequest(const TcpConnectionId& tcpConnectionId, const ContentId* contentId,
-        /*const string& hostName,*/ const string& file, bool withPipelining, HttpMethod httpMethod)
+        /*const string& hostName,*/ const string& file, bool withPipelining, HttpMethod httpMethod, const pair<int64_t, int64_t>& byteRange)
 {
 	ThreadAdapter::mutexLock(&mutex);
 
@@ -47,13 +51,21 @@ int HttpRequestManager::newHttpRequest(const TcpConnectionId& tcpConnectionId, c
 	}
 
 	const int reqId = s * (reqs.size() - 1) + reqs.back()->size();
-	reqs.back()->push_back(new HttpRequest(tcpConnectionId, contentId, file, withPipelining, httpMethod));
+	reqs.back()->push_back(new HttpRequest(tcpConnectionId, contentId, file, withPipelining, httpMethod, byteRange));
 
 	ThreadAdapter::mutexUnlock(&mutex);
 
 	return reqId;
 }
 
+int HttpRequestManager::getNextReqId()
+{
+	ThreadAdapter::mutexLock(&mutex);
+	const int ret = reqs.empty() ? 0 : s * (reqs.size() - 1) + reqs.back()->size();
+	ThreadAdapter::mutexUnlock(&mutex);
+	return ret;
+}
+
 void HttpRequestManager::appendHdrBytes(int reqId, const void* p, int newHdrBytes, int64_t recvTimestamp)
 {
 	HttpRequest* req = reqs.at(reqId / s)->at(reqId % s);
@@ -74,15 +86,28 @@ void HttpRequestManager::appendHdrBytes(int reqId, const void* p, int newHdrByte
 }
 
 // TODO: let DashHttp read directly from socket into DataField
-void HttpRequestManager::appendPldBytes(int reqId, const void* p, int newPldBytes, int64_t recvTimestamp)
+void HttpRequestManager::appendPldBytes(int reqId, const void* p, int newPldBytes, int64_t recvTimestamp, bool inChunk)
 {
 	HttpRequest* req = reqs.at(reqId / s)->at(reqId % s);
 
-	if(req->pldBytesReceived == 0)
-	    SegmentStorage::setSize(req->contentId, req->hdr.contentLength);
+	if(inChunk && req->lastPldTimestamp != -1) {
+		req->activeTime += recvTimestamp - req->lastPldTimestamp;
+		req->activeBytes += newPldBytes;
+	}
+	req->lastPldTimestamp = recvTimestamp;
 
 	if(req->pldBytesReceived + newPldBytes == req->hdr.contentLength)
 		req->tsLastByte = recvTimestamp;
+
+	/* Separate audio: the muxer stores what belongs to the joint stream itself. */
+	if(TrackMuxer::enabled() && TrackMuxer::addData(req->contentId, req->pldBytesReceived, (const char*)p, newPldBytes, req->hdr.contentLength, req->trackIdRewriter)) {
+		req->pldBytesReceived += newPldBytes;
+		return;
+	}
+
+	if(req->pldBytesReceived == 0)
+	    SegmentStorage::setSize(req->contentId, req->hdr.contentLength);
+
 	//if(!req->pldBytes)
 	//	req->pldBytes = new char[req->hdr.contentLength];
 	//memcpy(req->pldBytes + req->pldBytesReceived, p, newPldBytes);
@@ -91,6 +116,26 @@ void HttpRequestManager::appendPldBytes(int reqId, const void* p, int newPldByte
 	req->pldBytesReceived += newPldBytes;
 }
 
+void HttpRequestManager::completeChunked(int reqId, int64_t recvTimestamp)
+{
+	HttpRequest* req = reqs.at(reqId / s)->at(reqId % s);
+	dp2p_assert(req->hdr.chunked && req->chunkDecoder.done() && req->hdr.contentLength == -1);
+
+	if(TrackMuxer::enabled() && TrackMuxer::complete(req->contentId, req->pldBytesReceived))
+		DBGMSG("Initialization segment taken by the muxer.");
+	else if(req->pldBytesReceived == 0)
+		SegmentStorage::setSize(req->contentId, 0);
+	else
+		SegmentStorage::setFinalSize(req->contentId, req->pldBytesReceived);
+	req->hdr.contentLength = req->pldBytesReceived;
+	req->tsLastByte = recvTimestamp;
+}
+
+HttpChunkDecoder& HttpRequestManager::getChunkDecoder(int reqId)
+{
+	return reqs.at(reqId / s)->at(reqId % s)->chunkDecoder;
+}
+
 const HttpHdr& HttpRequestManager::parseHeader(int reqId)
 {
 	HttpRequest* req = reqs.at(reqId / s)->at(reqId % s);
@@ -111,7 +156,9 @@ const HttpHdr& HttpRequestManager::parseHeader(int reqId)
 			dp2p_assert(1 == sscanf(pos, "HTTP/1.1 %" SCNd32, &_httpStatusCode) && _httpStatusCode != 0);
 			switch(_httpStatusCode) {
 			case 200: req->hdr.statusCode = HTTP_STATUS_CODE_OK; break;
+			case 206: req->hdr.statusCode = HTTP_STATUS_CODE_PARTIAL_CONTENT; break;
 			case 302: req->hdr.statusCode = HTTP_STATUS_CODE_FOUND; break;
+			case 304: req->hdr.statusCode = HTTP_STATUS_CODE_NOT_MODIFIED; break;
 			default:
 				ERRMSG("HTTP returned status code %" PRIu32 " for %s.", _httpStatusCode, req->file.c_str());
 				throw std::runtime_error("HTTP returned bad status code.");
@@ -125,6 +172,13 @@ const HttpHdr& HttpRequestManager::parseHeader(int reqId)
 			dp2p_assert(1 == sscanf(pos, "Content-Length: %" SCNd64, &req->hdr.contentLength) && req->hdr.contentLength >= 0);
 		}
 
+		/* Chunked transfer coding. The content length is known when the last chunk is in. */
+		else if(0 == strncasecmp(pos, "Transfer-Encoding:", 18))
+		{
+			dp2p_assert_v(strstr(pos, "chunked") && strstr(pos, "chunked") - pos < lineLength, "Unsupported HTTP header line: %.*s.", lineLength, pos);
+			req->hdr.chunked = true;
+		}
+
 		/* Parse "Connection:" line */
 		else if(0 == strncmp(pos, "Connection:", 11))
 		{
@@ -136,6 +190,16 @@ const HttpHdr& HttpRequestManager::parseHeader(int reqId)
 			}
 		}
 
+		/* Validators, kept as they are for conditional requests */
+		else if(0 == strncasecmp(pos, "ETag:", 5) || 0 == strncasecmp(pos, "Last-Modified:", 14))
+		{
+			const char* value = strchr(pos, ':') + 1;
+			while(*value == ' ')
+				++value;
+			string& field = (tolower(pos[0]) == 'e') ? req->hdr.etag : req->hdr.lastModified;
+			field.assign(value, pos + lineLength - value);
+		}
+
 		/* Parse Keep-Alive: line */
 		else if(0 == strncmp(pos, "Keep-Alive:", 11))
 		{
@@ -180,6 +244,14 @@ void HttpRequestManager::markUnsent(int reqId)
 	reqs.at(reqId / s)->at(reqId % s)->markUnsent();
 }
 
+void HttpRequestManager::setValidators(int reqId, const string& etag, const string& lastModified)
+{
+	HttpRequest* req = reqs.at(reqId / s)->at(reqId % s);
+	dp2p_assert(!req->sent());
+	req->ifNoneMatch = etag;
+	req->ifModifiedSince = lastModified;
+}
+
 /*const string& HttpRequestManager::getDevName(int reqId)
 {
 	return reqs.at(reqId / s)->at(reqId % s)->devName;
@@ -205,6 +277,21 @@ HttpMethod HttpRequestManager::getHttpMethod(int reqId)
 	return reqs.at(reqId / s)->at(reqId % s)->httpMethod;
 }
 
+const pair<int64_t, int64_t>& HttpRequestManager::getByteRange(int reqId)
+{
+	return reqs.at(reqId / s)->at(reqId % s)->byteRange;
+}
+
+const string& HttpRequestManager::getIfNoneMatch(int reqId)
+{
+	return reqs.at(reqId / s)->at(reqId % s)->ifNoneMatch;
+}
+
+const string& HttpRequestManager::getIfModifiedSince(int reqId)
+{
+	return reqs.at(reqId / s)->at(reqId % s)->ifModifiedSince;
+}
+
 int64_t HttpRequestManager::getContentLength(int reqId)
 {
 	return reqs.at(reqId / s)->at(reqId % s)->hdr.contentLength;
@@ -255,6 +342,14 @@ int64_t HttpRequestManager::getTsLastByte(int reqId)
 	return reqs.at(reqId / s)->at(reqId % s)->tsLastByte;
 }
 
+int64_t HttpRequestManager::getTransferTime(int reqId)
+{
+	const HttpRequest* req = reqs.at(reqId / s)->at(reqId % s);
+	if(req->hdr.chunked && req->activeTime > 0 && req->activeBytes > 0)
+		return std::max<int64_t>(1, req->hdr.contentLength * req->activeTime / req->activeBytes);
+	return req->tsLastByte - req->tsSent;
+}
+
 const DownloadProcess& HttpRequestManager::getDownloadProcess(int reqId)
 {
 	return *reqs.at(reqId / s)->at(reqId % s)->downloadProcess;
@@ -324,7 +419,7 @@ void HttpRequestManager::cleanup()
 unsigned HttpRequestManager::HttpRequest::nextReqId = 0;
 
 HttpRequestManager::HttpRequest::HttpRequest(const TcpConnectionId& tcpConnectionId, const ContentId* contentId,
-        /*const string& hostName,*/ const string& file, bool allowPipelining, HttpMethod httpMethod)
+        /*const string& hostName,*/ const string& file, bool allowPipelining, HttpMethod httpMethod, const pair<int64_t, int64_t>& byteRange)
   : tcpConnectionId(tcpConnectionId),
     reqId(nextReqId),
     //hostName(hostName),
@@ -333,11 +428,19 @@ HttpRequestManager::HttpRequest::HttpRequest(const TcpConnectionId& tcpConnectio
     allowPipelining(allowPipelining),
     sentPipelined(false),
     httpMethod(httpMethod),
+    byteRange(byteRange),
+    ifNoneMatch(),
+    ifModifiedSince(),
     hdr(),
     hdrBytesReceived(0),
     hdrBytes(NULL),
     hdrCompleted(false),
     pldBytesReceived(0),
+    chunkDecoder(),
+    lastPldTimestamp(-1),
+    activeTime(0),
+    activeBytes(0),
+    trackIdRewriter(),
     //pldBytes(NULL),
     downloadProcess(NULL),
     tsSent(-1),
@@ -388,7 +491,7 @@ void HttpRequestManager::HttpRequest::recordDownloadProgress(const DownloadProce
 
 bool HttpRequestManager::HttpRequest::completed() const
 {
-	if(hdr.statusCode == HTTP_STATUS_CODE_FOUND)
+	if(hdr.statusCode == HTTP_STATUS_CODE_FOUND || hdr.statusCode == HTTP_STATUS_CODE_NOT_MODIFIED)
 		return hdrCompleted;
 
     switch(httpMethod) {
@@ -402,11 +505,60 @@ bool HttpRequestManager::HttpRequest::completed() const
     }
 }
 
+int HttpChunkDecoder::decode(const char* p, int size, const char** pld, int* pldSize)
+{
+	*pld = NULL;
+	*pldSize = 0;
+
+	int i = 0;
+	while(i < size && state != DONE)
+	{
+		if(state == DATA) {
+			const int n = (int)std::min<int64_t>(chunkRemaining, size - i);
+			*pld = p + i;
+			*pldSize = n;
+			chunkRemaining -= n;
+			if(chunkRemaining == 0)
+				state = DATA_CRLF;
+			return i + n;
+		}
+
+		/* Everything else is line based. */
+		const char c = p[i++];
+		if(c != '\n') {
+			if(c != '\r')
+				line.push_back(c);
+			dp2p_assert_v(line.size() <= 1024, "Chunk size or trailer line too long.", NULL);
+			continue;
+		}
+		switch(state) {
+		case SIZE:
+			dp2p_assert_v(!line.empty() && isxdigit((unsigned char)line[0]), "Bad chunk size line: %s.", line.c_str());
+			chunkRemaining = strtoll(line.c_str(), NULL, 16);
+			state = (chunkRemaining > 0) ? DATA : TRAILER;
+			break;
+		case DATA_CRLF:
+			dp2p_assert_v(line.empty(), "Chunk data longer than announced.", NULL);
+			state = SIZE;
+			break;
+		case TRAILER:
+			if(line.empty())
+				state = DONE;
+			break;
+		default:
+			dp2p_assert(false);
+			break;
+		}
+		line.clear();
+	}
+	return i;
+}
+
 string HttpHdr::toString() const
 {
 	static char tmp[2048];
-	sprintf(tmp, "Status: %d. Keep-Alive max: %d, timeout: %" PRId64 ". Content-length: %" PRId64 ". Connection: %d.",
-			statusCode, keepAliveMax, keepAliveTimeout, contentLength, connectionClose);
+	sprintf(tmp, "Status: %d. Keep-Alive max: %d, timeout: %" PRId64 ". Content-length: %" PRId64 "%s. Connection: %d.",
+			statusCode, keepAliveMax, keepAliveTimeout, contentLength, chunked ? " (chunked)" : "", connectionClose);
 	return string(tmp);
 }
 
@@ -28,6 +28,7 @@
 #include "ThreadAdapter.h"
 #include "ContentId.h"
 #include "HttpClientManager.h"
+#include "TrackMuxer.h"
 
 #include <list>
 #include <string>
@@ -42,13 +43,33 @@ namespace dashp2p {
 
 class HttpHdr {
 public:
-	HttpHdr() : statusCode(HTTP_STATUS_CODE_UNDEFINED), keepAliveMax(-1), keepAliveTimeout(-1), contentLength(-1), connectionClose(-1) {}
+	HttpHdr() : statusCode(HTTP_STATUS_CODE_UNDEFINED), keepAliveMax(-1), keepAliveTimeout(-1), contentLength(-1), connectionClose(-1), chunked(false) {}
 	string toString() const;
 	HTTPStatusCode statusCode;
 	int keepAliveMax;
 	int64_t keepAliveTimeout;
-	int64_t contentLength;
+	int64_t contentLength; // -1 until a chunked payload is complete
 	int connectionClose;
+	bool chunked;         // Transfer-Encoding: chunked
+	string etag;          // validators, empty if not sent
+	string lastModified;
+};
+
+/* Decoder of the chunked transfer coding (RFC 2616, 3.6.1). Chunk extensions and trailers are skipped. */
+class HttpChunkDecoder {
+public:
+	HttpChunkDecoder(): state(SIZE), chunkRemaining(0), line() {}
+	/** Consumes the bytes at p up to the end of the next piece of payload data. *pld and *pldSize are set to that data
+	 *  (size 0 if there is none, e.g., because the chunk size line is not complete yet). Returns the number of bytes consumed. */
+	int decode(const char* p, int size, const char** pld, int* pldSize);
+	/* The next byte is payload data of a chunk that is already being received. */
+	bool inChunk() const {return state == DATA;}
+	bool done() const {return state == DONE;}
+private:
+	enum State {SIZE, DATA, DATA_CRLF, TRAILER, DONE};
+	State state;
+	int64_t chunkRemaining;
+	string line; // incomplete chunk size or trailer line
 };
 
 class DownloadProcessElement {
@@ -68,15 +89,26 @@ public:
 	static void cleanup();
 
 	/** Creates a new HTTP request.
-	 *  @param contentId  Provided by the caller for later identification of the downloaded data in the call-back. We take over the memory management. */
-	static int newHttpRequest(const TcpConnectionId& tcpConnectionId, const ContentId* contentId, /*const string& hostName,*/ const string& file, bool withPipelining, HttpMethod httpMethod);
+	 *  @param contentId  Provided by the caller for later identification of the downloaded data in the call-back. We take over the memory management.
+	 *  @param byteRange  Inclusive byte range to request, or (-1,-1) for the whole file. */
+	static int newHttpRequest(const TcpConnectionId& tcpConnectionId, const ContentId* contentId, /*const string& hostName,*/ const string& file, bool withPipelining, HttpMethod httpMethod,
+	        const pair<int64_t, int64_t>& byteRange = pair<int64_t, int64_t>(-1, -1));
 
 	static void appendHdrBytes(int reqId, const void* p, int newHdrBytes, int64_t recvTimestamp);
-	static void appendPldBytes(int reqId, const void* p, int newPldBytes, int64_t recvTimestamp);
+	/** @param inChunk  The bytes continue a chunk of a chunked payload, they were sent without pause after the previous ones. */
+	static void appendPldBytes(int reqId, const void* p, int newPldBytes, int64_t recvTimestamp, bool inChunk = false);
+	/** Chunked payload complete: sets the content length and the size of the object in the SegmentStorage. */
+	static void completeChunked(int reqId, int64_t recvTimestamp);
+	static HttpChunkDecoder& getChunkDecoder(int reqId);
 	static const HttpHdr& parseHeader(int reqId);
 	static void replaceHeader(int reqId, const HttpHdr& newHdr);
 	static void recordDownloadProgress(int reqId, const DownloadProcessElement& el);
 	static void markUnsent(int reqId);
+	/** Makes the request conditional (If-None-Match, If-Modified-Since). The server answers 304 if the resource did not change.
+	 *  Empty strings are not sent. Call before the request is handed to the HTTP client. */
+	static void setValidators(int reqId, const string& etag, const string& lastModified);
+	/** Identifier the next request will get. Identifiers are increasing, so all requests created before have smaller ones. */
+	static int getNextReqId();
 
 	// TODO: check if functions below need mutex synchro
 	//static const string& getDevName(int reqId);
@@ -84,6 +116,9 @@ public:
 	static const string& getFileName(int reqId);
 	static ContentType getContentType(int reqId);
 	static HttpMethod getHttpMethod(int reqId);
+	static const pair<int64_t, int64_t>& getByteRange(int reqId);
+	static const string& getIfNoneMatch(int reqId);
+	static const string& getIfModifiedSince(int reqId);
 	static int64_t getContentLength(int reqId);
 	static const ContentId& getContentId(int reqId);
 	//static const char* getPldBytes(int reqId);
@@ -94,6 +129,9 @@ public:
     static int64_t getTsSent(int reqId);
     static int64_t getTsFirstByte(int reqId);
     static int64_t getTsLastByte(int reqId);
+    /** Time [us] the transfer would have taken without the pauses of a chunked payload (the server sending data as it is produced):
+     *  the size divided by the throughput measured within chunks. Otherwise, from sending the request to the last byte. */
+    static int64_t getTransferTime(int reqId);
     static const DownloadProcess& getDownloadProcess(int reqId);
 
     static bool isHdrCompleted(int reqId);
@@ -120,7 +158,8 @@ private:
 	public:
 		/** Constructor.
 		 *  @param contentId  Provided by the caller for later identification of the downloaded data in the call-back. We take over the memory management. */
-		HttpRequest(const TcpConnectionId& tcpConnectionId, const ContentId* contentId, /*const string& hostName,*/ const string& file, bool withPipelining, HttpMethod httpMethod);
+		HttpRequest(const TcpConnectionId& tcpConnectionId, const ContentId* contentId, /*const string& hostName,*/ const string& file, bool withPipelining, HttpMethod httpMethod,
+		        const pair<int64_t, int64_t>& byteRange);
 
 		virtual ~HttpRequest();
 
@@ -145,6 +184,9 @@ private:
 		bool sentPipelined;  // if yes, this request was sent before the previous one was completed
 
 		const HttpMethod httpMethod;
+		const pair<int64_t, int64_t> byteRange; // (-1,-1) if the whole file is requested
+		string ifNoneMatch;      // empty if the request is not conditional
+		string ifModifiedSince;
 
 		HttpHdr hdr;
 
@@ -153,6 +195,11 @@ private:
 		bool     hdrCompleted;
 
 		int64_t pldBytesReceived;
+		HttpChunkDecoder chunkDecoder;
+		int64_t lastPldTimestamp; // [us]
+		int64_t activeTime;       // [us] time, and bytes, within chunks
+		int64_t activeBytes;
+		TrackIdRewriter trackIdRewriter; // separate audio, see TrackMuxer
 		//char* pldBytes; // TODO: make pldBytes pointing directly into SegmentStorage in order to avoid copying
 		DownloadProcess* downloadProcess; // ([us],[byte])
 
@@ -0,0 +1,225 @@
+/****************************************************************************
+ * MpdCache.cpp                                                             *
+ ****************************************************************************
+ * Copyright (C) 2026                                                       *
+ *                                                                          *
+ * Created on: Oct 19, 2026                                                 *
+ * Authors: agent <agent@local>                                             *
+ *                                                                          *
+ * This program is free software: you can redistribute it and/or modify     *
+ * it under the terms of the GNU General Public License as published by     *
+ * the Free Software Foundation, either version 3 of the License, or        *
+ * (at your option) any later version.                                      *
+ *                                                                          *
+ * This program is distributed in the hope that it will be useful,          *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ * GNU General Public License for more details.                             *
+ *                                                                          *
+ * You should have received a copy of the GNU General Public License        *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.     *
+ ****************************************************************************/
+
+#include "MpdCache.h"
+#include "XmlAdapter.h"
+#include "mpd/model_parser.h"
+#include "Utilities.h"
+#include "DebugAdapter.h"
+
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+namespace dashp2p {
+
+namespace {
+
+/* File layout: header, URL, ETag, Last-Modified, events, padding to 8 bytes, playback index image. */
+class FileHeader {
+public:
+    char magic[8];
+    uint64_t namesHash;        // the events refer to element and attribute names by number
+    uint32_t urlLength;
+    uint32_t etagLength;
+    uint32_t lastModifiedLength;
+    uint32_t reserved;
+    uint64_t eventsSize;
+    uint64_t indexOffset;
+    uint64_t indexSize;
+};
+
+const char MAGIC[8] = {'D', 'P', '2', 'P', 'M', 'P', 'D', '1'};
+
+uint64_t fnv1a(const char* p, size_t n, uint64_t h = 14695981039346656037ULL)
+{
+    for(size_t i = 0; i < n; ++i)
+        h = (h ^ (unsigned char)p[i]) * 1099511628211ULL;
+    return h;
+}
+
+uint64_t getNamesHash()
+{
+    static uint64_t h = 0;
+    if(h == 0) {
+        h = fnv1a(nullptr, 0);
+        for(int i = 1; i < mpd::names::NUM_NAMES; ++i) {
+            const char* name = mpd::names::toString((mpd::names::Id)i);
+            h = fnv1a(name, strlen(name) + 1, h);
+        }
+    }
+    return h;
+}
+
+}
+
+string MpdCache::dir;
+void* MpdCache::mapping = nullptr;
+size_t MpdCache::mappingSize = 0;
+string MpdCache::etag;
+string MpdCache::lastModified;
+
+void MpdCache::init(const string& dir)
+{
+    dp2p_assert(!enabled() && !dir.empty());
+
+    if(0 != mkdir(dir.c_str(), 0755) && errno != EEXIST) {
+        ERRMSG("Cannot create the MPD cache directory %s: %s. Not caching MPDs.", dir.c_str(), strerror(errno));
+        return;
+    }
+
+    MpdCache::dir = dir;
+    INFOMSG("Caching parsed MPDs in %s.", dir.c_str());
+}
+
+void MpdCache::cleanup()
+{
+    if(mapping) {
+        munmap(mapping, mappingSize);
+        mapping = nullptr;
+        mappingSize = 0;
+    }
+    etag.clear();
+    lastModified.clear();
+    dir.clear();
+}
+
+bool MpdCache::load(const string& url, mpd::MediaPresentationDescription** mpd, PlaybackIndex** index)
+{
+    dp2p_assert(enabled() && !loaded());
+
+    const int64_t tStart = Utilities::getTime();
+
+    const string fileName = getFileName(url);
+    const int fd = open(fileName.c_str(), O_RDONLY);
+    if(fd == -1) {
+        DBGMSG("No snapshot of %s.", url.c_str());
+        return false;
+    }
+    struct stat st;
+    if(0 != fstat(fd, &st) || st.st_size < (off_t)sizeof(FileHeader)) {
+        close(fd);
+        return false;
+    }
+    const size_t size = st.st_size;
+    void* p = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(p == MAP_FAILED) {
+        ERRMSG("Cannot map %s: %s.", fileName.c_str(), strerror(errno));
+        return false;
+    }
+
+    /* Check that the file is complete, made by this version and for this URL.
+     * The sizes come from the file: compare by subtracting what is known to be smaller, so that nothing wraps. */
+    const char* const data = static_cast<const char*>(p);
+    FileHeader hdr;
+    memcpy(&hdr, data, sizeof(hdr));
+    const uint64_t stringsEnd = sizeof(FileHeader) + (uint64_t)hdr.urlLength + hdr.etagLength + hdr.lastModifiedLength;
+    if(0 != memcmp(hdr.magic, MAGIC, sizeof(MAGIC)) || hdr.namesHash != getNamesHash()
+            || stringsEnd > hdr.indexOffset || hdr.eventsSize > hdr.indexOffset - stringsEnd || hdr.indexOffset % 8 != 0
+            || hdr.indexOffset > size || hdr.indexSize != size - hdr.indexOffset
+            || hdr.urlLength != url.size() || 0 != memcmp(data + sizeof(FileHeader), url.data(), url.size()))
+    {
+        INFOMSG("Ignoring the snapshot of %s: damaged or from another version.", url.c_str());
+        munmap(p, size);
+        return false;
+    }
+
+    /* Model and index. */
+    *mpd = XmlAdapter::replayMpd(data + stringsEnd, hdr.eventsSize);
+    *index = *mpd ? PlaybackIndex::fromImage(data + hdr.indexOffset, hdr.indexSize) : nullptr;
+    if(!*index) {
+        INFOMSG("Ignoring the snapshot of %s: damaged.", url.c_str());
+        delete *mpd;
+        *mpd = nullptr;
+        munmap(p, size);
+        return false;
+    }
+
+    mapping = p;
+    mappingSize = size;
+    etag.assign(data + sizeof(FileHeader) + hdr.urlLength, hdr.etagLength);
+    lastModified.assign(data + sizeof(FileHeader) + hdr.urlLength + hdr.etagLength, hdr.lastModifiedLength);
+
+    INFOMSG("Loaded the snapshot of the MPD (%zu bytes) in %.3f ms.", size, (Utilities::getTime() - tStart) / 1e3);
+    return true;
+}
+
+void MpdCache::store(const string& url, const string& etag, const string& lastModified, const string& events, const PlaybackIndex& index)
+{
+    dp2p_assert(enabled());
+
+    string buf;
+    buf.reserve(sizeof(FileHeader) + url.size() + etag.size() + lastModified.size() + events.size() + 8 + index.getSize() + 64);
+
+    FileHeader hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, MAGIC, sizeof(MAGIC));
+    hdr.namesHash = getNamesHash();
+    hdr.urlLength = url.size();
+    hdr.etagLength = etag.size();
+    hdr.lastModifiedLength = lastModified.size();
+    hdr.eventsSize = events.size();
+    buf.append(sizeof(FileHeader), '\0');
+    buf.append(url);
+    buf.append(etag);
+    buf.append(lastModified);
+    buf.append(events);
+    buf.append((8 - buf.size() % 8) % 8, '\0');
+    hdr.indexOffset = buf.size();
+    index.writeImage(buf);
+    hdr.indexSize = buf.size() - hdr.indexOffset;
+    memcpy(&buf[0], &hdr, sizeof(hdr));
+
+    /* Write a temporary file and rename it, so that readers never see a partial snapshot. */
+    const string fileName = getFileName(url);
+    char tmpName[32];
+    sprintf(tmpName, ".tmp%d", (int)getpid());
+    const string tmpFileName = fileName + tmpName;
+    FILE* f = fopen(tmpFileName.c_str(), "wb");
+    if(!f) {
+        ERRMSG("Cannot write %s: %s.", tmpFileName.c_str(), strerror(errno));
+        return;
+    }
+    const bool ok = (buf.size() == fwrite(buf.data(), 1, buf.size(), f));
+    if(0 != fclose(f) || !ok || 0 != rename(tmpFileName.c_str(), fileName.c_str())) {
+        ERRMSG("Cannot write %s: %s.", fileName.c_str(), strerror(errno));
+        remove(tmpFileName.c_str());
+        return;
+    }
+
+    DBGMSG("Stored the snapshot of %s in %s (%zu bytes).", url.c_str(), fileName.c_str(), buf.size());
+}
+
+string MpdCache::getFileName(const string& url)
+{
+    char name[32];
+    sprintf(name, "%016" PRIx64 ".mpdc", fnv1a(url.data(), url.size()));
+    return dir + "/" + name;
+}
+
+} /* namespace dashp2p */
@@ -0,0 +1,83 @@
+/****************************************************************************
+ * MpdCache.h                                                               *
+ ****************************************************************************
+ * Copyright (C) 2026                                                       *
+ *                                                                          *
+ * Created on: Oct 19, 2026                                                 *
+ * Authors: agent <agent@local>                                             *
+ *                                                                          *
+ * This program is free software: you can redistribute it and/or modify     *
+ * it under the terms of the GNU General Public License as published by     *
+ * the Free Software Foundation, either version 3 of the License, or        *
+ * (at your option) any later version.                                      *
+ *                                                                          *
+ * This program is distributed in the hope that it will be useful,          *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ * GNU General Public License for more details.                             *
+ *                                                                          *
+ * You should have received a copy of the GNU General Public License        *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.     *
+ ****************************************************************************/
+
+#ifndef MPDCACHE_H_
+#define MPDCACHE_H_
+
+#include "mpd/model.h"
+#include "PlaybackIndex.h"
+
+#include <string>
+using std::string;
+
+namespace dashp2p {
+
+/**
+ * On-disk cache of parsed MPDs, so that playing the same content again starts without downloading and parsing the MPD.
+ *
+ * One file per MPD URL, holding the URL, the validators (ETag, Last-Modified) of the response it was made from,
+ * the events the model parsers received (see MpdPushParser::setRecorder()) and an image of the playback index.
+ * Nothing in the file is a pointer. The file is mapped, the model is rebuilt by replaying the events (no XML
+ * tokenizing, no name lookups) and the playback index is used in place.
+ *
+ * The snapshot is revalidated with a conditional GET. If the MPD changed, the new one is stored for the next start.
+ *
+ * Meant to be called from the control thread only.
+ */
+class MpdCache
+{
+public:
+    /* Snapshots are kept in dir, which is created if needed. */
+    static void init(const string& dir);
+    /* Unmaps the loaded snapshot. Call after MpdWrapper::cleanup(). */
+    static void cleanup();
+    static bool enabled() {return !dir.empty();}
+
+    /**
+     * Loads the snapshot of url. Returns false if there is none, or it is damaged or from another version.
+     * The playback index references the mapped file, which stays mapped until cleanup().
+     */
+    static bool load(const string& url, mpd::MediaPresentationDescription** mpd, PlaybackIndex** index);
+    static bool loaded() {return mapping != nullptr;}
+    /* Validators of the loaded snapshot, for the conditional request. Empty if the server did not send them. */
+    static const string& getEtag() {return etag;}
+    static const string& getLastModified() {return lastModified;}
+
+    /* Writes the snapshot of url, replacing the old one. events as recorded by MpdPushParser::setRecorder(). */
+    static void store(const string& url, const string& etag, const string& lastModified, const string& events, const PlaybackIndex& index);
+
+private:
+    MpdCache(){}
+    virtual ~MpdCache(){}
+
+    static string getFileName(const string& url);
+
+private:
+    static string dir;
+    static void* mapping;
+    static size_t mappingSize;
+    static string etag;
+    static string lastModified;
+};
+
+} /* namespace dashp2p */
+#endif /* MPDCACHE_H_ */
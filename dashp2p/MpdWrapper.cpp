@@ -28,23 +28,66 @@
 #include "XmlAdapter.h"
 #include "DebugAdapter.h"
 #include "SegmentStorage.h"
+#include "MpdCache.h"
+#include "Statistics.h"
+#include "Utilities.h"
 //#include <cinttypes>
 #include <limits>
+#include <cstring>
 
 namespace dashp2p {
 
 dashp2p::mpd::MediaPresentationDescription* MpdWrapper::mpd = nullptr;
+map<const dashp2p::mpd::Representation*, SegmentIndex> MpdWrapper::segmentIndexes;
+MpdPushParser* MpdWrapper::pushParser = nullptr;
+int64_t MpdWrapper::parsedMpdBytes = 0;
+PlaybackIndex* MpdWrapper::playbackIndex = nullptr;
+bool MpdWrapper::ifFromSnapshot = false;
+string MpdWrapper::snapshotEvents;
+string MpdWrapper::etag;
+string MpdWrapper::lastModified;
 
 //void MpdWrapper::init(char* p, int size)
-void MpdWrapper::init(const ContentIdMpd& contentIdMpd)
+void MpdWrapper::parse(const ContentIdMpd& contentIdMpd)
 {
-    assert(!mpd);
+    /* Already completely parsed. */
+    if(mpd && !pushParser)
+        return;
+
+    if(!pushParser) {
+        pushParser = new MpdPushParser();
+        parsedMpdBytes = 0;
+        /* Keep what the parsers see, for a snapshot. */
+        snapshotEvents.clear();
+        if(MpdCache::enabled())
+            pushParser->setRecorder(&snapshotEvents);
+    }
+
+    bool failed = false;
+    const bool completed = feed(*pushParser, contentIdMpd, parsedMpdBytes, failed);
+    if(failed)
+        THROW_RUNTIME("Could not parse the MPD.");
 
-    const int64_t s = SegmentStorage::get(contentIdMpd).getTotalSize();
-    char* p = new char[s];
-    dp2p_assert(SegmentStorage::get(contentIdMpd).getData(0, p, s) == s);
+    if(!mpd && (completed || pushParser->hasFirstAdaptationSet())) {
+        mpd = pushParser->release();
+        if(!mpd)
+            THROW_RUNTIME("MPD without MPD element.");
+        DBGMSG("MPD usable after %" PRId64 " bytes.", parsedMpdBytes);
+    }
 
-    mpd = XmlAdapter::parseMpd(p, s);
+    /* Representations addressed through a SegmentTemplate are only served from the playback index.
+     * Build it for what is parsed once the MPD is usable, and again for the whole MPD. */
+    if(mpd && !playbackIndex && !completed)
+        playbackIndex = new PlaybackIndex(*mpd);
+
+    if(completed) {
+        delete pushParser;
+        pushParser = nullptr;
+        delete playbackIndex;
+        playbackIndex = new PlaybackIndex(*mpd);
+        DBGMSG("MPD model: %zu bytes in the arena. Playback index: %d representations, %zu bytes.",
+                mpd->arena.getUsedBytes(), playbackIndex->getNumRepresentations(), playbackIndex->getSize());
+    }
 #if 0
     /* caching for faster/easier access later */
     vector<pair<unsigned,unsigned> > resolutions = mpd->getSpatialResolutions();
@@ -64,6 +107,278 @@ void MpdWrapper::init(const ContentIdMpd& contentIdMpd)
 #endif
 }
 
+bool MpdWrapper::feed(MpdPushParser& parser, const ContentIdMpd& contentIdMpd, int64_t& parsedBytes, bool& failed)
+{
+    failed = false;
+    /* Feed the new contiguous data directly from the storage. */
+    DashObject& o = SegmentStorage::get(contentIdMpd);
+    const int64_t contigBytes = o.getContigBytes();
+    while(parsedBytes < contigBytes)
+    {
+        const char* data = nullptr;
+        int64_t numBytes = 0;
+        DataBuffer* dataBuffer = o.getDataRef(parsedBytes, contigBytes - parsedBytes, &data, &numBytes);
+        const bool ok = parser.feed(data, numBytes, false);
+        dataBuffer->unref();
+        if(!ok) {
+            ERRMSG("Could not parse the MPD (error at or before byte %" PRId64 ").", parsedBytes + numBytes);
+            failed = true;
+            return false;
+        }
+        parsedBytes += numBytes;
+    }
+    const bool completed = o.completed() && parsedBytes == o.getTotalSize();
+    if(completed && !parser.feed(nullptr, 0, true)) {
+        ERRMSG("Could not parse the MPD (incomplete document).");
+        failed = true;
+        return false;
+    }
+    return completed;
+}
+
+bool MpdWrapper::loadSnapshot(const string& url)
+{
+    dp2p_assert(!mpd && !pushParser);
+    if(!MpdCache::enabled() || !MpdCache::load(url, &mpd, &playbackIndex))
+        return false;
+    ifFromSnapshot = true;
+    setValidators(MpdCache::getEtag(), MpdCache::getLastModified());
+    DBGMSG("MPD model from the snapshot: %zu bytes in the arena. Playback index: %d representations, %zu bytes.",
+            mpd->arena.getUsedBytes(), playbackIndex->getNumRepresentations(), playbackIndex->getSize());
+    return true;
+}
+
+void MpdWrapper::storeSnapshot(const ContentIdMpd& contentIdMpd, const string& url, const string& etag, const string& lastModified)
+{
+    dp2p_assert(MpdCache::enabled() && mpd && !pushParser);
+
+    /* Would be outdated by the next start. */
+    if(isLive())
+        return;
+
+    if(!ifFromSnapshot) {
+        MpdCache::store(url, etag, lastModified, snapshotEvents, *playbackIndex);
+        string().swap(snapshotEvents);
+        return;
+    }
+
+    /* The MPD changed since the snapshot was taken. Playback goes on with the old one, the new one is used next time. */
+    MpdPushParser parser;
+    string events;
+    parser.setRecorder(&events);
+    int64_t parsedBytes = 0;
+    bool failed = false;
+    const bool completed = feed(parser, contentIdMpd, parsedBytes, failed);
+    dashp2p::mpd::MediaPresentationDescription* newMpd = completed ? parser.release() : nullptr;
+    if(!newMpd) {
+        ERRMSG("Changed MPD not usable. Keeping the snapshot.");
+        return;
+    }
+    PlaybackIndex newIndex(*newMpd);
+    MpdCache::store(url, etag, lastModified, events, newIndex);
+    delete newMpd;
+}
+
+int MpdWrapper::refresh(const ContentIdMpd& contentIdMpd)
+{
+    dp2p_assert(mpd && playbackIndex && !pushParser);
+
+    const int64_t tStart = Utilities::getTime();
+    MpdPushParser parser;
+    int64_t parsedBytes = 0;
+    bool failed = false;
+    const bool completed = feed(parser, contentIdMpd, parsedBytes, failed);
+    dashp2p::mpd::MediaPresentationDescription* newer = completed ? parser.release() : nullptr;
+    if(!newer || !newer->periods.isSet()) {
+        /* Malformed, truncated or without MPD element. Playback goes on with what we know, the next refresh may be better. */
+        ERRMSG("Refreshed MPD not usable (%" PRId64 " bytes parsed). Keeping the MPD in use.", parsedBytes);
+        delete newer;
+        return -1;
+    }
+    const int64_t tParsed = Utilities::getTime();
+
+    /* The end of a live presentation is announced by a static MPD with a duration. */
+    mpd->type = newer->type;
+    mpd->mediaPresentationDuration = newer->mediaPresentationDuration;
+    mpd->minimumUpdatePeriod = newer->minimumUpdatePeriod;
+    mpd->timeShiftBufferDepth = newer->timeShiftBufferDepth;
+    mpd->suggestedPresentationDelay = newer->suggestedPresentationDelay;
+
+    /* Elements are matched by position. Those that changed otherwise keep what we know. */
+    int merged = 0;
+    const size_t numPeriods = std::min(mpd->periods.get().size(), newer->periods.get().size());
+    if(numPeriods != mpd->periods.get().size() || numPeriods != newer->periods.get().size())
+        WARNMSG("Refreshed MPD has %zu periods instead of %zu. Only merging the first %zu.", newer->periods.get().size(), mpd->periods.get().size(), numPeriods);
+    for(size_t i = 0; i < numPeriods; ++i)
+    {
+        dashp2p::mpd::Period& period = *mpd->periods.get()[i];
+        const dashp2p::mpd::Period& newerPeriod = *newer->periods.get()[i];
+        period.duration = newerPeriod.duration;
+        merged += mergeSegments(period, newerPeriod);
+        const size_t numAdaptationSets = newerPeriod.adaptationSets.isSet() ? std::min(period.adaptationSets.get().size(), newerPeriod.adaptationSets.get().size()) : 0;
+        for(size_t j = 0; j < numAdaptationSets; ++j)
+        {
+            dashp2p::mpd::AdaptationSet& adaptationSet = *period.adaptationSets.get()[j];
+            const dashp2p::mpd::AdaptationSet& newerAdaptationSet = *newerPeriod.adaptationSets.get()[j];
+            merged += mergeSegments(adaptationSet, newerAdaptationSet);
+            const size_t numRepresentations = newerAdaptationSet.representations.isSet()
+                    ? std::min(adaptationSet.representations.get().size(), newerAdaptationSet.representations.get().size()) : 0;
+            for(size_t k = 0; k < numRepresentations; ++k)
+            {
+                dashp2p::mpd::Representation& rep = *adaptationSet.representations.get()[k];
+                const dashp2p::mpd::Representation& newerRep = *newerAdaptationSet.representations.get()[k];
+                if(!newerRep.bandwidth.isSet() || rep.bandwidth.get() != newerRep.bandwidth.get()) {
+                    WARNMSG("Representation %zu of adaptation set %zu changed its bit-rate. Not merging.", k, j);
+                    continue;
+                }
+                merged += mergeSegments(rep, newerRep);
+            }
+        }
+    }
+    delete newer;
+
+    /* New segments are those of the last period. */
+    const int lastPeriod = getNumPeriods() - 1;
+    const int numSegmentsBefore = getNumSegments(lastPeriod, 0, 0);
+    PlaybackIndex* extended = new PlaybackIndex(*playbackIndex, *mpd);
+    delete playbackIndex;
+    playbackIndex = extended;
+    /* Fewer once a live presentation ends. */
+    const int newSegments = std::max(0, getNumSegments(lastPeriod, 0, 0) - numSegmentsBefore);
+    const int64_t tEnd = Utilities::getTime();
+
+    DBGMSG("Refreshed MPD: %" PRId64 " bytes, %d elements merged, %d new segments. Parsing: %.3f ms, merging and indexing: %.3f ms. Arena: %zu bytes.",
+            parsedBytes, merged, newSegments, (tParsed - tStart) / 1e3, (tEnd - tParsed) / 1e3, mpd->arena.getUsedBytes());
+    Statistics::recordMpdRefresh(true, parsedBytes, tParsed - tStart, tEnd - tParsed);
+    return newSegments;
+}
+
+template<typename E> int MpdWrapper::mergeSegments(E& old, const E& newer)
+{
+    int ret = 0;
+    if(old.segmentTemplate.isSet() && newer.segmentTemplate.isSet()
+            && old.segmentTemplate.get().segmentTimeline.isSet() && newer.segmentTemplate.get().segmentTimeline.isSet())
+        ret += mergeTimeline(old.segmentTemplate.get().segmentTimeline.get(), newer.segmentTemplate.get().segmentTimeline.get());
+    if(old.segmentList.isSet() && newer.segmentList.isSet())
+        ret += mergeSegmentList(old.segmentList.get(), newer.segmentList.get());
+    return ret;
+}
+
+int MpdWrapper::mergeTimeline(dashp2p::mpd::SegmentTimeline& old, const dashp2p::mpd::SegmentTimeline& newer)
+{
+    typedef dashp2p::mpd::SegmentTimeline::S S;
+    if(!newer.s.isSet())
+        return 0;
+
+    /* End of the known segments [timescale]. An open S (r < 0) counts once here, the index repeats it up to the next one. */
+    uint64_t end = 0;
+    const S* last = nullptr;
+    if(old.s.isSet()) {
+        for(const S* s: old.s.get()) {
+            if(s->t.isSet())
+                end = s->t.get();
+            if(!s->d.isSet() || s->d.get() == 0)
+                continue;
+            last = s;
+            end += ((s->r.get() < 0) ? 1 : (uint64_t)s->r.get() + 1) * s->d.get();
+        }
+    }
+
+    int ret = 0;
+    uint64_t t = 0;
+    for(const S* s: newer.s.get())
+    {
+        if(s->t.isSet())
+            t = s->t.get();
+        if(!s->d.isSet() || s->d.get() == 0)
+            continue;
+        const uint64_t d = s->d.get();
+        const bool open = (s->r.get() < 0);
+        const uint64_t count = open ? 1 : (uint64_t)s->r.get() + 1;
+        const uint64_t known = (t < end) ? (end - t + d - 1) / d : 0;
+        if(!open && known >= count) {
+            t += count * d;
+            continue;
+        }
+        /* Still going on as the open S we have. */
+        if(open && last && last->r.get() < 0 && last->d.get() == d && t + known * d == end)
+            break;
+
+        S next;
+        next.t.set(t + known * d);
+        next.d.set(d);
+        next.r.set(open ? -1 : (int)(count - known - 1));
+        old.s.add(next, mpd->arena);
+        ++ret;
+        t += count * d;
+    }
+    return ret;
+}
+
+int MpdWrapper::mergeSegmentList(dashp2p::mpd::SegmentList& old, const dashp2p::mpd::SegmentList& newer)
+{
+    if(!newer.segmentURLs.isSet())
+        return 0;
+
+    /* Segments are identified by their number. */
+    const uint64_t oldStart = old.startNumber.isSet() ? old.startNumber.get() : 1;
+    const uint64_t newerStart = newer.startNumber.isSet() ? newer.startNumber.get() : 1;
+    const uint64_t oldEnd = oldStart + (old.segmentURLs.isSet() ? old.segmentURLs.get().size() : 0);
+    if(newerStart > oldEnd)
+        WARNMSG("Refreshed MPD lacks segments %" PRIu64 " to %" PRIu64 ".", oldEnd, newerStart - 1);
+
+    dashp2p::mpd::Arena& arena = mpd->arena;
+    const auto copy = [&arena](dashp2p::mpd::field_access<std::string>& to, const dashp2p::mpd::field_access<std::string>& from) {
+        if(from.isSet())
+            to.set(dashp2p::xml::StrRef(from.get().data(), from.get().size()), arena);
+    };
+    int ret = 0;
+    const dashp2p::mpd::sequence_access<dashp2p::mpd::SegmentURL>::array& urls = newer.segmentURLs.get();
+    for(size_t i = (oldEnd > newerStart) ? oldEnd - newerStart : 0; i < urls.size(); ++i)
+    {
+        dashp2p::mpd::SegmentURL* url = arena.create<dashp2p::mpd::SegmentURL>();
+        copy(url->media, urls[i]->media);
+        copy(url->mediaRange, urls[i]->mediaRange);
+        copy(url->index, urls[i]->index);
+        copy(url->indexRange, urls[i]->indexRange);
+        old.segmentURLs.addRef(url, arena);
+        ++ret;
+    }
+    return ret;
+}
+
+void MpdWrapper::cleanup()
+{
+    delete pushParser;
+    pushParser = nullptr;
+    parsedMpdBytes = 0;
+    delete playbackIndex;
+    playbackIndex = nullptr;
+    delete mpd;
+    mpd = nullptr;
+    segmentIndexes.clear();
+    ifFromSnapshot = false;
+    string().swap(snapshotEvents);
+    etag.clear();
+    lastModified.clear();
+}
+
+int MpdWrapper::findAdaptationSet(int periodIndex, const char* mediaType)
+{
+	const size_t n = strlen(mediaType);
+	const dashp2p::mpd::Period& period = getPeriod(periodIndex);
+	for(size_t i = 0; i < period.adaptationSets.get().size(); ++i)
+	{
+		const dashp2p::mpd::AdaptationSet& adaptationSet = *(period.adaptationSets.get().at(i));
+		const dashp2p::mpd::RepresentationBase* rb = &adaptationSet;
+		if(!rb->mimeType.isSet() && !adaptationSet.representations.get().empty())
+			rb = adaptationSet.representations.get().at(0);
+		if(rb->mimeType.isSet() && 0 == strncmp(rb->mimeType.get().c_str(), mediaType, n) && rb->mimeType.get()[n] == '/')
+			return i;
+	}
+	return -1;
+}
+
 int MpdWrapper::getNumRepresentations(const AdaptationSetId& adaptationSetId)
 {
 	return getNumRepresentations(adaptationSetId.periodIndex, adaptationSetId.adaptationSetIndex);
@@ -144,11 +459,18 @@ RepresentationId MpdWrapper::getRepresentationIdByBitrate(const AdaptationSetId&
 int MpdWrapper::getNumSegments(int periodIndex, int adaptationSetIndex, int representationIndex)
 {
 	const dashp2p::mpd::Representation& rep = getRepresentation(periodIndex, adaptationSetIndex, representationIndex);
+	if(const PlaybackIndex::Representation* r = getIndexed(periodIndex, adaptationSetIndex, rep.bandwidth.get()))
+		return 1 + r->numSegments;
 	return getNumSegments(rep);
 }
 
 int MpdWrapper::getNumSegments(const dashp2p::mpd::Representation& rep)
 {
+	if(usesSegmentIndex(rep)) {
+		const SegmentIndex* segmentIndex = findSegmentIndex(rep, true);
+		dp2p_assert_v(segmentIndex, "Segment index for representation with %u bps not yet available.", rep.bandwidth.get());
+		return 1 + segmentIndex->subsegments.size();
+	}
 	return 1 + rep.segmentList.get().segmentURLs.get().size();
 }
 
@@ -169,11 +491,77 @@ vector<SegmentId> MpdWrapper::getSegments(const RepresentationId& representation
 
 int64_t MpdWrapper::getVideoDuration()
 {
+	if(!mpd->mediaPresentationDuration.isSet())
+		return -1;
 	return (int64_t)1000 * (int64_t)mpd->mediaPresentationDuration.get();
 }
 
+int64_t MpdWrapper::getPeriodStart(int periodIndex)
+{
+	return PlaybackIndex::getPeriodStart(*mpd, periodIndex);
+}
+
+int64_t MpdWrapper::getPeriodDuration(int periodIndex)
+{
+	return PlaybackIndex::getPeriodDuration(*mpd, periodIndex);
+}
+
+int MpdWrapper::findPeriod(int64_t time)
+{
+	int ret = 0;
+	for(int i = 1; i < getNumPeriods(); ++i) {
+		const int64_t start = getPeriodStart(i);
+		if(start < 0 || start > time)
+			break;
+		ret = i;
+	}
+	return ret;
+}
+
+int64_t MpdWrapper::getMinimumUpdatePeriod()
+{
+	return mpd->minimumUpdatePeriod.isSet() ? (int64_t)1000 * (int64_t)mpd->minimumUpdatePeriod.get() : -1;
+}
+
+int64_t MpdWrapper::getSuggestedPresentationDelay()
+{
+	return mpd->suggestedPresentationDelay.isSet() ? (int64_t)1000 * (int64_t)mpd->suggestedPresentationDelay.get() : -1;
+}
+
+int64_t MpdWrapper::getAvailabilityTime(const ContentIdSegment& segId, bool partial)
+{
+	if(!isLive() || segId.segmentIndex() == 0 || !mpd->availabilityStartTime.isSet())
+		return 0;
+	const int64_t periodStart = std::max<int64_t>(0, getPeriodStart(segId.periodIndex()));
+	const int64_t ret = (int64_t)1000000 * (int64_t)mpd->availabilityStartTime.get() + periodStart + getEndTime(segId);
+	if(!partial)
+		return ret;
+
+	/* With availabilityTimeOffset="INF" the segment can be requested as soon as it is started. */
+	const PlaybackIndex::Representation* r = getIndexed(segId);
+	if(!r || r->availabilityTimeOffset <= 0)
+		return ret;
+	return std::max(ret - r->availabilityTimeOffset, ret - getSegmentDuration(segId));
+}
+
+int MpdWrapper::getLiveEdgeSegment(const ContentIdSegment& segId, int64_t now, bool partial)
+{
+	dp2p_assert(isLive());
+	if(!mpd->availabilityStartTime.isSet())
+		return 1;
+	const ContentIdSegment first(segId.periodIndex(), segId.adaptationSetIndex(), segId.bitRate(), 1);
+	const int64_t start = getAvailabilityTime(first) - getEndTime(first);
+	int ret = findSegment(first, now - start);
+	while(ret > 1 && getAvailabilityTime(ContentIdSegment(segId.periodIndex(), segId.adaptationSetIndex(), segId.bitRate(), ret), partial) > now)
+		--ret;
+	return ret;
+}
+
 int64_t MpdWrapper::getSegmentDuration(const ContentIdSegment& segId)
 {
+    if(const PlaybackIndex::Representation* r = getIndexed(segId))
+        return (segId.segmentIndex() == 0) ? 0 : playbackIndex->getDuration(*r, segId.segmentIndex());
+
     const dashp2p::mpd::Representation& rep = getRepresentationByBitrate(segId.periodIndex(), segId.adaptationSetIndex(), segId.bitRate());
     return getSegmentDuration(rep, segId.segmentIndex());
 }
@@ -182,8 +570,12 @@ int64_t MpdWrapper::getSegmentDuration(const dashp2p::mpd::Representation& rep,
 {
     if(segmentIndex == 0) {
         return 0;
+    } else if(usesSegmentIndex(rep)) {
+        const SegmentIndex* index = findSegmentIndex(rep, true);
+        dp2p_assert(index);
+        return index->subsegments.at(segmentIndex - 1).duration;
     } else if(segmentIndex == getNumSegments(rep) - 1) {
-        const int64_t lastSegDuration = std::max<int64_t>(1, getVideoDuration() - (getNumSegments(rep) - 2) * getNominalSegmentDuration(rep));
+        const int64_t lastSegDuration = std::max<int64_t>(1, getPeriodDuration(getPeriodIndex(rep)) - (getNumSegments(rep) - 2) * getNominalSegmentDuration(rep));
         return lastSegDuration;
     } else {
         return getNominalSegmentDuration(rep);
@@ -204,8 +596,19 @@ int64_t MpdWrapper::getPosition(const ContentIdSegment& segId, int64_t byte, int
     if(segId.segmentIndex() == 0)
         return 0;
 
+    if(const PlaybackIndex::Representation* r = getIndexed(segId)) {
+        return playbackIndex->getStartTime(*r, segId.segmentIndex()) + (byte * playbackIndex->getDuration(*r, segId.segmentIndex())) / segmentSize;
+    }
+
     const dashp2p::mpd::Representation& rep = getRepresentationByBitrate(segId.periodIndex(), segId.adaptationSetIndex(), segId.bitRate());
 
+    if(usesSegmentIndex(rep)) {
+        const SegmentIndex* index = findSegmentIndex(rep, true);
+        dp2p_assert(index);
+        const SegmentIndex::Subsegment& subsegment = index->subsegments.at(segId.segmentIndex() - 1);
+        return subsegment.startTime + (byte * subsegment.duration) / segmentSize;
+    }
+
     const int64_t nominalDuration = getNominalSegmentDuration(rep);
     const int64_t durationCurrentSegment = getSegmentDuration(rep, segId.segmentIndex());
     return (segId.segmentIndex() - 1) * nominalDuration + (byte * durationCurrentSegment) / segmentSize;
@@ -215,34 +618,84 @@ int64_t MpdWrapper::getStartTime(const ContentIdSegment& segId)
 {
     if(segId.segmentIndex() == 0) {
         return 0;
+    } else if(const PlaybackIndex::Representation* r = getIndexed(segId)) {
+        return playbackIndex->getStartTime(*r, segId.segmentIndex());
     } else {
     	/* Get the representation. */
     	const dashp2p::mpd::Representation& rep = getRepresentationByBitrate(segId.periodIndex(), segId.adaptationSetIndex(), segId.bitRate());
 
+    	if(usesSegmentIndex(rep)) {
+    	    const SegmentIndex* index = findSegmentIndex(rep, true);
+    	    dp2p_assert(index);
+    	    return index->subsegments.at(segId.segmentIndex() - 1).startTime;
+    	}
+
         return (segId.segmentIndex() - 1) * getNominalSegmentDuration(rep);
     }
 }
 
 int64_t MpdWrapper::getEndTime(const ContentIdSegment& segId)
 {
+	if(const PlaybackIndex::Representation* r = getIndexed(segId)) {
+		if(segId.segmentIndex() == 0)
+			return 0;
+		return playbackIndex->getStartTime(*r, segId.segmentIndex()) + playbackIndex->getDuration(*r, segId.segmentIndex());
+	}
+
 	/* Get the representation. */
 	const dashp2p::mpd::Representation& rep = getRepresentationByBitrate(segId.periodIndex(), segId.adaptationSetIndex(), segId.bitRate());
 
+	if(usesSegmentIndex(rep) && segId.segmentIndex() > 0) {
+	    const SegmentIndex* index = findSegmentIndex(rep, true);
+	    dp2p_assert(index);
+	    const SegmentIndex::Subsegment& subsegment = index->subsegments.at(segId.segmentIndex() - 1);
+	    return subsegment.startTime + subsegment.duration;
+	}
+
     if(segId.segmentIndex() < getNumSegments(rep) - 1) {
         return segId.segmentIndex() * getNominalSegmentDuration(rep);
     } else {
-        return getVideoDuration();
+        return getPeriodDuration(segId.periodIndex());
     }
 }
 
+int MpdWrapper::findSegment(const ContentIdSegment& segId, int64_t time)
+{
+	if(const PlaybackIndex::Representation* r = getIndexed(segId))
+		return playbackIndex->findSegment(*r, time);
+
+	const dashp2p::mpd::Representation& rep = getRepresentationByBitrate(segId.periodIndex(), segId.adaptationSetIndex(), segId.bitRate());
+
+	/* Last segment whose start time is not after time. */
+	int lo = 1;
+	int hi = getNumSegments(rep) - 1;
+	dp2p_assert(hi >= lo);
+	while(lo < hi) {
+		const int mid = lo + (hi - lo + 1) / 2;
+		if(getStartTime(ContentIdSegment(segId.periodIndex(), segId.adaptationSetIndex(), segId.bitRate(), mid)) <= time)
+			lo = mid;
+		else
+			hi = mid - 1;
+	}
+	return lo;
+}
+
 int64_t MpdWrapper::getNominalSegmentDuration(int periodIndex, int adaptationSetIndex, int representationIndex)
 {
 	const dashp2p::mpd::Representation& rep = getRepresentation(periodIndex, adaptationSetIndex, representationIndex);
+	if(const PlaybackIndex::Representation* r = getIndexed(periodIndex, adaptationSetIndex, rep.bandwidth.get()))
+		return r->nominalDuration;
 	return getNominalSegmentDuration(rep);
 }
 
 int64_t MpdWrapper::getNominalSegmentDuration(const dashp2p::mpd::Representation& rep)
 {
+	if(usesSegmentIndex(rep)) {
+		const SegmentIndex* index = findSegmentIndex(rep, true);
+		dp2p_assert(index);
+		return index->subsegments.at(0).duration;
+	}
+
 	const unsigned timescale = rep.segmentList.get().timescale.isSet() ? rep.segmentList.get().timescale.get() : 1;
 	const unsigned duration = rep.segmentList.get().duration.get();
 	dp2p_assert(duration % timescale == 0);
@@ -404,20 +857,36 @@ vector<int> MpdWrapper::getBitrates(int periodIndex, int adaptationSetIndex, int
 
 string MpdWrapper::getSegmentURL(const ContentIdSegment& segId)
 {
+	string URL;
+	getSegmentURL(segId, URL);
+	return URL;
+}
+
+void MpdWrapper::getSegmentURL(const ContentIdSegment& segId, string& url)
+{
+	/* Prebuilt or generated from the template. */
+	if(const PlaybackIndex::Representation* r = getIndexed(segId)) {
+		playbackIndex->getUrl(*r, segId.segmentIndex(), url);
+		return;
+	}
+
 	/* Get the representation. */
 	const dashp2p::mpd::Representation& rep = getRepresentationByBitrate(segId.periodIndex(), segId.adaptationSetIndex(), segId.bitRate());
 
-	/* Initialize the return value with the base URL. */
-	string URL(mpd->baseURLs.get().at(0)->value.get());
+	/* Initialize with the base URL. */
+	const dashp2p::mpd::string_ref& baseUrl = mpd->baseURLs.get().at(0)->value.get();
+	url.assign(baseUrl.data(), baseUrl.size());
 
 	/* Get the segment URL. */
 	if(segId.segmentIndex() == 0) {
-		URL.append(getInitSegmentURL(rep));
+		url.append(getInitSegmentURL(rep));
+	} else if(usesSegmentIndex(rep)) {
+		const dashp2p::mpd::string_ref& repUrl = rep.baseURLs.get().at(0)->value.get();
+		url.append(repUrl.data(), repUrl.size());
 	} else {
-		URL.append(rep.segmentList.get().segmentURLs.get().at(segId.segmentIndex() - 1)->media.get());
+		const dashp2p::mpd::string_ref& media = rep.segmentList.get().segmentURLs.get().at(segId.segmentIndex() - 1)->media.get();
+		url.append(media.data(), media.size());
 	}
-
-	return URL;
 }
 
 dashp2p::URL MpdWrapper::getSegmentUrl(const SegmentId& segmentId)
@@ -430,7 +899,10 @@ dashp2p::URL MpdWrapper::getSegmentUrl(const SegmentId& segmentId)
 		string _url(mpd->baseURLs.get().at(0)->value.get());
 		/* Get the representation */
 		const dashp2p::mpd::Representation& rep = getRepresentation(segmentId);
-		_url.append(rep.segmentList.get().segmentURLs.get().at(segmentId.segmentIndex - 1)->media.get());
+		if(usesSegmentIndex(rep))
+			_url.append(rep.baseURLs.get().at(0)->value.get());
+		else
+			_url.append(rep.segmentList.get().segmentURLs.get().at(segmentId.segmentIndex - 1)->media.get());
 		return dashp2p::Utilities::splitURL(_url);
 	}
 }
@@ -439,6 +911,8 @@ string MpdWrapper::getInitSegmentURL(const dashp2p::mpd::Representation& rep)
 {
 	if(rep.segmentList.isSet() && rep.segmentList.get().initialization.isSet())
 		return rep.segmentList.get().initialization.get().sourceURL.get();
+	else if(usesSegmentIndex(rep) && !(rep.segmentBase.get().initialization.isSet() && rep.segmentBase.get().initialization.get().sourceURL.isSet()))
+		return rep.baseURLs.get().at(0)->value.get(); // initialization is at the beginning of the single file
 	else
 		return rep.segmentBase.get().initialization.get().sourceURL.get();
 }
@@ -449,19 +923,87 @@ dashp2p::URL MpdWrapper::getInitSegmentUrl(const RepresentationId& representatio
 	string _url(mpd->baseURLs.get().at(0)->value.get());
 
 	const dashp2p::mpd::Representation& rep = getRepresentation(representationId);
-
-	if(rep.segmentList.isSet() && rep.segmentList.get().initialization.isSet())
-		_url.append(rep.segmentList.get().initialization.get().sourceURL.get());
-	else
-		_url.append(rep.segmentBase.get().initialization.get().sourceURL.get());
+	_url.append(getInitSegmentURL(rep));
 
 	return dashp2p::Utilities::splitURL(_url);
 }
 
-ContentIdSegment MpdWrapper::getNextSegment(const ContentIdSegment& segId)
+pair<int64_t, int64_t> MpdWrapper::getSegmentRange(const ContentIdSegment& segId)
 {
 	const dashp2p::mpd::Representation& rep = getRepresentationByBitrate(segId.periodIndex(), segId.adaptationSetIndex(), segId.bitRate());
-	dp2p_assert(segId.valid() && segId.segmentIndex() < getNumSegments(rep) - 1);
+
+	if(usesSegmentIndex(rep))
+	{
+		const dashp2p::mpd::SegmentBase& segmentBase = rep.segmentBase.get();
+		if(segId.segmentIndex() == 0) {
+			/* Fetch initialization and index in one request. In practice, 'sidx' directly follows 'moov'. */
+			const pair<int64_t, int64_t> indexRange = SegmentIndex::parseByteRange(segmentBase.indexRange.get());
+			dp2p_assert_v(indexRange.first >= 0, "Bad indexRange: %s.", segmentBase.indexRange.get().c_str());
+			int64_t byteFrom = 0;
+			if(segmentBase.initialization.isSet() && segmentBase.initialization.get().range.isSet()) {
+				const pair<int64_t, int64_t> initRange = SegmentIndex::parseByteRange(segmentBase.initialization.get().range.get());
+				if(initRange.first >= 0)
+					byteFrom = std::min<int64_t>(initRange.first, indexRange.first);
+			}
+			return pair<int64_t, int64_t>(byteFrom, indexRange.second);
+		} else {
+			const SegmentIndex* index = findSegmentIndex(rep, false);
+			dp2p_assert_v(index, "Segment index for representation with %u bps not yet available.", rep.bandwidth.get());
+			const SegmentIndex::Subsegment& subsegment = index->subsegments.at(segId.segmentIndex() - 1);
+			return pair<int64_t, int64_t>(subsegment.byteFrom, subsegment.byteTo);
+		}
+	}
+
+	/* Segment lists might also address byte ranges. */
+	if(rep.segmentList.isSet())
+	{
+		const dashp2p::mpd::SegmentList& segmentList = rep.segmentList.get();
+		if(segId.segmentIndex() == 0 && segmentList.initialization.isSet() && segmentList.initialization.get().range.isSet())
+			return SegmentIndex::parseByteRange(segmentList.initialization.get().range.get());
+		if(segId.segmentIndex() > 0 && segmentList.segmentURLs.get().at(segId.segmentIndex() - 1)->mediaRange.isSet())
+			return SegmentIndex::parseByteRange(segmentList.segmentURLs.get().at(segId.segmentIndex() - 1)->mediaRange.get());
+	}
+
+	return pair<int64_t, int64_t>(-1, -1);
+}
+
+int64_t MpdWrapper::getSegmentSize(const ContentIdSegment& segId)
+{
+	const pair<int64_t, int64_t> range = getSegmentRange(segId);
+	return (range.first >= 0) ? (range.second - range.first + 1) : -1;
+}
+
+bool MpdWrapper::usesSegmentIndex(const ContentIdSegment& segId)
+{
+	return usesSegmentIndex(getRepresentationByBitrate(segId.periodIndex(), segId.adaptationSetIndex(), segId.bitRate()));
+}
+
+bool MpdWrapper::hasSegmentIndex(const ContentIdSegment& segId)
+{
+	return segmentIndexes.count(&getRepresentationByBitrate(segId.periodIndex(), segId.adaptationSetIndex(), segId.bitRate())) > 0;
+}
+
+bool MpdWrapper::setSegmentIndex(const ContentIdSegment& initSegId, const char* p, int64_t size)
+{
+	const dashp2p::mpd::Representation& rep = getRepresentationByBitrate(initSegId.periodIndex(), initSegId.adaptationSetIndex(), initSegId.bitRate());
+	dp2p_assert(initSegId.segmentIndex() == 0 && usesSegmentIndex(rep));
+
+	SegmentIndex segmentIndex;
+	if(!segmentIndex.parse(p, size, getSegmentRange(initSegId).first))
+		return false;
+
+	segmentIndexes[&rep] = segmentIndex;
+	return true;
+}
+
+ContentIdSegment MpdWrapper::getNextSegment(const ContentIdSegment& segId)
+{
+	if(const PlaybackIndex::Representation* r = getIndexed(segId)) {
+		dp2p_assert(segId.valid() && segId.segmentIndex() < (int)r->numSegments);
+	} else {
+		const dashp2p::mpd::Representation& rep = getRepresentationByBitrate(segId.periodIndex(), segId.adaptationSetIndex(), segId.bitRate());
+		dp2p_assert(segId.valid() && segId.segmentIndex() < getNumSegments(rep) - 1);
+	}
 	return ContentIdSegment(segId.periodIndex(), segId.adaptationSetIndex(), segId.bitRate(), segId.segmentIndex() + 1);
 }
 
@@ -536,6 +1078,12 @@ const dashp2p::mpd::Representation& MpdWrapper::getRepresentation(int periodInde
 
 const dashp2p::mpd::Representation& MpdWrapper::getRepresentationByBitrate(int periodIndex, int adaptationSetIndex, int bitRate)
 {
+	if(playbackIndex) {
+		const PlaybackIndex::Representation* r = playbackIndex->find(periodIndex, adaptationSetIndex, bitRate);
+		dp2p_assert_v(r, "Could not find representation by bitrate (%d bps).", bitRate);
+		return getRepresentation(periodIndex, adaptationSetIndex, r->representationIndex);
+	}
+
 	const dashp2p::mpd::AdaptationSet& adaptationSet = getAdaptationSet(periodIndex, adaptationSetIndex);
 
 	for(size_t i = 0; i < adaptationSet.representations.get().size(); ++i)
@@ -549,6 +1097,46 @@ const dashp2p::mpd::Representation& MpdWrapper::getRepresentationByBitrate(int p
 	exit(1);
 }
 
+int MpdWrapper::getPeriodIndex(const dashp2p::mpd::Representation& rep)
+{
+	for(size_t i = 0; i < mpd->periods.get().size(); ++i)
+		for(const dashp2p::mpd::AdaptationSet* adaptationSet: mpd->periods.get()[i]->adaptationSets.get())
+			for(const dashp2p::mpd::Representation* r: adaptationSet->representations.get())
+				if(r == &rep)
+					return i;
+	dp2p_assert(false);
+	return -1;
+}
+
+bool MpdWrapper::usesSegmentIndex(const dashp2p::mpd::Representation& rep)
+{
+	return !rep.segmentList.isSet() && rep.segmentBase.isSet() && rep.segmentBase.get().indexRange.isSet() && rep.baseURLs.isSet();
+}
+
+const PlaybackIndex::Representation* MpdWrapper::getIndexed(const ContentIdSegment& segId)
+{
+	return getIndexed(segId.periodIndex(), segId.adaptationSetIndex(), segId.bitRate());
+}
+
+const PlaybackIndex::Representation* MpdWrapper::getIndexed(int periodIndex, int adaptationSetIndex, int bitRate)
+{
+	if(!playbackIndex)
+		return nullptr;
+	const PlaybackIndex::Representation* r = playbackIndex->find(periodIndex, adaptationSetIndex, bitRate);
+	return (r && !r->usesSegmentIndex) ? r : nullptr;
+}
+
+const SegmentIndex* MpdWrapper::findSegmentIndex(const dashp2p::mpd::Representation& rep, bool allowAligned)
+{
+	map<const dashp2p::mpd::Representation*, SegmentIndex>::const_iterator it = segmentIndexes.find(&rep);
+	if(it != segmentIndexes.end())
+		return &it->second;
+	else if(allowAligned && !segmentIndexes.empty())
+		return &segmentIndexes.begin()->second;
+	else
+		return NULL;
+}
+
 bool PeriodId::operator<(const PeriodId& other) const
 {
 	if(MpdId::operator<(other))
@@ -26,6 +26,8 @@
 
 //#include "Dashp2pTypes.h"
 #include "mpd/model.h"
+#include "SegmentIndex.h"
+#include "PlaybackIndex.h"
 #include <cassert>
 #include <map>
 #include <vector>
@@ -43,6 +45,7 @@ class PeriodId;
 class AdaptationSetId;
 class RepresentationId;
 class SegmentId;
+class MpdPushParser;
 
 class MpdWrapper
 {
@@ -53,10 +56,46 @@ public:
 	 * @param size  Size of the MPD file.
 	 */
     //static void init(char* p, int size);
-    static void init(const ContentIdMpd& contentIdMpd);
-    static void cleanup() {delete mpd;}
+    //static void init(const ContentIdMpd& contentIdMpd);
+
+    /**
+     * Parses the MPD data received so far. Call again as more data arrive, until the MPD is complete.
+     * The MPD becomes available (hasMpd()) as soon as the first adaptation set of the first period is complete,
+     * which is enough to start. The remaining elements are added as they are parsed.
+     */
+    static void parse(const ContentIdMpd& contentIdMpd);
+    /* True if the MPD is not yet completely parsed. */
+    static bool parsing() {return pushParser != nullptr;}
+    static void cleanup();
     static bool hasMpd() {return mpd != nullptr;}
 
+    /**
+     * Takes the model and the playback index from the snapshot of url in the MpdCache. Returns false if there is none.
+     * A downloaded MPD is then not parsed, see storeSnapshot().
+     */
+    static bool loadSnapshot(const string& url);
+    static bool fromSnapshot() {return ifFromSnapshot;}
+    /**
+     * Stores the completely downloaded MPD as the snapshot of url, with the validators of the response. If we are
+     * running from a snapshot, the MPD changed and is parsed separately, to be used from the next start on.
+     * Nothing is stored if that MPD is not usable.
+     */
+    static void storeSnapshot(const ContentIdMpd& contentIdMpd, const string& url, const string& etag, const string& lastModified);
+
+    /* Validators (ETag, Last-Modified) of the response the MPD in use was made from, for conditional requests. */
+    static void setValidators(const string& etag, const string& lastModified) {MpdWrapper::etag = etag; MpdWrapper::lastModified = lastModified;}
+    static const string& getEtag() {return etag;}
+    static const string& getLastModified() {return lastModified;}
+
+    /**
+     * Parses the completely downloaded refresh of a live MPD and merges it into the model in use: S elements and
+     * segment URLs beyond the known ones are appended, the MPD's type, durations and update period are taken over,
+     * everything else stays as it is. Segments are never removed, so segment indexes remain valid.
+     * The playback index is then extended by the new segments. Returns the number of new segments of the first
+     * representation. Returns -1 if the refresh is not a usable MPD: the model in use is then kept as it is.
+     */
+    static int refresh(const ContentIdMpd& contentIdMpd);
+
     /**********************************************************************
      * Properties of the MPD **********************************************
      **********************************************************************/
@@ -65,16 +104,47 @@ public:
      * Returns the ID of the MPD or an empty string if the ID is not set.
      */
     static string getMpdId() {if(mpd->id.isSet()) return mpd->id.get(); else return string();}
+    /* [us], -1 if not known (live). */
     static int64_t getVideoDuration();
 
+    /**********************************************************************
+     * Live presentations *************************************************
+     **********************************************************************/
+
+    /* MPD@type is "dynamic". */
+    static bool isLive() {return mpd->type.isSet() && mpd->type.get() == dashp2p::mpd::EPresentation::DYNAMIC;}
+    /* MPD@minimumUpdatePeriod [us], -1 if the MPD is not refreshed. */
+    static int64_t getMinimumUpdatePeriod();
+    /* MPD@suggestedPresentationDelay [us], -1 if not given. */
+    static int64_t getSuggestedPresentationDelay();
+    /**
+     * Wall-clock time [us since the epoch] from which segId can be downloaded: the end of the segment, counted from
+     * MPD@availabilityStartTime and Period@start. 0 for initialization segments and if the MPD is not live.
+     * If partial is set, the time from which the server delivers the segment while it is being produced
+     * (chunked transfer), i.e., less SegmentTemplate@availabilityTimeOffset.
+     */
+    static int64_t getAvailabilityTime(const ContentIdSegment& segId, bool partial = false);
+    /* Latest media segment of the representation of segId available at wall-clock time now [us since the epoch]. At least 1. */
+    static int getLiveEdgeSegment(const ContentIdSegment& segId, int64_t now, bool partial = false);
+
     /**********************************************************************
      * Properties of a Period *********************************************
      **********************************************************************/
 
+    static int getNumPeriods() {return mpd->periods.get().size();}
+    /* Start [us] of the period in the presentation, -1 if not known. Segment times are relative to it. */
+    static int64_t getPeriodStart(int periodIndex);
+    /* [us], -1 if not known (live). */
+    static int64_t getPeriodDuration(int periodIndex);
+    /* Last period starting not after time [us] of the presentation. */
+    static int findPeriod(int64_t time);
+
     /**********************************************************************
      * Properties of an Adaptation Set ************************************
      **********************************************************************/
 
+    /* Index of the first adaptation set of the period whose @mimeType (or that of its first representation) is mediaType/..., e.g., "audio". -1 if none. */
+    static int findAdaptationSet(int periodIndex, const char* mediaType);
     static int getNumRepresentations(const AdaptationSetId& adaptationSetId);
     static int getNumRepresentations(int periodIndex, int adaptationSetIndex);
     static int getNumRepresentations(int periodIndex, int adaptationSetIndex, int width, int height);
@@ -125,13 +195,43 @@ public:
     static int64_t getPosition(const ContentIdSegment& segId, int64_t byte, int64_t segmentSize);
     static int64_t getStartTime(const ContentIdSegment& segId);
     static int64_t getEndTime(const ContentIdSegment& segId);
+    /**
+     * Index of the media segment of the representation of segId that contains time [us]. Clamped to the first and last segment.
+     */
+    static int findSegment(const ContentIdSegment& segId, int64_t time);
 
     /**
      * Returns the URL of a segment.
      */
     static string getSegmentURL(const ContentIdSegment& segId);
+    /* Same, written into url, whose capacity is reused when called in a loop. */
+    static void getSegmentURL(const ContentIdSegment& segId, string& url);
     static dashp2p::URL getSegmentUrl(const SegmentId& segmentId);
 
+    /**
+     * Byte range of a segment within the file returned by getSegmentURL() or (-1,-1) if it is the whole file.
+     * For single-file representations, the range of the initialization segment includes the segment index.
+     */
+    static pair<int64_t, int64_t> getSegmentRange(const ContentIdSegment& segId);
+
+    /**
+     * Segment size if known from the MPD or the segment index, -1 otherwise.
+     */
+    static int64_t getSegmentSize(const ContentIdSegment& segId);
+
+    /**********************************************************************
+     * Single-file representations (SegmentBase@indexRange) ***************
+     **********************************************************************/
+
+    static bool usesSegmentIndex(const ContentIdSegment& segId);
+    static bool hasSegmentIndex(const ContentIdSegment& segId);
+
+    /**
+     * Parses the segment index contained in the completely downloaded initialization segment initSegId.
+     * Returns false if there is none.
+     */
+    static bool setSegmentIndex(const ContentIdSegment& initSegId, const char* p, int64_t size);
+
 
 
 
@@ -150,10 +250,39 @@ private:
     static const dashp2p::mpd::Representation& getRepresentation(const RepresentationId& representationId);
     static const dashp2p::mpd::Representation& getRepresentation(int periodIndex, int adaptationSetIndex, int representationIndex);
     static const dashp2p::mpd::Representation& getRepresentationByBitrate(int periodIndex, int adaptationSetIndex, int bitRate);
+    static int getPeriodIndex(const dashp2p::mpd::Representation& rep);
+    static bool usesSegmentIndex(const dashp2p::mpd::Representation& rep);
+    /**
+     * Feeds the data of the MPD received after parsedBytes to parser. Returns true once the MPD is completely parsed.
+     * If it is not well-formed, logs the error, sets failed and returns false.
+     */
+    static bool feed(MpdPushParser& parser, const ContentIdMpd& contentIdMpd, int64_t& parsedBytes, bool& failed);
+    /* Representation of segId in the playback index. NULL if the index is not built yet or does not list the segments. */
+    static const PlaybackIndex::Representation* getIndexed(const ContentIdSegment& segId);
+    static const PlaybackIndex::Representation* getIndexed(int periodIndex, int adaptationSetIndex, int bitRate);
+    /* If allowAligned is set and rep's own index is not yet known, returns the index of another representation.
+     * Fine for the number of segments and their durations, since we expect segment alignment across representations. */
+    static const SegmentIndex* findSegmentIndex(const dashp2p::mpd::Representation& rep, bool allowAligned);
+    /* refresh(): append what newer lists beyond what old lists. Return the number of new segments. */
+    static int mergeTimeline(dashp2p::mpd::SegmentTimeline& old, const dashp2p::mpd::SegmentTimeline& newer);
+    static int mergeSegmentList(dashp2p::mpd::SegmentList& old, const dashp2p::mpd::SegmentList& newer);
+    /* Merges the timelines and segment lists of the elements of newer into those of old. */
+    template<typename E> static int mergeSegments(E& old, const E& newer);
 
 /* Private members */
 private:
     static dashp2p::mpd::MediaPresentationDescription* mpd;
+    static map<const dashp2p::mpd::Representation*, SegmentIndex> segmentIndexes;
+    static MpdPushParser* pushParser;
+    static int64_t parsedMpdBytes;
+    /* Built when the MPD is completely parsed. Until then, queries go to the model. */
+    static PlaybackIndex* playbackIndex;
+    /* Model and index come from the MpdCache. */
+    static bool ifFromSnapshot;
+    /* Parser events of the MPD being parsed, for storeSnapshot(). */
+    static string snapshotEvents;
+    static string etag;
+    static string lastModified;
 };
 
 
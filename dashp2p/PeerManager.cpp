@@ -0,0 +1,619 @@
+/****************************************************************************
+ * PeerManager.cpp                                                          *
+ ****************************************************************************
+ * Copyright (C) 2026                                                       *
+ *                                                                          *
+ * Created on: Oct 19, 2026                                                 *
+ * Authors: agent <agent@local>                                             *
+ *                                                                          *
+ * This program is free software: you can redistribute it and/or modify     *
+ * it under the terms of the GNU General Public License as published by     *
+ * the Free Software Foundation, either version 3 of the License, or        *
+ * (at your option) any later version.                                      *
+ *                                                                          *
+ * This program is distributed in the hope that it will be useful,          *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ * GNU General Public License for more details.                             *
+ *                                                                          *
+ * You should have received a copy of the GNU General Public License        *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.     *
+ ****************************************************************************/
+
+#include "PeerManager.h"
+#include "SegmentStorage.h"
+#include "Utilities.h"
+#include "DebugAdapter.h"
+
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <algorithm>
+#include <limits>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <sys/eventfd.h>
+#include <fcntl.h>
+#include <arpa/inet.h>
+
+namespace dashp2p {
+
+/* The tracker is supposed to be in the same LAN: a reply taking longer than this [us] means it is gone. */
+static const int64_t trackerTimeout = 500000;
+/* After a failed transaction, the tracker is not contacted again for this long [us]. */
+static const int64_t trackerRetryInterval = 1000000;
+/* Peer lists are fetched again after this long [us]. Empty lists sooner, since peers announce segments all the time. */
+static const int64_t peerListTtl = 10000000;
+static const int64_t emptyPeerListTtl = 1000000;
+/* findPeer() also fetches the peer lists of that many following segments, so that they are known when needed. */
+static const int peerListLookahead = 2;
+/* Peers that stop reading, respectively idle connections, are closed after this long [us]. */
+static const int64_t clientSendTimeout = 10000000;
+static const int64_t clientIdleTimeout = 60000000;
+/* Idle tracker connections are kept: closing one drops the announcements made over it (see forgetAnnouncements()). */
+static int64_t idleDeadline(bool isTracker, int64_t now) {return isTracker ? std::numeric_limits<int64_t>::max() : now + clientIdleTimeout;}
+
+bool PeerManager::ifEnabled = false;
+int PeerManager::listenPort = -1;
+int64_t PeerManager::deadlineMargin = 0;
+struct sockaddr_in PeerManager::trackerAddr;
+map<string, int> PeerManager::peerSources;
+set<int> PeerManager::failedPeers;
+std::mutex PeerManager::_mutex;
+std::deque<PeerManager::TrackerRequest> PeerManager::trackerQueue;
+map<string, PeerManager::PeerList> PeerManager::peerLists;
+Thread PeerManager::thread;
+std::atomic<bool> PeerManager::ifTerminating(false);
+int PeerManager::fdWakeUp = -1;
+int PeerManager::fdPeerServer = -1;
+int PeerManager::fdTracker = -1;
+map<int, PeerManager::Client> PeerManager::clients;
+map<string, map<string, int> > PeerManager::trackerDb;
+int PeerManager::trackerFd = -1;
+bool PeerManager::trackerConnecting = false;
+string PeerManager::trackerOut;
+string PeerManager::trackerIn;
+std::deque<PeerManager::TrackerRequest> PeerManager::trackerPending;
+int64_t PeerManager::trackerRetry = 0;
+
+void PeerManager::init(int listenPort, const string& tracker, bool runTracker, int64_t deadlineMargin)
+{
+    dp2p_assert(!ifEnabled);
+
+    PeerManager::listenPort = listenPort;
+    PeerManager::deadlineMargin = deadlineMargin;
+
+    /* Resolve the tracker address */
+    const Utilities::PeerInformation trackerInfo = Utilities::splitIPStringMPDPeer(tracker);
+    const SourceData trackerData(trackerInfo.ip, trackerInfo.port);
+    trackerAddr = trackerData.hostAddr;
+
+    /* Open the listening sockets */
+    fdPeerServer = openListenSocket(listenPort);
+    if(runTracker)
+        fdTracker = openListenSocket(trackerInfo.port);
+
+    fdWakeUp = eventfd(0, EFD_NONBLOCK);
+    dp2p_assert(fdWakeUp != -1);
+
+    ifTerminating = false;
+    dp2p_assert(0 == ThreadAdapter::startThread(&thread, PeerManager::startThread, NULL));
+
+    ifEnabled = true;
+    INFOMSG("Peer-assisted delivery enabled. Serving segments on port %d, tracker at %s%s.",
+            listenPort, tracker.c_str(), runTracker ? " (local)" : "");
+}
+
+void PeerManager::cleanup()
+{
+    if(!ifEnabled)
+        return;
+
+    ifTerminating = true;
+    wakeUp();
+    ThreadAdapter::joinThread(thread);
+
+    for(map<int, Client>::iterator it = clients.begin(); it != clients.end(); ++it)
+        close(it->first);
+    clients.clear();
+    if(trackerFd != -1)
+        close(trackerFd);
+    trackerFd = -1;
+    trackerConnecting = false;
+    trackerOut.clear();
+    trackerIn.clear();
+    trackerPending.clear();
+    trackerRetry = 0;
+    if(fdTracker != -1)
+        dp2p_assert(0 == close(fdTracker));
+    dp2p_assert(0 == close(fdPeerServer));
+    dp2p_assert(0 == close(fdWakeUp));
+    fdTracker = fdPeerServer = fdWakeUp = -1;
+
+    trackerDb.clear();
+    trackerQueue.clear();
+    peerLists.clear();
+    peerSources.clear();
+    failedPeers.clear();
+    ifEnabled = false;
+}
+
+void PeerManager::announce(const ContentIdSegment& segId)
+{
+    if(!ifEnabled)
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        trackerQueue.push_back(TrackerRequest(false, getKey(segId)));
+    }
+    wakeUp();
+}
+
+SourceId PeerManager::findPeer(const ContentIdSegment& segId)
+{
+    if(!ifEnabled)
+        return SourceId();
+
+    const int64_t now = Utilities::getTime();
+    vector<string> peers;
+    bool queued = false;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        for(int i = 0; i <= peerListLookahead; ++i) {
+            const ContentIdSegment s(segId.periodIndex(), segId.adaptationSetIndex(), segId.bitRate(), segId.segmentIndex() + i);
+            const string key = getKey(s);
+            PeerList& pl = peerLists[key];
+            if(i == 0 && pl.expires > now)
+                peers = pl.peers;
+            if(pl.expires <= now && !pl.pending) {
+                pl.pending = true;
+                trackerQueue.push_back(TrackerRequest(true, key));
+                queued = true;
+            }
+        }
+    }
+    if(queued)
+        wakeUp();
+
+    for(std::size_t i = 0; i < peers.size(); ++i)
+    {
+        const string& peer = peers.at(i);
+        map<string, int>::const_iterator it = peerSources.find(peer);
+        if(it == peerSources.end()) {
+            const Utilities::PeerInformation peerInfo = Utilities::splitIPStringMPDPeer(peer);
+            it = peerSources.insert(pair<string, int>(peer, SourceManager::add(peerInfo.ip, peerInfo.port))).first;
+        }
+        if(failedPeers.count(it->second))
+            continue;
+
+        DBGMSG("Peer %s has %s.", peer.c_str(), segId.toString().c_str());
+        return SourceId(it->second);
+    }
+
+    DBGMSG("No peer known to have %s.", segId.toString().c_str());
+    return SourceId();
+}
+
+void PeerManager::markFailed(const SourceId& srcId)
+{
+    WARNMSG("Excluding peer %s:%d.", SourceManager::get(srcId).hostName.c_str(), SourceManager::get(srcId).port);
+    failedPeers.insert(srcId.numeric());
+}
+
+string PeerManager::getPath(const ContentIdSegment& segId)
+{
+    return string("dp2p/") + getKey(segId);
+}
+
+string PeerManager::getKey(const ContentIdSegment& segId)
+{
+    char tmp[128];
+    sprintf(tmp, "%d/%d/%d/%d", segId.periodIndex(), segId.adaptationSetIndex(), segId.bitRate(), segId.segmentIndex());
+    return string(tmp);
+}
+
+int PeerManager::openListenSocket(int port)
+{
+    const int fd = socket(AF_INET, SOCK_STREAM, 0);
+    dp2p_assert(fd > 0);
+    const int one = 1;
+    dp2p_assert(0 == setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)));
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+    if(0 != bind(fd, (struct sockaddr*)&addr, sizeof(addr)))
+        THROW_RUNTIME("Could not bind to port %d: %s.", port, strerror(errno));
+    dp2p_assert(0 == listen(fd, 16));
+    dp2p_assert(0 == fcntl(fd, F_SETFL, O_NONBLOCK));
+
+    return fd;
+}
+
+void PeerManager::wakeUp()
+{
+    const uint64_t one = 1;
+    dp2p_assert(sizeof(one) == ::write(fdWakeUp, &one, sizeof(one)));
+}
+
+void* PeerManager::startThread(void* /*params*/)
+{
+    threadMain();
+    return NULL;
+}
+
+void PeerManager::threadMain()
+{
+    while(!ifTerminating)
+    {
+        int64_t now = Utilities::getTime();
+        sendTrackerRequests(now);
+
+        /* Clients with a response pending are not read from until it is sent, so that they cannot queue up unbounded data. */
+        fd_set readSet;
+        fd_set writeSet;
+        FD_ZERO(&readSet);
+        FD_ZERO(&writeSet);
+        FD_SET(fdWakeUp, &readSet);
+        FD_SET(fdPeerServer, &readSet);
+        int maxFd = std::max(fdWakeUp, fdPeerServer);
+        if(fdTracker != -1) {
+            FD_SET(fdTracker, &readSet);
+            maxFd = std::max(maxFd, fdTracker);
+        }
+        int64_t deadline = now + clientIdleTimeout;
+        for(map<int, Client>::const_iterator it = clients.begin(); it != clients.end(); ++it) {
+            FD_SET(it->first, it->second.out.empty() ? &readSet : &writeSet);
+            maxFd = std::max(maxFd, it->first);
+            deadline = std::min(deadline, it->second.deadline);
+        }
+        if(trackerFd != -1) {
+            FD_SET(trackerFd, &readSet);
+            if(trackerConnecting || !trackerOut.empty())
+                FD_SET(trackerFd, &writeSet);
+            maxFd = std::max(maxFd, trackerFd);
+        }
+        if(!trackerPending.empty())
+            deadline = std::min(deadline, trackerPending.front().deadline);
+
+        const int64_t timeout = std::max<int64_t>(0, deadline - now);
+        struct timeval tv = {(time_t)(timeout / 1000000), (suseconds_t)(timeout % 1000000)};
+        const int ret = select(maxFd + 1, &readSet, &writeSet, NULL, &tv);
+        if(ret == -1 && errno == EINTR)
+            continue;
+        dp2p_assert(ret >= 0);
+
+        if(ifTerminating)
+            break;
+        now = Utilities::getTime();
+
+        if(FD_ISSET(fdWakeUp, &readSet)) {
+            uint64_t dummy = 0;
+            dp2p_assert(sizeof(dummy) == ::read(fdWakeUp, &dummy, sizeof(dummy)));
+        }
+
+        /* Our connection to the tracker */
+        if(trackerFd != -1 && (FD_ISSET(trackerFd, &readSet) || FD_ISSET(trackerFd, &writeSet)))
+            processTrackerData(now);
+        if(!trackerPending.empty() && trackerPending.front().deadline <= now)
+            trackerFailed("no reply in time", now);
+
+        /* New connections */
+        const int listenFds[2] = {fdPeerServer, fdTracker};
+        for(int i = 0; i < 2; ++i) {
+            if(listenFds[i] == -1 || !FD_ISSET(listenFds[i], &readSet))
+                continue;
+            Client c;
+            c.isTracker = (listenFds[i] == fdTracker);
+            c.deadline = idleDeadline(c.isTracker, now);
+            socklen_t addrLen = sizeof(c.addr);
+            const int fd = accept(listenFds[i], (struct sockaddr*)&c.addr, &addrLen);
+            if(fd == -1) {
+                if(errno != EAGAIN && errno != EWOULDBLOCK)
+                    WARNMSG("accept() failed: %s.", strerror(errno));
+                continue;
+            }
+            dp2p_assert(0 == fcntl(fd, F_SETFL, O_NONBLOCK));
+            clients.insert(pair<int, Client>(fd, c));
+        }
+
+        /* Requests from and responses to connected clients */
+        for(map<int, Client>::iterator it = clients.begin(); it != clients.end(); ) {
+            bool ok = true;
+            if(FD_ISSET(it->first, &readSet))
+                ok = readClient(it->first, it->second);
+            if(ok && !it->second.out.empty())
+                ok = writeClient(it->first, it->second);
+            if(ok && it->second.deadline <= now) {
+                DBGMSG("Closing connection of %s: %s.", inet_ntoa(it->second.addr.sin_addr), it->second.out.empty() ? "idle" : "not reading");
+                ok = false;
+            }
+            if(!ok) {
+                close(it->first);
+                forgetAnnouncements(it->second);
+                clients.erase(it++);
+            } else {
+                ++it;
+            }
+        }
+    }
+}
+
+bool PeerManager::readClient(int fd, Client& c)
+{
+    char buf[4096];
+    const ssize_t ret = recv(fd, buf, sizeof(buf), 0);
+    if(ret == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        return true;
+    if(ret <= 0)
+        return false;
+    c.in.append(buf, ret);
+    c.deadline = idleDeadline(c.isTracker, Utilities::getTime());
+
+    /* Tracker transactions are single lines, segment requests are HTTP requests. */
+    const string delim = c.isTracker ? "\n" : "\r\n\r\n";
+    std::size_t pos;
+    while((pos = c.in.find(delim)) != string::npos)
+    {
+        const string request = c.in.substr(0, pos);
+        c.in.erase(0, pos + delim.size());
+        if(c.isTracker) {
+            if(!serveTracker(c, request))
+                return false;
+        } else {
+            if(!serveSegment(c, request))
+                return false;
+        }
+    }
+    if(!c.out.empty())
+        c.deadline = Utilities::getTime() + clientSendTimeout;
+
+    return c.in.size() < sizeof(buf);
+}
+
+bool PeerManager::writeClient(int fd, Client& c)
+{
+    const ssize_t ret = send(fd, c.out.data() + c.outPos, c.out.size() - c.outPos, MSG_NOSIGNAL);
+    if(ret == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        return true;
+    if(ret <= 0)
+        return false;
+    c.outPos += ret;
+    if(c.outPos == c.out.size()) {
+        c.out.clear();
+        c.outPos = 0;
+        c.deadline = idleDeadline(c.isTracker, Utilities::getTime());
+    } else {
+        c.deadline = Utilities::getTime() + clientSendTimeout;
+    }
+    return true;
+}
+
+bool PeerManager::serveSegment(Client& c, const string& request)
+{
+    int periodIndex = -1, adaptationSetIndex = -1, bitRate = -1, segmentIndex = -1;
+    if(4 != sscanf(request.c_str(), "GET /dp2p/%d/%d/%d/%d HTTP/1.1", &periodIndex, &adaptationSetIndex, &bitRate, &segmentIndex)) {
+        WARNMSG("Unexpected peer request: %.*s.", (int)request.find("\r\n"), request.c_str());
+        return false;
+    }
+
+    /* If we do not have the complete segment, the requesting peer sees a disconnect and falls back to the origin server. */
+    const ContentIdSegment segId(periodIndex, adaptationSetIndex, bitRate, segmentIndex);
+    int64_t size = 0;
+    char* data = SegmentStorage::getCopy(segId, &size);
+    if(!data) {
+        DBGMSG("Asked for %s which we do not have.", segId.toString().c_str());
+        return false;
+    }
+
+    char hdr[512];
+    const int hdrSize = sprintf(hdr, "HTTP/1.1 200 OK\r\nContent-Length: %" PRId64 "\r\nConnection: Keep-Alive\r\nKeep-Alive: timeout=60, max=1000\r\n\r\n", size);
+    c.out.append(hdr, hdrSize);
+    c.out.append(data, size);
+    delete [] data;
+
+    DBGMSG("Serving %s (%" PRId64 " bytes).", segId.toString().c_str(), size);
+    return true;
+}
+
+bool PeerManager::serveTracker(Client& c, const string& request)
+{
+    char cmd[16];
+    int port = -1;
+    char key[128];
+    if(3 != sscanf(request.c_str(), "%15s %d %127s", cmd, &port, key)) {
+        WARNMSG("Unexpected tracker request: %s.", request.c_str());
+        return false;
+    }
+
+    char peer[64];
+    sprintf(peer, "%s:%d", inet_ntoa(c.addr.sin_addr), port);
+
+    if(0 == strcmp(cmd, "ANNOUNCE")) {
+        if(c.announced.insert(pair<string, string>(key, peer)).second)
+            ++trackerDb[key][peer];
+        c.out.append("OK\n");
+    } else if(0 == strcmp(cmd, "QUERY")) {
+        c.out.append("PEERS");
+        map<string, map<string, int> >::const_iterator it = trackerDb.find(key);
+        if(it != trackerDb.end()) {
+            for(map<string, int>::const_iterator jt = it->second.begin(); jt != it->second.end(); ++jt) {
+                if(jt->first != peer)
+                    c.out.append(" ").append(jt->first);
+            }
+        }
+        c.out.append("\n");
+    } else {
+        WARNMSG("Unknown tracker command: %s.", cmd);
+        return false;
+    }
+
+    return true;
+}
+
+void PeerManager::forgetAnnouncements(const Client& c)
+{
+    for(set<pair<string, string> >::const_iterator it = c.announced.begin(); it != c.announced.end(); ++it) {
+        map<string, map<string, int> >::iterator kt = trackerDb.find(it->first);
+        dp2p_assert(kt != trackerDb.end());
+        map<string, int>::iterator pt = kt->second.find(it->second);
+        dp2p_assert(pt != kt->second.end() && pt->second > 0);
+        if(--pt->second == 0)
+            kt->second.erase(pt);
+        if(kt->second.empty())
+            trackerDb.erase(kt);
+    }
+    if(!c.announced.empty())
+        DBGMSG("Tracker connection of %s closed. Dropped %u announcements, %u segments known.", inet_ntoa(c.addr.sin_addr), (unsigned)c.announced.size(), (unsigned)trackerDb.size());
+}
+
+void PeerManager::sendTrackerRequests(int64_t now)
+{
+    std::deque<TrackerRequest> requests;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        requests.swap(trackerQueue);
+    }
+    if(requests.empty())
+        return;
+
+    /* The tracker failed recently: the transactions are dropped, lookups find no peers until it is back. */
+    if(trackerFd == -1 && now < trackerRetry) {
+        DBGMSG("Tracker unavailable. Dropping %u transactions.", (unsigned)requests.size());
+        for(std::deque<TrackerRequest>::const_iterator it = requests.begin(); it != requests.end(); ++it)
+            if(it->query)
+                setPeerList(it->key, vector<string>(), now);
+        return;
+    }
+
+    if(trackerFd == -1) {
+        trackerFd = socket(AF_INET, SOCK_STREAM, 0);
+        dp2p_assert(trackerFd > 0);
+        dp2p_assert(0 == fcntl(trackerFd, F_SETFL, O_NONBLOCK));
+        if(0 == connect(trackerFd, (struct sockaddr*)&trackerAddr, sizeof(trackerAddr))) {
+            trackerConnecting = false;
+        } else if(errno == EINPROGRESS) {
+            trackerConnecting = true;
+        } else {
+            trackerPending.insert(trackerPending.end(), requests.begin(), requests.end());
+            trackerFailed(strerror(errno), now);
+            return;
+        }
+    }
+
+    for(std::deque<TrackerRequest>::iterator it = requests.begin(); it != requests.end(); ++it) {
+        char tmp[256];
+        sprintf(tmp, "%s %d %s\n", it->query ? "QUERY" : "ANNOUNCE", listenPort, it->key.c_str());
+        trackerOut.append(tmp);
+        it->deadline = now + trackerTimeout;
+        trackerPending.push_back(*it);
+    }
+}
+
+void PeerManager::processTrackerData(int64_t now)
+{
+    if(trackerConnecting) {
+        int err = 0;
+        socklen_t errLen = sizeof(err);
+        dp2p_assert(0 == getsockopt(trackerFd, SOL_SOCKET, SO_ERROR, &err, &errLen));
+        if(err == EINPROGRESS)
+            return;
+        if(err != 0) {
+            trackerFailed(strerror(err), now);
+            return;
+        }
+        trackerConnecting = false;
+    }
+
+    if(!trackerOut.empty()) {
+        const ssize_t ret = send(trackerFd, trackerOut.data(), trackerOut.size(), MSG_NOSIGNAL);
+        if(ret > 0) {
+            trackerOut.erase(0, ret);
+        } else if(ret == -1 && errno != EAGAIN && errno != EWOULDBLOCK) {
+            trackerFailed(strerror(errno), now);
+            return;
+        }
+    }
+
+    char buf[4096];
+    const ssize_t ret = recv(trackerFd, buf, sizeof(buf), 0);
+    if(ret == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        return;
+    if(ret <= 0) {
+        trackerFailed(ret == 0 ? "connection closed" : strerror(errno), now);
+        return;
+    }
+    trackerIn.append(buf, ret);
+
+    /* Replies come in the order of the transactions. */
+    std::size_t eol;
+    while((eol = trackerIn.find('\n')) != string::npos)
+    {
+        const string reply = trackerIn.substr(0, eol);
+        trackerIn.erase(0, eol + 1);
+        if(trackerPending.empty()) {
+            trackerFailed("unexpected reply", now);
+            return;
+        }
+        const TrackerRequest r = trackerPending.front();
+        trackerPending.pop_front();
+        if(!r.query) {
+            if(reply.compare(0, 2, "OK") != 0)
+                DBGMSG("Tracker did not acknowledge announcement of %s.", r.key.c_str());
+        } else if(reply.compare(0, 5, "PEERS") != 0) {
+            DBGMSG("No usable tracker reply for %s.", r.key.c_str());
+            setPeerList(r.key, vector<string>(), now);
+        } else {
+            vector<string> peers;
+            const vector<string> tokens = Utilities::tokenize(reply.substr(5), ' ');
+            for(std::size_t i = 0; i < tokens.size(); ++i)
+                if(!tokens.at(i).empty() && tokens.at(i).find(':') != string::npos)
+                    peers.push_back(tokens.at(i));
+            setPeerList(r.key, peers, now);
+        }
+    }
+}
+
+void PeerManager::trackerFailed(const char* reason, int64_t now)
+{
+    DBGMSG("Tracker transaction failed: %s. Not contacting the tracker for %.1f s.", reason, trackerRetryInterval / 1e6);
+
+    if(trackerFd != -1)
+        close(trackerFd);
+    trackerFd = -1;
+    trackerConnecting = false;
+    trackerOut.clear();
+    trackerIn.clear();
+    for(std::deque<TrackerRequest>::const_iterator it = trackerPending.begin(); it != trackerPending.end(); ++it)
+        if(it->query)
+            setPeerList(it->key, vector<string>(), now);
+    trackerPending.clear();
+    trackerRetry = now + trackerRetryInterval;
+}
+
+void PeerManager::setPeerList(const string& key, const vector<string>& peers, int64_t now)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    PeerList& pl = peerLists[key];
+    pl.peers = peers;
+    pl.expires = now + (peers.empty() ? emptyPeerListTtl : peerListTtl);
+    pl.pending = false;
+
+    /* Forget lists that expired long ago. */
+    if(peerLists.size() > 1024) {
+        for(map<string, PeerList>::iterator it = peerLists.begin(); it != peerLists.end(); ) {
+            if(!it->second.pending && it->second.expires + peerListTtl < now)
+                peerLists.erase(it++);
+            else
+                ++it;
+        }
+    }
+}
+
+} /* namespace dashp2p */
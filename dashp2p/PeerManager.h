@@ -0,0 +1,172 @@
+/****************************************************************************
+ * PeerManager.h                                                            *
+ ****************************************************************************
+ * Copyright (C) 2026                                                       *
+ *                                                                          *
+ * Created on: Oct 19, 2026                                                 *
+ * Authors: agent <agent@local>                                             *
+ *                                                                          *
+ * This program is free software: you can redistribute it and/or modify     *
+ * it under the terms of the GNU General Public License as published by     *
+ * the Free Software Foundation, either version 3 of the License, or        *
+ * (at your option) any later version.                                      *
+ *                                                                          *
+ * This program is distributed in the hope that it will be useful,          *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ * GNU General Public License for more details.                             *
+ *                                                                          *
+ * You should have received a copy of the GNU General Public License        *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.     *
+ ****************************************************************************/
+
+#ifndef PEERMANAGER_H_
+#define PEERMANAGER_H_
+
+#include "ContentId.h"
+#include "SourceManager.h"
+#include "ThreadAdapter.h"
+
+#include <netinet/in.h>
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <map>
+#include <set>
+#include <vector>
+using std::string;
+using std::map;
+using std::pair;
+using std::set;
+using std::vector;
+
+namespace dashp2p {
+
+/**
+ * Peer-assisted segment delivery in a LAN.
+ *
+ * Every client serves the segments it has completely downloaded over plain HTTP on listenPort,
+ * under the path "/dp2p/<period>/<adaptation set>/<bit-rate>/<segment>". Segments are announced to,
+ * and peers are looked up at, a tracker speaking a one-line-per-transaction text protocol:
+ *     "ANNOUNCE <port> <key>\n"  ->  "OK\n"
+ *     "QUERY <port> <key>\n"     ->  "PEERS <ip>:<port> ...\n"
+ * where <key> is "<period>/<adaptation set>/<bit-rate>/<segment>" and <ip> is taken from the announcing socket.
+ * Any client can run the tracker (runTracker) so that no separate process is needed in a LAN. The tracker forgets the
+ * announcements made over a connection when it closes, so that it only knows about peers that are still around.
+ *
+ * The control thread never waits for the network. Announcements are queued, lookups are answered from peer lists
+ * that the PeerManager thread fetches in the background. That thread talks to the tracker over one persistent
+ * connection and serves peers, all with non-blocking sockets, so a slow tracker or peer delays nobody else.
+ *
+ * All public methods except init() and cleanup() are meant to be called from the control thread only.
+ */
+class PeerManager
+{
+public:
+    static void init(int listenPort, const string& tracker, bool runTracker, int64_t deadlineMargin);
+    static void cleanup();
+    static bool enabled() {return ifEnabled;}
+
+    /* Tells the tracker (in the background) that we can serve segId. */
+    static void announce(const ContentIdSegment& segId);
+    /**
+     * A peer holding segId, according to the peer list last fetched from the tracker. Returns an invalid SourceId if none
+     * is known (yet). Fetches the peer lists of segId and of the segments following it, if not recent.
+     */
+    static SourceId findPeer(const ContentIdSegment& segId);
+    /* Excludes a peer from future lookups (e.g., after it missed a deadline or dropped the connection). */
+    static void markFailed(const SourceId& srcId);
+    /* Path (without leading slash) under which peers serve segId. */
+    static string getPath(const ContentIdSegment& segId);
+    /* A peer fetch must complete at least this long [us] before the buffer runs empty. */
+    static int64_t getDeadlineMargin() {return deadlineMargin;}
+
+private:
+    PeerManager(){}
+    virtual ~PeerManager(){}
+
+    static string getKey(const ContentIdSegment& segId);
+    static int openListenSocket(int port);
+    static void wakeUp();
+
+    /* Thread talking to the tracker, serving segments to peers (and tracker requests, if enabled). */
+    static void* startThread(void* params);
+    static void threadMain();
+
+    /* A connection accepted by us. Responses are queued in out. */
+    class Client {
+    public:
+        Client(): isTracker(false), in(), out(), outPos(0), addr(), deadline(0), announced() {}
+        bool isTracker;
+        string in;
+        string out;
+        std::size_t outPos;
+        struct sockaddr_in addr;
+        int64_t deadline;    // [us] closed if no progress until then
+        set<pair<string, string> > announced; // <key, "ip:port"> announced over this connection (tracker)
+    };
+    /* Return false if the connection shall be closed. */
+    static bool readClient(int fd, Client& c);
+    static bool writeClient(int fd, Client& c);
+    static bool serveSegment(Client& c, const string& request);
+    static bool serveTracker(Client& c, const string& request);
+    /* Drops what was announced over a closed tracker connection, unless another open connection announced it too. */
+    static void forgetAnnouncements(const Client& c);
+
+    /* A transaction with the tracker, sent or to be sent over trackerFd. */
+    class TrackerRequest {
+    public:
+        TrackerRequest(bool query, const string& key): query(query), key(key), deadline(0) {}
+        bool query;          // otherwise an announcement
+        string key;
+        int64_t deadline;    // [us] by which the reply is expected
+    };
+    /* Takes over the requests queued by the control thread, connecting to the tracker if needed. */
+    static void sendTrackerRequests(int64_t now);
+    static void processTrackerData(int64_t now);
+    /* Closes the tracker connection, drops the outstanding transactions and does not reconnect for a while. */
+    static void trackerFailed(const char* reason, int64_t now);
+    /* Stores the peer list of key (the tracker's reply to a query). */
+    static void setPeerList(const string& key, const vector<string>& peers, int64_t now);
+
+private:
+    static bool ifEnabled;
+    static int listenPort;
+    static int64_t deadlineMargin;
+    static struct sockaddr_in trackerAddr;
+
+    /* Control thread side */
+    static map<string, int> peerSources;   // "ip:port" -> SourceId
+    static set<int> failedPeers;           // SourceIds
+
+    /* Shared, protected by _mutex. */
+    class PeerList {
+    public:
+        PeerList(): peers(), expires(0), pending(false) {}
+        vector<string> peers;  // "ip:port"
+        int64_t expires;       // [us] valid until then
+        bool pending;          // a query is on its way
+    };
+    static std::mutex _mutex;
+    static std::deque<TrackerRequest> trackerQueue;
+    static map<string, PeerList> peerLists;      // key -> peers
+
+    /* Server thread side */
+    static Thread thread;
+    static std::atomic<bool> ifTerminating;
+    static int fdWakeUp;
+    static int fdPeerServer;
+    static int fdTracker;
+    static map<int, Client> clients;
+    static map<string, map<string, int> > trackerDb; // key -> "ip:port" -> number of open connections that announced it
+    static int trackerFd;                        // our connection to the tracker, -1 if none
+    static bool trackerConnecting;
+    static string trackerOut;
+    static string trackerIn;
+    static std::deque<TrackerRequest> trackerPending;  // sent or in trackerOut, in order
+    static int64_t trackerRetry;                 // [us] no connection attempt before
+};
+
+} /* namespace dashp2p */
+#endif /* PEERMANAGER_H_ */
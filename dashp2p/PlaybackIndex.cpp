@@ -0,0 +1,740 @@
+/****************************************************************************
+ * PlaybackIndex.cpp                                                        *
+ ****************************************************************************
+ * Copyright (C) 2026                                                       *
+ *                                                                          *
+ * Created on: Oct 19, 2026                                                 *
+ * Authors: agent <agent@local>                                             *
+ *                                                                          *
+ * This program is free software: you can redistribute it and/or modify     *
+ * it under the terms of the GNU General Public License as published by     *
+ * the Free Software Foundation, either version 3 of the License, or        *
+ * (at your option) any later version.                                      *
+ *                                                                          *
+ * This program is distributed in the hope that it will be useful,          *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ * GNU General Public License for more details.                             *
+ *                                                                          *
+ * You should have received a copy of the GNU General Public License        *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.     *
+ ****************************************************************************/
+
+#include "PlaybackIndex.h"
+#include "DebugAdapter.h"
+
+#include <cstring>
+#include <algorithm>
+
+namespace dashp2p {
+
+namespace {
+
+/* SegmentTemplate of a representation. Attributes and elements are inherited one by one from the AdaptationSet and the Period. */
+class InheritedTemplate {
+public:
+    InheritedTemplate(const mpd::Period& period, const mpd::AdaptationSet& adaptationSet, const mpd::Representation& rep): n(0) {
+        if(rep.segmentTemplate.isSet())
+            levels[n++] = &rep.segmentTemplate.get();
+        if(adaptationSet.segmentTemplate.isSet())
+            levels[n++] = &adaptationSet.segmentTemplate.get();
+        if(period.segmentTemplate.isSet())
+            levels[n++] = &period.segmentTemplate.get();
+    }
+
+    /* Most specific value of field, NULL if it is not set at any level. */
+    template<typename M, typename C> const M* get(M C::* field) const {
+        for(int i = 0; i < n; ++i)
+            if((levels[i]->*field).isSet())
+                return &(levels[i]->*field);
+        return nullptr;
+    }
+
+    /* Only media segment templates are used for addressing. */
+    bool isSet() const {return get(&mpd::SegmentTemplate::media) != nullptr;}
+
+private:
+    const mpd::SegmentTemplate* levels[3];
+    int n;
+};
+
+typedef mpd::sequence_access<mpd::SegmentTimeline::S>::array Timeline;
+
+const mpd::Representation& getModel(const mpd::MediaPresentationDescription& mpd, const PlaybackIndex::Representation& r,
+        const mpd::Period** period, const mpd::AdaptationSet** adaptationSet)
+{
+    *period = mpd.periods.get().at(r.periodIndex);
+    *adaptationSet = (*period)->adaptationSets.get().at(r.adaptationSetIndex);
+    return *(*adaptationSet)->representations.get().at(r.representationIndex);
+}
+
+/* S elements of a representation addressed through a SegmentTemplate, NULL if it has no SegmentTimeline. */
+const Timeline* getTimeline(const mpd::MediaPresentationDescription& mpd, const PlaybackIndex::Representation& r)
+{
+    const mpd::Period* period = nullptr;
+    const mpd::AdaptationSet* adaptationSet = nullptr;
+    const mpd::Representation& rep = getModel(mpd, r, &period, &adaptationSet);
+    const mpd::element_access<mpd::SegmentTimeline>* timeline = InheritedTemplate(*period, *adaptationSet, rep).get(&mpd::SegmentTemplate::segmentTimeline);
+    return (timeline && timeline->get().s.isSet()) ? &timeline->get().s.get() : nullptr;
+}
+
+/* SegmentList of a representation, NULL if it has none with segment URLs or uses a segment index. */
+const mpd::SegmentList* getSegmentList(const mpd::MediaPresentationDescription& mpd, const PlaybackIndex::Representation& r)
+{
+    const mpd::Period* period = nullptr;
+    const mpd::AdaptationSet* adaptationSet = nullptr;
+    const mpd::Representation& rep = getModel(mpd, r, &period, &adaptationSet);
+    if(r.usesSegmentIndex || !rep.segmentList.isSet() || !rep.segmentList.get().segmentURLs.isSet())
+        return nullptr;
+    return &rep.segmentList.get();
+}
+
+/* [us] */
+int64_t getNominalDuration(const mpd::SegmentList& segmentList)
+{
+    const int64_t timescale = segmentList.timescale.isSet() ? segmentList.timescale.get() : 1;
+    return segmentList.duration.isSet() ? ((int64_t)1000000 * (int64_t)segmentList.duration.get()) / timescale : 0;
+}
+
+/**
+ * Number of runs of r that stay as they are when its S elements become ss and the end of its period endTime. The
+ * others are redone from the S element at *from on: the last one may be open and end with an appended S, and all
+ * open ones depend on the end of the period.
+ */
+uint32_t getKeptRuns(const PlaybackIndex::Representation& r, const Timeline& ss, int64_t endTime, size_t* from)
+{
+    *from = 0;
+    if(r.numRuns == 0 || r.endTime != endTime)
+        return 0;
+    dp2p_assert(r.numTimelineElements <= ss.size());
+    size_t j = r.numTimelineElements;
+    do {
+        --j;
+    } while(!ss[j]->d.isSet() || ss[j]->d.get() == 0);
+    *from = j;
+    return r.numRuns - 1;
+}
+
+}
+
+PlaybackIndex::PlaybackIndex()
+  : buffer(nullptr),
+    ownsBuffer(false),
+    size(0),
+    segments(nullptr),
+    numSegments(0),
+    runs(nullptr),
+    numRuns(0),
+    keys(nullptr),
+    representations(nullptr),
+    numRepresentations(0),
+    strings(nullptr),
+    baseUrl(0),
+    baseUrlLength(0)
+{
+}
+
+PlaybackIndex::PlaybackIndex(const mpd::MediaPresentationDescription& mpd)
+  : buffer(nullptr),
+    ownsBuffer(true),
+    size(0),
+    segments(nullptr),
+    numSegments(0),
+    runs(nullptr),
+    numRuns(0),
+    keys(nullptr),
+    representations(nullptr),
+    numRepresentations(0),
+    strings(nullptr),
+    baseUrl(0),
+    baseUrlLength(0)
+{
+    /* All URLs are made absolute here, once. */
+    const mpd::string_ref baseUrlString = (mpd.baseURLs.isSet() && mpd.baseURLs.get().size() > 0) ? mpd.baseURLs.get().at(0)->value.get() : mpd::string_ref();
+
+    /* First pass: sizes. */
+    std::string scratch;
+    size_t numChars = baseUrlString.size() + 1;
+    for(const mpd::Period* period: mpd.periods.get()) {
+        for(const mpd::AdaptationSet* adaptationSet: period->adaptationSets.get()) {
+            for(const mpd::Representation* rep: adaptationSet->representations.get()) {
+                ++numRepresentations;
+                const InheritedTemplate tmpl(*period, *adaptationSet, *rep);
+                if(!usesSegmentIndex(*rep) && !rep->segmentList.isSet() && tmpl.isSet()) {
+                    scratch.clear();
+                    if(const mpd::field_access<std::string>* initialization = tmpl.get(&mpd::SegmentTemplate::initialization))
+                        formatTemplate(initialization->get(), rep->id.isSet() ? rep->id.get() : mpd::string_ref(), rep->bandwidth.get(), 0, 0, scratch);
+                    numChars += baseUrlString.size() + scratch.size() + 1;
+                    numChars += tmpl.get(&mpd::SegmentTemplate::media)->get().size() + 1;
+                    numChars += (rep->id.isSet() ? rep->id.get().size() : 0) + 1;
+                    const mpd::element_access<mpd::SegmentTimeline>* timeline = tmpl.get(&mpd::SegmentTemplate::segmentTimeline);
+                    if(timeline && timeline->get().s.isSet()) {
+                        for(const mpd::SegmentTimeline::S* s: timeline->get().s.get())
+                            numRuns += (s->d.isSet() && s->d.get() > 0) ? 1 : 0;
+                    }
+                    continue;
+                }
+                const mpd::string_ref* initUrl = getInitSegmentURL(*rep);
+                numChars += baseUrlString.size() + (initUrl ? initUrl->size() : 0) + 1;
+                if(!usesSegmentIndex(*rep) && rep->segmentList.isSet() && rep->segmentList.get().segmentURLs.isSet()) {
+                    for(const mpd::SegmentURL* segmentUrl: rep->segmentList.get().segmentURLs.get()) {
+                        ++numSegments;
+                        numChars += baseUrlString.size() + (segmentUrl->media.isSet() ? segmentUrl->media.get().size() : 0) + 1;
+                    }
+                }
+            }
+        }
+    }
+    dp2p_assert(numChars <= UINT32_MAX);
+
+    /* One buffer: segments, runs, keys and representations (8-byte aligned), strings. */
+    size = numSegments * sizeof(Segment) + numRuns * sizeof(Run) + numRepresentations * (sizeof(Key) + sizeof(Representation)) + numChars;
+    buffer = new char[size];
+    setTables();
+
+    /* Second pass: contents. */
+    const bool live = mpd.type.isSet() && mpd.type.get() == mpd::EPresentation::DYNAMIC;
+    uint32_t stringPos = 0;
+    uint32_t segmentPos = 0;
+    uint32_t runPos = 0;
+    int repPos = 0;
+    baseUrlLength = baseUrlString.size();
+    baseUrl = addString(baseUrlString, mpd::string_ref(), stringPos);
+    for(size_t periodIndex = 0; periodIndex < mpd.periods.get().size(); ++periodIndex)
+    {
+        const mpd::Period& period = *mpd.periods.get()[periodIndex];
+        const int64_t periodDuration = getPeriodDuration(mpd, periodIndex);
+        for(size_t adaptationSetIndex = 0; adaptationSetIndex < period.adaptationSets.get().size(); ++adaptationSetIndex)
+        {
+            const mpd::AdaptationSet& adaptationSet = *period.adaptationSets.get()[adaptationSetIndex];
+            for(size_t representationIndex = 0; representationIndex < adaptationSet.representations.get().size(); ++representationIndex)
+            {
+                const mpd::Representation& rep = *adaptationSet.representations.get()[representationIndex];
+                keys[repPos].key = makeKey(periodIndex, adaptationSetIndex, rep.bandwidth.get());
+                keys[repPos].representation = repPos;
+                Representation& r = representations[repPos++];
+                memset(&r, 0, sizeof(r));
+                r.periodIndex = periodIndex;
+                r.adaptationSetIndex = adaptationSetIndex;
+                r.representationIndex = representationIndex;
+                r.bitRate = rep.bandwidth.get();
+                if(rep.width.isSet() && rep.height.isSet()) {
+                    r.width = rep.width.get();
+                    r.height = rep.height.get();
+                } else if(adaptationSet.width.isSet() && adaptationSet.height.isSet()) {
+                    r.width = adaptationSet.width.get();
+                    r.height = adaptationSet.height.get();
+                } else {
+                    r.width = r.height = 0;
+                }
+                r.usesSegmentIndex = usesSegmentIndex(rep);
+                r.endTime = periodDuration;
+                r.firstSegment = segmentPos;
+                r.firstRun = runPos;
+                r.timescale = 1;
+
+                const InheritedTemplate tmpl(period, adaptationSet, rep);
+                if(!r.usesSegmentIndex && !rep.segmentList.isSet() && tmpl.isSet())
+                {
+                    r.usesTemplate = true;
+                    const mpd::string_ref id = rep.id.isSet() ? rep.id.get() : mpd::string_ref();
+                    scratch.clear();
+                    if(const mpd::field_access<std::string>* initialization = tmpl.get(&mpd::SegmentTemplate::initialization))
+                        formatTemplate(initialization->get(), id, r.bitRate, 0, 0, scratch);
+                    r.initUrlLength = baseUrlString.size() + scratch.size();
+                    r.initUrl = addString(baseUrlString, mpd::string_ref(scratch.data(), scratch.size()), stringPos);
+                    const mpd::string_ref& media = tmpl.get(&mpd::SegmentTemplate::media)->get();
+                    r.mediaLength = media.size();
+                    r.media = addString(mpd::string_ref(), media, stringPos);
+                    r.idLength = id.size();
+                    r.id = addString(mpd::string_ref(), id, stringPos);
+
+                    const mpd::field_access<unsigned int>* startNumber = tmpl.get(&mpd::SegmentTemplate::startNumber);
+                    const mpd::field_access<unsigned int>* timescale = tmpl.get(&mpd::SegmentTemplate::timescale);
+                    const mpd::field_access<uint64_t>* presentationTimeOffset = tmpl.get(&mpd::SegmentTemplate::presentationTimeOffset);
+                    const mpd::field_access<unsigned int>* duration = tmpl.get(&mpd::SegmentTemplate::duration);
+                    const mpd::field_access<double>* availabilityTimeOffset = tmpl.get(&mpd::SegmentTemplate::availabilityTimeOffset);
+                    r.startNumber = startNumber ? startNumber->get() : 1;
+                    r.timescale = (timescale && timescale->get() > 0) ? timescale->get() : 1;
+                    r.presentationTimeOffset = presentationTimeOffset ? presentationTimeOffset->get() : 0;
+                    r.duration = duration ? duration->get() : 0;
+                    if(availabilityTimeOffset && availabilityTimeOffset->get() > 0)
+                        r.availabilityTimeOffset = (availabilityTimeOffset->get() < 9e12) ? (int64_t)(1e6 * availabilityTimeOffset->get()) : INT64_MAX;
+
+                    const mpd::element_access<mpd::SegmentTimeline>* timeline = tmpl.get(&mpd::SegmentTemplate::segmentTimeline);
+                    if(timeline && timeline->get().s.isSet())
+                        addRuns(r, timeline->get().s.get(), 0, 0, 0, live, runPos);
+                    else if(r.duration > 0)
+                    {
+                        r.numSegments = getNumConstantSegments(r, live);
+                        r.nominalDuration = toUsec(r, r.presentationTimeOffset + r.duration);
+                    }
+                    continue;
+                }
+
+                const mpd::string_ref* initUrl = getInitSegmentURL(rep);
+                r.initUrlLength = baseUrlString.size() + (initUrl ? initUrl->size() : 0);
+                r.initUrl = addString(baseUrlString, initUrl ? *initUrl : mpd::string_ref(), stringPos);
+                r.numSegments = 0;
+                if(r.usesSegmentIndex || !rep.segmentList.isSet() || !rep.segmentList.get().segmentURLs.isSet())
+                    continue;
+
+                /* Constant duration, except for the last segment, which ends with the presentation. */
+                const mpd::SegmentList& segmentList = rep.segmentList.get();
+                const int64_t nominalDuration = getNominalDuration(segmentList);
+                const uint32_t n = segmentList.segmentURLs.get().size();
+                for(uint32_t i = 0; i < n; ++i)
+                {
+                    const mpd::SegmentURL& segmentUrl = *segmentList.segmentURLs.get()[i];
+                    Segment& s = segments[segmentPos++];
+                    s.urlLength = baseUrlString.size() + (segmentUrl.media.isSet() ? segmentUrl.media.get().size() : 0);
+                    s.url = addString(baseUrlString, segmentUrl.media.isSet() ? segmentUrl.media.get() : mpd::string_ref(), stringPos);
+                }
+                r.numSegments = n;
+                r.nominalDuration = nominalDuration;
+                r.lastDuration = (periodDuration >= 0) ? std::max<int64_t>(1, periodDuration - (int64_t)(n - 1) * nominalDuration) : nominalDuration;
+            }
+        }
+    }
+    dp2p_assert(segmentPos == numSegments && runPos == numRuns && repPos == numRepresentations && stringPos == numChars);
+
+    std::sort(keys, keys + numRepresentations, [](const Key& a, const Key& b) {return a.key < b.key;});
+}
+
+PlaybackIndex::PlaybackIndex(const PlaybackIndex& previous, const mpd::MediaPresentationDescription& mpd)
+  : buffer(nullptr),
+    ownsBuffer(true),
+    size(0),
+    segments(nullptr),
+    numSegments(0),
+    runs(nullptr),
+    numRuns(0),
+    keys(nullptr),
+    representations(nullptr),
+    numRepresentations(previous.numRepresentations),
+    strings(nullptr),
+    baseUrl(previous.baseUrl),
+    baseUrlLength(previous.baseUrlLength)
+{
+    const mpd::string_ref baseUrlString = previous.getString(baseUrl, baseUrlLength);
+    const uint32_t previousChars = previous.size - (previous.strings - previous.buffer);
+
+    /* First pass: sizes. Refreshes do not add representations, they are matched by position. */
+    size_t numChars = previousChars;
+    for(int i = 0; i < numRepresentations; ++i)
+    {
+        const Representation& p = previous.representations[i];
+        if(p.usesTemplate) {
+            if(const Timeline* ss = getTimeline(mpd, p)) {
+                size_t from = 0;
+                numRuns += getKeptRuns(p, *ss, getPeriodDuration(mpd, p.periodIndex), &from);
+                for(size_t j = from; j < ss->size(); ++j)
+                    numRuns += ((*ss)[j]->d.isSet() && (*ss)[j]->d.get() > 0) ? 1 : 0;
+            }
+        } else if(const mpd::SegmentList* segmentList = getSegmentList(mpd, p)) {
+            const mpd::sequence_access<mpd::SegmentURL>::array& urls = segmentList->segmentURLs.get();
+            dp2p_assert(urls.size() >= p.numSegments);
+            numSegments += urls.size();
+            for(size_t j = p.numSegments; j < urls.size(); ++j)
+                numChars += baseUrlString.size() + (urls[j]->media.isSet() ? urls[j]->media.get().size() : 0) + 1;
+        }
+    }
+    dp2p_assert(numChars <= UINT32_MAX);
+
+    size = numSegments * sizeof(Segment) + numRuns * sizeof(Run) + numRepresentations * (sizeof(Key) + sizeof(Representation)) + numChars;
+    buffer = new char[size];
+    setTables();
+
+    /* Second pass: contents. What previous indexed is copied, string offsets stay valid. */
+    memcpy(keys, previous.keys, numRepresentations * sizeof(Key));
+    memcpy(strings, previous.strings, previousChars);
+    const bool live = mpd.type.isSet() && mpd.type.get() == mpd::EPresentation::DYNAMIC;
+    uint32_t stringPos = previousChars;
+    uint32_t segmentPos = 0;
+    uint32_t runPos = 0;
+    for(int i = 0; i < numRepresentations; ++i)
+    {
+        const Representation& p = previous.representations[i];
+        Representation& r = representations[i];
+        r = p;
+        r.endTime = getPeriodDuration(mpd, r.periodIndex);
+        r.firstSegment = segmentPos;
+        r.firstRun = runPos;
+        if(r.usesTemplate) {
+            if(const Timeline* ss = getTimeline(mpd, r)) {
+                size_t from = 0;
+                const uint32_t kept = getKeptRuns(p, *ss, r.endTime, &from);
+                memcpy(runs + runPos, previous.runs + p.firstRun, kept * sizeof(Run));
+                runPos += kept;
+                /* The first run redone starts where the S element it is made of starts. */
+                const Run* next = (from > 0) ? previous.runs + p.firstRun + kept : nullptr;
+                addRuns(r, *ss, from, next ? next->t : 0, next ? next->firstSegment : 0, live, runPos);
+            } else if(r.duration > 0) {
+                r.numSegments = getNumConstantSegments(r, live);
+            }
+            continue;
+        }
+
+        const mpd::SegmentList* segmentList = getSegmentList(mpd, r);
+        if(!segmentList)
+            continue;
+        const mpd::sequence_access<mpd::SegmentURL>::array& urls = segmentList->segmentURLs.get();
+        memcpy(segments + segmentPos, previous.segments + p.firstSegment, p.numSegments * sizeof(Segment));
+        segmentPos += p.numSegments;
+        for(size_t j = p.numSegments; j < urls.size(); ++j)
+        {
+            const mpd::SegmentURL& segmentUrl = *urls[j];
+            Segment& s = segments[segmentPos++];
+            s.urlLength = baseUrlString.size() + (segmentUrl.media.isSet() ? segmentUrl.media.get().size() : 0);
+            s.url = addString(baseUrlString, segmentUrl.media.isSet() ? segmentUrl.media.get() : mpd::string_ref(), stringPos);
+        }
+        const uint32_t n = urls.size();
+        r.numSegments = n;
+        r.nominalDuration = getNominalDuration(*segmentList);
+        r.lastDuration = (r.endTime >= 0) ? std::max<int64_t>(1, r.endTime - (int64_t)(n - 1) * r.nominalDuration) : r.nominalDuration;
+    }
+    dp2p_assert(segmentPos == numSegments && runPos == numRuns && stringPos == numChars);
+}
+
+void PlaybackIndex::addRuns(Representation& r, const mpd::sequence_access<mpd::SegmentTimeline::S>::array& ss, size_t from,
+        uint64_t t, uint64_t k, bool live, uint32_t& runPos)
+{
+    for(size_t j = from; j < ss.size(); ++j)
+    {
+        const mpd::SegmentTimeline::S& s = *ss[j];
+        if(s.t.isSet())
+            t = s.t.get();
+        if(!s.d.isSet() || s.d.get() == 0)
+            continue;
+        const uint64_t d = s.d.get();
+        uint64_t count = s.r.get() + 1;
+        if(s.r.get() < 0) {
+            /* Repeated up to the next S with a start time or up to the end of the period. */
+            uint64_t end = 0;
+            if(j + 1 < ss.size() && ss[j + 1]->t.isSet())
+                end = ss[j + 1]->t.get();
+            else if(r.endTime > 0)
+                end = fromUsec(r, r.endTime - 1) + 1;
+            count = (end > t) ? (end - t + d - 1) / d : 1;
+            /* Live: goes on until the next refresh of the MPD tells otherwise. */
+            if(live && end == 0 && j + 1 == ss.size())
+                count = LIVE_SEGMENTS - k;
+        }
+        Run& run = runs[runPos++];
+        run.t = t;
+        run.d = d;
+        run.firstSegment = k;
+        run.count = count;
+        k += count;
+        t += count * d;
+    }
+    dp2p_assert(k <= LIVE_SEGMENTS);
+    r.numRuns = runPos - r.firstRun;
+    r.numSegments = k;
+    r.numTimelineElements = ss.size();
+    if(r.numRuns > 0)
+        r.nominalDuration = toUsec(r, runs[r.firstRun].t + runs[r.firstRun].d) - toUsec(r, runs[r.firstRun].t);
+}
+
+uint32_t PlaybackIndex::getNumConstantSegments(const Representation& r, bool live)
+{
+    /* Constant duration, the last segment ends with the period. */
+    if(r.endTime > 0)
+        return std::min<uint64_t>(LIVE_SEGMENTS, (fromUsec(r, r.endTime - 1) - r.presentationTimeOffset) / r.duration + 1);
+    return live ? LIVE_SEGMENTS : 0;
+}
+
+int64_t PlaybackIndex::getPeriodStart(const mpd::MediaPresentationDescription& mpd, int periodIndex)
+{
+    const mpd::Period& period = *mpd.periods.get().at(periodIndex);
+    if(period.start.isSet())
+        return (int64_t)1000 * (int64_t)period.start.get();
+    if(periodIndex == 0)
+        return 0;
+    const mpd::Period& previous = *mpd.periods.get().at(periodIndex - 1);
+    const int64_t previousStart = getPeriodStart(mpd, periodIndex - 1);
+    if(previousStart < 0 || !previous.duration.isSet())
+        return -1;
+    return previousStart + (int64_t)1000 * (int64_t)previous.duration.get();
+}
+
+int64_t PlaybackIndex::getPeriodDuration(const mpd::MediaPresentationDescription& mpd, int periodIndex)
+{
+    const mpd::Period& period = *mpd.periods.get().at(periodIndex);
+    if(period.duration.isSet())
+        return (int64_t)1000 * (int64_t)period.duration.get();
+    const int64_t start = getPeriodStart(mpd, periodIndex);
+    int64_t end = -1;
+    if(periodIndex + 1 < (int)mpd.periods.get().size()) {
+        const mpd::Period& next = *mpd.periods.get().at(periodIndex + 1);
+        end = next.start.isSet() ? (int64_t)1000 * (int64_t)next.start.get() : -1;
+    } else if(mpd.mediaPresentationDuration.isSet()) {
+        end = (int64_t)1000 * (int64_t)mpd.mediaPresentationDuration.get();
+    }
+    return (start < 0 || end < start) ? -1 : end - start;
+}
+
+PlaybackIndex* PlaybackIndex::fromImage(const char* image, size_t imageSize)
+{
+    if(imageSize < sizeof(ImageHeader) || ((uintptr_t)image & 7) != 0)
+        return nullptr;
+    ImageHeader hdr;
+    memcpy(&hdr, image, sizeof(hdr));
+    if(hdr.magic != IMAGE_MAGIC || hdr.layout != getLayout() || hdr.size != imageSize - sizeof(ImageHeader) || hdr.numRepresentations < 0)
+        return nullptr;
+
+    PlaybackIndex* index = new PlaybackIndex();
+    index->buffer = const_cast<char*>(image + sizeof(ImageHeader));
+    index->size = hdr.size;
+    index->numSegments = hdr.numSegments;
+    index->numRuns = hdr.numRuns;
+    index->numRepresentations = hdr.numRepresentations;
+    index->baseUrl = hdr.baseUrl;
+    index->baseUrlLength = hdr.baseUrlLength;
+
+    /* Everything must reference into the buffer, a damaged image must not crash us later. */
+    const uint64_t tables = (uint64_t)hdr.numSegments * sizeof(Segment) + (uint64_t)hdr.numRuns * sizeof(Run)
+            + (uint64_t)hdr.numRepresentations * (sizeof(Key) + sizeof(Representation));
+    bool ok = tables <= hdr.size;
+    const uint64_t numChars = ok ? hdr.size - tables : 0;
+    ok = ok && (uint64_t)hdr.baseUrl + hdr.baseUrlLength < numChars;
+    if(ok) {
+        index->setTables();
+        for(int i = 0; ok && i < index->numRepresentations; ++i) {
+            const Representation& r = index->representations[i];
+            const Key& k = index->keys[i];
+            ok = k.representation >= 0 && k.representation < index->numRepresentations
+                    && (uint64_t)r.initUrl + r.initUrlLength < numChars
+                    && (r.usesTemplate || (uint64_t)r.firstSegment + r.numSegments <= index->numSegments)
+                    && (!r.usesTemplate || ((uint64_t)r.firstRun + r.numRuns <= index->numRuns
+                            && (uint64_t)r.media + r.mediaLength < numChars && (uint64_t)r.id + r.idLength < numChars));
+        }
+        for(uint32_t i = 0; ok && i < index->numSegments; ++i)
+            ok = (uint64_t)index->segments[i].url + index->segments[i].urlLength < numChars;
+    }
+    if(!ok) {
+        ERRMSG("Damaged playback index image.");
+        delete index;
+        return nullptr;
+    }
+    return index;
+}
+
+void PlaybackIndex::writeImage(std::string& out) const
+{
+    ImageHeader hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic = IMAGE_MAGIC;
+    hdr.layout = getLayout();
+    hdr.size = size;
+    hdr.numSegments = numSegments;
+    hdr.numRuns = numRuns;
+    hdr.numRepresentations = numRepresentations;
+    hdr.baseUrl = baseUrl;
+    hdr.baseUrlLength = baseUrlLength;
+    out.append(reinterpret_cast<const char*>(&hdr), sizeof(hdr));
+    out.append(buffer, size);
+}
+
+void PlaybackIndex::setTables()
+{
+    segments = reinterpret_cast<Segment*>(buffer);
+    runs = reinterpret_cast<Run*>(buffer + numSegments * sizeof(Segment));
+    keys = reinterpret_cast<Key*>(buffer + numSegments * sizeof(Segment) + numRuns * sizeof(Run));
+    representations = reinterpret_cast<Representation*>(buffer + numSegments * sizeof(Segment) + numRuns * sizeof(Run) + numRepresentations * sizeof(Key));
+    strings = buffer + numSegments * sizeof(Segment) + numRuns * sizeof(Run) + numRepresentations * (sizeof(Key) + sizeof(Representation));
+}
+
+const PlaybackIndex::Segment& PlaybackIndex::getSegment(const Representation& rep, int segmentIndex) const
+{
+    dp2p_assert_v(segmentIndex >= 1 && segmentIndex <= (int)rep.numSegments, "Segment %d of representation with %d bps not in the playback index.", segmentIndex, rep.bitRate);
+    return segments[rep.firstSegment + segmentIndex - 1];
+}
+
+uint64_t PlaybackIndex::getTemplateTime(const Representation& rep, uint32_t k, const Run** run) const
+{
+    if(rep.numRuns == 0) {
+        *run = nullptr;
+        return rep.presentationTimeOffset + k * rep.duration;
+    }
+    /* Last S element starting at or before segment k. */
+    const Run* first = runs + rep.firstRun;
+    const Run* r = std::upper_bound(first, first + rep.numRuns, k, [](uint32_t k, const Run& r) {return k < r.firstSegment;}) - 1;
+    *run = r;
+    return r->t + (k - r->firstSegment) * r->d;
+}
+
+int64_t PlaybackIndex::computeStartTime(const Representation& rep, int segmentIndex) const
+{
+    dp2p_assert_v(segmentIndex >= 1 && segmentIndex <= (int)rep.numSegments, "Segment %d of representation with %d bps not in the playback index.", segmentIndex, rep.bitRate);
+    if(!rep.usesTemplate)
+        return (int64_t)(segmentIndex - 1) * rep.nominalDuration;
+    const Run* run = nullptr;
+    return toUsec(rep, getTemplateTime(rep, segmentIndex - 1, &run));
+}
+
+int64_t PlaybackIndex::computeDuration(const Representation& rep, int segmentIndex) const
+{
+    dp2p_assert_v(segmentIndex >= 1 && segmentIndex <= (int)rep.numSegments, "Segment %d of representation with %d bps not in the playback index.", segmentIndex, rep.bitRate);
+    if(!rep.usesTemplate)
+        return (segmentIndex == (int)rep.numSegments) ? rep.lastDuration : rep.nominalDuration;
+    const Run* run = nullptr;
+    const uint64_t t = getTemplateTime(rep, segmentIndex - 1, &run);
+    if(run)
+        return toUsec(rep, t + run->d) - toUsec(rep, t);
+    if(segmentIndex == (int)rep.numSegments && rep.endTime >= 0)
+        return std::max<int64_t>(1, rep.endTime - toUsec(rep, t));
+    return toUsec(rep, t + rep.duration) - toUsec(rep, t);
+}
+
+int PlaybackIndex::findSegment(const Representation& rep, int64_t time) const
+{
+    dp2p_assert(rep.numSegments > 0);
+    if(!rep.usesTemplate) {
+        /* Last segment whose start time is not after time. */
+        if(time < 0)
+            return 1;
+        if(rep.nominalDuration <= 0)
+            return rep.numSegments;
+        return std::min<int64_t>(time / rep.nominalDuration, rep.numSegments - 1) + 1;
+    }
+
+    if(time <= 0)
+        return 1;
+    const uint64_t t = fromUsec(rep, time);
+    if(rep.numRuns == 0) {
+        const uint64_t k = (t - rep.presentationTimeOffset) / rep.duration;
+        return std::min<uint64_t>(k, rep.numSegments - 1) + 1;
+    }
+    /* Last S element starting at or before time, then the segment within. */
+    const Run* first = runs + rep.firstRun;
+    const Run* r = std::upper_bound(first, first + rep.numRuns, t, [](uint64_t t, const Run& r) {return t < r.t;});
+    if(r == first)
+        return 1;
+    --r;
+    return r->firstSegment + std::min<uint64_t>((t - r->t) / r->d, r->count - 1) + 1;
+}
+
+void PlaybackIndex::getUrl(const Representation& rep, int segmentIndex, std::string& url) const
+{
+    if(segmentIndex == 0) {
+        url.assign(strings + rep.initUrl, rep.initUrlLength);
+    } else if(!rep.usesTemplate) {
+        const Segment& segment = getSegment(rep, segmentIndex);
+        url.assign(strings + segment.url, segment.urlLength);
+    } else {
+        dp2p_assert_v(segmentIndex >= 1 && segmentIndex <= (int)rep.numSegments, "Segment %d of representation with %d bps not in the playback index.", segmentIndex, rep.bitRate);
+        const Run* run = nullptr;
+        const uint64_t t = getTemplateTime(rep, segmentIndex - 1, &run);
+        url.assign(strings + baseUrl, baseUrlLength);
+        formatTemplate(getString(rep.media, rep.mediaLength), getString(rep.id, rep.idLength), rep.bitRate, (uint64_t)rep.startNumber + segmentIndex - 1, t, url);
+    }
+}
+
+void PlaybackIndex::formatTemplate(const mpd::string_ref& tmpl, const mpd::string_ref& representationId, uint32_t bandwidth,
+        uint64_t number, uint64_t time, std::string& out)
+{
+    const char* p = tmpl.data();
+    const char* const end = p + tmpl.size();
+    while(p < end)
+    {
+        const char* open = static_cast<const char*>(memchr(p, '$', end - p));
+        if(!open) {
+            out.append(p, end - p);
+            return;
+        }
+        out.append(p, open - p);
+        const char* close = static_cast<const char*>(memchr(open + 1, '$', end - open - 1));
+        if(!close) {
+            out.append(open, end - open);
+            return;
+        }
+        p = close + 1;
+
+        /* "$$" is an escaped '$'. */
+        if(close == open + 1) {
+            out.push_back('$');
+            continue;
+        }
+
+        /* Identifier, optionally followed by a format tag "%0<width>d". */
+        const char* name = open + 1;
+        const char* format = static_cast<const char*>(memchr(name, '%', close - name));
+        const size_t nameLength = (format ? format : close) - name;
+        int width = 0;
+        for(const char* q = format ? format + 1 : close; q < close && *q >= '0' && *q <= '9' && width < 100; ++q)
+            width = 10 * width + (*q - '0');
+
+        uint64_t value = 0;
+        if(nameLength == 16 && memcmp(name, "RepresentationID", 16) == 0) {
+            out.append(representationId.data(), representationId.size());
+            continue;
+        } else if(nameLength == 6 && memcmp(name, "Number", 6) == 0) {
+            value = number;
+        } else if(nameLength == 9 && memcmp(name, "Bandwidth", 9) == 0) {
+            value = bandwidth;
+        } else if(nameLength == 4 && memcmp(name, "Time", 4) == 0) {
+            value = time;
+        } else {
+            out.append(open, p - open);
+            continue;
+        }
+
+        char digits[20];
+        int n = 0;
+        do {
+            digits[n++] = '0' + value % 10;
+            value /= 10;
+        } while(value > 0);
+        if(width > n)
+            out.append(width - n, '0');
+        while(n > 0)
+            out.push_back(digits[--n]);
+    }
+}
+
+int64_t PlaybackIndex::toUsec(const Representation& rep, uint64_t t)
+{
+    const int64_t v = (int64_t)(t - rep.presentationTimeOffset);
+    const int64_t timescale = rep.timescale;
+    return (v / timescale) * 1000000 + ((v % timescale) * 1000000) / timescale;
+}
+
+uint64_t PlaybackIndex::fromUsec(const Representation& rep, int64_t time)
+{
+    /* Latest t with toUsec(t) <= time, i.e., the largest t with (t - pto) * 10^6 < (time + 1) * timescale. */
+    dp2p_assert(time >= 0);
+    const uint64_t timescale = rep.timescale;
+    const uint64_t q = ((uint64_t)time + 1) / 1000000;
+    const uint64_t r = ((uint64_t)time + 1) % 1000000;
+    return rep.presentationTimeOffset + q * timescale + ((r * timescale + 999999) / 1000000) - 1;
+}
+
+bool PlaybackIndex::usesSegmentIndex(const mpd::Representation& rep)
+{
+    return !rep.segmentList.isSet() && rep.segmentBase.isSet() && rep.segmentBase.get().indexRange.isSet() && rep.baseURLs.isSet();
+}
+
+const mpd::string_ref* PlaybackIndex::getInitSegmentURL(const mpd::Representation& rep)
+{
+    if(rep.segmentList.isSet() && rep.segmentList.get().initialization.isSet() && rep.segmentList.get().initialization.get().sourceURL.isSet())
+        return &rep.segmentList.get().initialization.get().sourceURL.get();
+    else if(rep.segmentBase.isSet() && rep.segmentBase.get().initialization.isSet() && rep.segmentBase.get().initialization.get().sourceURL.isSet())
+        return &rep.segmentBase.get().initialization.get().sourceURL.get();
+    else if(usesSegmentIndex(rep))
+        return &rep.baseURLs.get().at(0)->value.get(); // initialization is at the beginning of the single file
+    else
+        return nullptr;
+}
+
+uint32_t PlaybackIndex::addString(const mpd::string_ref& prefix, const mpd::string_ref& s, uint32_t& pos)
+{
+    const uint32_t offset = pos;
+    memcpy(strings + pos, prefix.data(), prefix.size());
+    memcpy(strings + pos + prefix.size(), s.data(), s.size());
+    strings[pos + prefix.size() + s.size()] = 0;
+    pos += prefix.size() + s.size() + 1;
+    return offset;
+}
+
+}
@@ -0,0 +1,238 @@
+/****************************************************************************
+ * PlaybackIndex.h                                                          *
+ ****************************************************************************
+ * Copyright (C) 2026                                                       *
+ *                                                                          *
+ * Created on: Oct 19, 2026                                                 *
+ * Authors: agent <agent@local>                                             *
+ *                                                                          *
+ * This program is free software: you can redistribute it and/or modify     *
+ * it under the terms of the GNU General Public License as published by     *
+ * the Free Software Foundation, either version 3 of the License, or        *
+ * (at your option) any later version.                                      *
+ *                                                                          *
+ * This program is distributed in the hope that it will be useful,          *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ * GNU General Public License for more details.                             *
+ *                                                                          *
+ * You should have received a copy of the GNU General Public License        *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.     *
+ ****************************************************************************/
+
+#ifndef PLAYBACKINDEX_H_
+#define PLAYBACKINDEX_H_
+
+#include "mpd/model.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+namespace dashp2p {
+
+/**
+ * Flat, immutable copy of what playback needs from a completely parsed MPD: per representation the bit-rate,
+ * the spatial resolution and the segments, per segment the absolute URL.
+ * Everything is kept in a single buffer. Strings are referenced by offset and are null-terminated.
+ * Representations using a segment index (SegmentBase@indexRange) have no segments here.
+ *
+ * Representations addressed through a SegmentTemplate do not have a segment table either. They keep the media
+ * URL template and, if there is a SegmentTimeline, its S elements as runs of equally long segments. Times and
+ * URLs are computed when asked for, so the index does not grow with the number of segments.
+ *
+ * In a live presentation (MPD@type="dynamic") without a known end, such representations have LIVE_SEGMENTS
+ * segments if they have a constant segment duration or if their timeline ends with an open S (r="-1").
+ * Which of them are available yet follows from the wall-clock time, see MpdWrapper::getAvailabilityTime().
+ */
+class PlaybackIndex
+{
+public:
+    /* SegmentList segments have the nominal duration of their representation, except the last one, which ends with
+     * the period. Their times are computed, only the URL is kept per segment. */
+    class Segment {
+    public:
+        uint32_t url;              // offset of the URL
+        uint32_t urlLength;
+    };
+
+    /* One S element of a SegmentTimeline. */
+    class Run {
+    public:
+        uint64_t t;                // start time of the first segment [timescale]
+        uint64_t d;                // [timescale]
+        uint32_t firstSegment;     // position of the first segment (starting at 0) in the representation
+        uint32_t count;
+    };
+
+    class Representation {
+    public:
+        int periodIndex;
+        int adaptationSetIndex;
+        int representationIndex;
+        int bitRate;
+        int width;                 // 0 if not given
+        int height;                // 0 if not given
+        bool usesSegmentIndex;
+        bool usesTemplate;
+        uint32_t initUrl;          // offset of the init segment URL
+        uint32_t initUrlLength;
+        uint32_t firstSegment;     // position of the first media segment in the segment table
+        uint32_t numSegments;      // number of media segments
+        int64_t nominalDuration;   // [us]
+        int64_t lastDuration;      // SegmentList only: duration of the last segment [us]
+        int64_t endTime;           // end of the period [us], -1 if not known
+
+        /* SegmentTemplate only. */
+        uint32_t media;            // offset of the media URL template (without the base URL)
+        uint32_t mediaLength;
+        uint32_t id;               // offset of Representation@id
+        uint32_t idLength;
+        uint32_t startNumber;
+        uint32_t timescale;
+        uint64_t presentationTimeOffset; // [timescale]
+        int64_t availabilityTimeOffset;  // [us], INT64_MAX for "INF"
+        uint64_t duration;         // [timescale], if there is no SegmentTimeline
+        uint32_t firstRun;         // position of the first S element in the run table
+        uint32_t numRuns;          // 0 if there is no SegmentTimeline
+        uint32_t numTimelineElements; // S elements the runs were made of, including those without a duration
+    };
+
+public:
+    /* Number of media segments of a live representation without a known end: as many as a ContentIdSegment can number. */
+    static const uint32_t LIVE_SEGMENTS = 0x7ffffffe;
+
+    PlaybackIndex(const mpd::MediaPresentationDescription& mpd);
+    /**
+     * Index of mpd after MpdWrapper::refresh() merged a refresh into it, previous being its index before. Refreshes
+     * only append segment URLs and S elements, so previous is copied and only what was appended is indexed.
+     * Durations, the end of the period and live segment counts are updated for all representations.
+     */
+    PlaybackIndex(const PlaybackIndex& previous, const mpd::MediaPresentationDescription& mpd);
+    virtual ~PlaybackIndex() {if(ownsBuffer) delete[] buffer;}
+
+    /**
+     * Index stored with writeImage(), e.g., in a memory-mapped file. The image is used in place, not copied,
+     * and must outlive the index. It must be 8-byte aligned. Returns NULL if it was not written by this build.
+     */
+    static PlaybackIndex* fromImage(const char* image, size_t imageSize);
+    /* Appends the index to out. The buffer holds no pointers, so it is written as it is, behind a small header. */
+    void writeImage(std::string& out) const;
+
+    int getNumRepresentations() const {return numRepresentations;}
+    const Representation& getRepresentation(int i) const {return representations[i];}
+    /* Binary search over (period, adaptation set, bit-rate). NULL if there is no such representation. */
+    const Representation* find(int periodIndex, int adaptationSetIndex, int bitRate) const {
+        const uint64_t key = makeKey(periodIndex, adaptationSetIndex, bitRate);
+        const Key* k = std::lower_bound(keys, keys + numRepresentations, key, [](const Key& a, uint64_t b) {return a.key < b;});
+        if(k == keys + numRepresentations || k->key != key)
+            return nullptr;
+        return representations + k->representation;
+    }
+    /* Start time [us] of media segment segmentIndex (starting at 1, as in ContentIdSegment) of rep. */
+    int64_t getStartTime(const Representation& rep, int segmentIndex) const {
+        /* SegmentList segments all have the nominal duration, except the last one. No need to look at the table. */
+        if(!rep.usesTemplate && segmentIndex >= 1 && segmentIndex <= (int)rep.numSegments)
+            return (int64_t)(segmentIndex - 1) * rep.nominalDuration;
+        return computeStartTime(rep, segmentIndex);
+    }
+    /* Duration [us] of media segment segmentIndex of rep. */
+    int64_t getDuration(const Representation& rep, int segmentIndex) const {
+        if(!rep.usesTemplate && segmentIndex >= 1 && segmentIndex < (int)rep.numSegments)
+            return rep.nominalDuration;
+        return computeDuration(rep, segmentIndex);
+    }
+    /* Media segment of rep containing time [us], clamped to the first and the last one. Binary search. */
+    int findSegment(const Representation& rep, int64_t time) const;
+    mpd::string_ref getString(uint32_t offset, uint32_t length) const {return mpd::string_ref(strings + offset, length);}
+    /* Absolute URL of segment segmentIndex (0 being the init segment) of rep. Reuses the capacity of url. */
+    void getUrl(const Representation& rep, int segmentIndex, std::string& url) const;
+    /* [byte] */
+    size_t getSize() const {return size;}
+
+    /* Start [us] of a period: Period@start, otherwise the end of the previous one (0 for the first one). -1 if not known. */
+    static int64_t getPeriodStart(const mpd::MediaPresentationDescription& mpd, int periodIndex);
+    /* Duration [us] of a period: Period@duration, otherwise up to the start of the next one or the end of the presentation. -1 if not known. */
+    static int64_t getPeriodDuration(const mpd::MediaPresentationDescription& mpd, int periodIndex);
+
+    /**
+     * Appends tmpl to out, substituting $RepresentationID$, $Number$, $Bandwidth$ and $Time$ (the numbers with an
+     * optional width, as in $Number%05d$) and $$. Unknown identifiers are copied as they are.
+     */
+    static void formatTemplate(const mpd::string_ref& tmpl, const mpd::string_ref& representationId, uint32_t bandwidth,
+            uint64_t number, uint64_t time, std::string& out);
+
+private:
+    PlaybackIndex(const PlaybackIndex&);
+    PlaybackIndex& operator=(const PlaybackIndex&);
+    PlaybackIndex();
+
+    static const uint32_t IMAGE_MAGIC = 0x32495044; // "DPI2"
+    class ImageHeader {
+    public:
+        uint32_t magic;
+        uint32_t numSegments;
+        uint64_t layout;           // sizes of the tables' entries, to reject images of other builds
+        uint64_t size;
+        uint32_t numRuns;
+        int32_t numRepresentations;
+        uint32_t baseUrl;
+        uint32_t baseUrlLength;
+    };
+    static uint64_t getLayout() {
+        return sizeof(Segment) | (sizeof(Run) << 16) | ((uint64_t)sizeof(Key) << 32) | ((uint64_t)sizeof(Representation) << 48);
+    }
+    /* Sets the table pointers from buffer and the counts. */
+    void setTables();
+
+    class Key {
+    public:
+        uint64_t key;
+        int32_t representation;
+    };
+    static uint64_t makeKey(int periodIndex, int adaptationSetIndex, int bitRate) {
+        return ((uint64_t)(uint16_t)periodIndex << 48) | ((uint64_t)(uint16_t)adaptationSetIndex << 32) | (uint32_t)bitRate;
+    }
+
+    static bool usesSegmentIndex(const mpd::Representation& rep);
+    static const mpd::string_ref* getInitSegmentURL(const mpd::Representation& rep);
+    uint32_t addString(const mpd::string_ref& prefix, const mpd::string_ref& s, uint32_t& pos);
+    /**
+     * SegmentTemplate: adds the runs of ss[from], ss[from + 1], ... at runPos, the first one starting at time t
+     * [timescale] with segment k (starting at 0). r.firstRun and r.endTime must be set. Sets the other counts of r.
+     */
+    void addRuns(Representation& r, const mpd::sequence_access<mpd::SegmentTimeline::S>::array& ss, size_t from,
+            uint64_t t, uint64_t k, bool live, uint32_t& runPos);
+    /* SegmentTemplate without SegmentTimeline: number of media segments. */
+    static uint32_t getNumConstantSegments(const Representation& r, bool live);
+
+    const Segment& getSegment(const Representation& rep, int segmentIndex) const;
+    /* getStartTime() and getDuration() from the segment table or the template. */
+    int64_t computeStartTime(const Representation& rep, int segmentIndex) const;
+    int64_t computeDuration(const Representation& rep, int segmentIndex) const;
+    /* SegmentTemplate: start time [timescale] of segment k (starting at 0), and the S element it belongs to. */
+    uint64_t getTemplateTime(const Representation& rep, uint32_t k, const Run** run) const;
+    /* SegmentTemplate: media time [timescale] to time since the start of the period [us], rounded down. */
+    static int64_t toUsec(const Representation& rep, uint64_t t);
+    /* Inverse: the latest media time t with toUsec(t) <= time. */
+    static uint64_t fromUsec(const Representation& rep, int64_t time);
+
+private:
+    char* buffer;
+    bool ownsBuffer;
+    size_t size;
+    Segment* segments;
+    uint32_t numSegments;
+    Run* runs;
+    uint32_t numRuns;
+    Key* keys;
+    Representation* representations;
+    int numRepresentations;
+    char* strings;
+    uint32_t baseUrl;              // offset of MPD.BaseURL
+    uint32_t baseUrlLength;
+};
+
+}
+
+#endif /* PLAYBACKINDEX_H_ */
@@ -0,0 +1,143 @@
+/****************************************************************************
+ * SegmentIndex.cpp                                                         *
+ ****************************************************************************
+ * Copyright (C) 2026                                                       *
+ *                                                                          *
+ * Created on: Oct 19, 2026                                                 *
+ * Authors: agent <agent@local>                                             *
+ *                                                                          *
+ * This program is free software: you can redistribute it and/or modify     *
+ * it under the terms of the GNU General Public License as published by     *
+ * the Free Software Foundation, either version 3 of the License, or        *
+ * (at your option) any later version.                                      *
+ *                                                                          *
+ * This program is distributed in the hope that it will be useful,          *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ * GNU General Public License for more details.                             *
+ *                                                                          *
+ * You should have received a copy of the GNU General Public License        *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.     *
+ ****************************************************************************/
+
+#include "SegmentIndex.h"
+#include "DebugAdapter.h"
+
+#include <cstdio>
+#include <cstring>
+#include <cinttypes>
+
+namespace dashp2p {
+
+/* Big-endian readers. Caller checks bounds. */
+static uint32_t readU32(const unsigned char* p) {return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];}
+static uint64_t readU64(const unsigned char* p) {return ((uint64_t)readU32(p) << 32) | (uint64_t)readU32(p + 4);}
+static uint16_t readU16(const unsigned char* p) {return (uint16_t)(((uint16_t)p[0] << 8) | (uint16_t)p[1]);}
+
+bool SegmentIndex::parse(const char* _p, int64_t size, int64_t fileOffset)
+{
+    const unsigned char* p = (const unsigned char*)_p;
+    subsegments.clear();
+    totalDuration = 0;
+
+    /* Walk the top-level boxes until we find 'sidx'. */
+    int64_t pos = 0;
+    while(size - pos >= 8)
+    {
+        int64_t boxSize = readU32(p + pos);
+        int64_t hdrSize = 8;
+        if(boxSize == 1) {
+            if(size - pos < 16)
+                return false;
+            boxSize = readU64(p + pos + 8);
+            hdrSize = 16;
+        } else if(boxSize == 0) {
+            boxSize = size - pos;
+        }
+        if(boxSize < hdrSize) {
+            WARNMSG("Corrupt ISO-BMFF box at offset %" PRId64 ".", fileOffset + pos);
+            return false;
+        }
+
+        /* Bounds are compared by lengths, so that corrupt sizes neither overflow nor point past the buffer. */
+        if(0 != memcmp(p + pos + 4, "sidx", 4)) {
+            if(boxSize >= size - pos)
+                break;
+            pos += boxSize;
+            continue;
+        }
+
+        if(boxSize > size - pos) {
+            WARNMSG("Truncated 'sidx' box (%" PRId64 " bytes, %" PRId64 " available).", boxSize, size - pos);
+            return false;
+        }
+
+        /* Full box header, reference_ID, timescale */
+        const unsigned char* q = p + pos + hdrSize;
+        const unsigned char* end = p + pos + boxSize;
+        if(end - q < 12)
+            return false;
+        const int version = q[0];
+        const uint32_t timescale = readU32(q + 8);
+        q += 12;
+        if(timescale == 0)
+            return false;
+
+        /* earliest_presentation_time, first_offset */
+        uint64_t firstOffset = 0;
+        if(version == 0) {
+            if(end - q < 8) return false;
+            firstOffset = readU32(q + 4);
+            q += 8;
+        } else {
+            if(end - q < 16) return false;
+            firstOffset = readU64(q + 8);
+            q += 16;
+        }
+
+        /* reserved, reference_count */
+        if(end - q < 4)
+            return false;
+        const int referenceCount = readU16(q + 2);
+        q += 4;
+        if(end - q < 12 * referenceCount)
+            return false;
+
+        /* Subsegment offsets are relative to the first byte after the 'sidx' box. */
+        int64_t byteFrom = fileOffset + pos + boxSize + firstOffset;
+        uint64_t t = 0;
+        for(int i = 0; i < referenceCount; ++i, q += 12)
+        {
+            const uint32_t ref = readU32(q);
+            if(ref & 0x80000000) {
+                WARNMSG("Hierarchical 'sidx' boxes are not supported.");
+                subsegments.clear();
+                return false;
+            }
+            const int64_t referencedSize = ref & 0x7fffffff;
+            const uint32_t duration = readU32(q + 4);
+            const int64_t startTime = (int64_t)((t * 1000000) / timescale);
+            t += duration;
+            const int64_t endTime = (int64_t)((t * 1000000) / timescale);
+            subsegments.push_back(Subsegment(byteFrom, byteFrom + referencedSize - 1, startTime, endTime - startTime));
+            byteFrom += referencedSize;
+        }
+        totalDuration = (int64_t)((t * 1000000) / timescale);
+
+        DBGMSG("Parsed 'sidx' with %d subsegments, %.3f sec.", subsegments.size(), totalDuration / 1e6);
+        return !subsegments.empty();
+    }
+
+    return false;
+}
+
+std::pair<int64_t, int64_t> SegmentIndex::parseByteRange(const string& s)
+{
+    int64_t from = -1;
+    int64_t to = -1;
+    if(2 != sscanf(s.c_str(), "%" SCNd64 "-%" SCNd64, &from, &to) || from < 0 || to < from)
+        return std::pair<int64_t, int64_t>(-1, -1);
+    return std::pair<int64_t, int64_t>(from, to);
+}
+
+}
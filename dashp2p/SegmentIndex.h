@@ -0,0 +1,74 @@
+/****************************************************************************
+ * SegmentIndex.h                                                           *
+ ****************************************************************************
+ * Copyright (C) 2026                                                       *
+ *                                                                          *
+ * Created on: Oct 19, 2026                                                 *
+ * Authors: agent <agent@local>                                             *
+ *                                                                          *
+ * This program is free software: you can redistribute it and/or modify     *
+ * it under the terms of the GNU General Public License as published by     *
+ * the Free Software Foundation, either version 3 of the License, or        *
+ * (at your option) any later version.                                      *
+ *                                                                          *
+ * This program is distributed in the hope that it will be useful,          *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ * GNU General Public License for more details.                             *
+ *                                                                          *
+ * You should have received a copy of the GNU General Public License        *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.     *
+ ****************************************************************************/
+
+#ifndef SEGMENTINDEX_H_
+#define SEGMENTINDEX_H_
+
+#include <cstdint>
+#include <vector>
+#include <string>
+#include <utility>
+using std::vector;
+using std::string;
+
+namespace dashp2p {
+
+/**
+ * Content of an ISO-BMFF Segment Index box ('sidx'), i.e., byte ranges and durations of all subsegments
+ * of a representation that is delivered as a single file (SegmentBase@indexRange).
+ */
+class SegmentIndex
+{
+public:
+    class Subsegment {
+    public:
+        Subsegment(int64_t byteFrom, int64_t byteTo, int64_t startTime, int64_t duration)
+          : byteFrom(byteFrom), byteTo(byteTo), startTime(startTime), duration(duration) {}
+        int64_t size() const {return byteTo - byteFrom + 1;}
+        int64_t byteFrom;  // [byte], offset in the file
+        int64_t byteTo;    // [byte], inclusive
+        int64_t startTime; // [us], relative to the first subsegment
+        int64_t duration;  // [us]
+    };
+
+public:
+    SegmentIndex(): subsegments(), totalDuration(0) {}
+    virtual ~SegmentIndex(){}
+
+    /**
+     * Parses the first top-level 'sidx' box in [p, p + size).
+     * @param fileOffset  Offset of p in the file. Needed since subsegment offsets are relative to the end of the 'sidx' box.
+     * @return            False if no (supported) 'sidx' box was found.
+     */
+    bool parse(const char* p, int64_t size, int64_t fileOffset);
+
+    /* Parses byte ranges as in SegmentBase@indexRange ("from-to"). Returns (-1,-1) on error. */
+    static std::pair<int64_t, int64_t> parseByteRange(const string& s);
+
+public:
+    vector<Subsegment> subsegments;
+    int64_t totalDuration; // [us]
+};
+
+}
+
+#endif /* SEGMENTINDEX_H_ */
@@ -23,6 +23,8 @@
 #include "SegmentStorage.h"
 #include "DebugAdapter.h"
 #include <cassert>
+#include <cstring>
+#include <limits>
 //#include <cinttypes>
 
 /* Disable all debug output in this file */
@@ -35,7 +37,12 @@ namespace dashp2p {
 
 SegmentStorage::MpdMap SegmentStorage::mpdMap;
 SegmentStorage::SegMap SegmentStorage::segMap;
+std::shared_ptr<const SegmentStorage::RepresentationTable> SegmentStorage::representationTable(std::make_shared<SegmentStorage::RepresentationTable>());
+SegmentStorage::TracksMap SegmentStorage::tracksMap;
+std::multimap<uint64_t, DashSegment*> SegmentStorage::initsByHash;
 mutex SegmentStorage::_mutex;
+std::atomic<uint64_t> SegmentStorage::numLocks(0);
+std::atomic<uint64_t> SegmentStorage::numLocksContended(0);
 
 string StreamPosition::toString() const
 {
@@ -67,24 +74,35 @@ void SegmentStorage::init()
 
 void SegmentStorage::cleanup()
 {
-    std::unique_lock<mutex> lock(_mutex);
+    std::unique_lock<mutex> lock(_mutex, std::defer_lock);
+    lockMaps(lock);
     /* Delete the segment map and free storage */
     while(!mpdMap.empty()) {
         delete mpdMap.begin()->second;
         mpdMap.erase(mpdMap.begin());
     }
-    while(!segMap.empty()) {
-        delete segMap.begin()->second;
-        segMap.erase(segMap.begin());
-    }
+    for(SegMap::iterator it = segMap.begin(); it != segMap.end(); ++it)
+        delete it->second;
+    segMap.clear();
+    std::atomic_store(&representationTable, std::shared_ptr<const RepresentationTable>(std::make_shared<RepresentationTable>()));
+    tracksMap.clear();
+    initsByHash.clear();
 }
 
 bool SegmentStorage::initialized(const ContentId& contentId)
 {
-    std::unique_lock<mutex> lock(_mutex);
+    std::unique_lock<mutex> lock(_mutex, std::defer_lock);
     switch(contentId.getType()) {
-    case ContentType_Mpd: return (mpdMap.count(dynamic_cast<const ContentIdMpd&>(contentId)) > 0);
-    case ContentType_Segment: return (segMap.count(dynamic_cast<const ContentIdSegment&>(contentId)) > 0);
+    case ContentType_Mpd:
+        lockMaps(lock);
+        return (mpdMap.count(static_cast<const ContentIdMpd&>(contentId)) > 0);
+    case ContentType_Segment: {
+        const SegmentKey key = getKey(static_cast<const ContentIdSegment&>(contentId), false);
+        if(!key.valid())
+            return false;
+        lockMaps(lock);
+        return segMap.count(key) > 0;
+    }
     default: THROW_RUNTIME("Unknown segment type: %d.", contentId.getType());
     }
     abort(); // just to make gcc happy
@@ -92,33 +110,43 @@ bool SegmentStorage::initialized(const ContentId& contentId)
 
 void SegmentStorage::initSegment(const ContentIdMpd& contentIdMpd, int64_t numBytes)
 {
-    std::unique_lock<mutex> lock(_mutex);
+    std::unique_lock<mutex> lock(_mutex, std::defer_lock);
+    lockMaps(lock);
     DashObject* dashObject = new DashObject(contentIdMpd, numBytes);
     dp2p_assert(mpdMap.insert(pair<const ContentIdMpd&, DashObject*>(contentIdMpd, dashObject)).second);
 }
 
 void SegmentStorage::initSegment(const ContentIdSegment& segId, int64_t numBytes, int64_t duration)
 {
-    std::unique_lock<mutex> lock(_mutex);
+    std::unique_lock<mutex> lock(_mutex, std::defer_lock);
+    lockMaps(lock);
     DashSegment* dashSegment = new DashSegment(segId, numBytes, duration);
-    dp2p_assert(segMap.insert(pair<const ContentIdSegment&, DashSegment*>(segId, dashSegment)).second);
+    dp2p_assert(segMap.insert(SegMap::value_type(getKey(segId, true), dashSegment)).second);
 }
 
 void SegmentStorage::setSize(const ContentId& contentId, int64_t numBytes)
 {
-    std::unique_lock<mutex> lock(_mutex);
-    _get(contentId).setSize(numBytes);
+    get(contentId).setSize(numBytes);
+}
+
+void SegmentStorage::setFinalSize(const ContentId& contentId, int64_t numBytes)
+{
+    DashObject& dashObject = get(contentId);
+    dashObject.setFinalSize(numBytes);
+    if(contentId.getType() == ContentType_Segment)
+        parse(static_cast<DashSegment&>(dashObject));
 }
 
 void SegmentStorage::addData(const ContentId& contentId, int64_t byteFrom, int64_t byteTo, const char* srcBuffer, bool overwrite)
 {
-    std::unique_lock<mutex> lock(_mutex);
-    _get(contentId).setData(byteFrom, byteTo, srcBuffer, overwrite);
+    DashObject& dashObject = get(contentId);
+    dashObject.setData(byteFrom, byteTo, srcBuffer, overwrite);
+    if(contentId.getType() == ContentType_Segment)
+        parse(static_cast<DashSegment&>(dashObject));
 }
 
-StreamPosition SegmentStorage::getData(StreamPosition startPos, Contour contour, char** buffer, int* bufferSize, int* bytesReturned, int64_t* usecReturned)
+StreamPosition SegmentStorage::getData(StreamPosition startPos, const Contour& contour, char** buffer, int* bufferSize, int* bytesReturned, int64_t* usecReturned)
 {
-    std::unique_lock<mutex> lock(_mutex);
     if(bufferSize[0])
         DBGMSG("Enter. Asked for up to %d bytes at position (RepId: %d, SegNr: %d, offset: %" PRId64 ").",
                 bufferSize[0], startPos.segId.bitRate(), startPos.segId.segmentIndex(), startPos.byte);
@@ -126,51 +154,48 @@ StreamPosition SegmentStorage::getData(StreamPosition startPos, Contour contour,
         DBGMSG("Enter. Asked for all available bytes at position (RepId: %d, SegNr: %d, offset: %" PRId64 ").",
                 startPos.segId.bitRate(), startPos.segId.segmentIndex(), startPos.byte);
 
-    const pair<int64_t, int64_t> availableData = _getContigInterval(startPos, contour);
-    if(availableData.second == 0) {
-        DBGMSG("No data available. Will return an invalid stream position.");
-        return StreamPosition();
-    }
-
-    /* Reserve memory if none is given. */
+    /* Reserve memory if none is given. Only then the whole contiguous interval has to be determined up front. */
     if(buffer[0] == NULL) {
         dp2p_assert(bufferSize[0] == 0);
+        const pair<int64_t, int64_t> availableData = getContigInterval(startPos, contour);
+        if(availableData.second == 0) {
+            DBGMSG("No data available. Will return an invalid stream position.");
+            return StreamPosition();
+        }
         bufferSize[0] = availableData.second;
         buffer[0] = new char[bufferSize[0]];
     }
 
-    DBGMSG("Available: %" PRId64 " bytes, %" PRId64 " us. Will return %" PRId64 " bytes.",
-            availableData.second, availableData.first, std::min<int64_t>(bufferSize[0], availableData.second));
-
     bytesReturned[0] = 0;
     usecReturned[0] = 0;
     StreamPosition lastCopiedByte;
     StreamPosition nextByte2Copy = startPos;
-    while(bytesReturned[0] < std::min<int64_t>(bufferSize[0], availableData.second))
+    DashSegment* seg = NULL;
+    while(bytesReturned[0] < bufferSize[0] && (seg = find(nextByte2Copy.segId)) && seg->hasData(nextByte2Copy.byte))
     {
-        DashSegment& seg = _get(nextByte2Copy.segId);
-        const int64_t bytes = seg.getData(nextByte2Copy.byte, buffer[0] + bytesReturned[0], bufferSize[0] - bytesReturned[0]);
+        const int64_t bytes = seg->getData(nextByte2Copy.byte, buffer[0] + bytesReturned[0], bufferSize[0] - bytesReturned[0]);
         dp2p_assert(bytes > 0);
-        const int64_t usec = bytes * seg.duration / seg.getTotalSize();
+        const int64_t usec = seg->getMediaTime(nextByte2Copy.byte, bytes);
         bytesReturned[0] += bytes;
         usecReturned[0] += usec;
         DBGMSG("Copied %" PRId64 " bytes, %" PRId64 " us from position (RegId: %d, SegNr: %d, offset: %" PRId64 ").",
                 bytes, usec, nextByte2Copy.segId.bitRate(), nextByte2Copy.segId.segmentIndex(), nextByte2Copy.byte);
         lastCopiedByte.segId = nextByte2Copy.segId;
         lastCopiedByte.byte = nextByte2Copy.byte + bytes - 1;
-        if(lastCopiedByte.byte == seg.getTotalSize() - 1)
-        {
-            if(contour.hasNext(nextByte2Copy.segId)) {
-                nextByte2Copy.segId = contour.getNext(nextByte2Copy.segId);
-                nextByte2Copy.byte = 0;
-            } else {
-                dp2p_assert(bytesReturned[0] == std::min<int64_t>(bufferSize[0], availableData.second));
-            }
-        }
+        /* Stop at a gap or at the end of the contour. */
+        if(lastCopiedByte.byte < seg->getTotalSize() - 1 || !contour.hasNext(nextByte2Copy.segId))
+            break;
+        nextByte2Copy.segId = contour.getNext(nextByte2Copy.segId);
+        nextByte2Copy.byte = 0;
+    }
+
+    if(bytesReturned[0] == 0) {
+        DBGMSG("No data available. Will return an invalid stream position.");
+        return StreamPosition();
     }
 
-    DBGMSG("Available: %" PRId64 " bytes, %" PRId64 " us. Returning: %" PRId32 " bytes, %" PRId64 " us. Last byte at position: (RepId: %" PRId32 ", SegNr: %" PRId32 ", offset: %" PRId64 ").",
-            availableData.second, availableData.first, bytesReturned[0], usecReturned[0], lastCopiedByte.segId.bitRate(), lastCopiedByte.segId.segmentIndex(), lastCopiedByte.byte);
+    DBGMSG("Returning: %" PRId32 " bytes, %" PRId64 " us. Last byte at position: (RepId: %" PRId32 ", SegNr: %" PRId32 ", offset: %" PRId64 ").",
+            bytesReturned[0], usecReturned[0], lastCopiedByte.segId.bitRate(), lastCopiedByte.segId.segmentIndex(), lastCopiedByte.byte);
     return lastCopiedByte;
 
 #if 0
@@ -253,10 +278,35 @@ StreamPosition SegmentStorage::getSegmentData(StreamPosition startPos, char** bu
 	return getData(startPos, contour, buffer, bufferSize, bytesReturned, usecReturned);
 }
 
+StreamPosition SegmentStorage::getDataRef(StreamPosition startPos, int maxBytes, DataBuffer** dataBuffer, const char** data, int* bytesReturned, int64_t* usecReturned)
+{
+    DBGMSG("Enter. Asked for up to %d bytes by reference at position (RepId: %d, SegNr: %d, offset: %" PRId64 ").",
+            maxBytes, startPos.segId.bitRate(), startPos.segId.segmentIndex(), startPos.byte);
+
+    dataBuffer[0] = NULL;
+    data[0] = NULL;
+    bytesReturned[0] = 0;
+    usecReturned[0] = 0;
+
+    DashSegment& seg = get(startPos.segId);
+    if(!seg.hasData(startPos.byte)) {
+        DBGMSG("No data available. Will return an invalid stream position.");
+        return StreamPosition();
+    }
+
+    int64_t bytes = 0;
+    dataBuffer[0] = seg.getDataRef(startPos.byte, maxBytes, data, &bytes);
+    dp2p_assert(bytes > 0 && bytes <= std::numeric_limits<int>::max());
+    bytesReturned[0] = bytes;
+    usecReturned[0] = seg.getMediaTime(startPos.byte, bytes);
+
+    DBGMSG("Returning %d bytes, %" PRId64 " us by reference.", bytesReturned[0], usecReturned[0]);
+    return StreamPosition(startPos.segId, startPos.byte + bytes - 1);
+}
+
 int64_t SegmentStorage::getTotalSize(const ContentId& contentId)
 {
-    std::unique_lock<mutex> lock(_mutex);
-    return _get(contentId).getTotalSize();
+    return get(contentId).getTotalSize();
 }
 
 /*int64_t SegmentStorage::getTotalDuration(ContentIdSegment segId)
@@ -267,30 +317,57 @@ int64_t SegmentStorage::getTotalSize(const ContentId& contentId)
 
 DashObject& SegmentStorage::get(const ContentId& contentId)
 {
-    std::unique_lock<mutex> lock(_mutex);
-    return _get(contentId);
+    DashObject* dashObject = find(contentId);
+    if(!dashObject)
+        THROW_RUNTIME("Object %s not initialized.", contentId.toString().c_str());
+    return *dashObject;
 }
 
 DashSegment& SegmentStorage::get(const ContentIdSegment& segId)
 {
-    std::unique_lock<mutex> lock(_mutex);
-    return _get(segId);
+    DashSegment* seg = find(segId);
+    if(!seg)
+        THROW_RUNTIME("Segment %s not initialized.", segId.toString().c_str());
+    return *seg;
 }
 
-pair<int64_t, int64_t> SegmentStorage::getContigInterval(StreamPosition strPos, Contour contour)
+pair<int64_t, int64_t> SegmentStorage::getContigInterval(StreamPosition strPos, const Contour& contour)
 {
-    std::unique_lock<mutex> lock(_mutex);
-    return _getContigInterval(strPos, contour);
+    pair<int64_t, int64_t> availableData(0, 0);
+
+    DBGMSG("Asking for contiguous interval at position (RepId: %d, SegNr: %d, offset: %" PRId64 ").",
+            strPos.segId.bitRate(), strPos.segId.segmentIndex(), strPos.byte);
+
+    /* If the given position is invalid, return 0 */
+    if(!strPos.valid())
+        return availableData;
+
+    DashSegment* seg = NULL;
+    while((seg = find(strPos.segId)) && seg->hasData(strPos.byte))
+    {
+        pair<int64_t, int64_t> _availableData = seg->getContigInterval(strPos.byte);
+        availableData.first += _availableData.first;
+        availableData.second += _availableData.second;
+        if(strPos.byte + _availableData.second < seg->getTotalSize()) {
+            break;
+        } else if(contour.hasNext(strPos.segId)) {
+            dp2p_assert(strPos.byte + _availableData.second == seg->getTotalSize());
+            strPos.segId = contour.getNext(strPos.segId);
+            strPos.byte = 0;
+        } else {
+            break;
+        }
+    }
+
+    DBGMSG("Returning %" PRId64 " us, %" PRId64 " byte.", availableData.first, availableData.second);
+
+    return availableData;
 }
 
 bool SegmentStorage::dataAvailable(StreamPosition strPos)
 {
-    std::unique_lock<mutex> lock(_mutex);
-    try {
-        return _get(strPos.segId).hasData(strPos.byte);
-    } catch (const std::out_of_range& e) {
-        return false;
-    }
+    DashSegment* seg = find(strPos.segId);
+    return seg && seg->hasData(strPos.byte);
 }
 
 #if 0
@@ -320,13 +397,119 @@ string SegmentStorage::printDownloadedData(int startSegNr, int64_t offset)
 
 void SegmentStorage::toFile (const ContentId& contentId, string& fileName)
 {
-    std::unique_lock<mutex> lock(_mutex);
-	_get(contentId).toFile(fileName);
+	get(contentId).toFile(fileName);
+}
+
+bool SegmentStorage::sameContent(const ContentIdSegment& a, const ContentIdSegment& b)
+{
+    const DashSegment* segA = find(a);
+    const DashSegment* segB = find(b);
+    return segA && segB && segA->getOriginal() && segA->getOriginal() == segB->getOriginal();
+}
+
+char* SegmentStorage::getCopy(const ContentId& contentId, int64_t* size)
+{
+    size[0] = 0;
+    DashObject* dashObject = find(contentId);
+    if(!dashObject || !dashObject->completed())
+        return NULL;
+    size[0] = dashObject->getTotalSize();
+    return dashObject->getCopy();
+}
+
+void SegmentStorage::getLockStatistics(uint64_t* _numLocks, uint64_t* _numContended)
+{
+    _numLocks[0] = numLocks.load();
+    _numContended[0] = numLocksContended.load();
 }
 
 /*
  * Private methods
  */
+void SegmentStorage::parse(DashSegment& seg)
+{
+    const pair<int, int> adaptationSet(seg.segId.periodIndex(), seg.segId.adaptationSetIndex());
+
+    if(seg.segId.segmentIndex() == 0)
+    {
+        if(!seg.completed() || seg.getOriginal())
+            return;
+        const int64_t size = seg.getTotalSize();
+        char* p = seg.getCopy();
+
+        /* Representations and periods often share their initialization segment. Then, the decoder needs it only once. */
+        uint64_t hash = 14695981039346656037ULL;
+        for(int64_t i = 0; i < size; ++i)
+            hash = (hash ^ (unsigned char)p[i]) * 1099511628211ULL;
+        const DashSegment* original = &seg;
+        bool tracksKnown = false;
+        {
+            std::unique_lock<mutex> lock(_mutex, std::defer_lock);
+            lockMaps(lock);
+            typedef std::multimap<uint64_t, DashSegment*>::const_iterator It;
+            const pair<It, It> candidates = initsByHash.equal_range(hash);
+            for(It it = candidates.first; it != candidates.second && original == &seg; ++it) {
+                if(it->second->getTotalSize() != size)
+                    continue;
+                char* q = it->second->getCopy();
+                if(0 == memcmp(p, q, size))
+                    original = it->second;
+                delete [] q;
+            }
+            if(original == &seg)
+                initsByHash.insert(pair<uint64_t, DashSegment*>(hash, &seg));
+            tracksKnown = (tracksMap.count(adaptationSet) > 0);
+        }
+        seg.setOriginal(original);
+        if(original != &seg)
+            DBGMSG("%s is identical to %s.", seg.segId.toString().c_str(), original->segId.toString().c_str());
+        if(tracksKnown) {
+            delete [] p;
+            return;
+        }
+
+        /* Without tracks (not fragmented MP4), parsing the media segments fails and their media time is estimated linearly. */
+        TrackInfoMap tracks;
+        if(!FragmentParser::parseInit(p, size, tracks)) {
+            DBGMSG("%s is not fragmented MP4. Media time of its adaptation set will be estimated linearly.", seg.segId.toString().c_str());
+            tracks.clear();
+        }
+        delete [] p;
+
+        /* Media segments of the adaptation set that arrived before stopped parsing at their first movie fragment. Resume them. */
+        const TrackInfoMap* published = nullptr;
+        vector<DashSegment*> pending;
+        {
+            std::unique_lock<mutex> lock(_mutex, std::defer_lock);
+            lockMaps(lock);
+            const pair<TracksMap::iterator, bool> ins = tracksMap.insert(TracksMap::value_type(adaptationSet, tracks));
+            if(!ins.second)
+                return;
+            published = &ins.first->second;
+            for(SegMap::const_iterator it = segMap.begin(); it != segMap.end(); ++it) {
+                if(it->first.periodIndex() == adaptationSet.first && it->first.adaptationSetIndex() == adaptationSet.second
+                        && it->first.segmentIndex() != 0)
+                    pending.push_back(it->second);
+            }
+        }
+        for(size_t i = 0; i < pending.size(); ++i)
+            pending[i]->parse(published);
+        return;
+    }
+
+    if(seg.duration == 0)
+        return;
+    const TrackInfoMap* tracks = nullptr;
+    {
+        std::unique_lock<mutex> lock(_mutex, std::defer_lock);
+        lockMaps(lock);
+        TracksMap::const_iterator it = tracksMap.find(adaptationSet);
+        if(it != tracksMap.end())
+            tracks = &it->second;
+    }
+    seg.parse(tracks);
+}
+
 #if 0
 DashSegment& SegmentStorage::getSegment(ContentIdSegment segId)
 {
@@ -338,68 +521,65 @@ DashSegment& SegmentStorage::getSegment(ContentIdSegment segId)
 }
 #endif
 
-DashObject& SegmentStorage::_get(const ContentId& contentId)
+void SegmentStorage::lockMaps(std::unique_lock<mutex>& lock)
+{
+    if(!lock.try_lock()) {
+        ++numLocksContended;
+        lock.lock();
+    }
+    ++numLocks;
+}
+
+DashObject* SegmentStorage::find(const ContentId& contentId)
 {
-    // must not lock mutex, must be locked before calling
     switch(contentId.getType()) {
-    case ContentType_Mpd:
-        return *mpdMap.at(dynamic_cast<const ContentIdMpd&>(contentId));
+    case ContentType_Mpd: {
+        std::unique_lock<mutex> lock(_mutex, std::defer_lock);
+        lockMaps(lock);
+        MpdMap::const_iterator it = mpdMap.find(static_cast<const ContentIdMpd&>(contentId));
+        return (it != mpdMap.end()) ? it->second : NULL;
+    }
     case ContentType_Segment:
-        return *segMap.at(dynamic_cast<const ContentIdSegment&>(contentId));
+        return find(static_cast<const ContentIdSegment&>(contentId));
     default:
         THROW_RUNTIME("Unexpected ContentType: %d.", contentId.getType());
     }
     abort(); // just to make gcc happy
 }
 
-DashSegment& SegmentStorage::_get(const ContentIdSegment& contentId)
+DashSegment* SegmentStorage::find(const ContentIdSegment& segId)
 {
-    // must not lock mutex, must be locked before calling
-    return *segMap.at(dynamic_cast<const ContentIdSegment&>(contentId));
+    if(!segId.valid())
+        return NULL;
+    const SegmentKey key = getKey(segId, false);
+    if(!key.valid())
+        return NULL;
+    std::unique_lock<mutex> lock(_mutex, std::defer_lock);
+    lockMaps(lock);
+    SegMap::const_iterator it = segMap.find(key);
+    return (it != segMap.end()) ? it->second : NULL;
 }
 
-pair<int64_t, int64_t> SegmentStorage::_getContigInterval(StreamPosition strPos, Contour contour)
+SegmentKey SegmentStorage::getKey(const ContentIdSegment& segId, bool create)
 {
-    pair<int64_t, int64_t> availableData(0, 0);
-
-    DBGMSG("Asking for contiguous interval at position (RepId: %d, SegNr: %d, offset: %" PRId64 ").",
-            strPos.segId.bitRate(), strPos.segId.segmentIndex(), strPos.byte);
-
-    /* If the given position is invalid, return 0 */
-    if(!strPos.valid())
-        return availableData;
-
-    while(_dataAvailable(strPos))
-    {
-        //DBGMSG("Checking (RepId: %d, SegNr: %d, offset: %"PRId64").", strPos.segId.repId(), strPos.segId.segNr(), strPos.byte);
-        DashSegment& seg = _get(strPos.segId);
-        pair<int64_t, int64_t> _availableData = seg.getContigInterval(strPos.byte);
-        //DBGMSG("Available: %"PRId64" us, %"PRId64" byte. Total segment size: %"PRId64".", _availableData.first, _availableData.second, seg.getTotalSize());
-        availableData.first += _availableData.first;
-        availableData.second += _availableData.second;
-        if(strPos.byte + _availableData.second < seg.getTotalSize()) {
-            break;
-        } else if(contour.hasNext(strPos.segId)) {
-            dp2p_assert(strPos.byte + _availableData.second == seg.getTotalSize());
-            strPos.segId = contour.getNext(strPos.segId);
-            strPos.byte = 0;
-        } else {
-            break;
-        }
+    const pair<int, int> adaptationSet(segId.periodIndex(), segId.adaptationSetIndex());
+    std::shared_ptr<const RepresentationTable> table = std::atomic_load(&representationTable);
+    RepresentationTable::const_iterator it = table->find(adaptationSet);
+    if(it != table->end()) {
+        RepresentationIndex::const_iterator jt = it->second.find(segId.bitRate());
+        if(jt != it->second.end())
+            return SegmentKey(segId.periodIndex(), segId.adaptationSetIndex(), jt->second, segId.segmentIndex());
     }
-
-    DBGMSG("Returning %" PRId64 " us, %" PRId64 " byte.", availableData.first, availableData.second);
-
-    return availableData;
-}
-
-bool SegmentStorage::_dataAvailable(StreamPosition strPos)
-{
-    const SegMap::const_iterator it = segMap.find(strPos.segId);
-    if(it == segMap.end())
-        return false;
-    else
-        return it->second->hasData(strPos.byte);
+    if(!create)
+        return SegmentKey();
+
+    /* New representation: publish a modified copy. Writers hold _mutex, so table is still the current one. */
+    std::shared_ptr<RepresentationTable> newTable = std::make_shared<RepresentationTable>(*table);
+    RepresentationIndex& index = (*newTable)[adaptationSet];
+    const int r = index.size();
+    index.insert(RepresentationIndex::value_type(segId.bitRate(), r));
+    std::atomic_store(&representationTable, std::shared_ptr<const RepresentationTable>(newTable));
+    return SegmentKey(segId.periodIndex(), segId.adaptationSetIndex(), r, segId.segmentIndex());
 }
 
 }
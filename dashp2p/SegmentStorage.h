@@ -27,10 +27,15 @@
 #include "DashSegment.h"
 #include "Contour.h"
 #include "ContentId.h"
+#include <atomic>
 #include <map>
+#include <memory>
 #include <mutex>
+#include <unordered_map>
+#include <vector>
 using std::map;
 using std::mutex;
+using std::vector;
 
 namespace dashp2p {
 
@@ -46,6 +51,9 @@ public:
     int64_t byte;
 };
 
+/* Locking: _mutex protects the maps only and is held just for look-ups and insertions (the representation table is copy-on-write
+ * and read without it). Objects are never removed before cleanup(),
+ * so pointers obtained from a look-up remain valid without the lock; access to the data itself is synchronized per object (see DataField). */
 class SegmentStorage
 {
 /* Public methods */
@@ -55,40 +63,71 @@ public:
     static bool initialized(const ContentId& contentId);
     static void initSegment(const ContentIdMpd& segId, int64_t numBytes = -1);
     static void initSegment(const ContentIdSegment& segId, int64_t numBytes, int64_t duration);
+    /* numBytes < 0 if the size is not known before the object is complete (see DashObject::setSize()). */
     static void setSize(const ContentId& contentId, int64_t numBytes);
+    static void setFinalSize(const ContentId& contentId, int64_t numBytes);
     static void addData(const ContentId& contentId, int64_t byteFrom, int64_t byteTo, const char* srcBuffer, bool overwrite);
-    static StreamPosition getData(StreamPosition startPos, Contour contour, char** buffer, int* bufferSize, int* bytesReturned, int64_t* usecReturned);
+    static StreamPosition getData(StreamPosition startPos, const Contour& contour, char** buffer, int* bufferSize, int* bytesReturned, int64_t* usecReturned);
     static StreamPosition getSegmentData(StreamPosition startPos, char** buffer, int* bufferSize, int* bytesReturned, int64_t* usecReturned);
+    /* Zero-copy variant of getData(). Returns the contiguous data at startPos, up to the end of the segment and at most maxBytes (if > 0),
+     * by reference: *data points into *dataBuffer, which the caller must unref(). Returns the position of the last byte or an invalid one if no data. */
+    static StreamPosition getDataRef(StreamPosition startPos, int maxBytes, DataBuffer** dataBuffer, const char** data, int* bytesReturned, int64_t* usecReturned);
     static int64_t getTotalSize(const ContentId& contentId);
     //static int64_t getTotalDuration(ContentIdSegment segId);
     static DashObject& get(const ContentId& contentId);
     static DashSegment& get(const ContentIdSegment& segId);
     /* contiguous interval starting exactly at strPos */
-    static pair<int64_t, int64_t> getContigInterval(StreamPosition strPos, Contour contour);
+    static pair<int64_t, int64_t> getContigInterval(StreamPosition strPos, const Contour& contour);
     /* If data is available at the exactly position strPos */
     static bool dataAvailable(StreamPosition strPos);
     //static string printDownloadedData(int startSegNr, int64_t offset);
     static void toFile (const ContentId& contentId, string& fileName);
+    /* If both are complete initialization segments with the same bytes. */
+    static bool sameContent(const ContentIdSegment& a, const ContentIdSegment& b);
+    /* Copy of a completely downloaded object (caller deletes it) or NULL if not (yet) available. */
+    static char* getCopy(const ContentId& contentId, int64_t* size);
+    /* Number of acquisitions of the map mutex and how many of them had to wait. */
+    static void getLockStatistics(uint64_t* numLocks, uint64_t* numContended);
 
 /* Private methods */
 private:
     SegmentStorage(){}
     virtual ~SegmentStorage(){}
-    static DashObject& _get(const ContentId& contentId);
-    static DashSegment& _get(const ContentIdSegment& segId);
-    static pair<int64_t, int64_t> _getContigInterval(StreamPosition strPos, Contour contour); // not thread safe.
-    static bool _dataAvailable(StreamPosition strPos);
+    static void lockMaps(std::unique_lock<mutex>& lock);
+    /* Return NULL if the object is not initialized. */
+    static DashObject* find(const ContentId& contentId);
+    static DashSegment* find(const ContentIdSegment& segId);
+    /* Returns an invalid key if the representation is unknown and create is false. Needs no lock, except with create,
+     * which must be called with _mutex locked. */
+    static SegmentKey getKey(const ContentIdSegment& segId, bool create);
+    /* Called when data of seg arrived. Looks for an identical copy of a complete initialization segment and reads its tracks.
+     * Parses the fragments of media segments. */
+    static void parse(DashSegment& seg);
 
 /* Private types */
 private:
     typedef map<const ContentIdMpd, DashObject*> MpdMap;
-    typedef map<const ContentIdSegment, DashSegment*> SegMap;
+    typedef std::unordered_map<SegmentKey, DashSegment*, SegmentKeyHash> SegMap;
+    /* Representation index of a SegmentKey, by bit-rate. */
+    typedef map<int, int> RepresentationIndex;
+    /* By <period index, adaptation set index>. */
+    typedef map<pair<int, int>, RepresentationIndex> RepresentationTable;
+    /* By <period index, adaptation set index>. */
+    typedef map<pair<int, int>, TrackInfoMap> TracksMap;
 
 /* Private members */
 private:
     static MpdMap mpdMap;
     static SegMap segMap;
+    /* Never modified once published. Read without the lock, replaced by a modified copy (under _mutex) when a representation is added. */
+    static std::shared_ptr<const RepresentationTable> representationTable;
+    /* Tracks of the first complete initialization segment of an adaptation set. Entries are never changed before cleanup(). */
+    static TracksMap tracksMap;
+    /* Complete initialization segments, each with different bytes, by a hash of their bytes. */
+    static std::multimap<uint64_t, DashSegment*> initsByHash;
     static mutex _mutex;
+    static std::atomic<uint64_t> numLocks;
+    static std::atomic<uint64_t> numLocksContended;
 };
 
 }
@@ -26,6 +26,7 @@
 #include "Control.h"
 #include "TcpConnectionManager.h"
 #include "SourceManager.h"
+#include "SegmentStorage.h"
 
 #include <cassert>
 #include <cstdio>
@@ -65,6 +66,29 @@ bool  Statistics::logSegmentSizes = false;
 FILE* Statistics::fileSegmentSizes = nullptr;
 bool  Statistics::logRequestStatistics = false;
 bool  Statistics::logRequestDownloadProgress = false;
+int64_t Statistics::bytesFromPeers = 0;
+int64_t Statistics::bytesFromOrigin = 0;
+int     Statistics::peerFallbacks = 0;
+int     Statistics::throughputCollapses = 0;
+int     Statistics::abandonments = 0;
+int64_t Statistics::abandonedBytes = 0;
+int64_t Statistics::stallAvoided = 0;
+int     Statistics::seeks = 0;
+int64_t Statistics::seekLatencySum = 0;
+int64_t Statistics::seekLatencyMax = 0;
+int     Statistics::seekReconnects = 0;
+int     Statistics::seekStoredSegments = 0;
+int     Statistics::mpdRefreshes = 0;
+int     Statistics::mpdRefreshesModified = 0;
+int64_t Statistics::mpdRefreshBytes = 0;
+int64_t Statistics::mpdRefreshParseTimeSum = 0;
+int64_t Statistics::mpdRefreshParseTimeMax = 0;
+int64_t Statistics::mpdRefreshMergeTimeSum = 0;
+int     Statistics::periodStarts = 0;
+int64_t Statistics::periodStartLatencyMax = 0;
+int64_t Statistics::periodStartBufferMin = 0;
+set<string> Statistics::startupEvents;
+map<string, std::pair<vector<double>, vector<double> > > Statistics::pathSamples;
 
 void Statistics::init(const std::string& logDir, const bool logTcpState, const bool logScalarValues, const bool logAdaptationDecision,
 		const bool logGiveDataToVlc, const bool logBytesStored, const bool logSecStored, const bool logUnderruns,
@@ -191,6 +215,30 @@ if(fileSecDownloaded != nullptr) {
 
     Statistics::logRequestStatistics = false;
     Statistics::logRequestDownloadProgress = false;
+
+    bytesFromPeers = 0;
+    bytesFromOrigin = 0;
+    peerFallbacks = 0;
+    throughputCollapses = 0;
+    abandonments = 0;
+    abandonedBytes = 0;
+    stallAvoided = 0;
+    seeks = 0;
+    seekLatencySum = 0;
+    seekLatencyMax = 0;
+    seekReconnects = 0;
+    seekStoredSegments = 0;
+    mpdRefreshes = 0;
+    mpdRefreshesModified = 0;
+    mpdRefreshBytes = 0;
+    mpdRefreshParseTimeSum = 0;
+    mpdRefreshParseTimeMax = 0;
+    mpdRefreshMergeTimeSum = 0;
+    periodStarts = 0;
+    periodStartLatencyMax = 0;
+    periodStartBufferMin = 0;
+    startupEvents.clear();
+    pathSamples.clear();
 }
 
 #if 0
@@ -220,6 +268,15 @@ void Statistics::recordRequestStatistics(const TcpConnectionId& tcpConnectionId,
 
     httpRequests.at(tcpConnectionId.numeric()).push_back(reqId);
 
+    /* Samples of the path. The smoothed RTT of the connection is updated by the download thread. */
+    if(HttpRequestManager::getContentId(reqId).getType() == ContentType_Segment && HttpRequestManager::getTransferTime(reqId) > 0) {
+        std::pair<vector<double>, vector<double> >& samples = pathSamples[getPath(tcpConnectionId)];
+        samples.first.push_back(8e6 * HttpRequestManager::getContentLength(reqId) / HttpRequestManager::getTransferTime(reqId));
+        const unsigned rtt = TcpConnectionManager::get(tcpConnectionId).rtt();
+        if(rtt > 0)
+            samples.second.push_back(rtt);
+    }
+
     if(HttpRequestManager::getContentId(reqId).getType() == ContentType_Segment)
         Control::displayThroughputOverlay(
                 dynamic_cast<const ContentIdSegment&>(HttpRequestManager::getContentId(reqId)).segmentIndex(),
@@ -261,8 +318,9 @@ double Statistics::getThroughput(const TcpConnectionId& tcpConnectionId, int64_t
         const int reqId = *it;
         if(devName.empty() || TcpConnectionManager::get(tcpConnectionId).ifData.name.compare(devName) == 0)
         {
-            const int64_t startTime = HttpRequestManager::getTsSent(reqId);
+            /* For chunked payloads, without the time the server was waiting for the next chunk to be produced. */
             const int64_t complTime = HttpRequestManager::getTsLastByte(reqId);
+            const int64_t startTime = complTime - HttpRequestManager::getTransferTime(reqId);
             const int64_t bytes = HttpRequestManager::getContentLength(reqId);
 
             if(complTime <= now - delta) {
@@ -306,7 +364,26 @@ double Statistics::getThroughputLastRequest(const TcpConnectionId& tcpConnection
     dp2p_assert(!rsList.empty());
 
     const int reqId = rsList.back();
-    return (8.0 * HttpRequestManager::getContentLength(reqId)) / ((HttpRequestManager::getTsLastByte(reqId) - HttpRequestManager::getTsSent(reqId)) / 1e6);
+    return (8.0 * HttpRequestManager::getContentLength(reqId)) / (HttpRequestManager::getTransferTime(reqId) / 1e6);
+}
+
+void Statistics::getPathSamples(const TcpConnectionId& tcpConnectionId, vector<double>& throughput, vector<double>& rtt)
+{
+    map<string, std::pair<vector<double>, vector<double> > >::const_iterator it = pathSamples.find(getPath(tcpConnectionId));
+    if(it == pathSamples.end()) {
+        throughput.clear();
+        rtt.clear();
+    } else {
+        throughput = it->second.first;
+        rtt = it->second.second;
+    }
+}
+
+string Statistics::getPath(const TcpConnectionId& tcpConnectionId)
+{
+    const TcpConnection& tc = TcpConnectionManager::get(tcpConnectionId);
+    const SourceData& sd = SourceManager::get(tc.srcId);
+    return sd.hostName + ":" + std::to_string(sd.port) + " " + tc.ifData.name;
 }
 
 // TODO: assumes that requests are received in chronological order. fails if this is not the case!
@@ -430,11 +507,102 @@ std::vector<double> Statistics::getReceivedBytes(const TcpConnectionId& tcpConne
     return retVal;
 }
 
+bool Statistics::getBurstiness(const list<int>& reqList, int64_t binSize, double& cov, double& idleFraction)
+{
+    dp2p_assert(binSize > 0);
+
+    int64_t tFirst = std::numeric_limits<int64_t>::max();
+    int64_t tLast = std::numeric_limits<int64_t>::min();
+    for(list<int>::const_iterator it = reqList.begin(); it != reqList.end(); ++it) {
+        const DownloadProcess& dp = HttpRequestManager::getDownloadProcess(*it);
+        for(DownloadProcess::const_iterator j = dp.begin(); j != dp.end(); ++j) {
+            if(j->empty())
+                continue;
+            tFirst = std::min<int64_t>(tFirst, j->front().ts_us);
+            tLast = std::max<int64_t>(tLast, j->back().ts_us);
+        }
+    }
+    if(tFirst == std::numeric_limits<int64_t>::max() || tLast - tFirst < binSize)
+        return false;
+
+    vector<int64_t> bins((tLast - tFirst) / binSize + 1, 0);
+    for(list<int>::const_iterator it = reqList.begin(); it != reqList.end(); ++it) {
+        const DownloadProcess& dp = HttpRequestManager::getDownloadProcess(*it);
+        for(DownloadProcess::const_iterator j = dp.begin(); j != dp.end(); ++j)
+            for(unsigned k = 0; k < j->size(); ++k)
+                bins.at((j->at(k).ts_us - tFirst) / binSize) += j->at(k).byte;
+    }
+
+    double sum = 0;
+    double sumSq = 0;
+    unsigned idle = 0;
+    for(unsigned i = 0; i < bins.size(); ++i) {
+        sum += bins.at(i);
+        sumSq += (double)bins.at(i) * (double)bins.at(i);
+        if(bins.at(i) == 0)
+            ++idle;
+    }
+    const double mean = sum / bins.size();
+    cov = (mean > 0) ? std::sqrt(std::max<double>(0, sumSq / bins.size() - mean * mean)) / mean : 0;
+    idleFraction = (double)idle / bins.size();
+    return true;
+}
+
 void Statistics::outputStatistics()
 {
     char logPath[2048];
 
-    if(logDir.empty() || httpRequests.empty())
+    if(logDir.empty())
+    	return;
+
+    /* origin offload due to peer-assisted delivery */
+    if(bytesFromPeers + bytesFromOrigin > 0) {
+    	recordScalarD64("bytesFromPeers", bytesFromPeers);
+    	recordScalarD64("bytesFromOrigin", bytesFromOrigin);
+    	recordScalarDouble("originOffloadRatio", (double)bytesFromPeers / (double)(bytesFromPeers + bytesFromOrigin));
+    	recordScalarD64("peerFallbacks", peerFallbacks);
+    }
+
+    recordScalarD64("throughputCollapses", throughputCollapses);
+    recordScalarD64("abandonments", abandonments);
+    recordScalarD64("abandonedBytes", abandonedBytes);
+    recordScalarDouble("projectedStallAvoided", stallAvoided / 1e6);
+
+    /* seek-to-first-data latency */
+    recordScalarD64("seeks", seeks);
+    if(seeks > 0) {
+        recordScalarDouble("seekLatencyMean", seekLatencySum / 1e6 / seeks);
+        recordScalarDouble("seekLatencyMax", seekLatencyMax / 1e6);
+        recordScalarD64("seekReconnects", seekReconnects);
+        recordScalarD64("seekStoredSegments", seekStoredSegments);
+    }
+
+    /* refreshes of a live MPD and their cost */
+    if(mpdRefreshes > 0) {
+        recordScalarD64("mpdRefreshes", mpdRefreshes);
+        recordScalarD64("mpdRefreshesModified", mpdRefreshesModified);
+        recordScalarD64("mpdRefreshBytes", mpdRefreshBytes);
+        if(mpdRefreshesModified > 0) {
+            recordScalarDouble("mpdRefreshParseTimeMean", mpdRefreshParseTimeSum / 1e6 / mpdRefreshesModified);
+            recordScalarDouble("mpdRefreshParseTimeMax", mpdRefreshParseTimeMax / 1e6);
+            recordScalarDouble("mpdRefreshMergeTimeMean", mpdRefreshMergeTimeSum / 1e6 / mpdRefreshesModified);
+        }
+    }
+
+    /* transitions between periods */
+    if(periodStarts > 0) {
+        recordScalarD64("periodStarts", periodStarts);
+        recordScalarDouble("periodStartLatencyMax", periodStartLatencyMax / 1e6);
+        recordScalarDouble("periodStartBufferMin", periodStartBufferMin / 1e6);
+    }
+
+    /* contention on the segment storage maps */
+    uint64_t storageLocks = 0, storageLocksContended = 0;
+    SegmentStorage::getLockStatistics(&storageLocks, &storageLocksContended);
+    recordScalarU64("storageLocks", storageLocks);
+    recordScalarU64("storageLocksContended", storageLocksContended);
+
+    if(httpRequests.empty())
     	return;
 
     for(map<int, list<int> >::const_iterator it = httpRequests.begin(); it != httpRequests.end(); ++it)
@@ -542,6 +710,19 @@ void Statistics::outputStatistics()
     		fclose(fileRequestStatistics);
     	}
 
+    	/* burstiness of the download (e.g., to compare on/off downloading with pacing) */
+    	{
+    		double cov = 0;
+    		double idleFraction = 0;
+    		if(getBurstiness(reqList, 100000, cov, idleFraction)) {
+    			char name[64];
+    			sprintf(name, "TCP%05" PRId32 "_throughputCoV", tcpConnId);
+    			recordScalarDouble(name, cov);
+    			sprintf(name, "TCP%05" PRId32 "_idleFraction", tcpConnId);
+    			recordScalarDouble(name, idleFraction);
+    		}
+    	}
+
     	/* download processes of the requests */
     	if(logRequestDownloadProgress)
     	{
@@ -835,6 +1016,78 @@ void Statistics::recordSegmentSize(ContentIdSegment segId, int64_t bytes)
     fprintf(fileSegmentSizes, "%d %d %" PRId64 "\n", segId.bitRate(), segId.segmentIndex(), bytes);
 }
 
+void Statistics::recordSegmentSource(bool fromPeer, int64_t bytes)
+{
+    if(fromPeer)
+        bytesFromPeers += bytes;
+    else
+        bytesFromOrigin += bytes;
+}
+
+void Statistics::recordPeerFallback()
+{
+    ++peerFallbacks;
+}
+
+void Statistics::recordThroughputCollapse()
+{
+    ++throughputCollapses;
+}
+
+void Statistics::recordAbandonment(int64_t wastedBytes, int64_t stallAvoided)
+{
+    ++abandonments;
+    abandonedBytes += wastedBytes;
+    Statistics::stallAvoided += stallAvoided;
+}
+
+void Statistics::recordSeekRestart(bool reconnected, int storedSegments)
+{
+    if(reconnected)
+        ++seekReconnects;
+    seekStoredSegments += storedSegments;
+}
+
+void Statistics::recordSeek(int64_t latency)
+{
+    ++seeks;
+    seekLatencySum += latency;
+    seekLatencyMax = std::max<int64_t>(seekLatencyMax, latency);
+}
+
+void Statistics::recordMpdRefresh(bool modified, int64_t bytes, int64_t parseTime, int64_t mergeTime)
+{
+    ++mpdRefreshes;
+    if(!modified)
+        return;
+    ++mpdRefreshesModified;
+    mpdRefreshBytes += bytes;
+    mpdRefreshParseTimeSum += parseTime;
+    mpdRefreshParseTimeMax = std::max<int64_t>(mpdRefreshParseTimeMax, parseTime);
+    mpdRefreshMergeTimeSum += mergeTime;
+}
+
+void Statistics::recordPeriodStart(int periodIndex, int64_t latency, int64_t bufferLevel)
+{
+    DBGMSG("Period %d started %.3f sec after its initialization segment was requested. Buffer: %.3f sec.", periodIndex, latency / 1e6, bufferLevel / 1e6);
+    char name[64];
+    sprintf(name, "periodStartLatency%d", periodIndex);
+    recordScalarDouble(name, latency / 1e6);
+    sprintf(name, "periodStartBuffer%d", periodIndex);
+    recordScalarDouble(name, bufferLevel / 1e6);
+    periodStartBufferMin = (periodStarts == 0) ? bufferLevel : std::min<int64_t>(periodStartBufferMin, bufferLevel);
+    periodStartLatencyMax = std::max<int64_t>(periodStartLatencyMax, latency);
+    ++periodStarts;
+}
+
+void Statistics::recordStartupEvent(const char* name, int64_t time)
+{
+    if(!startupEvents.insert(name).second)
+        return;
+    DBGMSG("Start-up: %s at %.3f sec.", name, time / 1e6);
+    recordScalarD64(name, time);
+}
+
 #if 0
 void Statistics::recordP2PMeasurementToFile(string filePath, int segNr, int repId,
 		int sourceNNumber, double measuredBandwith , int mode, double actualFetchtime)
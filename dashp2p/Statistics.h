@@ -31,11 +31,15 @@
 #include <list>
 #include <vector>
 #include <map>
+#include <set>
+#include <string>
 #include <netinet/tcp.h>
 
 using std::vector;
 using std::map;
 using std::list;
+using std::set;
+using std::string;
 
 namespace dashp2p {
 
@@ -72,6 +76,9 @@ public:
     static double getThroughput(const TcpConnectionId& tcpConnectionId, int64_t delta, string devName = "");
     static double getThroughputLastRequest(const TcpConnectionId& tcpConnectionId); // [bit/s]
     static std::vector<double> getReceivedBytes(const TcpConnectionId& tcpConnectionId, std::vector<double> tVec);
+    /* Throughput [bit/s] and RTT [us] of the segment downloads completed over all connections to the origin server of
+     * tcpConnectionId, through its interface. For ThroughputHistory, at the end of the session. */
+    static void getPathSamples(const TcpConnectionId& tcpConnectionId, vector<double>& throughput, vector<double>& rtt);
     static void outputStatistics();
 
     static void recordAdaptationDecision(int64_t relTime, int64_t beta, double rho, double rhoLast, int r_last, int r_new, int64_t Bdelay, bool betaMinIncreasing, int reason);
@@ -95,6 +102,30 @@ public:
 
     static void recordSegmentSize(ContentIdSegment segId, int64_t bytes);
 
+    /* Peer-assisted delivery: where completed segments came from and how often a peer fetch was abandoned. */
+    static void recordSegmentSource(bool fromPeer, int64_t bytes);
+    static void recordPeerFallback();
+
+    /* A segment download that, at its current throughput, would not complete before the buffer runs empty. */
+    static void recordThroughputCollapse();
+    /* A segment download was abandoned after receiving wastedBytes. Continuing it was projected to stall playback for stallAvoided [us]. */
+    static void recordAbandonment(int64_t wastedBytes, int64_t stallAvoided);
+
+    /* Seeking: how the downloads were restarted (reconnected or drained the connection, number of segments found in the storage),
+     * and the time [us] from the seek until the first data were given to VLC. */
+    static void recordSeekRestart(bool reconnected, int storedSegments);
+    static void recordSeek(int64_t latency);
+
+    /* Refresh of a live MPD: if it was modified, its size [byte] and the time [us] spent parsing it and merging it into the model. */
+    static void recordMpdRefresh(bool modified, int64_t bytes, int64_t parseTime, int64_t mergeTime);
+
+    /* Multi-period content: the first segment of period periodIndex completed, latency [us] after its initialization segment was requested,
+     * and the buffer level [us] then. */
+    static void recordPeriodStart(int periodIndex, int64_t latency, int64_t bufferLevel);
+
+    /* Start-up timeline: records time [us] as scalar value name, once. Later occurrences (e.g., after a seek) are ignored. */
+    static void recordStartupEvent(const char* name, int64_t time);
+
     //static void recordP2PMeasurementToFile(string filePath, int segNr, int repId, int sourceNNumber,
     //			double measuredBandwith , int mode, double actualFetchtime);
     //static void recordP2PBufferlevelToFile(string filePath,
@@ -102,6 +133,12 @@ public:
 
 /* Private methods */
 private:
+    /* Coefficient of variation of the throughput in bins of binSize [us] and the fraction of bins without data,
+     * over the period in which the requests received data. Returns false if that period is shorter than one bin. */
+    static bool getBurstiness(const list<int>& reqList, int64_t binSize, double& cov, double& idleFraction);
+    /* Origin server and interface of a connection, as the key of pathSamples. */
+    static string getPath(const TcpConnectionId& tcpConnectionId);
+
     static void prepareFileScalarValues();
     static void prepareFileAdaptationDecision();
     static void prepareFileGiveDataToVlc();
@@ -141,6 +178,30 @@ private:
     static FILE* fileSegmentSizes;
     static bool  logRequestStatistics;
     static bool  logRequestDownloadProgress;
+    static int64_t bytesFromPeers;
+    static int64_t bytesFromOrigin;
+    static int     peerFallbacks;
+    static int     throughputCollapses;
+    static int     abandonments;
+    static int64_t abandonedBytes;
+    static int64_t stallAvoided;
+    static int     seeks;
+    static int64_t seekLatencySum;
+    static int64_t seekLatencyMax;
+    static int     seekReconnects;
+    static int     seekStoredSegments;
+    static int     mpdRefreshes;
+    static int     mpdRefreshesModified;
+    static int64_t mpdRefreshBytes;
+    static int64_t mpdRefreshParseTimeSum;
+    static int64_t mpdRefreshParseTimeMax;
+    static int64_t mpdRefreshMergeTimeSum;
+    static int     periodStarts;
+    static int64_t periodStartLatencyMax;
+    static int64_t periodStartBufferMin;
+    static set<string> startupEvents;
+    /* <throughput [bit/s], RTT [us]> of completed segment downloads, by getPath(). */
+    static map<string, std::pair<vector<double>, vector<double> > > pathSamples;
 };
 
 }
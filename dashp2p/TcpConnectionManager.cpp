@@ -46,6 +46,7 @@ TcpConnection::TcpConnection(const SourceId& srcId, const int& port, const IfDat
     connectTimeout(connectTimeout),
     fdSocket(-1),
     lastTcpInfo(),
+    lastRtt(0),
     /*numConnectEvents(0),*/
     numReqsCompleted(0),
     keepAliveMaxRemaining(-1),
@@ -53,7 +54,8 @@ TcpConnection::TcpConnection(const SourceId& srcId, const int& port, const IfDat
     aHdrReceived(false),
     recvBufContent(0),
     recvBuf(nullptr),
-    recvTimestamp(-1)
+    recvTimestamp(-1),
+    connectedTimestamp(-1)
 {
     /* Open the socket. */
     // TODO: increase outoing buffer size to something around 1 MB or more
@@ -95,6 +97,7 @@ int TcpConnection::connect()
 	dp2p_assert(recvBuf);
 
 	//++ numConnectEvents;
+	connectedTimestamp = Utilities::getTime();
 	numReqsCompleted = 0;
 	if(SourceManager::get(srcId).keepAliveTimeout != -1)
 		keepAliveTimeoutNext = Utilities::getAbsTime() + SourceManager::get(srcId).keepAliveTimeout;
@@ -109,7 +112,7 @@ int TcpConnection::connect()
 	return 0;
 }
 
-int TcpConnection::read()
+int TcpConnection::read(int maxBytes)
 {
 	dp2p_assert_v(recvBufContent == 0, "recvBufContent: %" PRId32, recvBufContent);
 
@@ -120,7 +123,7 @@ int TcpConnection::read()
 	/* Read from the socket */
 	const pair<int,int> socketBufferLengths = this->getSocketBufferLengths(); // TODO: remove after debugging
 	dp2p_assert_v(socketBufferLengths.second / 2 <= (int)recvBufSize, "Socket rcv buf size: %d, recv buf size: %d.", socketBufferLengths.second, recvBufSize);
-	recvBufContent = recv(fdSocket, recvBuf, recvBufSize, 0);
+	recvBufContent = recv(fdSocket, recvBuf, (maxBytes > 0) ? std::min<int>(maxBytes, recvBufSize) : recvBufSize, 0);
 	if(recvBufContent == -1) {
 		perror("select()");
 		throw std::runtime_error("Error reading from socket.");
@@ -168,6 +171,7 @@ void TcpConnection::updateTcpInfo()
     memset(&lastTcpInfo, 0, sizeof(lastTcpInfo));
     socklen_t len = sizeof(lastTcpInfo);
     dp2p_assert(0 == getsockopt(fdSocket, SOL_TCP, TCP_INFO, &lastTcpInfo, &len) && len == sizeof(lastTcpInfo));
+    lastRtt.store(lastTcpInfo.tcpi_rtt, std::memory_order_relaxed);
     dp2p_assert_v(lastTcpInfo.tcpi_state == TCP_CLOSE_WAIT || lastTcpInfo.tcpi_state == TCP_ESTABLISHED || lastTcpInfo.tcpi_state == TCP_CLOSE || lastTcpInfo.tcpi_state == TCP_LAST_ACK,
     		"TCP is in state %s.", TcpConnectionManager::tcpState2String(lastTcpInfo.tcpi_state).c_str());
 }
@@ -27,6 +27,7 @@
 #include "SourceManager.h"
 
 #include <netinet/tcp.h>
+#include <atomic>
 #include <vector>
 using std::vector;
 using std::pair;
@@ -55,12 +56,14 @@ public: /* public methods */
 	TcpConnection(const SourceId& srcId, const int& port, const IfData& ifData, const int& maxPendingRequests, const int64_t& connectTimeout);
 	virtual ~TcpConnection();
 	int connect(); // returns 0 of OK. Can be called again if fails.
-	int read();
+	int read(int maxBytes = 0); // maxBytes: read at most that many bytes, 0: as many as fit into recvBuf
 	void write(string& s);
 	void updateTcpInfo();
 	void assertSocketHealth() const;
 	pair<int,int> getSocketBufferLengths() const;
 	int state() const;
+	/* Smoothed RTT [us] of the last updateTcpInfo(), 0 if not known yet. Safe to call from any thread. */
+	unsigned rtt() const {return lastRtt.load(std::memory_order_relaxed);}
 	string getIfString() const {return ifData.toString();}
 private:
 	void disconnect();
@@ -72,6 +75,8 @@ public: /* public fields */
 	const int64_t connectTimeout;
     int fdSocket;
     struct tcp_info lastTcpInfo;
+    /* lastTcpInfo.tcpi_rtt, published for the other threads while lastTcpInfo is being updated. */
+    std::atomic<unsigned> lastRtt;
     //int numConnectEvents;
     int numReqsCompleted;
     int keepAliveMaxRemaining;
@@ -84,6 +89,9 @@ public: /* public fields */
     char* recvBuf;
     int64_t recvTimestamp;
 
+    /* Time [us] when the connection was last established, -1 if never. */
+    int64_t connectedTimestamp;
+
 /* friends */
     friend class TcpConnectionManager;
 };
@@ -0,0 +1,330 @@
+/****************************************************************************
+ * ThroughputHistory.cpp                                                    *
+ ****************************************************************************
+ * Copyright (C) 2026                                                       *
+ *                                                                          *
+ * Created on: Oct 19, 2026                                                 *
+ * Authors: agent <agent@local>                                             *
+ *                                                                          *
+ * This program is free software: you can redistribute it and/or modify     *
+ * it under the terms of the GNU General Public License as published by     *
+ * the Free Software Foundation, either version 3 of the License, or        *
+ * (at your option) any later version.                                      *
+ *                                                                          *
+ * This program is distributed in the hope that it will be useful,          *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ * GNU General Public License for more details.                             *
+ *                                                                          *
+ * You should have received a copy of the GNU General Public License        *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.     *
+ ****************************************************************************/
+
+#include "ThroughputHistory.h"
+#include "Utilities.h"
+#include "DebugAdapter.h"
+
+#include <cmath>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+namespace dashp2p {
+
+namespace {
+
+const int NUM_SLOTS = 128;
+/* Bins are a third of an octave wide: 64 kbit/s to 4 Gbit/s, and 1 ms to 4 s. Values outside go to the first or last bin. */
+const int NUM_THROUGHPUT_BINS = 48;
+const double FIRST_THROUGHPUT_BIN = 64e3; // [bit/s]
+const int NUM_RTT_BINS = 36;
+const double FIRST_RTT_BIN = 1e3;         // [us]
+const int BINS_PER_OCTAVE = 3;
+
+const int64_t HALF_LIFE = 7LL * 24 * 3600 * 1000000; // [us]
+/* Below this weight, a path counts as unknown: a single session older than two half-lives. */
+const double MIN_WEIGHT = 0.25;
+/* The weights of a path are scaled down to at most this, so that a new session always counts. */
+const double MAX_WEIGHT = 16;
+/* Sessions with fewer segment downloads tell too little. */
+const unsigned MIN_SAMPLES = 3;
+
+/* File layout: header, NUM_SLOTS slots. */
+class FileHeader {
+public:
+    char magic[8];
+    uint32_t numSlots;
+    uint32_t slotSize;
+};
+
+class Slot {
+public:
+    uint64_t key;                             // hash of the path, 0 if the slot is free
+    int64_t updated;                          // [us] since the epoch. The weights are as of this time.
+    float throughput[NUM_THROUGHPUT_BINS];
+    float rtt[NUM_RTT_BINS];
+    uint64_t checksum;                        // of the bytes before
+};
+
+const char MAGIC[8] = {'D', 'P', '2', 'P', 'T', 'H', 'R', '1'};
+const size_t FILE_SIZE = sizeof(FileHeader) + NUM_SLOTS * sizeof(Slot);
+
+uint64_t fnv1a(const char* p, size_t n, uint64_t h = 14695981039346656037ULL)
+{
+    for(size_t i = 0; i < n; ++i)
+        h = (h ^ (unsigned char)p[i]) * 1099511628211ULL;
+    return h;
+}
+
+uint64_t getKey(const string& origin, const string& ifName)
+{
+    const uint64_t h = fnv1a(ifName.data(), ifName.size(), fnv1a(origin.c_str(), origin.size() + 1));
+    return (h == 0) ? 1 : h;
+}
+
+uint64_t getChecksum(const Slot& slot)
+{
+    return fnv1a(reinterpret_cast<const char*>(&slot), offsetof(Slot, checksum));
+}
+
+bool headerValid(const FileHeader& hdr)
+{
+    return 0 == memcmp(hdr.magic, MAGIC, sizeof(MAGIC)) && hdr.numSlots == NUM_SLOTS && hdr.slotSize == sizeof(Slot);
+}
+
+int getBin(double x, double first, int numBins)
+{
+    if(!(x > first))
+        return 0;
+    return std::min<int>(numBins - 1, (int)(BINS_PER_OCTAVE * std::log2(x / first)));
+}
+
+double getBinStart(int i, double first)
+{
+    return first * std::pow(2.0, (double)i / BINS_PER_OCTAVE);
+}
+
+/* Bin in which the cumulative weight reaches the fraction q of the total. */
+int getQuantileBin(const float* w, int numBins, double q)
+{
+    double total = 0;
+    for(int i = 0; i < numBins; ++i)
+        total += w[i];
+    double sum = 0;
+    for(int i = 0; i < numBins; ++i) {
+        sum += w[i];
+        if(sum >= q * total)
+            return i;
+    }
+    return numBins - 1;
+}
+
+/* By which the weights of a slot updated at updated are multiplied at now. */
+double getDecay(int64_t updated, int64_t now)
+{
+    return (now <= updated) ? 1.0 : std::pow(0.5, (double)(now - updated) / HALF_LIFE);
+}
+
+}
+
+int ThroughputHistory::fd = -1;
+void* ThroughputHistory::mapping = nullptr;
+size_t ThroughputHistory::mappingSize = 0;
+
+void ThroughputHistory::init(const string& fileName)
+{
+    dp2p_assert(!enabled() && !fileName.empty());
+
+    fd = open(fileName.c_str(), O_RDWR | O_CREAT, 0644);
+    if(fd == -1) {
+        ERRMSG("Cannot open the throughput history %s: %s. Starting at the lowest bit-rate.", fileName.c_str(), strerror(errno));
+        return;
+    }
+
+    /* A new file, or one from another version: (re)initialize it. Other processes only access it with the lock held. */
+    if(!lock(F_WRLCK)) {
+        close(fd);
+        fd = -1;
+        return;
+    }
+    struct stat st;
+    FileHeader hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    bool ok = (0 == fstat(fd, &st));
+    if(ok && ((size_t)st.st_size != FILE_SIZE || sizeof(hdr) != pread(fd, &hdr, sizeof(hdr), 0) || !headerValid(hdr))) {
+        INFOMSG("Initializing the throughput history %s.", fileName.c_str());
+        memset(&hdr, 0, sizeof(hdr));
+        memcpy(hdr.magic, MAGIC, sizeof(MAGIC));
+        hdr.numSlots = NUM_SLOTS;
+        hdr.slotSize = sizeof(Slot);
+        ok = (0 == ftruncate(fd, 0) && 0 == ftruncate(fd, FILE_SIZE) && sizeof(hdr) == pwrite(fd, &hdr, sizeof(hdr), 0));
+    }
+    void* p = ok ? mmap(nullptr, FILE_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+    lock(F_UNLCK);
+    if(p == MAP_FAILED) {
+        ERRMSG("Cannot use the throughput history %s: %s. Starting at the lowest bit-rate.", fileName.c_str(), strerror(errno));
+        close(fd);
+        fd = -1;
+        return;
+    }
+
+    mapping = p;
+    mappingSize = FILE_SIZE;
+    INFOMSG("Using the throughput history in %s.", fileName.c_str());
+}
+
+void ThroughputHistory::cleanup()
+{
+    if(mapping) {
+        munmap(mapping, mappingSize);
+        mapping = nullptr;
+        mappingSize = 0;
+    }
+    if(fd != -1) {
+        close(fd);
+        fd = -1;
+    }
+}
+
+void ThroughputHistory::record(const string& origin, const string& ifName, const vector<double>& throughput, const vector<double>& rtt)
+{
+    dp2p_assert(enabled());
+
+    if(throughput.size() < MIN_SAMPLES) {
+        DBGMSG("Only %u throughput samples for %s via %s. Not recording.", (unsigned)throughput.size(), origin.c_str(),
+                ifName.empty() ? "the default interface" : ifName.c_str());
+        return;
+    }
+
+    const uint64_t key = getKey(origin, ifName);
+    const int64_t now = Utilities::getAbsTime();
+
+    if(!lock(F_WRLCK))
+        return;
+    const FileHeader& hdr = *static_cast<const FileHeader*>(mapping);
+    if(!headerValid(hdr)) {
+        lock(F_UNLCK);
+        WARNMSG("The throughput history was reinitialized by another version. Not recording.");
+        return;
+    }
+
+    /* The slot of the path. Otherwise a free or damaged one, otherwise the one updated least recently. */
+    Slot* const slots = reinterpret_cast<Slot*>(static_cast<char*>(mapping) + sizeof(FileHeader));
+    Slot* slot = nullptr;
+    Slot* unused = nullptr;
+    bool unusedValid = false;
+    for(int i = 0; i < NUM_SLOTS; ++i) {
+        Slot& s = slots[i];
+        const bool valid = (s.key != 0 && s.checksum == getChecksum(s));
+        if(valid && s.key == key) {
+            slot = &s;
+            break;
+        }
+        if(!unused || (unusedValid && (!valid || s.updated < unused->updated))) {
+            unused = &s;
+            unusedValid = valid;
+        }
+    }
+    if(!slot) {
+        slot = unused;
+        memset(slot, 0, sizeof(Slot));
+        slot->key = key;
+        slot->updated = now;
+    }
+
+    /* Age the old weights, then add the session with a total weight of one. */
+    double decay = getDecay(slot->updated, now);
+    double weight = 0;
+    for(int i = 0; i < NUM_THROUGHPUT_BINS; ++i)
+        weight += slot->throughput[i];
+    if(decay * weight > MAX_WEIGHT - 1)
+        decay = (MAX_WEIGHT - 1) / weight;
+    for(int i = 0; i < NUM_THROUGHPUT_BINS; ++i)
+        slot->throughput[i] *= decay;
+    for(int i = 0; i < NUM_RTT_BINS; ++i)
+        slot->rtt[i] *= decay;
+    for(unsigned i = 0; i < throughput.size(); ++i)
+        slot->throughput[getBin(throughput.at(i), FIRST_THROUGHPUT_BIN, NUM_THROUGHPUT_BINS)] += 1.0 / throughput.size();
+    for(unsigned i = 0; i < rtt.size(); ++i)
+        slot->rtt[getBin(rtt.at(i), FIRST_RTT_BIN, NUM_RTT_BINS)] += 1.0 / rtt.size();
+    slot->updated = std::max<int64_t>(now, slot->updated);
+    slot->checksum = getChecksum(*slot);
+
+    lock(F_UNLCK);
+
+    DBGMSG("Recorded %u throughput and %u RTT samples for %s via %s.", (unsigned)throughput.size(), (unsigned)rtt.size(), origin.c_str(),
+            ifName.empty() ? "the default interface" : ifName.c_str());
+}
+
+bool ThroughputHistory::lookup(const string& origin, const string& ifName, Estimate& estimate)
+{
+    dp2p_assert(enabled());
+
+    const uint64_t key = getKey(origin, ifName);
+
+    /* Copy the slot out, so that the lock is held briefly. */
+    Slot slot;
+    bool found = false;
+    if(!lock(F_RDLCK))
+        return false;
+    if(headerValid(*static_cast<const FileHeader*>(mapping))) {
+        const Slot* const slots = reinterpret_cast<const Slot*>(static_cast<const char*>(mapping) + sizeof(FileHeader));
+        for(int i = 0; i < NUM_SLOTS && !found; ++i) {
+            if(slots[i].key == key) {
+                memcpy(&slot, &slots[i], sizeof(Slot));
+                found = (slot.checksum == getChecksum(slot));
+            }
+        }
+    }
+    lock(F_UNLCK);
+    if(!found)
+        return false;
+
+    double weight = 0;
+    for(int i = 0; i < NUM_THROUGHPUT_BINS; ++i)
+        weight += slot.throughput[i];
+    weight *= getDecay(slot.updated, Utilities::getAbsTime());
+    if(weight < MIN_WEIGHT) {
+        DBGMSG("History of %s via %s too old (weight %.3f).", origin.c_str(), ifName.empty() ? "the default interface" : ifName.c_str(), weight);
+        return false;
+    }
+
+    /* Throughput rounded down, RTT up. */
+    estimate.weight = weight;
+    estimate.throughputLow = getBinStart(getQuantileBin(slot.throughput, NUM_THROUGHPUT_BINS, 0.2), FIRST_THROUGHPUT_BIN);
+    estimate.throughputMedian = getBinStart(getQuantileBin(slot.throughput, NUM_THROUGHPUT_BINS, 0.5), FIRST_THROUGHPUT_BIN);
+    double rttWeight = 0;
+    for(int i = 0; i < NUM_RTT_BINS; ++i)
+        rttWeight += slot.rtt[i];
+    if(rttWeight > 0) {
+        estimate.rttMedian = getBinStart(getQuantileBin(slot.rtt, NUM_RTT_BINS, 0.5) + 1, FIRST_RTT_BIN);
+        estimate.rttHigh = getBinStart(getQuantileBin(slot.rtt, NUM_RTT_BINS, 0.9) + 1, FIRST_RTT_BIN);
+    } else {
+        estimate.rttMedian = estimate.rttHigh = 0;
+    }
+
+    return true;
+}
+
+bool ThroughputHistory::lock(int type)
+{
+    struct flock fl;
+    memset(&fl, 0, sizeof(fl));
+    fl.l_type = type;
+    fl.l_whence = SEEK_SET;
+    fl.l_start = 0;
+    fl.l_len = 0;
+    while(0 != fcntl(fd, F_SETLKW, &fl)) {
+        if(errno != EINTR) {
+            ERRMSG("Cannot lock the throughput history: %s.", strerror(errno));
+            return false;
+        }
+    }
+    return true;
+}
+
+} /* namespace dashp2p */
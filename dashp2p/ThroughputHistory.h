@@ -0,0 +1,90 @@
+/****************************************************************************
+ * ThroughputHistory.h                                                      *
+ ****************************************************************************
+ * Copyright (C) 2026                                                       *
+ *                                                                          *
+ * Created on: Oct 19, 2026                                                 *
+ * Authors: agent <agent@local>                                             *
+ *                                                                          *
+ * This program is free software: you can redistribute it and/or modify     *
+ * it under the terms of the GNU General Public License as published by     *
+ * the Free Software Foundation, either version 3 of the License, or        *
+ * (at your option) any later version.                                      *
+ *                                                                          *
+ * This program is distributed in the hope that it will be useful,          *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ * GNU General Public License for more details.                             *
+ *                                                                          *
+ * You should have received a copy of the GNU General Public License        *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.     *
+ ****************************************************************************/
+
+#ifndef THROUGHPUTHISTORY_H_
+#define THROUGHPUTHISTORY_H_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+using std::string;
+using std::vector;
+
+namespace dashp2p {
+
+/**
+ * Throughput and RTT seen by past sessions, by origin server and network interface (a path), so that a session can start
+ * above the lowest representation.
+ *
+ * The file has a fixed number of slots, one per path, each holding histograms (logarithmic bins) of the throughput
+ * and the RTT of the segment downloads. A session adds its samples with a total weight of one, older weights decay
+ * with a half-life of a week, and a path whose weight decayed below a threshold counts as unknown. When all slots are
+ * in use, the path updated least recently is replaced. The weight of a path is bounded, so that it follows changes.
+ *
+ * The file is mapped shared and may be used by several processes at once: updates hold a write lock on the file, lookups
+ * a read lock. Slots carry a checksum, a damaged one is ignored and reused.
+ *
+ * Meant to be called from the control thread only.
+ */
+class ThroughputHistory
+{
+public:
+    /* What the history knows about a path. */
+    class Estimate {
+    public:
+        Estimate(): throughputLow(0), throughputMedian(0), rttMedian(0), rttHigh(0), weight(0) {}
+        double throughputLow;    // [bit/s], 20 % quantile, rounded down
+        double throughputMedian; // [bit/s]
+        double rttMedian;        // [us]
+        double rttHigh;          // [us], 90 % quantile, rounded up
+        double weight;           // number of sessions, decayed
+    };
+
+    /* Uses (and creates, if needed) the history in fileName. */
+    static void init(const string& fileName);
+    static void cleanup();
+    static bool enabled() {return mapping != nullptr;}
+
+    /**
+     * Adds the samples of a session on the path (origin, e.g. "host:port", and interface name, empty for the default one):
+     * throughput [bit/s] and RTT [us] of its segment downloads. Sessions with too few samples are ignored.
+     */
+    static void record(const string& origin, const string& ifName, const vector<double>& throughput, const vector<double>& rtt);
+
+    /* Returns false if the path is not known, or its history is too old. */
+    static bool lookup(const string& origin, const string& ifName, Estimate& estimate);
+
+private:
+    ThroughputHistory(){}
+    virtual ~ThroughputHistory(){}
+
+    /* Takes (F_RDLCK, F_WRLCK) or releases (F_UNLCK) the lock on the file. */
+    static bool lock(int type);
+
+private:
+    static int fd;
+    static void* mapping;
+    static size_t mappingSize;
+};
+
+} /* namespace dashp2p */
+#endif /* THROUGHPUTHISTORY_H_ */
@@ -0,0 +1,433 @@
+/****************************************************************************
+ * TrackMuxer.cpp                                                           *
+ ****************************************************************************
+ * Copyright (C) 2026                                                       *
+ *                                                                          *
+ * Created on: Oct 19, 2026                                                 *
+ * Authors: agent <agent@local>                                             *
+ *                                                                          *
+ * This program is free software: you can redistribute it and/or modify     *
+ * it under the terms of the GNU General Public License as published by     *
+ * the Free Software Foundation, either version 3 of the License, or        *
+ * (at your option) any later version.                                      *
+ *                                                                          *
+ * This program is distributed in the hope that it will be useful,          *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ * GNU General Public License for more details.                             *
+ *                                                                          *
+ * You should have received a copy of the GNU General Public License        *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.     *
+ ****************************************************************************/
+
+#include "TrackMuxer.h"
+#include "SegmentStorage.h"
+#include "DebugAdapter.h"
+
+#include <cstring>
+#include <algorithm>
+
+namespace dashp2p {
+
+namespace {
+
+uint32_t fourcc(const char* t)
+{
+    return ((uint32_t)(unsigned char)t[0] << 24) | ((uint32_t)(unsigned char)t[1] << 16) | ((uint32_t)(unsigned char)t[2] << 8) | (unsigned char)t[3];
+}
+
+uint32_t get32(const unsigned char* p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+uint32_t get32(const string& s, size_t at)
+{
+    return get32((const unsigned char*)s.data() + at);
+}
+
+uint64_t get64(const string& s, size_t at)
+{
+    return ((uint64_t)get32(s, at) << 32) | get32(s, at + 4);
+}
+
+void set32(string& s, size_t at, uint32_t v)
+{
+    for(int i = 0; i < 4; ++i)
+        s[at + i] = (char)(v >> (24 - 8 * i));
+}
+
+void set64(string& s, size_t at, uint64_t v)
+{
+    set32(s, at, (uint32_t)(v >> 32));
+    set32(s, at + 4, (uint32_t)v);
+}
+
+/* Box starting at at, within [at, end). Sets its size and header length. False if damaged. */
+bool readBox(const string& s, size_t at, size_t end, uint32_t& type, size_t& size, size_t& hdr)
+{
+    if(at + 8 > end)
+        return false;
+    type = get32(s, at + 4);
+    size = get32(s, at);
+    hdr = 8;
+    if(size == 1) {
+        if(at + 16 > end)
+            return false;
+        size = get64(s, at + 8);
+        hdr = 16;
+    } else if(size == 0) {
+        size = end - at;
+    }
+    return size >= hdr && at + size <= end;
+}
+
+/* Offset of the first box of the given type in [from, end), string::npos if none. Sets its size and header length. */
+size_t findBox(const string& s, size_t from, size_t end, const char* type, size_t& size, size_t& hdr)
+{
+    uint32_t t = 0;
+    for(size_t at = from; readBox(s, at, end, t, size, hdr); at += size)
+        if(t == fourcc(type))
+            return at;
+    return string::npos;
+}
+
+/* Offset of the track_ID in the tkhd of the trak at [at, at + size), string::npos if none. */
+size_t findTrackId(const string& s, size_t at, size_t size, size_t hdr)
+{
+    size_t tkhdSize = 0, tkhdHdr = 0;
+    const size_t tkhd = findBox(s, at + hdr, at + size, "tkhd", tkhdSize, tkhdHdr);
+    if(tkhd == string::npos)
+        return string::npos;
+    const size_t ret = tkhd + tkhdHdr + 4 + ((s[tkhd + tkhdHdr] == 1) ? 16 : 8);
+    return (ret + 4 <= tkhd + tkhdSize) ? ret : string::npos;
+}
+
+/* Timescale of the movie whose mvhd is at [at, at + size). 0 if damaged. */
+uint32_t getTimescale(const string& s, size_t at, size_t size, size_t hdr)
+{
+    const size_t ret = at + hdr + 4 + ((s[at + hdr] == 1) ? 16 : 8);
+    return (ret + 4 <= at + size) ? get32(s, ret) : 0;
+}
+
+/* Converts the durations of the trak in s (tkhd, edit list) from timescale from to timescale to. */
+void rescaleTrak(string& s, size_t hdr, uint32_t from, uint32_t to)
+{
+    size_t size = 0, h = 0;
+    const size_t tkhd = findBox(s, hdr, s.size(), "tkhd", size, h);
+    if(tkhd != string::npos && s[tkhd + h] == 1 && tkhd + h + 36 <= tkhd + size)
+        set64(s, tkhd + h + 28, get64(s, tkhd + h + 28) * to / from);
+    else if(tkhd != string::npos && tkhd + h + 24 <= tkhd + size)
+        set32(s, tkhd + h + 20, (uint32_t)((uint64_t)get32(s, tkhd + h + 20) * to / from));
+
+    const size_t edts = findBox(s, hdr, s.size(), "edts", size, h);
+    if(edts == string::npos)
+        return;
+    size_t elstSize = 0;
+    const size_t elst = findBox(s, edts + h, edts + size, "elst", elstSize, h);
+    if(elst == string::npos || elst + h + 8 > elst + elstSize)
+        return;
+    const bool v1 = (s[elst + h] == 1);
+    const size_t entrySize = v1 ? 20 : 12;
+    const uint32_t n = get32(s, elst + h + 4);
+    for(uint32_t i = 0; i < n && elst + h + 8 + (i + 1) * entrySize <= elst + elstSize; ++i) {
+        const size_t at = elst + h + 8 + i * entrySize;
+        if(v1)
+            set64(s, at, get64(s, at) * to / from);
+        else
+            set32(s, at, (uint32_t)((uint64_t)get32(s, at) * to / from));
+    }
+}
+
+}
+
+/*
+ * TrackIdRewriter
+ */
+void TrackIdRewriter::process(char* p, int n)
+{
+    if(trackId == 0)
+        return;
+
+    const int64_t end = pos + n;
+    while(pos < end)
+    {
+        char& c = p[n - (end - pos)];
+
+        /* track_ID of a tfhd. */
+        if(patchAt != -1 && pos >= patchAt && pos < patchAt + 4) {
+            c = (char)(trackId >> (8 * (3 - (pos - patchAt))));
+            ++pos;
+            continue;
+        }
+
+        /* Box header. moof and traf are entered, all other boxes are skipped. */
+        if(nextBox != -1 && pos >= nextBox) {
+            hdr[hdrLen++] = (unsigned char)c;
+            ++pos;
+            const uint32_t size = (hdrLen >= 8) ? get32(hdr) : 0;
+            if(hdrLen < 8 || (size == 1 && hdrLen < 16))
+                continue;
+            const uint32_t type = get32(hdr + 4);
+            const int64_t boxSize = (size == 1) ? (((int64_t)get32(hdr + 8) << 32) | get32(hdr + 12)) : size;
+            const int64_t boxHdrLen = hdrLen;
+            hdrLen = 0;
+            if(size == 0 || boxSize < boxHdrLen) {
+                nextBox = -1;
+            } else if(type == fourcc("moof") || type == fourcc("traf")) {
+                nextBox += boxHdrLen;
+            } else {
+                if(type == fourcc("tfhd"))
+                    patchAt = nextBox + boxHdrLen + 4;
+                nextBox += boxSize;
+            }
+            continue;
+        }
+
+        /* Skip to whatever comes next. */
+        int64_t to = end;
+        if(nextBox != -1)
+            to = std::min<int64_t>(to, nextBox);
+        if(patchAt > pos)
+            to = std::min<int64_t>(to, patchAt);
+        pos = to;
+    }
+}
+
+/*
+ * TrackMuxer
+ */
+bool TrackMuxer::ifEnabled = false;
+std::mutex TrackMuxer::_mutex;
+std::map<int, TrackMuxer::Period> TrackMuxer::periods;
+
+void TrackMuxer::init(int periodIndex, int videoAdaptationSetIndex, int audioAdaptationSetIndex)
+{
+    dp2p_assert(videoAdaptationSetIndex != audioAdaptationSetIndex);
+    std::lock_guard<std::mutex> lock(_mutex);
+    if(!periods.insert(std::make_pair(periodIndex, Period(videoAdaptationSetIndex, audioAdaptationSetIndex))).second)
+        return;
+    ifEnabled = true;
+    INFOMSG("Muxing the audio of adaptation set %d into the video of adaptation set %d (period %d).", audioAdaptationSetIndex, videoAdaptationSetIndex, periodIndex);
+}
+
+void TrackMuxer::cleanup()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    ifEnabled = false;
+    periods.clear();
+}
+
+bool TrackMuxer::isAudio(const ContentIdSegment& segId)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    const Period* period = find(segId.periodIndex());
+    return period && segId.adaptationSetIndex() == period->audioAdaptationSetIndex;
+}
+
+bool TrackMuxer::isJointInit(const ContentIdSegment& segId)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    const Period* period = find(segId.periodIndex());
+    return period && segId.adaptationSetIndex() == period->videoAdaptationSetIndex && segId.segmentIndex() == 0;
+}
+
+TrackMuxer::Period* TrackMuxer::find(int periodIndex)
+{
+    std::map<int, Period>::iterator it = periods.find(periodIndex);
+    return (it != periods.end()) ? &it->second : nullptr;
+}
+
+bool TrackMuxer::addData(const ContentId& contentId, int64_t byteFrom, const char* p, int numBytes, int64_t contentLength, TrackIdRewriter& rewriter)
+{
+    if(contentId.getType() != ContentType_Segment)
+        return false;
+    const ContentIdSegment& segId = static_cast<const ContentIdSegment&>(contentId);
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    Period* period = find(segId.periodIndex());
+    if(!period)
+        return false;
+
+    /* Audio segment: renumbered on the way to the storage. */
+    if(segId.adaptationSetIndex() == period->audioAdaptationSetIndex && segId.segmentIndex() != 0)
+    {
+        if(byteFrom == 0) {
+            if(period->audioTrackId == 0)
+                WARNMSG("Receiving %s before the initialization segments are joined. Its track is not renumbered.", segId.toString().c_str());
+            rewriter.setTrackId(period->audioTrackId);
+            SegmentStorage::setSize(segId, contentLength);
+        }
+        string tmp(p, numBytes);
+        rewriter.process(&tmp[0], numBytes);
+        SegmentStorage::addData(segId, byteFrom, byteFrom + numBytes - 1, tmp.data(), true);
+        return true;
+    }
+
+    /* Initialization segments: collected. The audio one also goes to the storage, the video one only once it is joined. */
+    if(segId.segmentIndex() != 0 || period->joined)
+        return false;
+    if(segId.adaptationSetIndex() == period->audioAdaptationSetIndex)
+    {
+        dp2p_assert((int64_t)period->audioInit.size() == byteFrom);
+        period->audioInit.append(p, numBytes);
+        if(contentLength >= 0 && (int64_t)period->audioInit.size() == contentLength)
+            period->audioInitSize = contentLength;
+        tryJoin(*period);
+        return false;
+    }
+    if(segId.adaptationSetIndex() == period->videoAdaptationSetIndex && (!period->videoInitId.valid() || period->videoInitId == segId))
+    {
+        period->videoInitId = segId;
+        dp2p_assert((int64_t)period->videoInit.size() == byteFrom);
+        period->videoInit.append(p, numBytes);
+        if(contentLength >= 0 && (int64_t)period->videoInit.size() == contentLength)
+            period->videoInitSize = contentLength;
+        tryJoin(*period);
+        return true;
+    }
+    return false;
+}
+
+bool TrackMuxer::complete(const ContentId& contentId, int64_t size)
+{
+    if(contentId.getType() != ContentType_Segment)
+        return false;
+    const ContentIdSegment& segId = static_cast<const ContentIdSegment&>(contentId);
+    if(segId.segmentIndex() != 0)
+        return false;
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    Period* period = find(segId.periodIndex());
+    if(!period || period->joined)
+        return false;
+    if(segId.adaptationSetIndex() == period->audioAdaptationSetIndex) {
+        period->audioInitSize = size;
+        tryJoin(*period);
+        return false;
+    }
+    if(segId == period->videoInitId) {
+        period->videoInitSize = size;
+        tryJoin(*period);
+        return true;
+    }
+    return false;
+}
+
+void TrackMuxer::tryJoin(Period& period)
+{
+    if(period.videoInitSize == -1 || period.audioInitSize == -1)
+        return;
+
+    string out;
+    if(!join(period.videoInit, period.audioInit, out, period.audioTrackId)) {
+        ERRMSG("Cannot add the audio track to the video initialization segment. Playing without audio.");
+        out = period.videoInit;
+        period.audioTrackId = 0;
+    } else {
+        DBGMSG("Joined the initialization segments (%zu + %zu bytes -> %zu bytes). Audio track ID: %u.",
+                period.videoInit.size(), period.audioInit.size(), out.size(), period.audioTrackId);
+    }
+    period.joined = true;
+    string().swap(period.videoInit);
+    string().swap(period.audioInit);
+
+    SegmentStorage::setSize(period.videoInitId, out.size());
+    SegmentStorage::addData(period.videoInitId, 0, out.size() - 1, out.data(), true);
+}
+
+bool TrackMuxer::join(const string& video, const string& audio, string& out, uint32_t& audioTrackId)
+{
+    size_t size = 0, hdr = 0;
+
+    /* Video: moov with mvhd and mvex (fragmented), highest track_ID in use. */
+    size_t vMoovSize = 0, vMoovHdr = 0;
+    const size_t vMoov = findBox(video, 0, video.size(), "moov", vMoovSize, vMoovHdr);
+    if(vMoov == string::npos)
+        return false;
+    const size_t vMoovEnd = vMoov + vMoovSize;
+    size_t vMvhdSize = 0, vMvhdHdr = 0;
+    const size_t vMvhd = findBox(video, vMoov + vMoovHdr, vMoovEnd, "mvhd", vMvhdSize, vMvhdHdr);
+    size_t vMvexSize = 0, vMvexHdr = 0;
+    const size_t vMvex = findBox(video, vMoov + vMoovHdr, vMoovEnd, "mvex", vMvexSize, vMvexHdr);
+    if(vMvhd == string::npos || vMvex == string::npos || vMvhdSize < vMvhdHdr + 4)
+        return false;
+    uint32_t maxTrackId = 0;
+    uint32_t type = 0;
+    for(size_t at = vMoov + vMoovHdr; readBox(video, at, vMoovEnd, type, size, hdr); at += size) {
+        const size_t trackId = (type == fourcc("trak")) ? findTrackId(video, at, size, hdr) : string::npos;
+        if(trackId != string::npos)
+            maxTrackId = std::max<uint32_t>(maxTrackId, get32(video, trackId));
+    }
+    const uint32_t nextTrackId = get32(video, vMvhd + vMvhdSize - 4);
+
+    /* Audio: its (first) trak and the trex for it. */
+    size_t aMoovSize = 0, aMoovHdr = 0;
+    const size_t aMoov = findBox(audio, 0, audio.size(), "moov", aMoovSize, aMoovHdr);
+    if(aMoov == string::npos)
+        return false;
+    const size_t aMoovEnd = aMoov + aMoovSize;
+    size_t aMvhdSize = 0, aMvhdHdr = 0;
+    const size_t aMvhd = findBox(audio, aMoov + aMoovHdr, aMoovEnd, "mvhd", aMvhdSize, aMvhdHdr);
+    size_t aTrakSize = 0, aTrakHdr = 0;
+    const size_t aTrak = findBox(audio, aMoov + aMoovHdr, aMoovEnd, "trak", aTrakSize, aTrakHdr);
+    size_t aMvexSize = 0, aMvexHdr = 0;
+    const size_t aMvex = findBox(audio, aMoov + aMoovHdr, aMoovEnd, "mvex", aMvexSize, aMvexHdr);
+    if(aMvhd == string::npos || aTrak == string::npos || aMvex == string::npos || findTrackId(audio, aTrak, aTrakSize, aTrakHdr) == string::npos)
+        return false;
+    const uint32_t oldTrackId = get32(audio, findTrackId(audio, aTrak, aTrakSize, aTrakHdr));
+    size_t aTrex = string::npos;
+    size_t aTrexSize = 0, aTrexHdr = 0;
+    for(size_t at = aMvex + aMvexHdr; readBox(audio, at, aMvex + aMvexSize, type, size, hdr); at += size) {
+        if(type == fourcc("trex") && size >= hdr + 8 && get32(audio, at + hdr + 4) == oldTrackId) {
+            aTrex = at;
+            aTrexSize = size;
+            aTrexHdr = hdr;
+            break;
+        }
+    }
+    if(aTrex == string::npos)
+        return false;
+
+    /* A track_ID the video does not use. */
+    audioTrackId = maxTrackId + 1;
+    if(nextTrackId != 0 && nextTrackId != 0xFFFFFFFF)
+        audioTrackId = std::max(audioTrackId, nextTrackId);
+
+    /* Audio trak and trex with the new track_ID. Durations in the video's movie timescale. */
+    string trak = audio.substr(aTrak, aTrakSize);
+    set32(trak, findTrackId(trak, 0, aTrakSize, aTrakHdr), audioTrackId);
+    const uint32_t vTimescale = getTimescale(video, vMvhd, vMvhdSize, vMvhdHdr);
+    const uint32_t aTimescale = getTimescale(audio, aMvhd, aMvhdSize, aMvhdHdr);
+    if(vTimescale != 0 && aTimescale != 0 && vTimescale != aTimescale)
+        rescaleTrak(trak, aTrakHdr, aTimescale, vTimescale);
+    string trex = audio.substr(aTrex, aTrexSize);
+    set32(trex, aTrexHdr + 4, audioTrackId);
+
+    /* New moov: the video's children with the next track_ID updated, the audio trak, the video's mvex with the audio trex. */
+    string moov(4, '\0');
+    moov.append("moov", 4);
+    for(size_t at = vMoov + vMoovHdr; readBox(video, at, vMoovEnd, type, size, hdr); at += size) {
+        if(type == fourcc("mvex"))
+            continue;
+        moov.append(video, at, size);
+        if(type == fourcc("mvhd"))
+            set32(moov, moov.size() - 4, audioTrackId + 1);
+    }
+    moov.append(trak);
+    string mvex(video, vMvex, vMvexSize);
+    mvex.append(trex);
+    if(vMvexHdr == 16)
+        set64(mvex, 8, mvex.size());
+    else
+        set32(mvex, 0, mvex.size());
+    moov.append(mvex);
+    set32(moov, 0, moov.size());
+
+    out.assign(video, 0, vMoov);
+    out.append(moov);
+    out.append(video, vMoovEnd, string::npos);
+    return true;
+}
+
+} /* namespace dashp2p */
@@ -0,0 +1,127 @@
+/****************************************************************************
+ * TrackMuxer.h                                                             *
+ ****************************************************************************
+ * Copyright (C) 2026                                                       *
+ *                                                                          *
+ * Created on: Oct 19, 2026                                                 *
+ * Authors: agent <agent@local>                                             *
+ *                                                                          *
+ * This program is free software: you can redistribute it and/or modify     *
+ * it under the terms of the GNU General Public License as published by     *
+ * the Free Software Foundation, either version 3 of the License, or        *
+ * (at your option) any later version.                                      *
+ *                                                                          *
+ * This program is distributed in the hope that it will be useful,          *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ * GNU General Public License for more details.                             *
+ *                                                                          *
+ * You should have received a copy of the GNU General Public License        *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.     *
+ ****************************************************************************/
+
+#ifndef TRACKMUXER_H_
+#define TRACKMUXER_H_
+
+#include "ContentId.h"
+
+#include <map>
+#include <mutex>
+#include <string>
+using std::string;
+
+namespace dashp2p {
+
+/**
+ * Sets the track_ID of all track fragment headers (moof/traf/tfhd) of a fragmented MP4 stream that passes through
+ * in arbitrary pieces. Used per request, the stream being one segment.
+ */
+class TrackIdRewriter
+{
+public:
+    TrackIdRewriter(): trackId(0), pos(0), nextBox(0), hdrLen(0), patchAt(-1) {}
+    void setTrackId(uint32_t trackId) {this->trackId = trackId;}
+    uint32_t getTrackId() const {return trackId;}
+    /* Rewrites the next n bytes of the stream in place. Nothing is done while the track_ID is 0. */
+    void process(char* p, int n);
+
+private:
+    uint32_t trackId;
+    int64_t pos;              // stream offset of the next byte
+    int64_t nextBox;          // stream offset of the next box header, -1 if there is none (damaged, or the last box extends to the end)
+    unsigned char hdr[16];    // box header received so far
+    int hdrLen;
+    int64_t patchAt;          // stream offset of the track_ID in the last tfhd, -1 if none
+};
+
+/**
+ * Separate audio, muxed into the video stream given to VLC. An access module delivers a single byte stream, so the audio
+ * of a second adaptation set cannot be given to VLC as an elementary stream of its own. Instead, both tracks form one
+ * fragmented MP4 stream: the video initialization segment is replaced by one describing both tracks (the audio trak and
+ * trex appended to the video moov, with a track_ID the video does not use), and the audio segments, which follow the
+ * video segments they are played with (see Contour), get the same track_ID in their track fragments.
+ *
+ * The payload of segment downloads passes through addData() before it goes to the storage. Each period is muxed on its own,
+ * with the adaptation sets given to init(). Thread-safe.
+ */
+class TrackMuxer
+{
+public:
+    /* Muxes the given adaptation sets of the period. Nothing is done if the period is known already. */
+    static void init(int periodIndex, int videoAdaptationSetIndex, int audioAdaptationSetIndex);
+    static void cleanup();
+    static bool enabled() {return ifEnabled;}
+    /* If segId is of the audio, respectively, is the video initialization segment the audio is joined into. */
+    static bool isAudio(const ContentIdSegment& segId);
+    static bool isJointInit(const ContentIdSegment& segId);
+
+    /**
+     * Payload bytes [byteFrom, byteFrom + numBytes) of contentId, which is contentLength bytes long (-1 if not known yet).
+     * Returns false if the data shall go to the storage as they are. Otherwise, the muxer took care of them: the video
+     * initialization segment is held back until the audio one is complete as well, then the joint one is stored in its place;
+     * the track fragments of audio segments are renumbered, rewriter being the state of the request.
+     */
+    static bool addData(const ContentId& contentId, int64_t byteFrom, const char* p, int numBytes, int64_t contentLength, TrackIdRewriter& rewriter);
+    /* A chunked response of contentId is complete, with size bytes. Returns true if the muxer took care of it (see addData()). */
+    static bool complete(const ContentId& contentId, int64_t size);
+
+    /**
+     * Joins the video and the audio initialization segment: out is video with the audio track added to its moov.
+     * Sets audioTrackId to the track_ID the audio got. Returns false if they are not fragmented MP4 as expected.
+     */
+    static bool join(const string& video, const string& audio, string& out, uint32_t& audioTrackId);
+
+private:
+    TrackMuxer(){}
+    virtual ~TrackMuxer(){}
+
+    /* State of a period. */
+    class Period {
+    public:
+        Period(int videoAdaptationSetIndex, int audioAdaptationSetIndex)
+          : videoAdaptationSetIndex(videoAdaptationSetIndex), audioAdaptationSetIndex(audioAdaptationSetIndex), videoInitId(-1, -1, -1, -1),
+            videoInit(), audioInit(), videoInitSize(-1), audioInitSize(-1), joined(false), audioTrackId(0) {}
+        int videoAdaptationSetIndex;
+        int audioAdaptationSetIndex;
+        ContentIdSegment videoInitId;   // invalid until the video initialization segment starts arriving
+        string videoInit;
+        string audioInit;
+        int64_t videoInitSize;          // -1 while not known
+        int64_t audioInitSize;
+        bool joined;
+        uint32_t audioTrackId;          // 0 while not known (audio fragments are not renumbered)
+    };
+
+    /* Called with the lock held. Stores the joint initialization segment once both are complete. */
+    static void tryJoin(Period& period);
+    /* Called with the lock held. NULL if the period is not muxed. */
+    static Period* find(int periodIndex);
+
+private:
+    static bool ifEnabled;
+    static std::mutex _mutex;
+    static std::map<int, Period> periods;
+};
+
+} /* namespace dashp2p */
+#endif /* TRACKMUXER_H_ */
@@ -27,7 +27,7 @@
 
 
 #include "XmlAdapter.h"
-#include "xml/VLCDocumentAdapter.h"
+#include "xml/XmlParser.h"
 #include "mpd/ModelReader.h"
 
 namespace dashp2p {
@@ -37,9 +37,7 @@ namespace dashp2p {
 mpd::MediaPresentationDescription* XmlAdapter::parseMpd(char* buffer, int bufferSize)
 {
 
-	//dp2p_assert(dashp2pPluginObject);
-    //xml::VLCDocumentAdapterFactory* documentFactory = new xml::VLCDocumentAdapterFactory(dashp2pPluginObject);
-	xml::VLCDocumentAdapterFactory* documentFactory = new xml::VLCDocumentAdapterFactory();
+	xml::XmlDocumentFactory* documentFactory = new xml::XmlDocumentFactory();
 
     /* the parser will work on a copy of the string and delete it afterwards */
     xml::BasicDocument* document= documentFactory->createDocument(buffer, bufferSize);
@@ -54,4 +52,44 @@ mpd::MediaPresentationDescription* XmlAdapter::parseMpd(char* buffer, int buffer
     return mpd;
 }
 
+mpd::MediaPresentationDescription* XmlAdapter::replayMpd(const char* events, size_t size)
+{
+    mpd::ModelReader modelReader(mpd::ModelFactory::DEFAULT_FACTORY);
+    return modelReader.replay(events, size);
+}
+
+MpdPushParser::MpdPushParser()
+  : modelReader(new mpd::ModelReader(mpd::ModelFactory::DEFAULT_FACTORY)),
+    document(nullptr)
+{
+    document = new xml::XmlParser(modelReader->getHandler());
+}
+
+MpdPushParser::~MpdPushParser()
+{
+    delete document;
+    delete modelReader;
+}
+
+bool MpdPushParser::feed(const char* p, int size, bool last)
+{
+    dp2p_assert(size >= 0);
+    return document->feed(p, (size_t)size, last);
+}
+
+bool MpdPushParser::hasFirstAdaptationSet() const
+{
+    return modelReader->hasFirstAdaptationSet();
+}
+
+mpd::MediaPresentationDescription* MpdPushParser::release()
+{
+    return modelReader->release();
+}
+
+void MpdPushParser::setRecorder(std::string* events)
+{
+    modelReader->setRecorder(events);
+}
+
 }
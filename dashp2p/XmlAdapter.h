@@ -25,9 +25,13 @@
 
 #include "mpd/model.h"
 #include <vlc_common.h>
+#include <string>
 
 namespace dashp2p {
 
+namespace mpd {class ModelReader;}
+namespace xml {class XmlParser;}
+
 class XmlAdapter
 {
 public:
@@ -40,6 +44,12 @@ public:
      */
     static mpd::MediaPresentationDescription* parseMpd(char* buffer, int bufferSize);
 
+    /**
+     * Builds the model from parser events recorded by MpdPushParser::setRecorder(), without the XML.
+     * Returns NULL if the record is malformed.
+     */
+    static mpd::MediaPresentationDescription* replayMpd(const char* events, size_t size);
+
 private:
     XmlAdapter(){}
     virtual ~XmlAdapter(){}
@@ -48,6 +58,32 @@ private:
     //static vlc_object_t* dashp2pPluginObject;
 };
 
+/**
+ * Incremental MPD parsing. The MPD is fed in chunks as it is received and the model is built as far as the data go.
+ */
+class MpdPushParser
+{
+public:
+    MpdPushParser();
+    virtual ~MpdPushParser();
+
+    /* Returns false if the MPD is not well-formed. Set last with the final chunk. */
+    bool feed(const char* p, int size, bool last);
+
+    /* True once the first adaptation set of the first period is complete. */
+    bool hasFirstAdaptationSet() const;
+
+    /* Hands over the model read so far. Chunks fed later are still added to it. */
+    mpd::MediaPresentationDescription* release();
+
+    /* Records the parser events to events (see XmlAdapter::replayMpd()) from now on. */
+    void setRecorder(std::string* events);
+
+private:
+    mpd::ModelReader* modelReader;
+    xml::XmlParser* document;
+};
+
 }
 
 #endif /* XMLADAPTER_H_ */
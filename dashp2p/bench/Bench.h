@@ -0,0 +1,79 @@
+/****************************************************************************
+ * Bench.h                                                                  *
+ ****************************************************************************
+ * Copyright (C) 2026                                                       *
+ *                                                                          *
+ * Created on: Oct 19, 2026                                                 *
+ * Authors: agent <agent@local>                                             *
+ *                                                                          *
+ * This program is free software: you can redistribute it and/or modify     *
+ * it under the terms of the GNU General Public License as published by     *
+ * the Free Software Foundation, either version 3 of the License, or        *
+ * (at your option) any later version.                                      *
+ *                                                                          *
+ * This program is distributed in the hope that it will be useful,          *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ * GNU General Public License for more details.                             *
+ *                                                                          *
+ * You should have received a copy of the GNU General Public License        *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.     *
+ ****************************************************************************/
+
+#ifndef BENCH_H_
+#define BENCH_H_
+
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+namespace dashp2p {
+
+/* Helpers shared by the benchmarks in this directory ("make bench" in the plugin directory). */
+class Bench
+{
+public:
+    /* Monotonic time [ns]. */
+    static int64_t now() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    /* Prints mean, median, 99th percentile and maximum of the samples [ns], sorting them. */
+    static void printLatency(const char* name, std::vector<int64_t>& samples) {
+        if(samples.empty()) {
+            printf("%-24s no samples\n", name);
+            return;
+        }
+        std::sort(samples.begin(), samples.end());
+        double sum = 0;
+        for(size_t i = 0; i < samples.size(); ++i)
+            sum += samples[i];
+        printf("%-24s n = %8zu  mean = %9.1f ns  p50 = %9" PRId64 " ns  p99 = %9" PRId64 " ns  max = %9" PRId64 " ns\n", name,
+                samples.size(), sum / samples.size(), samples[samples.size() / 2], samples[samples.size() * 99 / 100], samples.back());
+    }
+
+    /* Runs f() repeatedly for about minNs and returns the average time per call [ns]. */
+    template<typename F>
+    static double timePerCall(F f, int64_t minNs = 200000000) {
+        int64_t n = 0;
+        const int64_t start = now();
+        int64_t elapsed = 0;
+        do {
+            for(int i = 0; i < 1000; ++i)
+                f();
+            n += 1000;
+            elapsed = now() - start;
+        } while(elapsed < minNs);
+        return (double)elapsed / n;
+    }
+
+private:
+    Bench(){}
+};
+
+}
+
+#endif /* BENCH_H_ */
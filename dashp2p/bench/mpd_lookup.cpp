@@ -0,0 +1,130 @@
+/****************************************************************************
+ * mpd_lookup.cpp                                                           *
+ ****************************************************************************
+ * Copyright (C) 2026                                                       *
+ *                                                                          *
+ * Created on: Oct 19, 2026                                                 *
+ * Authors: agent <agent@local>                                             *
+ *                                                                          *
+ * This program is free software: you can redistribute it and/or modify     *
+ * it under the terms of the GNU General Public License as published by     *
+ * the Free Software Foundation, either version 3 of the License, or        *
+ * (at your option) any later version.                                      *
+ *                                                                          *
+ * This program is distributed in the hope that it will be useful,          *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ * GNU General Public License for more details.                             *
+ *                                                                          *
+ * You should have received a copy of the GNU General Public License        *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.     *
+ ****************************************************************************/
+
+/* The per-segment MpdWrapper look-ups of the control logic and of Control::vlcCb(): durations, positions, the next
+ * segment, URLs and time to segment, for random segments of a generated SegmentList MPD.
+ *
+ * Usage: mpd_lookup [representations [segments per representation]] (default: 4 25000) */
+
+#include "Bench.h"
+#include "DebugAdapter.h"
+#include "MpdWrapper.h"
+#include "SegmentStorage.h"
+
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace dashp2p;
+using std::string;
+using std::vector;
+
+static const int numQueries = 200000;
+
+static string generateMpd(int representations, int segments)
+{
+    string s;
+    char line[256];
+    s += "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n";
+    snprintf(line, sizeof(line), "<MPD xmlns=\"urn:mpeg:DASH:schema:MPD:2011\" type=\"static\" mediaPresentationDuration=\"PT%dS\" "
+            "minBufferTime=\"PT2S\" profiles=\"urn:mpeg:dash:profile:isoff-main:2011\">\n", 2 * segments);
+    s += line;
+    s += "<BaseURL>http://example.com/video/</BaseURL>\n<Period start=\"PT0S\">\n<AdaptationSet segmentAlignment=\"true\">\n";
+    for(int r = 0; r < representations; ++r) {
+        snprintf(line, sizeof(line), "<Representation id=\"r%d\" mimeType=\"video/mp4\" codecs=\"avc1\" width=\"%d\" height=\"360\" "
+                "startWithSAP=\"1\" bandwidth=\"%d\">\n<SegmentList duration=\"2\">\n<Initialization sourceURL=\"r%d/init.mp4\"/>\n",
+                r, 640 + r, 100000 * (r + 1), r);
+        s += line;
+        for(int i = 0; i < segments; ++i) {
+            snprintf(line, sizeof(line), "<SegmentURL media=\"r%d/seg_%d.m4s\"/>\n", r, i);
+            s += line;
+        }
+        s += "</SegmentList>\n</Representation>\n";
+    }
+    s += "</AdaptationSet>\n</Period>\n</MPD>\n";
+    return s;
+}
+
+int main(int argc, char** argv)
+{
+    const int representations = (argc > 1) ? atoi(argv[1]) : 4;
+    const int segments = (argc > 2) ? atoi(argv[2]) : 25000;
+
+    DebugAdapter::init(DebuggingLevel_Quiet, NULL);
+    SegmentStorage::init();
+
+    const string mpd = generateMpd(representations, segments);
+    SegmentStorage::initSegment(ContentIdMpd(), mpd.size());
+    SegmentStorage::addData(ContentIdMpd(), 0, mpd.size() - 1, mpd.data(), false);
+    MpdWrapper::parse(ContentIdMpd());
+    if(MpdWrapper::parsing())
+        abort();
+
+    printf("%d representations x %d segments, %d random queries\n", representations, segments, numQueries);
+
+    /* Media segments only: the last one is excluded, since there is no next one. */
+    std::mt19937 rng(1);
+    vector<ContentIdSegment> segIds;
+    vector<int64_t> times;
+    for(int i = 0; i < numQueries; ++i) {
+        segIds.push_back(ContentIdSegment(0, 0, 100000 * (1 + rng() % representations), 1 + rng() % (segments - 1)));
+        times.push_back(rng() % ((int64_t)2000000 * segments));
+    }
+
+    size_t k = 0;
+    int64_t sum = 0;
+    string url;
+
+    printf("getSegmentDuration()     %8.1f ns/call\n", Bench::timePerCall([&]() {
+        sum += MpdWrapper::getSegmentDuration(segIds[k]);
+        k = (k + 1) % segIds.size();
+    }));
+    printf("getPosition()            %8.1f ns/call\n", Bench::timePerCall([&]() {
+        sum += MpdWrapper::getPosition(segIds[k], 1000, 100000);
+        k = (k + 1) % segIds.size();
+    }));
+    printf("getEndTime()             %8.1f ns/call\n", Bench::timePerCall([&]() {
+        sum += MpdWrapper::getEndTime(segIds[k]);
+        k = (k + 1) % segIds.size();
+    }));
+    printf("getNextSegment()         %8.1f ns/call\n", Bench::timePerCall([&]() {
+        sum += MpdWrapper::getNextSegment(segIds[k]).segmentIndex();
+        k = (k + 1) % segIds.size();
+    }));
+    printf("getSegmentURL()          %8.1f ns/call\n", Bench::timePerCall([&]() {
+        sum += MpdWrapper::getSegmentURL(segIds[k]).size();
+        k = (k + 1) % segIds.size();
+    }));
+    printf("findSegment()            %8.1f ns/call\n", Bench::timePerCall([&]() {
+        sum += MpdWrapper::findSegment(segIds[k], times[k]);
+        k = (k + 1) % segIds.size();
+    }));
+
+    /* Keeps the calls from being optimized away. */
+    if(sum == 0)
+        printf("\n");
+
+    MpdWrapper::cleanup();
+    SegmentStorage::cleanup();
+    return 0;
+}
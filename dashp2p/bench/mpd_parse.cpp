@@ -0,0 +1,156 @@
+/****************************************************************************
+ * mpd_parse.cpp                                                            *
+ ****************************************************************************
+ * Copyright (C) 2026                                                       *
+ *                                                                          *
+ * Created on: Oct 19, 2026                                                 *
+ * Authors: agent <agent@local>                                             *
+ *                                                                          *
+ * This program is free software: you can redistribute it and/or modify     *
+ * it under the terms of the GNU General Public License as published by     *
+ * the Free Software Foundation, either version 3 of the License, or        *
+ * (at your option) any later version.                                      *
+ *                                                                          *
+ * This program is distributed in the hope that it will be useful,          *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ * GNU General Public License for more details.                             *
+ *                                                                          *
+ * You should have received a copy of the GNU General Public License        *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.     *
+ ****************************************************************************/
+
+/* MPD parsing: the XML parser alone (with a handler that does nothing), the complete MPD in one piece
+ * (XmlAdapter::parseMpd()) and in chunks as it is received (MpdPushParser). The MPDs are generated: one period, one
+ * adaptation set, 4 representations with a SegmentList each, the given numbers of segments in total.
+ * Prints the best of several runs.
+ *
+ * Usage: mpd_parse [segments ...] (default: 10000 100000) */
+
+#include "Bench.h"
+#include "DebugAdapter.h"
+#include "XmlAdapter.h"
+#include "xml/XmlParser.h"
+
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+using namespace dashp2p;
+using std::string;
+using std::vector;
+
+static const int representations = 4;
+static const int chunkSize = 16384;    // [byte], fed to MpdPushParser at a time
+static const int runs = 20;
+
+static string generateMpd(int segments)
+{
+    string s;
+    char line[256];
+    s += "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n";
+    snprintf(line, sizeof(line), "<MPD xmlns=\"urn:mpeg:DASH:schema:MPD:2011\" type=\"static\" mediaPresentationDuration=\"PT%dS\" "
+            "minBufferTime=\"PT2S\" profiles=\"urn:mpeg:dash:profile:isoff-main:2011\">\n", 2 * segments / representations);
+    s += line;
+    s += "<BaseURL>http://example.com/a&amp;b/</BaseURL>\n<Period start=\"PT0S\">\n<AdaptationSet segmentAlignment=\"true\">\n";
+    for(int r = 0; r < representations; ++r) {
+        snprintf(line, sizeof(line), "<Representation id=\"r%d\" mimeType=\"video/mp4\" codecs=\"avc1\" width=\"%d\" height=\"360\" "
+                "startWithSAP=\"1\" bandwidth=\"%d\">\n<SegmentList duration=\"2\">\n<Initialization sourceURL=\"r%d/init.mp4\"/>\n",
+                r, 640 + r, 100000 * (r + 1), r);
+        s += line;
+        for(int i = 0; i < segments / representations; ++i) {
+            snprintf(line, sizeof(line), "<SegmentURL media=\"r%d/seg_%d.m4s\"/>\n", r, i);
+            s += line;
+        }
+        s += "</SegmentList>\n</Representation>\n";
+    }
+    s += "</AdaptationSet>\n</Period>\n</MPD>\n";
+    return s;
+}
+
+class NullHandler: public xml::BasicDocumentHandler
+{
+public:
+    virtual void onDocumentStart() {}
+    virtual void onAttribute(const xml::StrRef&, const xml::StrRef&) {++n;}
+    virtual void onElementStart(const xml::StrRef&) {++n;}
+    virtual void onElementValue(const xml::StrRef&) {++n;}
+    virtual void onElementEnd(const xml::StrRef&) {++n;}
+    virtual void onDocumentEnd() {}
+    int64_t n = 0;
+};
+
+/* Best time of runs calls of f() [ms]. prepare() is called before each, outside of the measurement. */
+template<typename P, typename F>
+static double best(P prepare, F f)
+{
+    int64_t t = INT64_MAX;
+    for(int i = 0; i < runs; ++i) {
+        prepare();
+        const int64_t start = Bench::now();
+        f();
+        t = std::min(t, Bench::now() - start);
+    }
+    return t / 1e6;
+}
+
+template<typename F>
+static double best(F f)
+{
+    return best([]() {}, f);
+}
+
+static void print(const char* name, double ms, size_t bytes)
+{
+    printf("  %-22s %8.2f ms  %7.1f MB/s\n", name, ms, bytes / ms / 1e3);
+}
+
+int main(int argc, char** argv)
+{
+    DebugAdapter::init(DebuggingLevel_Quiet, NULL);
+
+    vector<int> sizes;
+    for(int i = 1; i < argc; ++i)
+        sizes.push_back(atoi(argv[i]));
+    if(sizes.empty()) {
+        sizes.push_back(10000);
+        sizes.push_back(100000);
+    }
+
+    for(size_t k = 0; k < sizes.size(); ++k)
+    {
+        const string mpd = generateMpd(sizes[k]);
+        printf("%d segments, %zu bytes\n", sizes[k], mpd.size());
+
+        print("XmlParser", best([&]() {
+            NullHandler handler;
+            xml::XmlParser parser(handler);
+            if(!parser.feed(mpd.data(), mpd.size(), true))
+                abort();
+        }), mpd.size());
+
+        /* parseMpd() takes over the buffer. */
+        char* buffer = NULL;
+        print("XmlAdapter::parseMpd", best([&]() {
+            buffer = new char[mpd.size()];
+            memcpy(buffer, mpd.data(), mpd.size());
+        }, [&]() {
+            mpd::MediaPresentationDescription* m = XmlAdapter::parseMpd(buffer, mpd.size());
+            if(m == NULL)
+                abort();
+            delete m;
+        }), mpd.size());
+
+        print("MpdPushParser", best([&]() {
+            MpdPushParser parser;
+            for(size_t pos = 0; pos < mpd.size(); pos += chunkSize) {
+                const size_t n = std::min((size_t)chunkSize, mpd.size() - pos);
+                if(!parser.feed(mpd.data() + pos, n, pos + n == mpd.size()))
+                    abort();
+            }
+            delete parser.release();
+        }), mpd.size());
+    }
+
+    return 0;
+}
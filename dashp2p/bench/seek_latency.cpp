@@ -0,0 +1,278 @@
+/****************************************************************************
+ * seek_latency.cpp                                                         *
+ ****************************************************************************
+ * Copyright (C) 2026                                                       *
+ *                                                                          *
+ * Created on: Oct 19, 2026                                                 *
+ * Authors: agent <agent@local>                                             *
+ *                                                                          *
+ * This program is free software: you can redistribute it and/or modify     *
+ * it under the terms of the GNU General Public License as published by     *
+ * the Free Software Foundation, either version 3 of the License, or        *
+ * (at your option) any later version.                                      *
+ *                                                                          *
+ * This program is distributed in the hope that it will be useful,          *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ * GNU General Public License for more details.                             *
+ *                                                                          *
+ * You should have received a copy of the GNU General Public License        *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.     *
+ ****************************************************************************/
+
+/* Seek-to-first-data latency: plays a synthetic presentation from a built-in HTTP server on the loopback interface through
+ * Control, the way VLC drives the plugin (read at playback rate, pf_seek between reads), and measures the time from
+ * Control::seek() to the first data returned by Control::vlcCb(). Backward seeks stay within the stored data, forward seeks
+ * beyond it need new downloads.
+ *
+ * The server has to listen on port 80, since SourceManager connects there (root or CAP_NET_BIND_SERVICE).
+ *
+ * Usage: seek_latency [seeks [link rate, Mbit/s]] */
+
+#include "Bench.h"
+#include "Control.h"
+#include "DebugAdapter.h"
+#include "HttpClientManager.h"
+#include "MpdWrapper.h"
+#include "SegmentStorage.h"
+#include "SourceManager.h"
+#include "Statistics.h"
+#include "TcpConnectionManager.h"
+#include "Utilities.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+
+using namespace dashp2p;
+using std::string;
+
+static const int bitRates[] = {500000, 1000000, 2000000};
+static const int numSegments = 150;
+static const int segmentDuration = 2;                   // [s]
+static const int initSize = 1024;                       // [byte]
+
+static int64_t linkRate = 20000000;                     // [bit/s], per connection
+static std::atomic<bool> stop(false);
+
+static string getMpd()
+{
+    char buf[2048];
+    sprintf(buf, "<?xml version=\"1.0\"?>\n"
+            "<MPD xmlns=\"urn:mpeg:dash:schema:mpd:2011\" type=\"static\" mediaPresentationDuration=\"PT%dS\" minBufferTime=\"PT2S\" "
+            "profiles=\"urn:mpeg:dash:profile:isoff-live:2011\">\n"
+            " <BaseURL>http://127.0.0.1/</BaseURL>\n"
+            " <Period>\n"
+            "  <AdaptationSet mimeType=\"video/mp4\" width=\"640\" height=\"360\">\n"
+            "   <SegmentTemplate timescale=\"1\" duration=\"%d\" startNumber=\"1\" media=\"seg_$Bandwidth$_$Number$.m4s\" initialization=\"init_$Bandwidth$.mp4\"/>\n",
+            numSegments * segmentDuration, segmentDuration);
+    string mpd = buf;
+    for(size_t i = 0; i < sizeof(bitRates) / sizeof(bitRates[0]); ++i) {
+        sprintf(buf, "   <Representation id=\"r%zu\" bandwidth=\"%d\"/>\n", i, bitRates[i]);
+        mpd.append(buf);
+    }
+    mpd.append("  </AdaptationSet>\n </Period>\n</MPD>\n");
+    return mpd;
+}
+
+/* Size of the object at path, -1 if there is none. */
+static int64_t getObjectSize(const string& path)
+{
+    int bitRate = 0;
+    int segNr = 0;
+    if(path == "/bench.mpd")
+        return getMpd().size();
+    if(1 == sscanf(path.c_str(), "/init_%d.mp4", &bitRate))
+        return initSize;
+    if(2 == sscanf(path.c_str(), "/seg_%d_%d.m4s", &bitRate, &segNr) && segNr >= 1 && segNr <= numSegments)
+        return (int64_t)bitRate * segmentDuration / 8;
+    return -1;
+}
+
+/* Sends [from, to] of the object at path, paced to linkRate. Returns false if the connection is gone. */
+static bool sendObject(int fd, const string& path, int64_t from, int64_t to)
+{
+    const string mpd = (path == "/bench.mpd") ? getMpd() : string();
+    char buf[16384];
+    const int64_t start = Bench::now();
+    for(int64_t pos = from; pos <= to; )
+    {
+        const int n = std::min<int64_t>(sizeof(buf), to - pos + 1);
+        if(!mpd.empty())
+            memcpy(buf, mpd.data() + pos, n);
+        else
+            memset(buf, 'x', n);
+        if(n != send(fd, buf, n, MSG_NOSIGNAL))
+            return false;
+        pos += n;
+        const int64_t ahead = start + (pos - from) * 8000000000LL / linkRate - Bench::now();
+        if(ahead > 0)
+            std::this_thread::sleep_for(std::chrono::nanoseconds(ahead));
+    }
+    return true;
+}
+
+/* Serves the requests of one persistent connection, pipelined or not. */
+static void serveConnection(int fd)
+{
+    string in;
+    char buf[4096];
+    while(!stop.load())
+    {
+        const size_t end = in.find("\r\n\r\n");
+        if(end == string::npos) {
+            const ssize_t n = recv(fd, buf, sizeof(buf), 0);
+            if(n <= 0)
+                break;
+            in.append(buf, n);
+            continue;
+        }
+        const string request = in.substr(0, end + 4);
+        in.erase(0, end + 4);
+
+        char method[16] = "";
+        char _path[1024] = "";
+        if(2 != sscanf(request.c_str(), "%15s %1023s", method, _path))
+            break;
+        /* The plugin requests files at the root as "//file". */
+        string path = _path;
+        while(path.compare(0, 2, "//") == 0)
+            path.erase(0, 1);
+        const int64_t size = getObjectSize(path);
+        int64_t from = 0;
+        int64_t to = size - 1;
+        const size_t range = request.find("Range: bytes=");
+        const bool partial = (range != string::npos && size >= 0);
+        if(partial && 2 != sscanf(request.c_str() + range, "Range: bytes=%" SCNd64 "-%" SCNd64, &from, &to))
+            to = size - 1;
+        to = std::min(to, size - 1);
+
+        char hdr[512];
+        if(size < 0)
+            sprintf(hdr, "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+        else if(partial)
+            sprintf(hdr, "HTTP/1.1 206 Partial Content\r\nContent-Length: %" PRId64 "\r\nContent-Range: bytes %" PRId64 "-%" PRId64 "/%" PRId64 "\r\n"
+                    "Connection: Keep-Alive\r\nKeep-Alive: timeout=60, max=10000\r\n\r\n", to - from + 1, from, to, size);
+        else
+            sprintf(hdr, "HTTP/1.1 200 OK\r\nContent-Length: %" PRId64 "\r\nConnection: Keep-Alive\r\nKeep-Alive: timeout=60, max=10000\r\n\r\n", size);
+        if((ssize_t)strlen(hdr) != send(fd, hdr, strlen(hdr), MSG_NOSIGNAL) || size < 0)
+            break;
+        if(0 != strcmp(method, "HEAD") && !sendObject(fd, path, from, to))
+            break;
+    }
+    close(fd);
+}
+
+static void serve(int listenFd)
+{
+    while(!stop.load()) {
+        const int fd = accept(listenFd, NULL, NULL);
+        if(fd < 0)
+            break;
+        std::thread(serveConnection, fd).detach();
+    }
+}
+
+/* Reads like VLC's read callback. Returns the number of bytes (0: none yet) and adds their media time to *mediaTime. */
+static int play(vector<char>& buf, int64_t* mediaTime)
+{
+    char* p = &buf[0];
+    int size = buf.size();
+    int bytesReturned = 0;
+    int64_t usecReturned = 0;
+    if(0 == Control::vlcCb(&p, &size, &bytesReturned, &usecReturned)) {
+        printf("Unexpected EOF.\n");
+        exit(1);
+    }
+    mediaTime[0] += usecReturned;
+    return bytesReturned;
+}
+
+int main(int argc, char** argv)
+{
+    const int seeks = (argc > 1) ? atoi(argv[1]) : 10;
+    if(argc > 2)
+        linkRate = atoll(argv[2]) * 1000000;
+
+    const int listenFd = socket(AF_INET, SOCK_STREAM, 0);
+    const int one = 1;
+    setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(80);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if(listenFd < 0 || 0 != bind(listenFd, (struct sockaddr*)&addr, sizeof(addr)) || 0 != listen(listenFd, 16)) {
+        perror("Cannot listen on 127.0.0.1:80");
+        return 1;
+    }
+    std::thread server(serve, listenFd);
+
+    Utilities::setReferenceTime();
+    DebugAdapter::init(DebuggingLevel_Quiet, NULL);
+    Statistics::init("", false, false, false, false, false, false, false, false, false, false, false);
+    SegmentStorage::init();
+    Control::init("http://127.0.0.1/bench.mpd", 1, 1, ControlType_ST, "2:10:30:0.75:0.8:0.8:0.8:0.9:5:0");
+
+    vector<char> buf(32768);
+    int64_t mediaTime = 0;
+    const int64_t start = Bench::now();
+    vector<int64_t> latency[2];
+    const char* names[2] = {"backward (stored)", "forward (download)"};
+    int64_t streamPos = 0;
+    int64_t bitRate = bitRates[0];
+    int64_t nextSeek = start + 10000000000LL;   // 10 s of playback before the first seek
+    for(int i = 0; i < seeks; )
+    {
+        /* Consume at playback rate. */
+        const int64_t mediaTimeBefore = mediaTime;
+        int n = play(buf, &mediaTime);
+        streamPos += n;
+        if(n > 0 && mediaTime > mediaTimeBefore)
+            bitRate = n * 8000000LL / (mediaTime - mediaTimeBefore);
+        if(n == 0 || Bench::now() < nextSeek) {
+            const int64_t ahead = start + mediaTime * 1000 - Bench::now();
+            if(ahead > 0 && Bench::now() < nextSeek)
+                std::this_thread::sleep_for(std::chrono::nanoseconds(ahead));
+            continue;
+        }
+
+        /* Alternately back to the middle of what was played and a minute ahead at the current bit-rate, beyond the buffer. */
+        const bool forward = (i % 2 == 1);
+        const int64_t pos = forward ? streamPos + 60 * bitRate / 8 : streamPos / 2;
+        const int64_t t = Bench::now();
+        if(!Control::seek(pos)) {
+            nextSeek = Bench::now() + 100000000;
+            continue;
+        }
+        streamPos = pos;
+        while((n = play(buf, &mediaTime)) == 0) {}
+        latency[forward].push_back(Bench::now() - t);
+        streamPos += n;
+        ++i;
+        nextSeek = Bench::now() + 3000000000LL;
+    }
+
+    printf("%d seeks, link rate %.1f Mbit/s\n", seeks, linkRate / 1e6);
+    for(int k = 0; k < 2; ++k)
+        Bench::printLatency(names[k], latency[k]);
+
+    stop.store(true);
+    shutdown(listenFd, SHUT_RDWR);
+    close(listenFd);
+    server.join();
+    Control::cleanUp();
+    Statistics::cleanUp();
+    HttpClientManager::cleanup();
+    TcpConnectionManager::cleanup();
+    SourceManager::cleanup();
+    MpdWrapper::cleanup();
+    SegmentStorage::cleanup();
+    DebugAdapter::cleanUp();
+    return 0;
+}
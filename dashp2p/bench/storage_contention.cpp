@@ -0,0 +1,148 @@
+/****************************************************************************
+ * storage_contention.cpp                                                   *
+ ****************************************************************************
+ * Copyright (C) 2026                                                       *
+ *                                                                          *
+ * Created on: Oct 19, 2026                                                 *
+ * Authors: agent <agent@local>                                             *
+ *                                                                          *
+ * This program is free software: you can redistribute it and/or modify     *
+ * it under the terms of the GNU General Public License as published by     *
+ * the Free Software Foundation, either version 3 of the License, or        *
+ * (at your option) any later version.                                      *
+ *                                                                          *
+ * This program is distributed in the hope that it will be useful,          *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ * GNU General Public License for more details.                             *
+ *                                                                          *
+ * You should have received a copy of the GNU General Public License        *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.     *
+ ****************************************************************************/
+
+/* Contention in SegmentStorage: one writer thread per connection stores segments of its own representation in chunks,
+ * like the HTTP receive threads, while a reader consumes one representation at playback rate, like the VLC read thread.
+ * Reports the latency of the calls of both sides and how often the map mutex had to be waited for.
+ *
+ * Usage: storage_contention [connections [seconds [download rate per connection, Mbit/s]]] */
+
+#include "Bench.h"
+#include "DebugAdapter.h"
+#include "SegmentStorage.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <thread>
+
+using namespace dashp2p;
+
+static const int bitRate = 4000000;                     // playback rate of the reader [bit/s]
+static const int64_t segmentDuration = 2000000;         // [us]
+static const int segmentSize = bitRate / 8 * 2;         // [byte]
+static const int chunkSize = 16384;                     // bytes per addData()
+static const int readSize = 32768;                      // bytes per getData()
+
+static std::atomic<bool> stop(false);
+
+/* Connection i downloads the segments of representation bitRate + i. */
+static void writer(int i, int64_t rate, vector<int64_t>* latency)
+{
+    vector<char> chunk(chunkSize, (char)i);
+    const int64_t start = Bench::now();
+    int64_t bytes = 0;
+    for(int segNr = 1; !stop.load(); ++segNr)
+    {
+        const ContentIdSegment segId(0, 0, bitRate + i, segNr);
+        SegmentStorage::initSegment(segId, segmentSize, segmentDuration);
+        for(int64_t byteFrom = 0; byteFrom < segmentSize && !stop.load(); byteFrom += chunkSize)
+        {
+            const int64_t byteTo = std::min<int64_t>(byteFrom + chunkSize, segmentSize) - 1;
+            const int64_t t = Bench::now();
+            SegmentStorage::addData(segId, byteFrom, byteTo, &chunk[0], false);
+            latency->push_back(Bench::now() - t);
+            bytes += byteTo - byteFrom + 1;
+            /* Pace to the download rate. */
+            const int64_t due = start + bytes * 8000000000LL / rate;
+            const int64_t ahead = due - Bench::now();
+            if(ahead > 0)
+                std::this_thread::sleep_for(std::chrono::nanoseconds(ahead));
+        }
+    }
+}
+
+/* Plays representation bitRate, which connection 0 downloads. */
+static void reader(vector<int64_t>* latency, int64_t* bytesRead)
+{
+    Contour contour;
+    vector<char> buf(readSize);
+    StreamPosition pos(ContentIdSegment(0, 0, bitRate, 1), 0);
+    contour.setNext(pos.segId);
+    const int64_t start = Bench::now();
+    while(!stop.load())
+    {
+        const int64_t ahead = start + bytesRead[0] * 8000000000LL / bitRate - Bench::now();
+        if(ahead > 0) {
+            std::this_thread::sleep_for(std::chrono::nanoseconds(ahead));
+            continue;
+        }
+        if(!SegmentStorage::initialized(pos.segId)) {
+            std::this_thread::yield();
+            continue;
+        }
+        const int64_t t = Bench::now();
+        if(!SegmentStorage::dataAvailable(pos))
+            continue;
+        char* p = &buf[0];
+        int size = readSize;
+        int bytesReturned = 0;
+        int64_t usecReturned = 0;
+        const StreamPosition last = SegmentStorage::getData(pos, contour, &p, &size, &bytesReturned, &usecReturned);
+        latency->push_back(Bench::now() - t);
+        bytesRead[0] += bytesReturned;
+        if(last.byte == segmentSize - 1) {
+            pos = StreamPosition(ContentIdSegment(0, 0, bitRate, last.segId.segmentIndex() + 1), 0);
+            contour.setNext(pos.segId);
+        } else {
+            pos = StreamPosition(last.segId, last.byte + 1);
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const int connections = (argc > 1) ? atoi(argv[1]) : 3;
+    const int seconds = (argc > 2) ? atoi(argv[2]) : 5;
+    const int64_t rate = (argc > 3) ? atoll(argv[3]) * 1000000 : 50000000;
+
+    DebugAdapter::init(DebuggingLevel_Quiet, NULL);
+    SegmentStorage::init();
+
+    vector<vector<int64_t> > writeLatency(connections);
+    vector<int64_t> readLatency;
+    int64_t bytesRead = 0;
+    vector<std::thread> threads;
+    for(int i = 0; i < connections; ++i)
+        threads.push_back(std::thread(writer, i, rate, &writeLatency[i]));
+    threads.push_back(std::thread(reader, &readLatency, &bytesRead));
+    std::this_thread::sleep_for(std::chrono::seconds(seconds));
+    stop.store(true);
+    for(size_t i = 0; i < threads.size(); ++i)
+        threads[i].join();
+
+    uint64_t numLocks = 0, numContended = 0;
+    SegmentStorage::getLockStatistics(&numLocks, &numContended);
+
+    printf("%d writer(s) at %.1f Mbit/s, reader at %.1f Mbit/s, %d s\n", connections, rate / 1e6, bitRate / 1e6, seconds);
+    vector<int64_t> allWrites;
+    for(int i = 0; i < connections; ++i)
+        allWrites.insert(allWrites.end(), writeLatency[i].begin(), writeLatency[i].end());
+    Bench::printLatency("addData()", allWrites);
+    Bench::printLatency("dataAvailable+getData()", readLatency);
+    printf("reader: %.1f Mbit/s\n", bytesRead * 8.0 / seconds / 1e6);
+    printf("map mutex: %" PRIu64 " acquisitions, %" PRIu64 " contended (%.3f %%)\n", numLocks, numContended,
+            numLocks ? 100.0 * numContended / numLocks : 0.0);
+
+    SegmentStorage::cleanup();
+    DebugAdapter::cleanUp();
+    return 0;
+}
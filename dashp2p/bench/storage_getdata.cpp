@@ -0,0 +1,108 @@
+/****************************************************************************
+ * storage_getdata.cpp                                                      *
+ ****************************************************************************
+ * Copyright (C) 2026                                                       *
+ *                                                                          *
+ * Created on: Oct 19, 2026                                                 *
+ * Authors: agent <agent@local>                                             *
+ *                                                                          *
+ * This program is free software: you can redistribute it and/or modify     *
+ * it under the terms of the GNU General Public License as published by     *
+ * the Free Software Foundation, either version 3 of the License, or        *
+ * (at your option) any later version.                                      *
+ *                                                                          *
+ * This program is distributed in the hope that it will be useful,          *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ * GNU General Public License for more details.                             *
+ *                                                                          *
+ * You should have received a copy of the GNU General Public License        *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.     *
+ ****************************************************************************/
+
+/* The read path of SegmentStorage: dataAvailable() and getData() across segment boundaries, as Control::vlcCb() calls
+ * them, and the zero-copy getDataRef(). All data is stored beforehand, so this measures look-ups and copying only.
+ *
+ * Usage: storage_getdata [representations [segments per representation]] */
+
+#include "Bench.h"
+#include "DebugAdapter.h"
+#include "SegmentStorage.h"
+
+#include <cstdlib>
+
+using namespace dashp2p;
+
+static const int segmentSize = 65536;              // [byte], small, so that reads often cross segment boundaries
+static const int64_t segmentDuration = 2000000;    // [us]
+
+int main(int argc, char** argv)
+{
+    const int representations = (argc > 1) ? atoi(argv[1]) : 8;
+    const int segments = (argc > 2) ? atoi(argv[2]) : 1000;
+
+    DebugAdapter::init(DebuggingLevel_Quiet, NULL);
+    SegmentStorage::init();
+
+    vector<char> data(segmentSize, 'x');
+    for(int r = 0; r < representations; ++r) {
+        for(int s = 1; s <= segments; ++s) {
+            const ContentIdSegment segId(0, 0, 1000000 * (r + 1), s);
+            SegmentStorage::initSegment(segId, segmentSize, segmentDuration);
+            SegmentStorage::addData(segId, 0, segmentSize - 1, &data[0], false);
+        }
+    }
+
+    /* Play the highest representation. */
+    const int bitRate = 1000000 * representations;
+    Contour contour;
+    for(int s = 1; s <= segments; ++s)
+        contour.setNext(ContentIdSegment(0, 0, bitRate, s));
+    const StreamPosition first(ContentIdSegment(0, 0, bitRate, 1), 0);
+
+    printf("%d representations x %d segments of %d bytes\n", representations, segments, segmentSize);
+
+    StreamPosition pos = first;
+    const double tAvailable = Bench::timePerCall([&]() {
+        if(!SegmentStorage::dataAvailable(pos))
+            abort();
+        pos.segId = ContentIdSegment(0, 0, bitRate, pos.segId.segmentIndex() % segments + 1);
+    });
+    printf("dataAvailable()          %8.1f ns/call\n", tAvailable);
+
+    const int readSizes[] = {1316, 32768};
+    for(size_t i = 0; i < sizeof(readSizes) / sizeof(readSizes[0]); ++i)
+    {
+        vector<char> buf(readSizes[i]);
+        pos = first;
+        const double t = Bench::timePerCall([&]() {
+            char* p = &buf[0];
+            int size = readSizes[i];
+            int bytesReturned = 0;
+            int64_t usecReturned = 0;
+            if(!SegmentStorage::dataAvailable(pos))
+                abort();
+            const StreamPosition last = SegmentStorage::getData(pos, contour, &p, &size, &bytesReturned, &usecReturned);
+            pos = (last.byte < segmentSize - 1) ? StreamPosition(last.segId, last.byte + 1)
+                : contour.hasNext(last.segId) ? StreamPosition(contour.getNext(last.segId), 0) : first;
+        });
+        printf("getData(%5d bytes)     %8.1f ns/call, %6.2f GB/s\n", readSizes[i], t, readSizes[i] / t);
+    }
+
+    pos = first;
+    const double tRef = Bench::timePerCall([&]() {
+        DataBuffer* b = NULL;
+        const char* p = NULL;
+        int bytesReturned = 0;
+        int64_t usecReturned = 0;
+        const StreamPosition last = SegmentStorage::getDataRef(pos, 32768, &b, &p, &bytesReturned, &usecReturned);
+        b->unref();
+        pos = (last.byte < segmentSize - 1) ? StreamPosition(last.segId, last.byte + 1)
+            : contour.hasNext(last.segId) ? StreamPosition(contour.getNext(last.segId), 0) : first;
+    });
+    printf("getDataRef(32768 bytes)  %8.1f ns/call\n", tRef);
+
+    SegmentStorage::cleanup();
+    DebugAdapter::cleanUp();
+    return 0;
+}
@@ -47,6 +47,11 @@
 #include "XmlAdapter.h"
 #include "TcpConnectionManager.h"
 #include "SourceManager.h"
+#include "PeerManager.h"
+#include "MpdCache.h"
+#include "ThroughputHistory.h"
+#include "TrackMuxer.h"
+#include "DashHttp.h"
 
 #define DP2P_dashp2p_cpp
 #include "StatisticsVlc.h"
@@ -70,7 +75,7 @@ static int      Open    ( vlc_object_t * );
 static void     Close   ( vlc_object_t * );
 static int      seek    ( access_t *, uint64_t );
 static int      control ( access_t *, int i_query, va_list args );
-//static block_t* block   ( access_t *p_access );
+static block_t* block   ( access_t *p_access );
 static ssize_t  read    ( access_t* p_access, uint8_t* buffer, size_t size );
 
 /*****************************************************************************
@@ -103,7 +108,31 @@ vlc_module_begin()
     /* Adaptation related */
     add_integer_with_range("dashp2p-adaptation-strategy", 0, 0, 3, "Adaptation strategy", "Adaptation strategy", false)
     add_string("dashp2p-adaptation-config", "2:10:30:0.75:0.8:0.8:0.8:0.9:5:0", "Configuration of the selected adaptation strategy.",
-    		"Configuration of the selected adaptation strategy.", false)
+    		"Configuration of the selected adaptation strategy. ST: Bmin:Blow:Bhigh:alfa1:alfa2:alfa3:alfa4:alfa5:Delta_t:fetchHeads[:pacingFactor].", false)
+    add_bool("dashp2p-zero-copy", true, "Give data to VLC in blocks referencing the downloaded segments instead of copying them.",
+            "Give data to VLC in blocks referencing the downloaded segments instead of copying them.", true)
+    add_integer("dashp2p-progress-interval", 100, "Minimum time in [ms] between progress reports of a segment or MPD download. 0: report completed downloads only.",
+            "Minimum time in [ms] between progress reports of a segment or MPD download. 0: report completed downloads only.", true)
+    add_bool("dashp2p-fast-start", false, "Open a second connection while the MPD is downloaded and fetch the initialization and the first segment in parallel.",
+            "Open a second connection while the MPD is downloaded and fetch the initialization and the first segment in parallel.", true)
+    add_string("dashp2p-mpd-cache", "", "Directory for snapshots of parsed MPDs, used when the same MPD is played again. Empty: no caching.",
+            "Directory for snapshots of parsed MPDs, used when the same MPD is played again. Empty: no caching.", true)
+    add_string("dashp2p-throughput-history", "", "File keeping the throughput of past sessions, used to select the start bit-rate. Empty: always start at the lowest.",
+            "File keeping the throughput and RTT of past sessions by origin server and interface, used to select the start bit-rate. May be shared by several players. Empty: always start at the lowest bit-rate.", true)
+    add_integer("dashp2p-live-delay", -1, "Live streams: distance in [ms] from the live edge at which to start. -1: as suggested by the MPD.",
+            "Live streams: distance in [ms] from the live edge at which to start. -1: as suggested by the MPD, or three segments.", true)
+    add_bool("dashp2p-low-latency", false, "Live streams: request segments while they are produced (chunked transfer).",
+            "Live streams: request segments as soon as the server starts delivering them (availabilityTimeOffset, chunked transfer), not when they are complete.", true)
+    add_bool("dashp2p-separate-audio", true, "Download the audio of a separate adaptation set along with the video.",
+            "If the audio is in an adaptation set of its own, download it along with the video and mux it into the stream.", true)
+
+    /* Peer-assisted delivery */
+    add_bool("dashp2p-p2p", false, "Fetch segments from peers in the LAN if possible.", "Fetch segments from peers in the LAN if possible.", true)
+    add_string("dashp2p-p2p-tracker", "127.0.0.1:6880", "Tracker address (ip:port).", "Tracker address (ip:port).", true)
+    add_integer("dashp2p-p2p-port", 6881, "Port for serving segments to peers.", "Port for serving segments to peers.", true)
+    add_bool("dashp2p-p2p-run-tracker", false, "Run the tracker in this instance.", "Run the tracker in this instance.", true)
+    add_integer("dashp2p-p2p-margin", 4000, "Buffer level in [ms] reserved for falling back to the origin server.",
+            "Buffer level in [ms] reserved for falling back to the origin server.", true)
 
     /* Application layer handover related */
     //add_bool("dashp2p-handover", false, "Experimental: enable application-layer handover.", "Experimental: enable application-layer handover.", true)
@@ -167,10 +196,15 @@ static int Open( vlc_object_t *p_this )
     p_access->p_sys->decoderBufferSize = 1000 * decoderBufferSize; // [ms] -> [us]
     p_access->p_sys->withOverlay = false;
     p_access->pf_seek = seek;
-    p_access->pf_seek = NULL;
     p_access->pf_control = control;
-    p_access->pf_read = read;
-    p_access->pf_block = NULL; // = block;
+    /* In block mode, data are handed to VLC without copying. */
+    if(var_InheritBool(p_this, "dashp2p-zero-copy")) {
+        p_access->pf_read = NULL;
+        p_access->pf_block = block;
+    } else {
+        p_access->pf_read = read;
+        p_access->pf_block = NULL;
+    }
 
     /* Setting reference time to current system time. */
     dashp2p::Utilities::setReferenceTime();
@@ -239,6 +273,26 @@ static int Open( vlc_object_t *p_this )
 
     /* Initializing the Control module, which starts to retrieve data. */
     SegmentStorage::init();
+    if(var_InheritBool(p_this, "dashp2p-p2p")) {
+        char* pszTracker = var_InheritString(p_this, "dashp2p-p2p-tracker");
+        const string tracker = pszTracker ? pszTracker : "";
+        free(pszTracker);
+        PeerManager::init(var_InheritInteger(p_this, "dashp2p-p2p-port"), tracker, var_InheritBool(p_this, "dashp2p-p2p-run-tracker"),
+                1000 * var_InheritInteger(p_this, "dashp2p-p2p-margin")); // [ms] -> [us]
+    }
+    char* pszMpdCache = var_InheritString(p_this, "dashp2p-mpd-cache");
+    if(pszMpdCache && *pszMpdCache)
+        MpdCache::init(pszMpdCache);
+    free(pszMpdCache);
+    char* pszThroughputHistory = var_InheritString(p_this, "dashp2p-throughput-history");
+    if(pszThroughputHistory && *pszThroughputHistory)
+        ThroughputHistory::init(pszThroughputHistory);
+    free(pszThroughputHistory);
+    DashHttp::setProgressEventInterval(1000 * var_InheritInteger(p_this, "dashp2p-progress-interval")); // [ms] -> [us]
+    ControlLogic::setFastStart(var_InheritBool(p_this, "dashp2p-fast-start"));
+    ControlLogic::setLiveDelay((var_InheritInteger(p_this, "dashp2p-live-delay") < 0) ? -1 : 1000 * var_InheritInteger(p_this, "dashp2p-live-delay")); // [ms] -> [us]
+    ControlLogic::setLowLatency(var_InheritBool(p_this, "dashp2p-low-latency"));
+    ControlLogic::setSeparateAudio(var_InheritBool(p_this, "dashp2p-separate-audio"));
     const ControlType _controlType = (ControlType)controlType;
     Control::init(mpdUrl, windowWidth, windowHeight, _controlType, adaptationConfig);
 
@@ -285,6 +339,7 @@ static void Close( vlc_object_t *p_this )
 
     /* Clean-up. */
     Control::cleanUp();
+    PeerManager::cleanup();
     //XmlAdapter::cleanup();
     Statistics::cleanUp();
     if(p_sys->withOverlay)
@@ -293,6 +348,9 @@ static void Close( vlc_object_t *p_this )
     TcpConnectionManager::cleanup();
     SourceManager::cleanup();
     MpdWrapper::cleanup();
+    MpdCache::cleanup();
+    ThroughputHistory::cleanup();
+    TrackMuxer::cleanup();
     SegmentStorage::cleanup();
 
     DBGMSG("The End.");
@@ -306,8 +364,7 @@ static void Close( vlc_object_t *p_this )
     DebugAdapter::cleanUp();
 }
 
-/* TODO: implement seeking */
-static int seek( access_t * /*p_access*/, uint64_t )
+static int seek( access_t *p_access, uint64_t i_pos )
 {
     /*
      * The seeking function will be called whenever a seek is requested.
@@ -319,9 +376,13 @@ static int seek( access_t * /*p_access*/, uint64_t )
      */
     //access_sys_t* p_sys = p_access->p_sys;
 
-    DBGMSG("seek entered" );
-    dp2p_assert(0);
-    return VLC_EGENERIC;
+    DBGMSG("VLC seeks to %" PRIu64 ".", i_pos);
+    if(!Control::seek(i_pos))
+        return VLC_EGENERIC;
+
+    p_access->info.i_pos = i_pos;
+    p_access->info.b_eof = false;
+    return VLC_SUCCESS;
 }
 
 static int control( access_t* p_access, int i_query, va_list args)
@@ -336,7 +397,7 @@ static int control( access_t* p_access, int i_query, va_list args)
     {
         DBGMSG("VLC asking if ACCESS_CAN_SEEK");
         bool* pb_bool = (bool*)va_arg( args, bool* );
-        *pb_bool = false;
+        *pb_bool = true;
         return VLC_SUCCESS;
     }
 
@@ -344,6 +405,7 @@ static int control( access_t* p_access, int i_query, va_list args)
     {
         DBGMSG("VLC asking if ACCESS_CAN_FASTSEEK");
         bool* pb_bool = (bool*)va_arg( args, bool* );
+        /* Seeking beyond the stored data restarts the downloads, so the demuxer should not seek casually. */
         *pb_bool = false;
         return VLC_SUCCESS;
     }
@@ -409,50 +471,85 @@ static int control( access_t* p_access, int i_query, va_list args)
 }
 
 
-#if 0
+/* A block_t wrapping stream data held by the SegmentStorage. The data are not copied, a reference to their buffer is held instead. */
+struct DataBlock {
+    block_t block; // must be the first member
+    DataBuffer* dataBuffer;
+};
+
+static void releaseDataBlock(block_t* p_block)
+{
+    DataBlock* b = (DataBlock*)p_block;
+    b->dataBuffer->unref();
+    delete b;
+}
+
+/* Statistics on the data given to VLC. Shared by read() and block(). */
+static void recordGiveDataToVlc(int bytesReturned, int64_t usecReturned)
+{
+    enum _State {READ_INIT, READ_OK, READ_UNDERRUN};
+    static _State _state = READ_INIT;
+
+    if(bytesReturned == 0) {
+        if(_state == READ_OK) {
+            _state = READ_UNDERRUN;
+            Statistics::recordGiveDataToVlc(dashp2p::Utilities::getTime(), 0.0, 0.0);
+        }
+        return;
+    }
+
+    if(_state == READ_INIT) {
+        Statistics::recordScalarD64("startGiveDataToVLC", dashp2p::Utilities::getTime());
+    }
+
+    _state = READ_OK;
+
+    static int64_t usecConsumed = 0;
+    static uint64_t byteConsumed = 0;
+    usecConsumed += usecReturned;
+    byteConsumed += bytesReturned;
+    Statistics::recordGiveDataToVlc(dashp2p::Utilities::getTime(), usecConsumed / 1e6, (double)byteConsumed);
+}
+
 static block_t* block( access_t* p_access )
 {
-    /* Get new stream data. */
+    /* Get the next contiguous run of stream data (up to the end of the current segment) by reference. */
     char* buffer = NULL;
     int bufferSize = 0;
     int bytesReturned = 0;
-    double secReturned = 0;
-    int ifExpectingMoreData = Control::getDataForPlayback(&buffer, &bufferSize, &bytesReturned, &secReturned);
+    int64_t usecReturned = 0;
+    DataBuffer* dataBuffer = NULL;
+    const int ifExpectingMoreData = Control::vlcCb(&buffer, &bufferSize, &bytesReturned, &usecReturned, &dataBuffer);
 
-    block_t* p_block = NULL;
-    if(buffer)
-    {
-        dbgPrintf(moduleName.c_str(), "Got %u bytes from Control.", bufferSize);
-        dp2p_assert(bufferSize);
-        p_block = block_New( p_access, bufferSize );
-        /* TODO: avoid copying here */
-        memcpy(p_block->p_buffer, buffer, bufferSize);
-        p_block->i_buffer = bufferSize;
-    }
-    else
-    {
-        dp2p_assert(!bufferSize);
-        if(ifExpectingMoreData) {
-            dbgPrintf(moduleName.c_str(), "Got NO bytes from Control. Expecting more data.");
-            dp2p_assert( 0 == usleep(100000) );
-        } else {
-            dbgPrintf(moduleName.c_str(), "Got NO bytes from Control. EOF reached.");
+    recordGiveDataToVlc(bytesReturned, usecReturned);
+
+    if(bytesReturned == 0) {
+        dp2p_assert(dataBuffer == NULL);
+        if(!ifExpectingMoreData) {
+            DBGMSG("Returning no block and EOF.");
             p_access->info.b_eof = true;
+        } else {
+            DBGMSG("Returning no block but NO EOF.");
         }
+        return NULL;
     }
 
-    return p_block;
+    /* Wrap the data. The reference is given up when VLC releases the block. */
+    DataBlock* b = new DataBlock;
+    block_Init(&b->block, buffer, bytesReturned);
+    b->block.pf_release = releaseDataBlock;
+    b->dataBuffer = dataBuffer;
+    p_access->info.i_pos += bytesReturned;
+
+    DBGMSG("Returning a block of %d bytes (%s).", bytesReturned, ifExpectingMoreData ? "NO EOF" : "EOF");
+    return &b->block;
 }
-#endif
 
 
-ssize_t read(access_t* /*p_access*/, uint8_t* buffer, size_t size)
+ssize_t read(access_t* p_access, uint8_t* buffer, size_t size)
 {
     DBGMSG("Asking for up to %d bytes.", size);
 
-    enum _State {READ_INIT, READ_OK, READ_UNDERRUN};
-    static _State _state = READ_INIT;
-
     /* Get new stream data. */
     char* _buffer = (char*)buffer;
     int _size = size;
@@ -465,26 +562,14 @@ ssize_t read(access_t* /*p_access*/, uint8_t* buffer, size_t size)
         return 0;
     } else if(bytesReturned == 0 && ifExpectingMoreData) {
         /* Logging */
-        if(_state == READ_OK) {
-            _state = READ_UNDERRUN;
-            Statistics::recordGiveDataToVlc(dashp2p::Utilities::getTime(), 0.0, 0.0);
-        }
+        recordGiveDataToVlc(0, 0);
         DBGMSG("Returning 0 bytes but NO EOF.");
         return -1;
     }
 
-    if(_state == READ_INIT) {
-        Statistics::recordScalarD64("startGiveDataToVLC", dashp2p::Utilities::getTime());
-    }
-
-    _state = READ_OK;
-
     /* Dump statistics */
-    static int64_t usecConsumed = 0;
-    static uint64_t byteConsumed = 0;
-    usecConsumed += usecReturned;
-    byteConsumed += bytesReturned;
-    Statistics::recordGiveDataToVlc(dashp2p::Utilities::getTime(), usecConsumed / 1e6, (double)byteConsumed);
+    recordGiveDataToVlc(bytesReturned, usecReturned);
+    p_access->info.i_pos += bytesReturned;
 
     /* Dump segment data */
 #if 0
@@ -45,7 +45,8 @@ using std::ostringstream;
 namespace dashp2p {
 
 /* HTTP status codes. */
-enum HTTPStatusCode {HTTP_STATUS_CODE_UNDEFINED = 0, HTTP_STATUS_CODE_OK = 200, HTTP_STATUS_CODE_FOUND = 302};
+enum HTTPStatusCode {HTTP_STATUS_CODE_UNDEFINED = 0, HTTP_STATUS_CODE_OK = 200, HTTP_STATUS_CODE_PARTIAL_CONTENT = 206, HTTP_STATUS_CODE_FOUND = 302,
+        HTTP_STATUS_CODE_NOT_MODIFIED = 304};
 
 /* HTTP methods */
 enum HttpMethod {HttpMethod_GET, HttpMethod_HEAD};
@@ -95,7 +96,9 @@ enum ControlLogicEventType {
 	//Event_KeepAliveMaxReached = 6,
 	//Event_Pause = 7,
 	//Event_ResumePlayback = 8,
-	Event_StartPlayback = 9
+	Event_StartPlayback = 9,
+	Event_Seek = 10,
+	Event_Timer = 11
 };
 
 enum ControlLogicActionType {
@@ -0,0 +1,90 @@
+/****************************************************************************
+ * Arena.cpp                                                                *
+ ****************************************************************************
+ * Copyright (C) 2026                                                       *
+ *                                                                          *
+ * Created on: Oct 19, 2026                                                 *
+ * Authors: agent <agent@local>                                             *
+ *                                                                          *
+ * This program is free software: you can redistribute it and/or modify     *
+ * it under the terms of the GNU General Public License as published by     *
+ * the Free Software Foundation, either version 3 of the License, or        *
+ * (at your option) any later version.                                      *
+ *                                                                          *
+ * This program is distributed in the hope that it will be useful,          *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ * GNU General Public License for more details.                             *
+ *                                                                          *
+ * You should have received a copy of the GNU General Public License        *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.     *
+ ****************************************************************************/
+
+#include "mpd/Arena.h"
+#include "DebugAdapter.h"
+
+#include <cstdlib>
+#include <cstring>
+
+namespace dashp2p {
+    namespace mpd {
+        /* Blocks grow geometrically up to maxBlockSize. Larger requests get a block of their own. */
+        static const size_t firstBlockSize= 16384;
+        static const size_t maxBlockSize= 1048576;
+
+        Arena::Arena():
+            blocks(NULL),
+            pos(NULL),
+            end(NULL),
+            nextBlockSize(firstBlockSize),
+            destructors(NULL),
+            usedBytes(0),
+            reservedBytes(0)
+        {}
+
+        Arena::~Arena() {
+            for(Destructor* d= destructors; d != NULL; d= d->next) {
+                d->fn(d->obj);
+            }
+            while(blocks != NULL) {
+                Block* next= blocks->next;
+                free(blocks);
+                blocks= next;
+            }
+        }
+
+        const char* Arena::copyString(const char* p, size_t size) {
+            char* s= static_cast<char*>(allocate(size + 1, 1));
+            memcpy(s, p, size);
+            s[size]= 0;
+            return s;
+        }
+
+        void Arena::addDestructor(void* obj, void (*fn)(void*)) {
+            Destructor* d= static_cast<Destructor*>(allocate(sizeof(Destructor), alignof(Destructor)));
+            d->fn= fn;
+            d->obj= obj;
+            d->next= destructors;
+            destructors= d;
+        }
+
+        void Arena::newBlock(size_t minSize) {
+            size_t size= nextBlockSize;
+            if(size < minSize + sizeof(Block)) {
+                size= minSize + sizeof(Block);
+            } else if(nextBlockSize < maxBlockSize) {
+                nextBlockSize*= 2;
+            }
+
+            Block* block= static_cast<Block*>(malloc(size));
+            if(block == NULL) {
+                THROW_RUNTIME("Out of memory (MPD arena block of %zu bytes).", size);
+            }
+            block->next= blocks;
+            blocks= block;
+            pos= (char*)(block + 1);
+            end= (char*)block + size;
+            reservedBytes+= size;
+        }
+    }
+}
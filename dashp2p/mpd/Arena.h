@@ -0,0 +1,106 @@
+/****************************************************************************
+ * Arena.h                                                                  *
+ ****************************************************************************
+ * Copyright (C) 2026                                                       *
+ *                                                                          *
+ * Created on: Oct 19, 2026                                                 *
+ * Authors: agent <agent@local>                                             *
+ *                                                                          *
+ * This program is free software: you can redistribute it and/or modify     *
+ * it under the terms of the GNU General Public License as published by     *
+ * the Free Software Foundation, either version 3 of the License, or        *
+ * (at your option) any later version.                                      *
+ *                                                                          *
+ * This program is distributed in the hope that it will be useful,          *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ * GNU General Public License for more details.                             *
+ *                                                                          *
+ * You should have received a copy of the GNU General Public License        *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.     *
+ ****************************************************************************/
+
+#ifndef ARENA_H_
+#define ARENA_H_
+
+#include <cstddef>
+#include <new>
+#include <stdint.h>
+#include <type_traits>
+#include <utility>
+
+namespace dashp2p {
+    namespace mpd {
+        /**
+         * Region allocator for the MPD model. Objects are placed one after another in large blocks and are released
+         * all together when the arena is destroyed. There is no per-object deallocation. Objects with a non-trivial
+         * destructor are destroyed in reverse order of their creation.
+         * Not thread-safe.
+         */
+        class Arena {
+        public:
+            Arena();
+            ~Arena();
+
+            void* allocate(size_t size, size_t align) {
+                uintptr_t p= ((uintptr_t)pos + (align - 1)) & ~(uintptr_t)(align - 1);
+                if(pos == NULL || p + size > (uintptr_t)end) {
+                    newBlock(size + align);
+                    p= ((uintptr_t)pos + (align - 1)) & ~(uintptr_t)(align - 1);
+                }
+                pos= (char*)(p + size);
+                usedBytes+= size;
+                return (void*)p;
+            }
+
+            template<typename T, typename... Args> T* create(Args&&... args) {
+                T* obj= new(allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+                if(!std::is_trivially_destructible<T>::value) {
+                    addDestructor(obj, &destroy<T>);
+                }
+                return obj;
+            }
+
+            /* Uninitialised array for trivial types. */
+            template<typename T> T* allocateArray(size_t n) {
+                static_assert(std::is_trivial<T>::value, "Arena arrays are not destroyed");
+                return static_cast<T*>(allocate(n * sizeof(T), alignof(T)));
+            }
+
+            /* Null-terminated copy of [p, p + size). */
+            const char* copyString(const char* p, size_t size);
+
+            /* Bytes handed out so far and bytes reserved from the heap. */
+            size_t getUsedBytes() const {return usedBytes;}
+            size_t getReservedBytes() const {return reservedBytes;}
+
+        private:
+            Arena(const Arena&);
+            Arena& operator=(const Arena&);
+
+            struct Block {
+                Block* next;
+            };
+            struct Destructor {
+                void (*fn)(void*);
+                void* obj;
+                Destructor* next;
+            };
+
+            template<typename T> static void destroy(void* obj) {static_cast<T*>(obj)->~T();}
+            void addDestructor(void* obj, void (*fn)(void*));
+            void newBlock(size_t minSize);
+
+        private:
+            Block* blocks;
+            char* pos;
+            char* end;
+            size_t nextBlockSize;
+            Destructor* destructors;
+            size_t usedBytes;
+            size_t reservedBytes;
+        };
+    }
+}
+
+#endif /* ARENA_H_ */
@@ -40,6 +40,63 @@ namespace dashp2p {
 
         MediaPresentationDescription *ModelReader::read(dashp2p::xml::BasicDocument& xmlDocument) {
             xmlDocument.parse(_handler);
+            return release();
+        }
+
+        MediaPresentationDescription *ModelReader::replay(const char* p, size_t size) {
+            const char* const end= p + size;
+            bool ok= true;
+            while(ok && p < end) {
+                const char op= *p++;
+                names::Id name= names::UNKNOWN;
+                if(op != 'V') {
+                    if(p == end || (unsigned char)*p >= names::NUM_NAMES) {
+                        ok= false;
+                        break;
+                    }
+                    name= (names::Id)(unsigned char)*p++;
+                }
+
+                dashp2p::xml::StrRef value;
+                if(op == 'A' || op == 'V') {
+                    /* Length as LEB128. */
+                    size_t n= 0;
+                    int shift= 0;
+                    for(ok= false; p < end && shift < 64; shift += 7) {
+                        const unsigned char c= *p++;
+                        n |= (size_t)(c & 0x7f) << shift;
+                        if(!(c & 0x80)) {
+                            ok= true;
+                            break;
+                        }
+                    }
+                    if(!ok || n > (size_t)(end - p)) {
+                        ok= false;
+                        break;
+                    }
+                    value= dashp2p::xml::StrRef(p, n);
+                    p += n;
+                }
+
+                switch(op) {
+                case 'S': _handler.onElementStart(name); break;
+                case 'A': _handler.onAttribute(name, value); break;
+                case 'V': _handler.onElementValue(value); break;
+                case 'E': _handler.onElementEnd(name); break;
+                default: ok= false; break;
+                }
+            }
+
+            /* Malformed or truncated. */
+            if(!ok || _handler.mpd == NULL || _handler._parser != NULL) {
+                ERRMSG("invalid MPD event record");
+                return NULL;
+            }
+
+            return release();
+        }
+
+        MediaPresentationDescription *ModelReader::release() {
             MediaPresentationDescription* result= _handler.mpd;
             _handler.mpd= NULL;
             return result;
@@ -48,19 +105,23 @@ namespace dashp2p {
 
         ModelReader::ModelHandler::ModelHandler(const ModelFactory& factory):
             mpd(NULL),
-            _toSkip(),
+            adaptationSetsCompleted(0),
+            _skipDepth(0),
             _context(*(new ParserContext(factory))),
-            _parser(NULL)
+            _parser(NULL),
+            _recorder(NULL)
         {}
 
         ModelReader::ModelHandler::~ModelHandler() {
+            delete mpd;
             delete &_context;
         }
 
-        void ModelReader::ModelHandler::onElementValue(const std::string & value) {
-            if(_toSkip.size() <= 0) {
+        void ModelReader::ModelHandler::onElementValue(const dashp2p::xml::StrRef& value) {
+            if(_skipDepth <= 0) {
                 if(_parser != NULL) {
                     _parser->attachContent(value);
+                    record('V', names::UNKNOWN, &value);
                 }
             }
         }
@@ -69,9 +130,21 @@ namespace dashp2p {
             DBGMSG("document end");
         }
 
-        void ModelReader::ModelHandler::onElementStart(const std::string& name) {
+        void ModelReader::ModelHandler::onElementStart(const dashp2p::xml::StrRef& name) {
+            if(_skipDepth > 0) {
+                ++_skipDepth;
+            } else {
+                const names::Id id= names::intern(name);
+                onElementStart(id);
+                if(_skipDepth > 0) {
+                	DBGMSG("skip %.*s", (int)name.size(), name.data());
+                }
+            }
+        }
+
+        void ModelReader::ModelHandler::onElementStart(names::Id name) {
             if(_parser == NULL) {
-                if(name == "MPD") {
+                if(name == names::MPD) {
                     _parser= _context.getParser(ParserDescriptor::MEDIA_PRESENTATION_DESCRIPTION);
 
                     if(_parser == NULL) {
@@ -80,51 +153,81 @@ namespace dashp2p {
                     }
 
                     mpd= static_cast<MediaPresentationDescription*>(_parser->pre(NULL));
+                    record('S', name);
                 } else {
                     ERRMSG("invalid root element");
                 }
             } else {
-                if(_toSkip.size() > 0) {
-//                    _dbg->printf("%s(%d): skip %s", __FILE__, __LINE__, name.c_str());
-                    _toSkip.push_back(name);
+                if(_skipDepth > 0) {
+                    ++_skipDepth;
                 } else {
                     ElementParserBase* nextParser= _parser->attachElement(name);
 
                     if(nextParser == NULL) {
-                    	DBGMSG("skip %s", name.c_str());
-                        _toSkip.push_back(name);
+                        _skipDepth= 1;
                     } else {
                         _parser= nextParser;
+                        record('S', name);
                     }
                 }
             }
         }
 
-        void ModelReader::ModelHandler::onElementEnd(const std::string& name) {
-            if(_toSkip.size() > 0) {
-                const std::string& expected= _toSkip.back();
-
-                if(expected == name) {
-                    _toSkip.pop_back();
-
-                    if(_toSkip.size() <= 0) {
-                    	DBGMSG("skipped %s", name.c_str());
-                    }
-                } else {
-                    ERRMSG("expected %s but got %s", expected.c_str(), name.c_str());
+        void ModelReader::ModelHandler::onElementEnd(const dashp2p::xml::StrRef& name) {
+            if(_skipDepth > 0) {
+                if(--_skipDepth == 0) {
+                	DBGMSG("skipped %.*s", (int)name.size(), name.data());
                 }
+            } else if(_parser != NULL) {
+                onElementEnd(names::intern(name));
+            } else {
+                ERRMSG("invalid end tag %.*s", (int)name.size(), name.data());
+            }
+        }
+
+        void ModelReader::ModelHandler::onElementEnd(names::Id name) {
+            if(_skipDepth > 0) {
+                --_skipDepth;
             } else {
                 if(_parser != NULL) {
                     _parser= _parser->post();
+                    if(name == names::AdaptationSet)
+                        ++adaptationSetsCompleted;
+                    record('E', name);
                 } else {
-                    ERRMSG("invalid end tag %s", name.c_str());
+                    ERRMSG("invalid end tag %s", names::toString(name));
                 }
             }
         }
 
-        void ModelReader::ModelHandler::onAttribute(const std::string & name, const std::string & value) {
-            if(_toSkip.size() <= 0 && _parser != NULL) {
+        void ModelReader::ModelHandler::onAttribute(const dashp2p::xml::StrRef& name, const dashp2p::xml::StrRef& value) {
+            if(_skipDepth <= 0 && _parser != NULL) {
+                onAttribute(names::intern(name), value);
+            }
+        }
+
+        void ModelReader::ModelHandler::onAttribute(names::Id name, const dashp2p::xml::StrRef& value) {
+            if(_skipDepth <= 0 && _parser != NULL) {
                 _parser->attachAttribute(name, value);
+                record('A', name, &value);
+            }
+        }
+
+        void ModelReader::ModelHandler::record(char op, names::Id name, const dashp2p::xml::StrRef* value) {
+            if(_recorder == NULL)
+                return;
+
+            _recorder->push_back(op);
+            if(op != 'V')
+                _recorder->push_back((char)name);
+            if(value != NULL) {
+                /* Length as LEB128. */
+                size_t n= value->size();
+                do {
+                    _recorder->push_back((char)((n & 0x7f) | (n > 0x7f ? 0x80 : 0)));
+                    n >>= 7;
+                } while(n > 0);
+                _recorder->append(value->data(), value->size());
             }
         }
 
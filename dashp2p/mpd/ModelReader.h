@@ -27,6 +27,7 @@
 #include "mpd/model_parser.h"
 #include "xml/basic_xml.h"
 
+#include <string>
 #include <vector>
 
 namespace dashp2p {
@@ -38,6 +39,21 @@ namespace dashp2p {
 
             MediaPresentationDescription* read(dashp2p::xml::BasicDocument& xmlDocument);
 
+            /* Incremental reading: the document is pushed to the handler piecewise (see xml::XmlParser). */
+            dashp2p::xml::BasicDocumentHandler& getHandler() {return _handler;}
+            /* True once the first AdaptationSet (of the first Period) is complete. */
+            bool hasFirstAdaptationSet() const {return _handler.adaptationSetsCompleted > 0;}
+            /* Hands over the model read so far. It is completed in place while the rest of the document is pushed. */
+            MediaPresentationDescription* release();
+
+            /**
+             * Appends the events that reach the parsers to events, in a compact binary form, so that the model can
+             * later be rebuilt by replay() without the XML. Skipped elements are not recorded. NULL stops recording.
+             */
+            void setRecorder(std::string* events) {_handler._recorder= events;}
+            /* Builds the model from recorded events. Returns NULL if they are malformed. */
+            MediaPresentationDescription* replay(const char* p, size_t size);
+
         private:
             class ModelHandler: public dashp2p::xml::BasicDocumentHandler {
             public:
@@ -45,19 +61,30 @@ namespace dashp2p {
                 ~ModelHandler();
 
                 void onDocumentStart();
-                void onAttribute(const std::string& name, const std::string& value);
-                void onElementStart(const std::string& name);
-                void onElementValue(const std::string& value);
-                void onElementEnd(const std::string& name);
+                void onAttribute(const dashp2p::xml::StrRef& name, const dashp2p::xml::StrRef& value);
+                void onElementStart(const dashp2p::xml::StrRef& name);
+                void onElementValue(const dashp2p::xml::StrRef& value);
+                void onElementEnd(const dashp2p::xml::StrRef& name);
                 void onDocumentEnd();
 
+                /* The same, with interned names. Called directly on replay. */
+                void onElementStart(names::Id name);
+                void onAttribute(names::Id name, const dashp2p::xml::StrRef& value);
+                void onElementEnd(names::Id name);
+
             protected:
                 MediaPresentationDescription* mpd;
+                int adaptationSetsCompleted;
 
             private:
-                std::vector<std::string> _toSkip;
+                /* Appends an event to the recorder, if any. */
+                void record(char op, names::Id name, const dashp2p::xml::StrRef* value= NULL);
+
+                /* Depth of the unknown element being skipped, 0 if none. Tags are matched by the XML parser. */
+                int _skipDepth;
                 ParserContext& _context;
                 ElementParserBase* _parser;
+                std::string* _recorder;
 
                 friend class ModelReader;
             };
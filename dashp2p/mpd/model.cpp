@@ -1017,6 +1017,8 @@ namespace dashp2p {
             presentationTimeOffset(),
             indexRange(),
             indexRangeExact(false),
+            availabilityTimeOffset(),
+            availabilityTimeComplete(true),
             initialization(),
             representationIndex()
         {}
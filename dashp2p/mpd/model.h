@@ -27,13 +27,19 @@
 //#include "Dashp2pTypes.h"
 #include "ContentId.h"
 #include "Utilities.h"
+#include "mpd/Arena.h"
+#include "xml/basic_xml.h"
 
 
 #include <vector>
 #include <string>
 #include <list>
 #include <ctime>
+#include <new>
+#include <stdexcept>
+#include <stdint.h>
 #include <string.h>
+#include <type_traits>
 
 #if 0
 /* Type for storing information about a block of data in memory.
@@ -91,30 +97,121 @@ namespace dashp2p {
 
 namespace dashp2p {
     namespace mpd {
+        /**
+         * Optional attribute value, stored in place.
+         */
         template<typename T> class field_access {
+            static_assert(std::is_trivially_destructible<T>::value, "Model fields must be trivially destructible");
         public:
-            field_access():_ptr(NULL) {}
+            field_access(): _set(false) {}
 
-            field_access(const T& val):_ptr(NULL) {
+            field_access(const T& val): _set(false) {
                 set(val);
             }
 
-            ~field_access() {
-                if(_ptr != NULL) {
-                    delete _ptr;
-                    _ptr= NULL;
+            const T& get() const throw() {
+                if(!_set) {
+                    throw "uninitialised";
                 }
+
+                return *reinterpret_cast<const T*>(&_storage);
             }
 
-            const T& get() const throw() {
-                if(_ptr == NULL) {
+            T& get() throw() {
+                if(!_set) {
                     throw "uninitialised";
                 }
 
-                return *_ptr;
+                return *reinterpret_cast<T*>(&_storage);
             }
 
-            T& get() throw() {
+            void set(const T& val) {
+                new(&_storage) T(val);
+                _set= true;
+            }
+
+            bool isSet() const {
+                return _set;
+            }
+
+            /**
+             * Takes over a heap-allocated value (as returned by the converters). NULL leaves the field unset.
+             */
+            void handOver(T* ptr) {
+                if(ptr != NULL) {
+                    set(*ptr);
+                    delete ptr;
+                }
+            }
+
+        private:
+            typename std::aligned_storage<sizeof(T), alignof(T)>::type _storage;
+            bool _set;
+        };
+
+
+        /**
+         * Characters in the model's arena. Null-terminated.
+         */
+        class string_ref {
+        public:
+            string_ref(): _p(""), _n(0) {}
+            string_ref(const char* p, size_t n): _p(p), _n(n) {}
+
+            const char* c_str() const {return _p;}
+            const char* data() const {return _p;}
+            size_t size() const {return _n;}
+            size_t length() const {return _n;}
+            bool empty() const {return _n == 0;}
+            char operator[](size_t i) const {return _p[i];}
+
+            std::string str() const {return std::string(_p, _n);}
+            operator std::string() const {return str();}
+
+            bool operator==(const char* s) const {return strcmp(_p, s) == 0;}
+            bool operator!=(const char* s) const {return !operator==(s);}
+
+        private:
+            const char* _p;
+            uint32_t _n;
+        };
+
+        /**
+         * Optional string value. The characters are kept in the model's arena. Unset while the pointer is NULL.
+         */
+        template<> class field_access<std::string> {
+        public:
+            field_access(): _val(NULL, 0) {}
+
+            const string_ref& get() const throw() {
+                if(_val.data() == NULL) {
+                    throw "uninitialised";
+                }
+
+                return _val;
+            }
+
+            void set(const dashp2p::xml::StrRef& val, Arena& arena) {
+                _val= string_ref(arena.copyString(val.data(), val.size()), val.size());
+            }
+
+            bool isSet() const {
+                return _val.data() != NULL;
+            }
+
+        private:
+            string_ref _val;
+        };
+
+
+        /**
+         * Optional child element. The element lives in the model's arena, this is only a reference to it.
+         */
+        template<typename T> class element_access {
+        public:
+            element_access():_ptr(NULL) {}
+
+            const T& get() const throw() {
                 if(_ptr == NULL) {
                     throw "uninitialised";
                 }
@@ -122,12 +219,12 @@ namespace dashp2p {
                 return *_ptr;
             }
 
-            void set(const T& val) {
-                if(_ptr != NULL) {
-                    delete _ptr;
+            T& get() throw() {
+                if(_ptr == NULL) {
+                    throw "uninitialised";
                 }
 
-                _ptr= new T(val);
+                return *_ptr;
             }
 
             bool isSet() const {
@@ -135,10 +232,6 @@ namespace dashp2p {
             }
 
             void handOver(T* ptr) {
-                if(_ptr != NULL && _ptr != ptr) {
-                    delete _ptr;
-                }
-
                 _ptr= ptr;
             }
 
@@ -153,60 +246,72 @@ namespace dashp2p {
         };
 
 
+        /**
+         * Sequence of child elements. The elements and the (contiguous) array referencing them live in the model's arena.
+         */
         template<typename E> class sequence_access {
         public:
-            sequence_access():_p_seq(NULL) {}
-
-            ~sequence_access() {
-                if(_p_seq != NULL) {
-                    // delete all elements
-                    typename std::vector<E*>::iterator iter;
-                    for(iter= _p_seq->begin(); iter != _p_seq->end(); iter++) {
-                        delete *iter;
+            class array {
+            public:
+                array(): _data(NULL), _size(0), _capacity(0) {}
+
+                size_t size() const {return _size;}
+                bool empty() const {return _size == 0;}
+                E* operator[](size_t i) const {return _data[i];}
+                E* at(size_t i) const {
+                    if(i >= _size) {
+                        throw std::out_of_range("sequence_access");
                     }
-                    delete _p_seq;
-                    _p_seq= NULL;
+                    return _data[i];
                 }
-            }
+                E* front() const {return at(0);}
+                E* back() const {return at(_size - 1);}
+                E* const* begin() const {return _data;}
+                E* const* end() const {return _data + _size;}
 
-            void add(const E& val) {
-                if(_p_seq == NULL) {
-                    _p_seq= new std::vector<E*>();
-                }
+            private:
+                E** _data;
+                uint32_t _size;
+                uint32_t _capacity;
+
+                friend class sequence_access;
+            };
+
+            sequence_access(): _items() {}
 
-                _p_seq->push_back(new E(val));
+            void add(const E& val, Arena& arena) {
+                addRef(arena.create<E>(val), arena);
             }
 
-            void addRef(E* ptr) {
-                if(_p_seq == NULL) {
-                    _p_seq= new std::vector<E*>();
+            void addRef(E* ptr, Arena& arena) {
+                if(_items._size == _items._capacity) {
+                    /* The old array is left in the arena. */
+                    const uint32_t capacity= (_items._capacity == 0) ? 4 : 2 * _items._capacity;
+                    E** data= arena.allocateArray<E*>(capacity);
+                    if(_items._size > 0) {
+                        memcpy(data, _items._data, _items._size * sizeof(E*));
+                    }
+                    _items._data= data;
+                    _items._capacity= capacity;
                 }
 
-                _p_seq->push_back(ptr);
+                _items._data[_items._size++]= ptr;
             }
 
             bool isSet() const {
-                return _p_seq != NULL;
-            }
-
-            const std::vector<E*>& get() const throw() {
-                if(_p_seq == NULL) {
-                    throw "uninitialised";
-                }
-
-                return *_p_seq;
+                return _items._data != NULL;
             }
 
-            std::vector<E*>& get() throw() {
-                if(_p_seq == NULL) {
+            const array& get() const throw() {
+                if(_items._data == NULL) {
                     throw "uninitialised";
                 }
 
-                return *_p_seq;
+                return _items;
             }
 
         private:
-            std::vector<E*>* _p_seq;
+            array _items;
         };
 
         /* enumerations */
@@ -250,10 +355,12 @@ namespace dashp2p {
 
         /* model classes */
 
+        /* All elements except the MPD itself are created in the MPD's arena and never destroyed one by one,
+         * so they (and their fields) have to be trivially destructible. */
+
         class BaseURL {
         public:
             BaseURL();
-            virtual ~BaseURL(){}
 
             field_access<std::string> value; /*required*/
             field_access<std::string> serviceLocation;
@@ -289,7 +396,6 @@ namespace dashp2p {
         class ContentComponent {
         public:
             ContentComponent();
-            virtual ~ContentComponent(){}
 
             field_access<unsigned int> id;
             field_access<std::string> lang;
@@ -306,7 +412,6 @@ namespace dashp2p {
         class Descriptor {
         public:
             Descriptor();
-            virtual ~Descriptor(){}
 
             field_access<std::string> schemIdUri; /*required*/
             field_access<std::string> value;
@@ -316,7 +421,6 @@ namespace dashp2p {
         class Metrics {
         public:
             Metrics();
-            virtual ~Metrics(){}
 
             field_access<std::string> metrics; /*required*/
             sequence_access<Descriptor> reporting;
@@ -327,7 +431,6 @@ namespace dashp2p {
         class Range {
         public:
             Range();
-            virtual ~Range(){}
 
             field_access<Duration> starttime;
             field_access<Duration> duration;
@@ -336,7 +439,6 @@ namespace dashp2p {
 
         class RepresentationBase {
         public:
-            virtual ~RepresentationBase(){}
 
         protected:
             RepresentationBase();
@@ -366,7 +468,6 @@ namespace dashp2p {
         class SubRepresentation : public RepresentationBase {
         public:
             SubRepresentation();
-            virtual ~SubRepresentation(){}
 
             field_access<unsigned int> level;
             sequence_access<unsigned int> dependencyLevel;
@@ -378,7 +479,6 @@ namespace dashp2p {
         class URLRange {
         public:
             URLRange();
-            virtual ~URLRange(){}
 
             field_access<std::string> sourceURL;
             field_access<std::string> range;
@@ -388,7 +488,6 @@ namespace dashp2p {
         class SegmentURL {
         public:
             SegmentURL();
-            virtual ~SegmentURL(){}
 
             //int localSegmentID;
             //std::string localSegmentStringID;
@@ -403,7 +502,6 @@ namespace dashp2p {
         class SegmentBase {
         public:
             SegmentBase();
-            virtual ~SegmentBase(){}
 
             //const std::pair<const std::string&, const std::string&> getInitializationSegmentURL() const;
 
@@ -411,33 +509,34 @@ namespace dashp2p {
             //std::string localInitSegmentStringID;
 
             field_access<unsigned int> timescale;
-            field_access<unsigned int> presentationTimeOffset;
+            field_access<uint64_t> presentationTimeOffset;
             field_access<std::string> indexRange;
             field_access<bool> indexRangeExact;
+            /* [s], infinity for "INF". Segments may be requested this long before they are complete (chunked delivery). */
+            field_access<double> availabilityTimeOffset;
+            field_access<bool> availabilityTimeComplete;
 
-            field_access<URLRange> initialization;
-            field_access<URLRange> representationIndex;
+            element_access<URLRange> initialization;
+            element_access<URLRange> representationIndex;
         };
 
 
         class MultipleSegmentBase : public SegmentBase {
         protected:
             MultipleSegmentBase();
-            virtual ~MultipleSegmentBase(){}
 
         public:
             field_access<unsigned int> duration;
             field_access<unsigned int> startNumber;
 
-            field_access<SegmentTimeline> segmentTimeline;
-            field_access<URLRange> bitstreamSwitching;
+            element_access<SegmentTimeline> segmentTimeline;
+            element_access<URLRange> bitstreamSwitching;
         };
 
 
         class SegmentList : public MultipleSegmentBase {
         public:
             SegmentList();
-            virtual ~SegmentList(){}
 
             field_access<std::string> href;
             field_access<EActuate> actuate;
@@ -449,7 +548,6 @@ namespace dashp2p {
         class ProgramInformation {
         public:
             ProgramInformation();
-            virtual ~ProgramInformation(){}
 
             field_access<std::string> lang;
             field_access<std::string> moreInformationURL;
@@ -463,7 +561,6 @@ namespace dashp2p {
         class SegmentTemplate : public MultipleSegmentBase {
         public:
             SegmentTemplate();
-            virtual ~SegmentTemplate(){}
 
             field_access<std::string> media;
             field_access<std::string> index;
@@ -477,15 +574,13 @@ namespace dashp2p {
             class S {
             public:
                 S();
-                ~S(){}
 
-                field_access<unsigned int> t;
-                field_access<unsigned int> d; /*required*/
-                field_access<unsigned int> r;
+                field_access<uint64_t> t;
+                field_access<uint64_t> d; /*required*/
+                field_access<int> r;      /* -1: repeated until the next S or the end of the period */
             };
 
             SegmentTimeline();
-            virtual ~SegmentTimeline(){}
 
             sequence_access<S> s;
         };
@@ -494,7 +589,6 @@ namespace dashp2p {
         class Subset {
         public:
             Subset();
-            virtual ~Subset(){}
 
             sequence_access<unsigned int> contains; /*required*/
         };
@@ -503,7 +597,6 @@ namespace dashp2p {
         class Representation : public RepresentationBase {
         public:
             Representation();
-            virtual ~Representation(){}
 
             //unsigned getBandwidth() const;
             //int getNumSegments() const;
@@ -520,16 +613,15 @@ namespace dashp2p {
 
             sequence_access<BaseURL> baseURLs;
             sequence_access<SubRepresentation> subRepresentations;
-            field_access<SegmentBase> segmentBase;
-            field_access<SegmentList> segmentList;
-            field_access<SegmentTemplate> segmentTemplate;
+            element_access<SegmentBase> segmentBase;
+            element_access<SegmentList> segmentList;
+            element_access<SegmentTemplate> segmentTemplate;
         };
 
 
         class AdaptationSet : public RepresentationBase {
         public:
             AdaptationSet();
-            virtual ~AdaptationSet(){}
 
             //int getNumRepresentations() const;
             //Representation& getRepresentation(int i);
@@ -570,9 +662,9 @@ int getLowestRepresentation() const;
             sequence_access<Descriptor> viewPoints;
             sequence_access<ContentComponent> contentComponents;
             sequence_access<BaseURL> baseURLs;
-            field_access<SegmentBase> segmentBase;
-            field_access<SegmentList> segmentList;
-            field_access<SegmentTemplate> segmentTemplate;
+            element_access<SegmentBase> segmentBase;
+            element_access<SegmentList> segmentList;
+            element_access<SegmentTemplate> segmentTemplate;
             sequence_access<Representation> representations;
         };
 
@@ -580,7 +672,6 @@ int getLowestRepresentation() const;
         class Period {
         public:
             Period();
-            virtual ~Period(){}
 
             //data::PeriodID getID() const;
             //int getNumAdaptationSets() const {return adaptationSets.get().size();}
@@ -598,9 +689,9 @@ int getLowestRepresentation() const;
             field_access<bool> bitstreamSwitching;
 
             sequence_access<BaseURL> baseURLs;
-            field_access<SegmentBase> segmentBase;
-            field_access<SegmentList> segmentList;
-            field_access<SegmentTemplate> segmentTemplate;
+            element_access<SegmentBase> segmentBase;
+            element_access<SegmentList> segmentList;
+            element_access<SegmentTemplate> segmentTemplate;
             sequence_access<AdaptationSet> adaptationSets;
             sequence_access<Subset> subSets;
         };
@@ -611,6 +702,9 @@ int getLowestRepresentation() const;
             MediaPresentationDescription();
             virtual ~MediaPresentationDescription(){}
 
+            /* Holds all other elements of the model. They are released together with the MPD. */
+            Arena arena;
+
             /*
              * Simplified interface.
              */
@@ -692,24 +786,25 @@ int getLowestRepresentation() const;
         public:
             const static ModelFactory& DEFAULT_FACTORY;
 
-            virtual BaseURL* createBaseURL() const {return new BaseURL();}
-            virtual ProgramInformation* createProgramInformation() const {return new ProgramInformation();}
+            virtual BaseURL* createBaseURL(Arena& arena) const {return arena.create<BaseURL>();}
+            virtual ProgramInformation* createProgramInformation(Arena& arena) const {return arena.create<ProgramInformation>();}
             virtual MediaPresentationDescription* createMediaPresentationDescription() const {return new MediaPresentationDescription();}
-            virtual URLRange* createURLRange() const {return new URLRange();}
-            virtual SegmentBase* createSegmentBase() const {return new SegmentBase();}
-            virtual Period* createPeriod() const {return new Period();}
-            virtual Descriptor* createDescriptor() const {return new Descriptor();}
-            virtual AdaptationSet* createAdaptationSet() const {return new AdaptationSet();}
-            virtual ContentComponent* createContentComponent() const {return new ContentComponent();}
-            virtual Representation* createRepresentation() const {return new Representation();}
-            virtual SubRepresentation* createSubRepresentation() const {return new SubRepresentation();}
-            virtual Subset* createSubSet() const {return new Subset();}
-            virtual SegmentURL* createSegmentURL() const {return new SegmentURL();}
-            virtual SegmentList* createSegmentList() const {return new SegmentList();}
-            virtual SegmentTemplate* createSegmentTemplate() const {return new SegmentTemplate();}
-            virtual SegmentTimeline* createSegmentTimeline() const {return new SegmentTimeline();}
-            virtual Range* createRange() const {return new Range();}
-            virtual Metrics* createMetrics() const {return new Metrics();}
+            virtual URLRange* createURLRange(Arena& arena) const {return arena.create<URLRange>();}
+            virtual SegmentBase* createSegmentBase(Arena& arena) const {return arena.create<SegmentBase>();}
+            virtual Period* createPeriod(Arena& arena) const {return arena.create<Period>();}
+            virtual Descriptor* createDescriptor(Arena& arena) const {return arena.create<Descriptor>();}
+            virtual AdaptationSet* createAdaptationSet(Arena& arena) const {return arena.create<AdaptationSet>();}
+            virtual ContentComponent* createContentComponent(Arena& arena) const {return arena.create<ContentComponent>();}
+            virtual Representation* createRepresentation(Arena& arena) const {return arena.create<Representation>();}
+            virtual SubRepresentation* createSubRepresentation(Arena& arena) const {return arena.create<SubRepresentation>();}
+            virtual Subset* createSubSet(Arena& arena) const {return arena.create<Subset>();}
+            virtual SegmentURL* createSegmentURL(Arena& arena) const {return arena.create<SegmentURL>();}
+            virtual SegmentList* createSegmentList(Arena& arena) const {return arena.create<SegmentList>();}
+            virtual SegmentTemplate* createSegmentTemplate(Arena& arena) const {return arena.create<SegmentTemplate>();}
+            virtual SegmentTimeline* createSegmentTimeline(Arena& arena) const {return arena.create<SegmentTimeline>();}
+            virtual SegmentTimeline::S* createS(Arena& arena) const {return arena.create<SegmentTimeline::S>();}
+            virtual Range* createRange(Arena& arena) const {return arena.create<Range>();}
+            virtual Metrics* createMetrics(Arena& arena) const {return arena.create<Metrics>();}
 
         protected:
             ModelFactory(){}
@@ -25,7 +25,11 @@
 
 #include <cassert>
 #include <cstdlib>
+#include <cstring>
 #include <exception>
+#include <limits>
+#include <stdint.h>
+#include <vector>
 
 #include "util/conversions.h"
 
@@ -52,13 +56,13 @@ namespace dashp2p {
                 _fieldPtr= fieldPtr;
             }
 
-            void attachAttribute(const std::string&, const std::string&) {}
+            void attachAttribute(names::Id, const dashp2p::xml::StrRef&) {}
 
-            void attachContent(const std::string& content) {
-                _fieldPtr->set(content);
+            void attachContent(const dashp2p::xml::StrRef& content) {
+                _fieldPtr->set(content, *ctx->arena);
             }
 
-            ElementParserBase* attachElement(const std::string&) {
+            ElementParserBase* attachElement(names::Id) {
                 return NULL;
             }
 
@@ -83,13 +87,13 @@ namespace dashp2p {
                 _sequencePtr= sequencePtr;
             }
 
-            void attachAttribute(const std::string&, const std::string&) {}
+            void attachAttribute(names::Id, const dashp2p::xml::StrRef&) {}
 
-            void attachContent(const std::string& content) {
-                _sequencePtr->add(content);
+            void attachContent(const dashp2p::xml::StrRef& content) {
+                _sequencePtr->add(content, *ctx->arena);
             }
 
-            ElementParserBase* attachElement(const std::string&) {
+            ElementParserBase* attachElement(names::Id) {
                 return NULL;
             }
 
@@ -110,8 +114,8 @@ namespace dashp2p {
         class BaseURLParser : public ElementParserBase {
         public:
             BaseURLParser();
-            void attachAttribute(const std::string& name, const std::string& value);
-            void attachContent(const std::string& content);
+            void attachAttribute(names::Id name, const dashp2p::xml::StrRef& value);
+            void attachContent(const dashp2p::xml::StrRef& content);
 
         protected:
             void* initialiseObject();
@@ -125,8 +129,8 @@ namespace dashp2p {
         class MediaPresentationDescriptionParser : public ElementParserBase {
         public:
             MediaPresentationDescriptionParser();
-            void attachAttribute(const std::string& name, const std::string& value);
-            ElementParserBase* attachElement(const std::string& name);
+            void attachAttribute(names::Id name, const dashp2p::xml::StrRef& value);
+            ElementParserBase* attachElement(names::Id name);
 
         protected:
             void* initialiseObject();
@@ -140,8 +144,8 @@ namespace dashp2p {
         class PeriodParser : public ElementParserBase {
         public:
             PeriodParser();
-            void attachAttribute(const std::string& name, const std::string& value);
-            ElementParserBase* attachElement(const std::string& name);
+            void attachAttribute(names::Id name, const dashp2p::xml::StrRef& value);
+            ElementParserBase* attachElement(names::Id name);
 
         protected:
             void* initialiseObject();
@@ -155,8 +159,8 @@ namespace dashp2p {
         class ProgramInformationParser : public ElementParserBase {
         public:
             ProgramInformationParser();
-            void attachAttribute(const std::string& name, const std::string& value);
-            ElementParserBase* attachElement(const std::string& name);
+            void attachAttribute(names::Id name, const dashp2p::xml::StrRef& value);
+            ElementParserBase* attachElement(names::Id name);
 
         protected:
             void* initialiseObject();
@@ -169,8 +173,8 @@ namespace dashp2p {
 
         class RepresentationBaseParser : public ElementParserBase {
         public:
-            virtual void attachAttribute(const std::string& name, const std::string& value);
-            virtual ElementParserBase* attachElement(const std::string& name);
+            virtual void attachAttribute(names::Id name, const dashp2p::xml::StrRef& value);
+            virtual ElementParserBase* attachElement(names::Id name);
 
         protected:
             virtual void* initialiseObject()= 0;
@@ -182,8 +186,8 @@ namespace dashp2p {
         class AdaptationSetParser : public RepresentationBaseParser {
         public:
             AdaptationSetParser();
-            void attachAttribute(const std::string& name, const std::string& value);
-            ElementParserBase* attachElement(const std::string& name);
+            void attachAttribute(names::Id name, const dashp2p::xml::StrRef& value);
+            ElementParserBase* attachElement(names::Id name);
 
         protected:
             void* initialiseObject();
@@ -198,8 +202,8 @@ namespace dashp2p {
         class RepresentationParser : public RepresentationBaseParser {
         public:
             RepresentationParser();
-            void attachAttribute(const std::string& name, const std::string& value);
-            ElementParserBase* attachElement(const std::string& name);
+            void attachAttribute(names::Id name, const dashp2p::xml::StrRef& value);
+            ElementParserBase* attachElement(names::Id name);
 
         protected:
             void* initialiseObject();
@@ -213,8 +217,8 @@ namespace dashp2p {
 
         class AbstractSegmentBaseParser : public ElementParserBase {
         public:
-            virtual void attachAttribute(const std::string& name, const std::string& value);
-            virtual ElementParserBase* attachElement(const std::string& name);
+            virtual void attachAttribute(names::Id name, const dashp2p::xml::StrRef& value);
+            virtual ElementParserBase* attachElement(names::Id name);
 
         protected:
             virtual void* initialiseObject()= 0;
@@ -225,8 +229,8 @@ namespace dashp2p {
 
         class AbstractMultipleSegmentBaseParser : public AbstractSegmentBaseParser {
         public:
-            virtual void attachAttribute(const std::string& name, const std::string& value);
-            virtual ElementParserBase* attachElement(const std::string& name);
+            virtual void attachAttribute(names::Id name, const dashp2p::xml::StrRef& value);
+            virtual ElementParserBase* attachElement(names::Id name);
 
         protected:
             virtual void* initialiseObject()= 0;
@@ -253,8 +257,8 @@ namespace dashp2p {
         class SegmentListParser : public AbstractMultipleSegmentBaseParser {
         public:
             SegmentListParser();
-            void attachAttribute(const std::string& name, const std::string& value);
-            ElementParserBase* attachElement(const std::string& name);
+            void attachAttribute(names::Id name, const dashp2p::xml::StrRef& value);
+            ElementParserBase* attachElement(names::Id name);
 
         protected:
             void* initialiseObject();
@@ -266,10 +270,53 @@ namespace dashp2p {
         };
 
 
+        class SegmentTemplateParser : public AbstractMultipleSegmentBaseParser {
+        public:
+            SegmentTemplateParser();
+            void attachAttribute(names::Id name, const dashp2p::xml::StrRef& value);
+
+        protected:
+            void* initialiseObject();
+            void validateObject();
+            MultipleSegmentBase* getMultipleSegmentBase();
+
+        private:
+            SegmentTemplate* _element;
+        };
+
+
+        class SegmentTimelineParser : public ElementParserBase {
+        public:
+            SegmentTimelineParser();
+            ElementParserBase* attachElement(names::Id name);
+
+        protected:
+            void* initialiseObject();
+            void validateObject();
+
+        private:
+            SegmentTimeline* _element;
+        };
+
+
+        class SParser : public ElementParserBase {
+        public:
+            SParser();
+            void attachAttribute(names::Id name, const dashp2p::xml::StrRef& value);
+
+        protected:
+            void* initialiseObject();
+            void validateObject();
+
+        private:
+            SegmentTimeline::S* _element;
+        };
+
+
         class SegmentURLParser : public ElementParserBase {
         public:
             SegmentURLParser();
-            void attachAttribute(const std::string& name, const std::string& value);
+            void attachAttribute(names::Id name, const dashp2p::xml::StrRef& value);
 
         protected:
             void* initialiseObject();
@@ -283,7 +330,7 @@ namespace dashp2p {
         class URLRangeParser : public ElementParserBase {
         public:
             URLRangeParser();
-            void attachAttribute(const std::string& name, const std::string& value);
+            void attachAttribute(names::Id name, const dashp2p::xml::StrRef& value);
 
         protected:
             void* initialiseObject();
@@ -310,8 +357,8 @@ namespace dashp2p {
         const ParserDescriptor& ParserDescriptor::REPRESENTATION= TypedParserDescriptor<RepresentationParser>();
         const ParserDescriptor& ParserDescriptor::SEGMENT_BASE= TypedParserDescriptor<SegmentBaseParser>();
         const ParserDescriptor& ParserDescriptor::SEGMENT_LIST= TypedParserDescriptor<SegmentListParser>();
-        const ParserDescriptor& ParserDescriptor::SEGMENT_TEMPLATE= NULL_DESCRIPTOR;
-        const ParserDescriptor& ParserDescriptor::SEGMENT_TIMELINE= NULL_DESCRIPTOR;
+        const ParserDescriptor& ParserDescriptor::SEGMENT_TEMPLATE= TypedParserDescriptor<SegmentTemplateParser>();
+        const ParserDescriptor& ParserDescriptor::SEGMENT_TIMELINE= TypedParserDescriptor<SegmentTimelineParser>();
         const ParserDescriptor& ParserDescriptor::SEGMENT_URL= TypedParserDescriptor<SegmentURLParser>();
         const ParserDescriptor& ParserDescriptor::SUB_REPRESENTATION= NULL_DESCRIPTOR;
         const ParserDescriptor& ParserDescriptor::SUBSET= NULL_DESCRIPTOR;
@@ -319,6 +366,7 @@ namespace dashp2p {
 
         static const ParserDescriptor& SIMPLE_STRING= TypedParserDescriptor<SimpleStringParser>();
         static const ParserDescriptor& SIMPLE_STRING_SEQUENCE= TypedParserDescriptor<SimpleStringSequenceParser>();
+        static const ParserDescriptor& SEGMENT_TIMELINE_S= TypedParserDescriptor<SParser>();
 
         static Duration* convertDuration(const std::string& value) {
             try {
@@ -347,20 +395,150 @@ std::cout << __FILE__ << '(' << __LINE__ << ") ERROR DURING CONVERSION " << e.wh
         }
 
 
-        static DateTime* convertDateTime(const std::string& /*value*/) {
-            // TODO
-            return NULL;
+        static DateTime* convertDateTime(const std::string& value) {
+            try {
+                return new DateTime(dashp2p::util::dateTimeStringToTime(value));
+            } catch (std::exception& e) {
+std::cout << __FILE__ << '(' << __LINE__ << ") ERROR DURING CONVERSION " << e.what() << std::endl;
+                return NULL;
+            }
+        }
+
+        /********************************************
+         * Name Interning                           *
+         ********************************************/
+        namespace names {
+            namespace {
+#define DASHP2P_MPD_NAME_STRING(n) #n,
+                const char* const strings[NUM_NAMES] = {"", DASHP2P_MPD_NAMES(DASHP2P_MPD_NAME_STRING)};
+#undef DASHP2P_MPD_NAME_STRING
+
+                /* The first and the last (up to) 8 characters and the length tell the known names apart. */
+                inline uint32_t hash(const char* p, size_t n, uint32_t seed) {
+                    uint64_t head = 0;
+                    uint64_t tail = n;
+                    if(n >= 8) {
+                        memcpy(&head, p, 8);
+                        uint64_t last;
+                        memcpy(&last, p + n - 8, 8);
+                        tail ^= last;
+                    } else {
+                        for(size_t i = 0; i < n; ++i) {
+                            head = (head << 8) | (unsigned char)p[i];
+                        }
+                    }
+                    const uint64_t h = (head ^ seed) * 0x9E3779B97F4A7C15ull + tail * 0xC2B2AE3D27D4EB4Full;
+                    return (uint32_t)(h >> 32);
+                }
+
+                /* Perfect hash: seed and size are searched once so that every known name gets a slot of its own. */
+                class NameTable {
+                public:
+                    NameTable(): seed(0), mask(0) {
+                        for(int id = 0; id < NUM_NAMES; ++id) {
+                            lengths[id] = strlen(strings[id]);
+                        }
+                        for(uint32_t size = 128; ; size *= 2) {
+                            /* Names the hash cannot tell apart would end up here. */
+                            assert(size <= 65536);
+                            for(seed = 0; seed < 1024; ++seed) {
+                                mask = size - 1;
+                                slots.assign(size, UNKNOWN);
+                                bool ok = true;
+                                for(int id = 1; ok && id < NUM_NAMES; ++id) {
+                                    unsigned char& slot = slots.at(hash(strings[id], lengths[id], seed) & mask);
+                                    if(slot != UNKNOWN) {
+                                        ok = false;
+                                    } else {
+                                        slot = (unsigned char)id;
+                                    }
+                                }
+                                if(ok) {
+                                    return;
+                                }
+                            }
+                        }
+                    }
+                    Id lookup(const char* p, size_t n) const {
+                        const Id id = (Id)slots[hash(p, n, seed) & mask];
+                        if(id != UNKNOWN && lengths[id] == n && memcmp(strings[id], p, n) == 0) {
+                            return id;
+                        }
+                        return UNKNOWN;
+                    }
+                private:
+                    uint32_t seed;
+                    uint32_t mask;
+                    std::vector<unsigned char> slots;
+                    size_t lengths[NUM_NAMES];
+                };
+
+                const NameTable& table() {
+                    static const NameTable t;
+                    return t;
+                }
+            }
+
+            Id intern(const dashp2p::xml::StrRef& name) {
+                return table().lookup(name.data(), name.size());
+            }
+
+            const char* toString(Id id) {
+                return (id > UNKNOWN && id < NUM_NAMES) ? strings[id] : "";
+            }
         }
 
-        inline static unsigned int convertUnsignedInt(const std::string& value) {
+        /* Leading digits, as atoi() did, without copying the value. */
+        inline static unsigned int convertUnsignedInt(const dashp2p::xml::StrRef& value) {
             // TODO: is this a problem?
-            return (unsigned) std::atoi(value.c_str());
+            size_t i= 0;
+            while(i < value.size() && (value[i] == ' ' || value[i] == '\t' || value[i] == '\n' || value[i] == '\r')) {
+                ++i;
+            }
+            unsigned int val= 0;
+            for( ; i < value.size() && value[i] >= '0' && value[i] <= '9'; ++i) {
+                val= 10 * val + (value[i] - '0');
+            }
+            return val;
+        }
+
+        /* As convertUnsignedInt(), for 64-bit media times. */
+        inline static uint64_t convertUnsignedLong(const dashp2p::xml::StrRef& value) {
+            size_t i= 0;
+            while(i < value.size() && (value[i] == ' ' || value[i] == '\t' || value[i] == '\n' || value[i] == '\r')) {
+                ++i;
+            }
+            uint64_t val= 0;
+            for( ; i < value.size() && value[i] >= '0' && value[i] <= '9'; ++i) {
+                val= 10 * val + (value[i] - '0');
+            }
+            return val;
+        }
+
+        inline static int convertInt(const dashp2p::xml::StrRef& value) {
+            size_t i= 0;
+            while(i < value.size() && (value[i] == ' ' || value[i] == '\t' || value[i] == '\n' || value[i] == '\r')) {
+                ++i;
+            }
+            if(i < value.size() && value[i] == '-') {
+                return -(int)convertUnsignedInt(dashp2p::xml::StrRef(value.data() + i + 1, value.size() - i - 1));
+            }
+            return (int)convertUnsignedInt(value);
+        }
+
+        /* Like strtod(), but also accepts "INF" (availabilityTimeOffset). */
+        static double convertDoubleOrInf(const dashp2p::xml::StrRef& value) {
+            const std::string s(value.data(), value.size());
+            if(s.find("INF") != std::string::npos) {
+                return std::numeric_limits<double>::infinity();
+            }
+            return strtod(s.c_str(), NULL);
         }
 
-        static bool convertBool(const std::string& value) {
+        static bool convertBool(const dashp2p::xml::StrRef& value) {
             // FIXME: better conversion!
             bool val= true;
-            if(value.at(0) == 'F' || value.at(0) == 'f') {
+            if(!value.empty() && (value[0] == 'F' || value[0] == 'f')) {
                 val= false;
             }
 
@@ -369,7 +547,10 @@ std::cout << __FILE__ << '(' << __LINE__ << ") ERROR DURING CONVERSION " << e.wh
 
         ParserContext::ParserContext(const ModelFactory& modelFactory):
             factory(modelFactory),
-            _parsers()
+            arena(NULL),
+            _parsers(),
+            _lastDescriptor(NULL),
+            _lastParser(NULL)
         {}
 
         ParserContext::~ParserContext() {
@@ -384,6 +565,10 @@ std::cout << __FILE__ << '(' << __LINE__ << ") ERROR DURING CONVERSION " << e.wh
             const ParserDescriptor* descrPtr= &descriptor;
             ElementParserBase* parser;
 
+            if(descrPtr == _lastDescriptor) {
+                return _lastParser;
+            }
+
             std::map<const ParserDescriptor*, ElementParserBase*>::const_iterator lookup= _parsers.find(descrPtr);
 
             if(lookup == _parsers.end()) {
@@ -396,6 +581,8 @@ std::cout << __FILE__ << '(' << __LINE__ << ") ERROR DURING CONVERSION " << e.wh
                 parser= lookup->second;
             }
 
+            _lastDescriptor= descrPtr;
+            _lastParser= parser;
             return parser;
         }
 
@@ -406,15 +593,15 @@ std::cout << __FILE__ << '(' << __LINE__ << ") ERROR DURING CONVERSION " << e.wh
             return initialiseObject();
         }
 
-        void ElementParserBase::attachAttribute(const std::string&, const std::string&) {
+        void ElementParserBase::attachAttribute(names::Id, const dashp2p::xml::StrRef&) {
             // TODO: report unknown attribute
         }
 
-        void ElementParserBase::attachContent(const std::string&) {
+        void ElementParserBase::attachContent(const dashp2p::xml::StrRef&) {
             // TODO: report content is invalid for complex type
         }
 
-        ElementParserBase* ElementParserBase::attachElement(const std::string&) {
+        ElementParserBase* ElementParserBase::attachElement(names::Id) {
             // TODO report unknown element
             return NULL;
         }
@@ -433,7 +620,7 @@ std::cout << __FILE__ << '(' << __LINE__ << ") ERROR DURING CONVERSION " << e.wh
         AdaptationSetParser::AdaptationSetParser() : _element(NULL) {}
 
         void* AdaptationSetParser::initialiseObject() {
-            _element= ctx->factory.createAdaptationSet();
+            _element= ctx->factory.createAdaptationSet(*ctx->arena);
             return _element;
         }
 
@@ -446,24 +633,42 @@ std::cout << __FILE__ << '(' << __LINE__ << ") ERROR DURING CONVERSION " << e.wh
             return _element;
         }
 
-        void AdaptationSetParser::attachAttribute(const std::string& name, const std::string& value) {
+        void AdaptationSetParser::attachAttribute(names::Id name, const dashp2p::xml::StrRef& value) {
             // TODO: parse all attributes!
 
-            if(name == "bitstreamSwitching") {
+            if(name == names::bitstreamSwitching) {
                 _element->bitstreamSwitching.set(convertBool(value));
             } else {
                 RepresentationBaseParser::attachAttribute(name, value);
             }
         }
 
-        ElementParserBase* AdaptationSetParser::attachElement(const std::string& name) {
+        ElementParserBase* AdaptationSetParser::attachElement(names::Id name) {
             // TODO: parse all inner elements!
             ElementParserBase* parser= NULL;
-            if(name == "Representation") {
+            if(name == names::Representation) {
                 parser= ctx->getParser(ParserDescriptor::REPRESENTATION);
                 if(parser != NULL) {
                     Representation* r= static_cast<Representation*>(parser->pre(this));
-                    _element->representations.addRef(r);
+                    _element->representations.addRef(r, *ctx->arena);
+                }
+            } else if(name == names::SegmentBase) {
+                parser= ctx->getParser(ParserDescriptor::SEGMENT_BASE);
+                if(parser != NULL) {
+                    SegmentBase* sb= static_cast<SegmentBase*>(parser->pre(this));
+                    _element->segmentBase.handOver(sb);
+                }
+            } else if(name == names::SegmentList) {
+                parser= ctx->getParser(ParserDescriptor::SEGMENT_LIST);
+                if(parser != NULL) {
+                    SegmentList* sl= static_cast<SegmentList*>(parser->pre(this));
+                    _element->segmentList.handOver(sl);
+                }
+            } else if(name == names::SegmentTemplate) {
+                parser= ctx->getParser(ParserDescriptor::SEGMENT_TEMPLATE);
+                if(parser != NULL) {
+                    SegmentTemplate* st= static_cast<SegmentTemplate*>(parser->pre(this));
+                    _element->segmentTemplate.handOver(st);
                 }
             }
 
@@ -479,7 +684,7 @@ std::cout << __FILE__ << '(' << __LINE__ << ") ERROR DURING CONVERSION " << e.wh
         BaseURLParser::BaseURLParser() : _element(NULL) {}
 
         void* BaseURLParser::initialiseObject() {
-            _element= ctx->factory.createBaseURL();
+            _element= ctx->factory.createBaseURL(*ctx->arena);
             return _element;
         }
 
@@ -488,18 +693,18 @@ std::cout << __FILE__ << '(' << __LINE__ << ") ERROR DURING CONVERSION " << e.wh
             _element= NULL;
         }
 
-        void BaseURLParser::attachAttribute(const std::string& name, const std::string& value) {
-            if(name == "serviceLocation") {
-                _element->serviceLocation.set(value);
-            } else if(name == "byteRange") {
-                _element->byteRange.set(value);
+        void BaseURLParser::attachAttribute(names::Id name, const dashp2p::xml::StrRef& value) {
+            if(name == names::serviceLocation) {
+                _element->serviceLocation.set(value, *ctx->arena);
+            } else if(name == names::byteRange) {
+                _element->byteRange.set(value, *ctx->arena);
             } else {
                 // TODO: report unknown attribute
             }
         }
 
-        void BaseURLParser::attachContent(const std::string& content) {
-            _element->value.set(content);
+        void BaseURLParser::attachContent(const dashp2p::xml::StrRef& content) {
+            _element->value.set(content, *ctx->arena);
         }
 
 
@@ -509,6 +714,7 @@ std::cout << __FILE__ << '(' << __LINE__ << ") ERROR DURING CONVERSION " << e.wh
 
         void* MediaPresentationDescriptionParser::initialiseObject() {
             _element= ctx->factory.createMediaPresentationDescription();
+            ctx->arena= &_element->arena;
             return _element;
         }
 
@@ -517,12 +723,12 @@ std::cout << __FILE__ << '(' << __LINE__ << ") ERROR DURING CONVERSION " << e.wh
             _element= NULL;
         }
 
-        void MediaPresentationDescriptionParser::attachAttribute(const std::string &name, const std::string &value) {
-            if(name == "id") {
-                _element->id.set(value);
-            } else if(name == "profiles") {
-                _element->profiles.set(value);
-            } else if(name == "type") {
+        void MediaPresentationDescriptionParser::attachAttribute(names::Id name, const dashp2p::xml::StrRef& value) {
+            if(name == names::id) {
+                _element->id.set(value, *ctx->arena);
+            } else if(name == names::profiles) {
+                _element->profiles.set(value, *ctx->arena);
+            } else if(name == names::type) {
                 if(value == "static") {
                     _element->type.set(EPresentation::STATIC);
                 } else if(value == "dynamic") {
@@ -530,60 +736,60 @@ std::cout << __FILE__ << '(' << __LINE__ << ") ERROR DURING CONVERSION " << e.wh
                 } else {
                     // TODO: report invalid value
                 }
-            } else if(name == "availabilityStartTime") {
+            } else if(name == names::availabilityStartTime) {
                 _element->availabilityStartTime.handOver(convertDateTime(value));
-            } else if(name == "availabilityEndTime") {
+            } else if(name == names::availabilityEndTime) {
                 _element->availabilityEndTime.handOver(convertDateTime(value));
-            } else if(name == "mediaPresentationDuration") {
+            } else if(name == names::mediaPresentationDuration) {
                 _element->mediaPresentationDuration.handOver(convertDuration(value));
-            } else if(name == "minimumUpdatePeriod") {
+            } else if(name == names::minimumUpdatePeriod) {
                 _element->minimumUpdatePeriod.handOver(convertDuration(value));
-            } else if(name == "minBufferTime") {
+            } else if(name == names::minBufferTime) {
                 _element->minBufferTime.handOver(convertDuration(value));
-            } else if(name == "timeShiftBufferDepth") {
+            } else if(name == names::timeShiftBufferDepth) {
                 _element->timeShiftBufferDepth.handOver(convertDuration(value));
-            } else if(name == "suggestedPresentationDelay") {
+            } else if(name == names::suggestedPresentationDelay) {
                 _element->suggestedPresentationDelay.handOver(convertDuration(value));
-            } else if(name == "maxSegmentDuration") {
+            } else if(name == names::maxSegmentDuration) {
                 _element->maxSegmentDuration.handOver(convertDuration(value));
-            } else if(name == "maxSubsegmentDuration") {
+            } else if(name == names::maxSubsegmentDuration) {
                 _element->maxSubsegmentDuration.handOver(convertDuration(value));
             } else {
                 // TODO report warning about unknown attribute
             }
         }
 
-        ElementParserBase* MediaPresentationDescriptionParser::attachElement(const std::string & name) {
+        ElementParserBase* MediaPresentationDescriptionParser::attachElement(names::Id name) {
             ElementParserBase* parser= NULL;
-            if(name == "ProgramInformation") {
+            if(name == names::ProgramInformation) {
                 parser= ctx->getParser(ParserDescriptor::PROGRAM_INFORMATION);
                 if(parser != NULL) {
                     ProgramInformation* pi= static_cast<ProgramInformation*>(parser->pre(this));
-                    _element->programInformations.addRef(pi);
+                    _element->programInformations.addRef(pi, *ctx->arena);
                 }
-            } else if(name == "BaseURL") {
+            } else if(name == names::BaseURL) {
                 parser= ctx->getParser(ParserDescriptor::BASE_URL);
                 if(parser != NULL) {
                     BaseURL* b= static_cast<BaseURL*>(parser->pre(this));
-                    _element->baseURLs.addRef(b);
+                    _element->baseURLs.addRef(b, *ctx->arena);
                 }
-            } else if(name == "Location") {
+            } else if(name == names::Location) {
                 parser= ctx->getParser(SIMPLE_STRING_SEQUENCE);
                 if(parser != NULL) {
                     parser->pre(this);
                     (static_cast<SimpleStringSequenceParser*>(parser))->setSequencePtr(&(_element->locations));
                 }
-            } else if(name == "Period") {
+            } else if(name == names::Period) {
                 parser= ctx->getParser(ParserDescriptor::PERIOD);
                 if(parser != NULL) {
                     Period* p= static_cast<Period*>(parser->pre(this));
-                    _element->periods.addRef(p);
+                    _element->periods.addRef(p, *ctx->arena);
                 }
-            } else if(name == "Metrics") {
+            } else if(name == names::Metrics) {
                 parser= ctx->getParser(ParserDescriptor::METRICS);
                 if(parser != NULL) {
                     Metrics* m= static_cast<Metrics*>(parser->pre(this));
-                    _element->metrics.addRef(m);
+                    _element->metrics.addRef(m, *ctx->arena);
                 }
             }
 
@@ -594,7 +800,7 @@ std::cout << __FILE__ << '(' << __LINE__ << ") ERROR DURING CONVERSION " << e.wh
         PeriodParser::PeriodParser() : _element(NULL) {}
 
         void* PeriodParser::initialiseObject() {
-            _element= ctx->factory.createPeriod();
+            _element= ctx->factory.createPeriod(*ctx->arena);
             return _element;
         }
 
@@ -603,10 +809,10 @@ std::cout << __FILE__ << '(' << __LINE__ << ") ERROR DURING CONVERSION " << e.wh
             _element= NULL;
         }
 
-        void PeriodParser::attachAttribute(const std::string& name, const std::string& value) {
-            if(name == "href") {
-                _element->href.set(value);
-            } else if(name == "actuate") {
+        void PeriodParser::attachAttribute(names::Id name, const dashp2p::xml::StrRef& value) {
+            if(name == names::href) {
+                _element->href.set(value, *ctx->arena);
+            } else if(name == names::actuate) {
                 if(value == "onLoad") {
                     _element->actuate.set(EActuate::ON_LOAD);
                 } else if (value == "onRequest") {
@@ -614,54 +820,54 @@ std::cout << __FILE__ << '(' << __LINE__ << ") ERROR DURING CONVERSION " << e.wh
                 } else {
                     // TODO: report invalid attribute value!
                 }
-            } else if(name == "id") {
-                _element->id.set(value);
-            } else if(name == "start") {
+            } else if(name == names::id) {
+                _element->id.set(value, *ctx->arena);
+            } else if(name == names::start) {
                 _element->start.handOver(convertDuration(value));
-            } else if(name == "duration") {
+            } else if(name == names::duration) {
                 _element->duration.handOver(convertDuration(value));
-            } else if(name == "bitstreamSwitching") {
+            } else if(name == names::bitstreamSwitching) {
                 _element->bitstreamSwitching.set(convertBool(value));
             }
         }
 
-        ElementParserBase* PeriodParser::attachElement(const std::string& name) {
+        ElementParserBase* PeriodParser::attachElement(names::Id name) {
             ElementParserBase* parser= NULL;
-            if(name == "BaseURL") {
+            if(name == names::BaseURL) {
                 parser= ctx->getParser(ParserDescriptor::BASE_URL);
                 if(parser != NULL) {
                     BaseURL* b= static_cast<BaseURL*>(parser->pre(this));
-                    _element->baseURLs.addRef(b);
+                    _element->baseURLs.addRef(b, *ctx->arena);
                 }
-            } else if(name == "SegmentBase") {
+            } else if(name == names::SegmentBase) {
                 parser= ctx->getParser(ParserDescriptor::SEGMENT_BASE);
                 if(parser != NULL) {
                     SegmentBase* sb= static_cast<SegmentBase*>(parser->pre(this));
                     _element->segmentBase.handOver(sb);
                 }
-            } else if(name == "SegmentList") {
+            } else if(name == names::SegmentList) {
                 parser= ctx->getParser(ParserDescriptor::SEGMENT_LIST);
                 if(parser != NULL) {
                     SegmentList* sl= static_cast<SegmentList*>(parser->pre(this));
                     _element->segmentList.handOver(sl);
                 }
-            } else if(name == "SegmentTemplate") {
+            } else if(name == names::SegmentTemplate) {
                 parser= ctx->getParser(ParserDescriptor::SEGMENT_TEMPLATE);
                 if(parser != NULL) {
                     SegmentTemplate* st= static_cast<SegmentTemplate*>(parser->pre(this));
                     _element->segmentTemplate.handOver(st);
                 }
-            } else if(name == "AdaptationSet") {
+            } else if(name == names::AdaptationSet) {
                 parser= ctx->getParser(ParserDescriptor::ADAPTATION_SET);
                 if(parser != NULL) {
                     AdaptationSet* as= static_cast<AdaptationSet*>(parser->pre(this));
-                    _element->adaptationSets.addRef(as);
+                    _element->adaptationSets.addRef(as, *ctx->arena);
                 }
-            } else if(name == "Subset") {
+            } else if(name == names::Subset) {
                 parser= ctx->getParser(ParserDescriptor::SUBSET);
                 if(parser != NULL) {
                     Subset* ss= static_cast<Subset*>(parser->pre(this));
-                    _element->subSets.addRef(ss);
+                    _element->subSets.addRef(ss, *ctx->arena);
                 }
             }
 
@@ -672,7 +878,7 @@ std::cout << __FILE__ << '(' << __LINE__ << ") ERROR DURING CONVERSION " << e.wh
         ProgramInformationParser::ProgramInformationParser() : _element(NULL) {}
 
         void* ProgramInformationParser::initialiseObject() {
-            _element= ctx->factory.createProgramInformation();
+            _element= ctx->factory.createProgramInformation(*ctx->arena);
             return _element;
         }
 
@@ -681,31 +887,31 @@ std::cout << __FILE__ << '(' << __LINE__ << ") ERROR DURING CONVERSION " << e.wh
             _element= NULL;
         }
 
-        void ProgramInformationParser::attachAttribute(const std::string& name, const std::string& value) {
-            if(name == "lang") {
-                _element->lang.set(value);
-            } else if(name == "moreInformationURL") {
-                _element->moreInformationURL.set(value);
+        void ProgramInformationParser::attachAttribute(names::Id name, const dashp2p::xml::StrRef& value) {
+            if(name == names::lang) {
+                _element->lang.set(value, *ctx->arena);
+            } else if(name == names::moreInformationURL) {
+                _element->moreInformationURL.set(value, *ctx->arena);
             } else {
                 // TODO: report unknown attribute
             }
         }
 
-        ElementParserBase* ProgramInformationParser::attachElement(const std::string& name) {
+        ElementParserBase* ProgramInformationParser::attachElement(names::Id name) {
             ElementParserBase* parser= NULL;
-            if(name == "Title") {
+            if(name == names::Title) {
                 parser= ctx->getParser(SIMPLE_STRING);
                 if(parser != NULL) {
                     parser->pre(this);
                     (static_cast<SimpleStringParser*>(parser))->setFieldPtr(&(_element->title));
                 }
-            } else if(name == "Source") {
+            } else if(name == names::Source) {
                 parser= ctx->getParser(SIMPLE_STRING);
                 if(parser != NULL) {
                     parser->pre(this);
                     (static_cast<SimpleStringParser*>(parser))->setFieldPtr(&(_element->source));
                 }
-            } else if(name == "Copyright") {
+            } else if(name == names::Copyright) {
                 parser= ctx->getParser(SIMPLE_STRING);
                 if(parser != NULL) {
                     parser->pre(this);
@@ -720,7 +926,7 @@ std::cout << __FILE__ << '(' << __LINE__ << ") ERROR DURING CONVERSION " << e.wh
         RepresentationParser::RepresentationParser() : _element(NULL) {}
 
         void* RepresentationParser::initialiseObject() {
-            _element= ctx->factory.createRepresentation();
+            _element= ctx->factory.createRepresentation(*ctx->arena);
             return _element;
         }
 
@@ -733,49 +939,49 @@ std::cout << __FILE__ << '(' << __LINE__ << ") ERROR DURING CONVERSION " << e.wh
             return _element;
         }
 
-        void RepresentationParser::attachAttribute(const std::string& name, const std::string& value) {
-            if(name == "id") {
-                _element->id.set(value);
-            } else if(name == "bandwidth") {
+        void RepresentationParser::attachAttribute(names::Id name, const dashp2p::xml::StrRef& value) {
+            if(name == names::id) {
+                _element->id.set(value, *ctx->arena);
+            } else if(name == names::bandwidth) {
                 _element->bandwidth.set(convertUnsignedInt(value));
-            } else if(name == "qualityRanking") {
+            } else if(name == names::qualityRanking) {
                 _element->qualityRanking.set(convertUnsignedInt(value));
-            } else if(name == "dependencyId") {
+            } else if(name == names::dependencyId) {
                 // TODO: split string and put parts into sequence
-            } else if(name == "mediaStreamStructureId") {
+            } else if(name == names::mediaStreamStructureId) {
                 // TODO: split string and put parts into sequence
             } else {
                 RepresentationBaseParser::attachAttribute(name, value);
             }
         }
 
-        ElementParserBase* RepresentationParser::attachElement(const std::string& name) {
+        ElementParserBase* RepresentationParser::attachElement(names::Id name) {
             ElementParserBase* parser= NULL;
-            if(name == "BaseURL") {
+            if(name == names::BaseURL) {
                 parser= ctx->getParser(ParserDescriptor::BASE_URL);
                 if(parser != NULL) {
                     BaseURL* b= static_cast<BaseURL*>(parser->pre(this));
-                    _element->baseURLs.addRef(b);
+                    _element->baseURLs.addRef(b, *ctx->arena);
                 }
-            } else if(name == "SubRepresentation") {
+            } else if(name == names::SubRepresentation) {
                 parser= ctx->getParser(ParserDescriptor::SUB_REPRESENTATION);
                 if(parser != NULL) {
                     SubRepresentation* sr= static_cast<SubRepresentation*>(parser->pre(this));
-                    _element->subRepresentations.addRef(sr);
+                    _element->subRepresentations.addRef(sr, *ctx->arena);
                 }
-            } else if(name == "SegmentBase") {
+            } else if(name == names::SegmentBase) {
                 parser= ctx->getParser(ParserDescriptor::SEGMENT_BASE);
                 if(parser != NULL) {
                     SegmentBase* sb= static_cast<SegmentBase*>(parser->pre(this));
                     _element->segmentBase.handOver(sb);
                 }
-            } else if(name == "SegmentList") {
+            } else if(name == names::SegmentList) {
                 parser= ctx->getParser(ParserDescriptor::SEGMENT_LIST);
                 if(parser != NULL) {
                     SegmentList* sl= static_cast<SegmentList*>(parser->pre(this));
                     _element->segmentList.handOver(sl);
                 }
-            } else if(name == "SegmentTemplate") {
+            } else if(name == names::SegmentTemplate) {
                 parser= ctx->getParser(ParserDescriptor::SEGMENT_TEMPLATE);
                 if(parser != NULL) {
                     SegmentTemplate* st= static_cast<SegmentTemplate*>(parser->pre(this));
@@ -789,37 +995,37 @@ std::cout << __FILE__ << '(' << __LINE__ << ") ERROR DURING CONVERSION " << e.wh
         }
 
 
-        void RepresentationBaseParser::attachAttribute(const std::string& name, const std::string& value) {
+        void RepresentationBaseParser::attachAttribute(names::Id name, const dashp2p::xml::StrRef& value) {
             RepresentationBase* element= getModelObject();
 
-            if(name == "profiles") {
-                element->profiles.set(value);
-            } else if(name == "width") {
+            if(name == names::profiles) {
+                element->profiles.set(value, *ctx->arena);
+            } else if(name == names::width) {
                 element->width.set(convertUnsignedInt(value));
-            } else if(name == "height") {
+            } else if(name == names::height) {
                 element->height.set(convertUnsignedInt(value));
-            } else if(name == "sar") {
-                element->sar.set(value);
-            } else if(name == "frameRate") {
-                element->frameRate.set(value);
-            } else if(name == "audioSamplingRate") {
-                element->audioSamplingRate.set(value);
-            } else if(name == "mimeType") {
-                element->mimeType.set(value);
-            } else if(name == "segmentProfiles") {
-                element->segmentProfiles.set(value);
-            } else if(name == "codecs") {
-                element->codecs.set(value);
-            } else if(name == "maximumSAPPeriod") {
+            } else if(name == names::sar) {
+                element->sar.set(value, *ctx->arena);
+            } else if(name == names::frameRate) {
+                element->frameRate.set(value, *ctx->arena);
+            } else if(name == names::audioSamplingRate) {
+                element->audioSamplingRate.set(value, *ctx->arena);
+            } else if(name == names::mimeType) {
+                element->mimeType.set(value, *ctx->arena);
+            } else if(name == names::segmentProfiles) {
+                element->segmentProfiles.set(value, *ctx->arena);
+            } else if(name == names::codecs) {
+                element->codecs.set(value, *ctx->arena);
+            } else if(name == names::maximumSAPPeriod) {
                 element->maximumSAPPeriod.handOver(convertDouble(value));
-            } else if(name == "startWithSAP") {
+            } else if(name == names::startWithSAP) {
                 // FIXME: better conversion ?!
-                element->startWithSAP.set((unsigned char) std::atoi(value.c_str()));
-            } else if(name == "maxPlayoutRate") {
+                element->startWithSAP.set((unsigned char) convertUnsignedInt(value));
+            } else if(name == names::maxPlayoutRate) {
                 element->maxPlayoutRate.handOver(convertDouble(value));
-            } else if(name == "codingDependency") {
+            } else if(name == names::codingDependency) {
                 element->codingDependency.set(convertBool(value));
-            } else if(name == "scanType") {
+            } else if(name == names::scanType) {
                 if(value == "progressive") {
                     element->scanType.set(EVideoScan::PROGRESSIVE);
                 } else if(value == "interlaced") {
@@ -834,26 +1040,26 @@ std::cout << __FILE__ << '(' << __LINE__ << ") ERROR DURING CONVERSION " << e.wh
             }
         }
 
-        ElementParserBase* RepresentationBaseParser::attachElement(const std::string& name) {
+        ElementParserBase* RepresentationBaseParser::attachElement(names::Id name) {
             RepresentationBase* element= getModelObject();
             ElementParserBase* parser= NULL;
-            if(name == "FramePacking") {
+            if(name == names::FramePacking) {
                 parser= ctx->getParser(ParserDescriptor::DESCRIPTOR);
                 if(parser != NULL) {
                     Descriptor* fp= static_cast<Descriptor*>(parser->pre(this));
-                    element->framePackagings.addRef(fp);
+                    element->framePackagings.addRef(fp, *ctx->arena);
                 }
-            } else if(name == "AudioChannelConfiguration") {
+            } else if(name == names::AudioChannelConfiguration) {
                 parser= ctx->getParser(ParserDescriptor::DESCRIPTOR);
                 if(parser != NULL) {
                     Descriptor* acc= static_cast<Descriptor*>(parser->pre(this));
-                    element->audioChannelConfigurations.addRef(acc);
+                    element->audioChannelConfigurations.addRef(acc, *ctx->arena);
                 }
-            } else if(name == "ContentProtection") {
+            } else if(name == names::ContentProtection) {
                 parser= ctx->getParser(ParserDescriptor::DESCRIPTOR);
                 if(parser != NULL) {
                     Descriptor* cp= static_cast<Descriptor*>(parser->pre(this));
-                    element->contentProtections.addRef(cp);
+                    element->contentProtections.addRef(cp, *ctx->arena);
                 }
             }
 
@@ -861,33 +1067,37 @@ std::cout << __FILE__ << '(' << __LINE__ << ") ERROR DURING CONVERSION " << e.wh
         }
 
 
-        void AbstractSegmentBaseParser::attachAttribute(const std::string& name, const std::string& value) {
+        void AbstractSegmentBaseParser::attachAttribute(names::Id name, const dashp2p::xml::StrRef& value) {
             SegmentBase* element= getSegmentBase();
 
-            if(name == "timescale") {
+            if(name == names::timescale) {
                 element->timescale.set(convertUnsignedInt(value));
-            } else if(name == "presentationTimeOffset") {
-                element->presentationTimeOffset.set(convertUnsignedInt(value));
-            } else if(name == "indexRange") {
-                element->indexRange.set(value);
-            } else if(name == "indexRangeExact") {
+            } else if(name == names::presentationTimeOffset) {
+                element->presentationTimeOffset.set(convertUnsignedLong(value));
+            } else if(name == names::indexRange) {
+                element->indexRange.set(value, *ctx->arena);
+            } else if(name == names::indexRangeExact) {
                 element->indexRangeExact.set(convertBool(value));
+            } else if(name == names::availabilityTimeOffset) {
+                element->availabilityTimeOffset.set(convertDoubleOrInf(value));
+            } else if(name == names::availabilityTimeComplete) {
+                element->availabilityTimeComplete.set(convertBool(value));
             } else {
                 // TODO report unknown attribute
             }
         }
 
-        ElementParserBase* AbstractSegmentBaseParser::attachElement(const std::string& name) {
+        ElementParserBase* AbstractSegmentBaseParser::attachElement(names::Id name) {
             SegmentBase* element= getSegmentBase();
             ElementParserBase* parser= NULL;
 
-            if(name == "Initialization" || name == "Initialisation") {
+            if(name == names::Initialization || name == names::Initialisation) {
                 parser= ctx->getParser(ParserDescriptor::URL_RANGE);
                 if(parser != NULL) {
                     URLRange* u= static_cast<URLRange*>(parser->pre(this));
                     element->initialization.handOver(u);
                 }
-            } else if(name == "RepresentationIndex") {
+            } else if(name == names::RepresentationIndex) {
                 parser= ctx->getParser(ParserDescriptor::URL_RANGE);
                 if(parser != NULL) {
                     URLRange* u= static_cast<URLRange*>(parser->pre(this));
@@ -901,29 +1111,29 @@ std::cout << __FILE__ << '(' << __LINE__ << ") ERROR DURING CONVERSION " << e.wh
         }
 
 
-        void AbstractMultipleSegmentBaseParser::attachAttribute(const std::string& name, const std::string& value) {
+        void AbstractMultipleSegmentBaseParser::attachAttribute(names::Id name, const dashp2p::xml::StrRef& value) {
             MultipleSegmentBase* element= getMultipleSegmentBase();
 
-            if(name == "duration") {
+            if(name == names::duration) {
                 element->duration.set(convertUnsignedInt(value));
-            } else if(name == "startNumber") {
+            } else if(name == names::startNumber) {
                 element->startNumber.set(convertUnsignedInt(value));
             } else {
                 AbstractSegmentBaseParser::attachAttribute(name, value);
             }
         }
 
-        ElementParserBase* AbstractMultipleSegmentBaseParser::attachElement(const std::string& name) {
+        ElementParserBase* AbstractMultipleSegmentBaseParser::attachElement(names::Id name) {
             MultipleSegmentBase* element= getMultipleSegmentBase();
             ElementParserBase* parser= NULL;
 
-            if(name == "SegmentTimeline") {
+            if(name == names::SegmentTimeline) {
                 parser= ctx->getParser(ParserDescriptor::SEGMENT_TIMELINE);
                 if(parser != NULL) {
                     SegmentTimeline* st= static_cast<SegmentTimeline*>(parser->pre(this));
                     element->segmentTimeline.handOver(st);
                 }
-            } else if(name == "BitstreamSwitching") {
+            } else if(name == names::BitstreamSwitching) {
                 parser= ctx->getParser(ParserDescriptor::URL_RANGE);
                 if(parser != NULL) {
                     URLRange* u= static_cast<URLRange*>(parser->pre(this));
@@ -944,7 +1154,7 @@ std::cout << __FILE__ << '(' << __LINE__ << ") ERROR DURING CONVERSION " << e.wh
         SegmentBaseParser::SegmentBaseParser() : _element(NULL) {}
 
         void* SegmentBaseParser::initialiseObject() {
-            _element= ctx->factory.createSegmentBase();
+            _element= ctx->factory.createSegmentBase(*ctx->arena);
             return _element;
         }
 
@@ -961,7 +1171,7 @@ std::cout << __FILE__ << '(' << __LINE__ << ") ERROR DURING CONVERSION " << e.wh
         SegmentListParser::SegmentListParser() : _element(NULL) {}
 
         void* SegmentListParser::initialiseObject() {
-            _element= ctx->factory.createSegmentList();
+            _element= ctx->factory.createSegmentList(*ctx->arena);
             return _element;
         }
 
@@ -974,10 +1184,10 @@ std::cout << __FILE__ << '(' << __LINE__ << ") ERROR DURING CONVERSION " << e.wh
             return _element;
         }
 
-        void SegmentListParser::attachAttribute(const std::string& name, const std::string& value) {
-            if(name == "href") {
-                _element->href.set(value);
-            } else if(name == "actuate") {
+        void SegmentListParser::attachAttribute(names::Id name, const dashp2p::xml::StrRef& value) {
+            if(name == names::href) {
+                _element->href.set(value, *ctx->arena);
+            } else if(name == names::actuate) {
                 if(value == "onLoad") {
                     _element->actuate.set(EActuate::ON_LOAD);
                 } else if (value == "onRequest") {
@@ -990,14 +1200,14 @@ std::cout << __FILE__ << '(' << __LINE__ << ") ERROR DURING CONVERSION " << e.wh
             }
         }
 
-        ElementParserBase* SegmentListParser::attachElement(const std::string& name) {
+        ElementParserBase* SegmentListParser::attachElement(names::Id name) {
             ElementParserBase* parser= NULL;
 
-            if(name == "SegmentURL") {
+            if(name == names::SegmentURL) {
                 parser= ctx->getParser(ParserDescriptor::SEGMENT_URL);
                 if(parser != NULL) {
                     SegmentURL* su= static_cast<SegmentURL*>(parser->pre(this));
-                    _element->segmentURLs.addRef(su);
+                    _element->segmentURLs.addRef(su, *ctx->arena);
                 }
             } else {
                 parser= AbstractMultipleSegmentBaseParser::attachElement(name);
@@ -1007,10 +1217,93 @@ std::cout << __FILE__ << '(' << __LINE__ << ") ERROR DURING CONVERSION " << e.wh
         }
 
 
+        SegmentTemplateParser::SegmentTemplateParser() : _element(NULL) {}
+
+        void* SegmentTemplateParser::initialiseObject() {
+            _element= ctx->factory.createSegmentTemplate(*ctx->arena);
+            return _element;
+        }
+
+        void SegmentTemplateParser::validateObject() {
+            // TODO
+            _element= NULL;
+        }
+
+        MultipleSegmentBase* SegmentTemplateParser::getMultipleSegmentBase() {
+            return _element;
+        }
+
+        void SegmentTemplateParser::attachAttribute(names::Id name, const dashp2p::xml::StrRef& value) {
+            if(name == names::media) {
+                _element->media.set(value, *ctx->arena);
+            } else if(name == names::index) {
+                _element->index.set(value, *ctx->arena);
+            } else if(name == names::initialization) {
+                _element->initialization.set(value, *ctx->arena);
+            } else if(name == names::bitstreamSwitching) {
+                _element->bitstreamSwitching.set(value, *ctx->arena);
+            } else {
+                AbstractMultipleSegmentBaseParser::attachAttribute(name, value);
+            }
+        }
+
+
+        SegmentTimelineParser::SegmentTimelineParser() : _element(NULL) {}
+
+        void* SegmentTimelineParser::initialiseObject() {
+            _element= ctx->factory.createSegmentTimeline(*ctx->arena);
+            return _element;
+        }
+
+        void SegmentTimelineParser::validateObject() {
+            // TODO
+            _element= NULL;
+        }
+
+        ElementParserBase* SegmentTimelineParser::attachElement(names::Id name) {
+            ElementParserBase* parser= NULL;
+
+            if(name == names::S) {
+                parser= ctx->getParser(SEGMENT_TIMELINE_S);
+                if(parser != NULL) {
+                    SegmentTimeline::S* s= static_cast<SegmentTimeline::S*>(parser->pre(this));
+                    _element->s.addRef(s, *ctx->arena);
+                }
+            }
+
+            return parser;
+        }
+
+
+        SParser::SParser() : _element(NULL) {}
+
+        void* SParser::initialiseObject() {
+            _element= ctx->factory.createS(*ctx->arena);
+            return _element;
+        }
+
+        void SParser::validateObject() {
+            // TODO: S@d is required
+            _element= NULL;
+        }
+
+        void SParser::attachAttribute(names::Id name, const dashp2p::xml::StrRef& value) {
+            if(name == names::t) {
+                _element->t.set(convertUnsignedLong(value));
+            } else if(name == names::d) {
+                _element->d.set(convertUnsignedLong(value));
+            } else if(name == names::r) {
+                _element->r.set(convertInt(value));
+            } else {
+                // TODO: report unknown attribute
+            }
+        }
+
+
         SegmentURLParser::SegmentURLParser() : _element(NULL) {}
 
         void* SegmentURLParser::initialiseObject() {
-            _element= ctx->factory.createSegmentURL();
+            _element= ctx->factory.createSegmentURL(*ctx->arena);
             return _element;
         }
 
@@ -1019,15 +1312,15 @@ std::cout << __FILE__ << '(' << __LINE__ << ") ERROR DURING CONVERSION " << e.wh
             _element= NULL;
         }
 
-        void SegmentURLParser::attachAttribute(const std::string& name, const std::string& value) {
-            if(name == "media") {
-                _element->media.set(value);
-            } else if(name == "mediaRange") {
-                _element->mediaRange.set(value);
-            } else if(name == "index") {
-                _element->index.set(value);
-            } else if(name == "indexRange") {
-                _element->indexRange.set(value);
+        void SegmentURLParser::attachAttribute(names::Id name, const dashp2p::xml::StrRef& value) {
+            if(name == names::media) {
+                _element->media.set(value, *ctx->arena);
+            } else if(name == names::mediaRange) {
+                _element->mediaRange.set(value, *ctx->arena);
+            } else if(name == names::index) {
+                _element->index.set(value, *ctx->arena);
+            } else if(name == names::indexRange) {
+                _element->indexRange.set(value, *ctx->arena);
             }
         }
 
@@ -1035,7 +1328,7 @@ std::cout << __FILE__ << '(' << __LINE__ << ") ERROR DURING CONVERSION " << e.wh
         URLRangeParser::URLRangeParser() : _element(NULL) {}
 
         void* URLRangeParser::initialiseObject() {
-            _element= ctx->factory.createURLRange();
+            _element= ctx->factory.createURLRange(*ctx->arena);
             return _element;
         }
 
@@ -1044,11 +1337,11 @@ std::cout << __FILE__ << '(' << __LINE__ << ") ERROR DURING CONVERSION " << e.wh
             _element= NULL;
         }
 
-        void URLRangeParser::attachAttribute(const std::string& name, const std::string& value) {
-            if(name == "sourceURL") {
-                _element->sourceURL.set(value);
-            } else if(name == "range") {
-                _element->range.set(value);
+        void URLRangeParser::attachAttribute(names::Id name, const dashp2p::xml::StrRef& value) {
+            if(name == names::sourceURL) {
+                _element->sourceURL.set(value, *ctx->arena);
+            } else if(name == names::range) {
+                _element->range.set(value, *ctx->arena);
             }
         }
     }
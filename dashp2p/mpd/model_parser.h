@@ -24,9 +24,42 @@
 #define MODEL_PARSER_H_
 
 #include "mpd/model.h"
+#include "xml/basic_xml.h"
 #include <string>
 #include <map>
 
+/* Element and attribute names the parsers know. */
+#define DASHP2P_MPD_NAMES(X) \
+    X(AdaptationSet) X(AudioChannelConfiguration) X(BaseURL) X(BitstreamSwitching) X(ContentProtection) X(Copyright) \
+    X(FramePacking) X(Initialisation) X(Initialization) X(Location) X(MPD) X(Metrics) X(Period) X(ProgramInformation) \
+    X(Representation) X(RepresentationIndex) X(S) X(SegmentBase) X(SegmentList) X(SegmentTemplate) X(SegmentTimeline) \
+    X(SegmentURL) X(Source) X(SubRepresentation) X(Subset) X(Title) \
+    X(actuate) X(audioSamplingRate) X(availabilityEndTime) X(availabilityStartTime) X(availabilityTimeComplete) \
+    X(availabilityTimeOffset) X(bandwidth) X(bitstreamSwitching) \
+    X(byteRange) X(codecs) X(codingDependency) X(d) X(dependencyId) X(duration) X(frameRate) X(height) X(href) X(id) X(index) \
+    X(indexRange) X(indexRangeExact) X(initialization) X(lang) X(maxPlayoutRate) X(maxSegmentDuration) X(maxSubsegmentDuration) \
+    X(maximumSAPPeriod) X(media) X(mediaPresentationDuration) X(mediaRange) X(mediaStreamStructureId) X(mimeType) \
+    X(minBufferTime) X(minimumUpdatePeriod) X(moreInformationURL) X(presentationTimeOffset) X(profiles) X(qualityRanking) \
+    X(r) X(range) X(sar) X(scanType) X(segmentProfiles) X(serviceLocation) X(sourceURL) X(start) X(startNumber) X(startWithSAP) \
+    X(suggestedPresentationDelay) X(t) X(timeShiftBufferDepth) X(timescale) X(type) X(width)
+
+namespace dashp2p {
+    namespace mpd {
+        /**
+         * Names are interned once, through a perfect hash over the known names, and the parsers dispatch on the integer.
+         * Unknown names (including qualified ones, such as "xlink:href") map to UNKNOWN.
+         */
+        namespace names {
+#define DASHP2P_MPD_NAME_ENUM(n) n,
+            enum Id {UNKNOWN = 0, DASHP2P_MPD_NAMES(DASHP2P_MPD_NAME_ENUM) NUM_NAMES};
+#undef DASHP2P_MPD_NAME_ENUM
+
+            Id intern(const dashp2p::xml::StrRef& name);
+            const char* toString(Id id);
+        }
+    }
+}
+
 namespace dashp2p {
     namespace mpd {
         struct ParserDescriptor;
@@ -73,9 +106,14 @@ namespace dashp2p {
             ElementParserBase* getParser(const ParserDescriptor& );
 
             const ModelFactory& factory;
+            /* Arena of the MPD being read. Set when the root element is created. */
+            Arena* arena;
 
         private:
             std::map<const ParserDescriptor*, ElementParserBase*> _parsers;
+            /* Last look-up. Sibling elements, such as SegmentURLs, ask for the same parser over and over. */
+            const ParserDescriptor* _lastDescriptor;
+            ElementParserBase* _lastParser;
         };
 
 
@@ -86,9 +124,9 @@ namespace dashp2p {
             virtual void* pre(ElementParserBase* parent);
             virtual ElementParserBase* post();
 
-            virtual void attachAttribute(const std::string& name, const std::string& value);
-            virtual ElementParserBase* attachElement(const std::string& name);
-            virtual void attachContent(const std::string& content);
+            virtual void attachAttribute(names::Id name, const dashp2p::xml::StrRef& value);
+            virtual ElementParserBase* attachElement(names::Id name);
+            virtual void attachContent(const dashp2p::xml::StrRef& content);
 
         protected:
             ParserContext* ctx;
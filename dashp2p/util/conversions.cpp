@@ -24,6 +24,7 @@
 
 #include <stdexcept>
 #include <sstream>
+#include <cstdio>
 
 namespace dashp2p {
     namespace util {
@@ -160,5 +161,41 @@ namespace dashp2p {
 
             return buffer.str();
         }
+
+        std::time_t dateTimeStringToTime(const std::string& value) {
+            int year= 0, month= 0, day= 0, hour= 0, minute= 0, second= 0, consumed= 0;
+            if(6 != sscanf(value.c_str(), "%d-%d-%dT%d:%d:%d%n", &year, &month, &day, &hour, &minute, &second, &consumed)
+                    || month < 1 || month > 12 || day < 1 || day > 31 || hour > 24 || minute > 59 || second > 60) {
+                throw std::invalid_argument("invalid date/time");
+            }
+
+            const char* p= value.c_str() + consumed;
+            if(*p == '.') {
+                do {
+                    ++p;
+                } while(*p >= '0' && *p <= '9');
+            }
+
+            long offset= 0;
+            if(*p == '+' || *p == '-') {
+                int offsetHours= 0, offsetMinutes= 0;
+                if(2 != sscanf(p + 1, "%2d:%2d", &offsetHours, &offsetMinutes)) {
+                    throw std::invalid_argument("invalid time zone");
+                }
+                offset= (*p == '+' ? 1 : -1) * (offsetHours * 3600L + offsetMinutes * 60L);
+            } else if(*p != 'Z' && *p != '\0') {
+                throw std::invalid_argument("invalid time zone");
+            }
+
+            /* Days since 1970-01-01 in the proleptic Gregorian calendar. */
+            const int y= year - (month <= 2 ? 1 : 0);
+            const int era= (y >= 0 ? y : y - 399) / 400;
+            const int yoe= y - era * 400;
+            const int doy= (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+            const int doe= yoe * 365 + yoe / 4 - yoe / 100 + doy;
+            const long days= (long)era * 146097 + doe - 719468;
+
+            return (std::time_t)(days * 86400L + hour * 3600L + minute * 60L + second - offset);
+        }
     }
 }
@@ -25,6 +25,7 @@
 
 #include <string>
 #include <locale>
+#include <ctime>
 
 namespace dashp2p {
     namespace util {
@@ -41,6 +42,12 @@ namespace dashp2p {
          * Only durations with parts days, hours, minutes, seconds and mseconds are created.
          */
         std::string millisToDurationString(const long& millis) throw();
+
+        /**
+         * xs:dateTime ("2013-12-04T10:00:00Z") to seconds since the epoch. Fractional seconds are dropped,
+         * a missing time zone is taken as UTC. Throws std::invalid_argument.
+         */
+        std::time_t dateTimeStringToTime(const std::string& value);
     }
 }
 
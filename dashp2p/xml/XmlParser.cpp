@@ -0,0 +1,450 @@
+/****************************************************************************
+ * XmlParser.cpp                                                            *
+ ****************************************************************************
+ * Copyright (C) 2026                                                       *
+ *                                                                          *
+ * Created on: Oct 19, 2026                                                 *
+ * Authors: agent <agent@local>                                             *
+ *                                                                          *
+ * This program is free software: you can redistribute it and/or modify     *
+ * it under the terms of the GNU General Public License as published by     *
+ * the Free Software Foundation, either version 3 of the License, or        *
+ * (at your option) any later version.                                      *
+ *                                                                          *
+ * This program is distributed in the hope that it will be useful,          *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ * GNU General Public License for more details.                             *
+ *                                                                          *
+ * You should have received a copy of the GNU General Public License        *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.     *
+ ****************************************************************************/
+
+#include "xml/XmlParser.h"
+#include "DebugAdapter.h"
+#include <cstring>
+#include <cstdlib>
+using std::string;
+
+namespace dashp2p {
+    namespace xml {
+
+        namespace {
+            enum CharClass {
+                Space = 1,
+                /* Ends element and attribute names. */
+                NameEnd = 2,
+                /* Needs decoding in text, in attribute values. */
+                TextSpecial = 4,
+                AttributeSpecial = 8
+            };
+
+            struct CharClasses {
+                unsigned char c[256];
+                CharClasses() {
+                    memset(c, 0, sizeof(c));
+                    c[(unsigned char)' '] = c[(unsigned char)'\t'] = c[(unsigned char)'\n'] = c[(unsigned char)'\r'] = Space | NameEnd;
+                    c[(unsigned char)'/'] = c[(unsigned char)'>'] = c[(unsigned char)'='] = NameEnd;
+                    c[(unsigned char)'&'] = TextSpecial | AttributeSpecial;
+                    c[(unsigned char)'\r'] |= TextSpecial | AttributeSpecial;
+                    c[(unsigned char)'\t'] |= AttributeSpecial;
+                    c[(unsigned char)'\n'] |= AttributeSpecial;
+                }
+            };
+            const CharClasses charClasses;
+
+            inline unsigned char charClass(char c) {return charClasses.c[(unsigned char)c];}
+        }
+
+        static inline bool isSpace(char c) {return charClass(c) & Space;}
+
+        /* Position of the first occurrence of s in [p, p + size), or NULL. */
+        static const char* find(const char* p, size_t size, const char* s)
+        {
+            const size_t n = strlen(s);
+            for(const char* q = p; q + n <= p + size; ++q) {
+                q = (const char*)memchr(q, s[0], p + size - q);
+                if(q == NULL || q + n > p + size)
+                    return NULL;
+                if(memcmp(q, s, n) == 0)
+                    return q;
+            }
+            return NULL;
+        }
+
+        /* Compares the beginning of [p, p + size) with s. Sets incomplete if it matches as far as it goes. */
+        static bool startsWith(const char* p, size_t size, const char* s, bool& incomplete)
+        {
+            const size_t n = strlen(s);
+            incomplete = false;
+            if(size < n) {
+                incomplete = (memcmp(p, s, size) == 0);
+                return false;
+            }
+            return memcmp(p, s, n) == 0;
+        }
+
+        XmlParser::XmlParser(BasicDocumentHandler& handler)
+          : handler(handler),
+            carry(),
+            scratch(),
+            attributes(),
+            openNames(),
+            openNameStarts(),
+            bomChecked(false),
+            rootDone(false),
+            failed(false)
+        {}
+
+        bool XmlParser::feed(const char* p, size_t size, bool last)
+        {
+            if(failed)
+                return false;
+
+            /* Complete the token left over from the last chunk, taking as little as possible from this one. */
+            size_t off = 0;
+            while(!carry.empty())
+            {
+                if(off == size && !last)
+                    return true;
+                const char* gt = (off < size) ? (const char*)memchr(p + off, '>', size - off) : NULL;
+                const size_t k = gt ? (gt - p + 1) : size;
+                const size_t carried = carry.size();
+                carry.append(p + off, k - off);
+                const size_t used = parse(carry.data(), carry.size(), last && k == size);
+                if(failed)
+                    return false;
+                if(used >= carried) {
+                    /* The rest is also in this chunk. */
+                    off += used - carried;
+                    carry.clear();
+                } else {
+                    carry.erase(0, used);
+                    off = k;
+                }
+            }
+
+            const size_t used = parse(p + off, size - off, last);
+            if(failed)
+                return false;
+            carry.assign(p + off + used, size - off - used);
+
+            if(last && !rootDone)
+                return fail("document incomplete");
+            return true;
+        }
+
+        size_t XmlParser::parse(const char* p, size_t size, bool last)
+        {
+            size_t pos = 0;
+
+            if(!bomChecked) {
+                if(size < 3 && !last)
+                    return 0;
+                if(size >= 3 && memcmp(p, "\xEF\xBB\xBF", 3) == 0)
+                    pos = 3;
+                bomChecked = true;
+            }
+
+            while(pos < size)
+            {
+                if(p[pos] != '<') {
+                    const char* lt = (const char*)memchr(p + pos, '<', size - pos);
+                    if(lt == NULL && !last)
+                        break;
+                    const size_t n = lt ? (lt - p - pos) : (size - pos);
+                    text(p + pos, n);
+                    if(failed)
+                        return pos;
+                    pos += n;
+                    continue;
+                }
+
+                const size_t n = parseMarkup(p + pos, size - pos);
+                if(failed)
+                    return pos;
+                if(n == 0)
+                    break;
+                pos += n;
+            }
+
+            if(last && pos < size)
+                fail("document incomplete");
+            return pos;
+        }
+
+        size_t XmlParser::parseMarkup(const char* p, size_t size)
+        {
+            if(size < 2)
+                return 0;
+
+            bool incomplete = false;
+
+            /* Processing instruction or XML declaration */
+            if(p[1] == '?') {
+                const char* e = find(p + 2, size - 2, "?>");
+                return e ? (e + 2 - p) : 0;
+            }
+
+            if(p[1] == '/')
+                return parseEndTag(p, size);
+
+            if(p[1] != '!')
+                return parseStartTag(p, size);
+
+            if(startsWith(p, size, "<!--", incomplete)) {
+                const char* e = find(p + 4, size - 4, "-->");
+                return e ? (e + 3 - p) : 0;
+            }
+            if(incomplete)
+                return 0;
+
+            if(startsWith(p, size, "<![CDATA[", incomplete)) {
+                const char* e = find(p + 9, size - 9, "]]>");
+                if(e == NULL)
+                    return 0;
+                if(openNameStarts.empty())
+                    return fail("CDATA outside of the root element");
+                handler.onElementValue(StrRef(p + 9, e - p - 9));
+                return e + 3 - p;
+            }
+            if(incomplete)
+                return 0;
+
+            /* DOCTYPE. Skipped, including an internal subset. */
+            int brackets = 0;
+            for(size_t i = 2; i < size; ++i) {
+                if(p[i] == '[')
+                    ++brackets;
+                else if(p[i] == ']')
+                    --brackets;
+                else if(p[i] == '>' && brackets == 0)
+                    return i + 1;
+            }
+            return 0;
+        }
+
+        size_t XmlParser::parseStartTag(const char* p, size_t size)
+        {
+            /* Attributes are collected first, so that nothing is reported for an incomplete tag. */
+            size_t i = 1;
+            while(i < size && !(charClass(p[i]) & NameEnd))
+                ++i;
+            if(i == size)
+                return 0;
+            if(i == 1)
+                return fail("element without name");
+            const StrRef name(p + 1, i - 1);
+
+            attributes.clear();
+            bool empty = false;
+            for(;;)
+            {
+                while(i < size && isSpace(p[i]))
+                    ++i;
+                if(i == size)
+                    return 0;
+                if(p[i] == '>')
+                    break;
+                if(p[i] == '/') {
+                    if(i + 1 == size)
+                        return 0;
+                    if(p[i + 1] != '>')
+                        return fail("malformed attribute");
+                    empty = true;
+                    ++i;
+                    break;
+                }
+
+                Attribute a;
+                a.name = i;
+                while(i < size && !(charClass(p[i]) & NameEnd))
+                    ++i;
+                a.nameLength = i - a.name;
+                while(i < size && isSpace(p[i]))
+                    ++i;
+                if(i == size)
+                    return 0;
+                if(p[i] != '=' || a.nameLength == 0)
+                    return fail("malformed attribute");
+                ++i;
+                while(i < size && isSpace(p[i]))
+                    ++i;
+                if(i == size)
+                    return 0;
+                if(p[i] != '"' && p[i] != '\'')
+                    return fail("attribute value not quoted");
+                const char q = p[i++];
+                const char* valueEnd = (const char*)memchr(p + i, q, size - i);
+                if(valueEnd == NULL)
+                    return 0;
+                a.value = i;
+                a.valueLength = valueEnd - p - i;
+                attributes.push_back(a);
+                i = valueEnd - p + 1;
+            }
+
+            if(openNameStarts.empty()) {
+                if(rootDone)
+                    return fail("more than one root element");
+                handler.onDocumentStart();
+            }
+            handler.onElementStart(name);
+
+            for(size_t k = 0; k < attributes.size(); ++k) {
+                const Attribute& a = attributes[k];
+                StrRef value;
+                if(!decode(p + a.value, a.valueLength, true, value))
+                    return 0;
+                handler.onAttribute(StrRef(p + a.name, a.nameLength), value);
+            }
+
+            if(empty) {
+                handler.onElementEnd(name);
+                if(openNameStarts.empty()) {
+                    rootDone = true;
+                    handler.onDocumentEnd();
+                }
+            } else {
+                openNameStarts.push_back(openNames.size());
+                openNames.append(name.data(), name.size());
+            }
+
+            return i + 1;
+        }
+
+        size_t XmlParser::parseEndTag(const char* p, size_t size)
+        {
+            const char* gt = (const char*)memchr(p, '>', size);
+            if(gt == NULL)
+                return 0;
+
+            size_t n = gt - p - 2;
+            while(n > 0 && isSpace(p[2 + n - 1]))
+                --n;
+            const StrRef name(p + 2, n);
+
+            if(openNameStarts.empty())
+                return fail("end tag without start tag");
+            const size_t start = openNameStarts.back();
+            if(openNames.size() - start != n || memcmp(openNames.data() + start, name.data(), n) != 0)
+                return fail("end tag does not match start tag");
+            openNameStarts.pop_back();
+            openNames.resize(start);
+
+            handler.onElementEnd(name);
+            if(openNameStarts.empty()) {
+                rootDone = true;
+                handler.onDocumentEnd();
+            }
+
+            return gt + 1 - p;
+        }
+
+        void XmlParser::text(const char* p, size_t size)
+        {
+            size_t i = 0;
+            while(i < size && isSpace(p[i]))
+                ++i;
+            if(i == size)
+                return;
+
+            if(openNameStarts.empty()) {
+                fail("text outside of the root element");
+                return;
+            }
+
+            StrRef value;
+            if(decode(p, size, false, value))
+                handler.onElementValue(value);
+        }
+
+        bool XmlParser::decode(const char* p, size_t size, bool attribute, StrRef& out)
+        {
+            /* Usually, there is nothing to do. */
+            const unsigned char special = attribute ? AttributeSpecial : TextSpecial;
+            size_t i = 0;
+            while(i < size && !(charClass(p[i]) & special))
+                ++i;
+            if(i == size) {
+                out = StrRef(p, size);
+                return true;
+            }
+
+            scratch.assign(p, i);
+            for( ; i < size; ++i)
+            {
+                const char c = p[i];
+                if(c == '\r') {
+                    /* Line ends are normalized to \n, in attribute values to a space. */
+                    if(i + 1 < size && p[i + 1] == '\n')
+                        ++i;
+                    scratch.push_back(attribute ? ' ' : '\n');
+                } else if(attribute && (c == '\t' || c == '\n')) {
+                    scratch.push_back(' ');
+                } else if(c == '&') {
+                    const char* semicolon = (const char*)memchr(p + i, ';', size - i);
+                    if(semicolon == NULL)
+                        return fail("unterminated reference");
+                    const StrRef ref(p + i + 1, semicolon - p - i - 1);
+                    if(ref == "lt") {
+                        scratch.push_back('<');
+                    } else if(ref == "gt") {
+                        scratch.push_back('>');
+                    } else if(ref == "amp") {
+                        scratch.push_back('&');
+                    } else if(ref == "quot") {
+                        scratch.push_back('"');
+                    } else if(ref == "apos") {
+                        scratch.push_back('\'');
+                    } else if(ref.size() >= 2 && ref[0] == '#') {
+                        char* endPtr = NULL;
+                        const bool hex = (ref[1] == 'x');
+                        const unsigned long cp = strtoul(ref.data() + (hex ? 2 : 1), &endPtr, hex ? 16 : 10);
+                        if(endPtr != semicolon || cp == 0 || cp > 0x10FFFF)
+                            return fail("invalid character reference");
+                        /* UTF-8 */
+                        if(cp < 0x80) {
+                            scratch.push_back((char)cp);
+                        } else if(cp < 0x800) {
+                            scratch.push_back((char)(0xC0 | (cp >> 6)));
+                            scratch.push_back((char)(0x80 | (cp & 0x3F)));
+                        } else if(cp < 0x10000) {
+                            scratch.push_back((char)(0xE0 | (cp >> 12)));
+                            scratch.push_back((char)(0x80 | ((cp >> 6) & 0x3F)));
+                            scratch.push_back((char)(0x80 | (cp & 0x3F)));
+                        } else {
+                            scratch.push_back((char)(0xF0 | (cp >> 18)));
+                            scratch.push_back((char)(0x80 | ((cp >> 12) & 0x3F)));
+                            scratch.push_back((char)(0x80 | ((cp >> 6) & 0x3F)));
+                            scratch.push_back((char)(0x80 | (cp & 0x3F)));
+                        }
+                    } else {
+                        return fail("unknown entity");
+                    }
+                    i = semicolon - p;
+                } else {
+                    scratch.push_back(c);
+                }
+            }
+
+            out = StrRef(scratch.data(), scratch.size());
+            return true;
+        }
+
+        bool XmlParser::fail(const char* reason)
+        {
+            if(!failed)
+                ERRMSG("XML parser: %s.", reason);
+            failed = true;
+            return false;
+        }
+
+        void XmlDocument::parse(BasicDocumentHandler& handler)
+        {
+            XmlParser parser(handler);
+            if(!parser.feed(buffer, size, true))
+                ERRMSG("Could not parse the XML document.");
+        }
+    }
+}
@@ -0,0 +1,122 @@
+/****************************************************************************
+ * XmlParser.h                                                              *
+ ****************************************************************************
+ * Copyright (C) 2026                                                       *
+ *                                                                          *
+ * Created on: Oct 19, 2026                                                 *
+ * Authors: agent <agent@local>                                             *
+ *                                                                          *
+ * This program is free software: you can redistribute it and/or modify     *
+ * it under the terms of the GNU General Public License as published by     *
+ * the Free Software Foundation, either version 3 of the License, or        *
+ * (at your option) any later version.                                      *
+ *                                                                          *
+ * This program is distributed in the hope that it will be useful,          *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ * GNU General Public License for more details.                             *
+ *                                                                          *
+ * You should have received a copy of the GNU General Public License        *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.     *
+ ****************************************************************************/
+#ifndef XMLPARSER_H_
+#define XMLPARSER_H_
+
+#include "xml/basic_xml.h"
+
+#include <string>
+#include <vector>
+
+namespace dashp2p {
+
+    namespace xml {
+
+        /**
+         * Small, self-contained XML parser for MPDs. Accepts the document in arbitrary chunks, as it is received,
+         * and reports everything that is complete so far. Names and values are passed as references into the
+         * chunk, except for values with entity or character references, which are decoded into a scratch buffer.
+         *
+         * Reports what the libxml2 reader used to: namespace declarations as ordinary attributes, qualified names
+         * as they are, each text or CDATA section separately, whitespace-only text not at all.
+         * Not supported: DTDs (skipped), other encodings than UTF-8.
+         */
+        class XmlParser {
+        public:
+            XmlParser(BasicDocumentHandler& handler);
+            virtual ~XmlParser() {}
+
+            /**
+             * Parses the next size bytes of the document. Set last when the document is complete.
+             * Returns false if the document is not well-formed.
+             */
+            bool feed(const char* p, size_t size, bool last);
+
+        private:
+            /* Parses complete tokens in [p, p + size). Returns the number of bytes consumed. Sets failed on error. */
+            size_t parse(const char* p, size_t size, bool last);
+            /* Token starting with '<'. Returns its length, 0 if incomplete. */
+            size_t parseMarkup(const char* p, size_t size);
+            size_t parseStartTag(const char* p, size_t size);
+            size_t parseEndTag(const char* p, size_t size);
+            void text(const char* p, size_t size);
+            /* Resolves references (and, in attribute values, normalizes white space) if necessary. */
+            bool decode(const char* p, size_t size, bool attribute, StrRef& out);
+            bool fail(const char* reason);
+
+            BasicDocumentHandler& handler;
+
+            /* Incomplete token at the end of the last chunk. */
+            std::string carry;
+            std::string scratch;
+
+            /* Attributes of the start tag being parsed, as offsets into it. */
+            struct Attribute {
+                size_t name;
+                size_t nameLength;
+                size_t value;
+                size_t valueLength;
+            };
+            std::vector<Attribute> attributes;
+
+            /* Names of the open elements, one after another. */
+            std::string openNames;
+            std::vector<size_t> openNameStarts;
+
+            bool bomChecked;
+            bool rootDone;
+            bool failed;
+        };
+
+        /**
+         * Complete document in memory.
+         */
+        class XmlDocument: public BasicDocument {
+        public:
+            /* Takes over buffer. */
+            XmlDocument(char* buffer, int size): buffer(buffer), size(size) {}
+            virtual ~XmlDocument() {delete[] buffer;}
+
+            virtual void parse(BasicDocumentHandler& handler);
+
+        private:
+            char* buffer;
+            int size;
+        };
+
+        class XmlDocumentFactory: public BasicDocumentFactory {
+        public:
+            XmlDocumentFactory() {}
+            virtual ~XmlDocumentFactory() {}
+
+            /**
+             * Takes the ownership of the memory buffer.
+             * @param xml Will be deleted when the document is deleted.
+             */
+            virtual BasicDocument* createDocument(char *xml, int size) {return new XmlDocument(xml, size);}
+        };
+
+    }
+
+}
+
+#endif /* XMLPARSER_H_ */
@@ -24,17 +24,43 @@
 #define BASIC_XML_H_
 
 #include <string>
+#include <cstring>
 
 namespace dashp2p {
     namespace xml {
+        /**
+         * Characters owned by someone else, usually the document buffer. Not null-terminated.
+         * Only valid during the handler call it is passed to.
+         */
+        class StrRef {
+        public:
+            StrRef(): _p(NULL), _n(0) {}
+            StrRef(const char* p, size_t n): _p(p), _n(n) {}
+
+            const char* data() const {return _p;}
+            size_t size() const {return _n;}
+            bool empty() const {return _n == 0;}
+            char operator[](size_t i) const {return _p[i];}
+
+            std::string str() const {return std::string(_p, _n);}
+            operator std::string() const {return str();}
+
+            bool operator==(const char* s) const {return strncmp(_p, s, _n) == 0 && s[_n] == '\0';}
+            bool operator!=(const char* s) const {return !operator==(s);}
+
+        private:
+            const char* _p;
+            size_t _n;
+        };
+
         class BasicDocumentHandler {
         public:
             virtual ~BasicDocumentHandler() {}
             virtual void onDocumentStart()= 0;
-            virtual void onAttribute(const std::string& name, const std::string& value)= 0;
-            virtual void onElementStart(const std::string& name)= 0;
-            virtual void onElementValue(const std::string& value)= 0;
-            virtual void onElementEnd(const std::string& name)= 0;
+            virtual void onAttribute(const StrRef& name, const StrRef& value)= 0;
+            virtual void onElementStart(const StrRef& name)= 0;
+            virtual void onElementValue(const StrRef& value)= 0;
+            virtual void onElementEnd(const StrRef& name)= 0;
             virtual void onDocumentEnd()= 0;
         };
 